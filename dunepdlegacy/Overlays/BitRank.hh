@@ -0,0 +1,93 @@
+// BitRank.hh
+// Rank index over a bitfield, used to find the stored headers of the faulty
+// frames of reordered fragments.
+
+#ifndef artdaq_dune_Overlays_BitRank_hh
+#define artdaq_dune_Overlays_BitRank_hh
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+namespace dune {
+
+// Number of set bits before any bit of a bitfield of num_bits bits, bit i
+// being bit i % 8 of byte i / 8. The field is read in 64 bit words, and the
+// index holds the count before every block of eight words, so a rank takes
+// at most eight popcounts. The index is only built on the first call to
+// rank(), which may come from several threads at once.
+class BitRank {
+ public:
+  static constexpr size_t block_bits = 512;
+
+  BitRank(const uint8_t* bits, const size_t num_bits)
+      : bits_(bits), num_bits_(num_bits) {}
+  // A copy builds its own index when needed.
+  BitRank(const BitRank& other) : bits_(other.bits_), num_bits_(other.num_bits_) {}
+  BitRank& operator=(const BitRank&) = delete;
+
+  size_t size() const { return num_bits_; }
+
+  bool test(const size_t i) const { return (bits_[i / 8] >> (i % 8)) & 1; }
+
+  // Number of set bits in [0, i), for i up to size().
+  size_t rank(const size_t i) const {
+    std::call_once(built_, [this] { build(); });
+    const size_t last_word = i / 64;
+    size_t count = blocks_[i / block_bits];
+    for (size_t w = i / block_bits * (block_bits / 64); w < last_word; ++w) {
+      count += __builtin_popcountll(word(w));
+    }
+    if (i % 64) {
+      count += __builtin_popcountll(word(last_word) & ((1ul << (i % 64)) - 1));
+    }
+    return count;
+  }
+
+  // Number of set bits.
+  size_t count() const { return rank(num_bits_); }
+
+ private:
+  const uint8_t* bits_;
+  size_t num_bits_;
+  mutable std::once_flag built_;
+  mutable std::vector<uint32_t> blocks_;
+
+  // The 64 bit word w, without reading beyond the field.
+  uint64_t word(const size_t w) const {
+    const size_t num_bytes = (num_bits_ + 7) / 8;
+    uint64_t result = 0;
+    const size_t begin = 8 * w;
+    if (begin < num_bytes) {
+      memcpy(&result, bits_ + begin,
+             begin + 8 <= num_bytes ? 8 : num_bytes - begin);
+    }
+    return result;
+  }
+
+  void build() const {
+    const size_t num_words = (num_bits_ + 63) / 64;
+    // One count per started block, and one after the last for a full block
+    blocks_.resize(num_words / (block_bits / 64) + 1);
+    uint32_t count = 0;
+    for (size_t w = 0; w < num_words; ++w) {
+      if (w % (block_bits / 64) == 0) {
+        blocks_[w / (block_bits / 64)] = count;
+      }
+      uint64_t bits = word(w);
+      if (w + 1 == num_words && num_bits_ % 64) {
+        bits &= (1ul << (num_bits_ % 64)) - 1;
+      }
+      count += __builtin_popcountll(bits);
+    }
+    if (num_words % (block_bits / 64) == 0) {
+      blocks_[num_words / (block_bits / 64)] = count;
+    }
+  }
+};
+
+}  // namespace dune
+
+#endif /* artdaq_dune_Overlays_BitRank_hh */
@@ -0,0 +1,194 @@
+// FelixChannelStats.hh accumulates per-channel statistics of FELIX data in a
+// single pass over decoded channel-major blocks.
+
+#ifndef artdaq_dune_Overlays_FelixChannelStats_hh
+#define artdaq_dune_Overlays_FelixChannelStats_hh
+
+#include <immintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
+
+namespace dune {
+
+// Mean, RMS, minimum, maximum and optionally a histogram of the ADC values of
+// all 256 channels of a fiber. The moments are kept as integer sums, so that
+// accumulators filled by different threads or from different files merge
+// exactly and in any order. ADC values are taken to be 12 bit, as the FELIX
+// format stores them.
+class FelixChannelStats {
+ public:
+  static constexpr unsigned num_channels = 256;
+  static constexpr unsigned num_bins = 4096;
+
+  FelixChannelStats(const bool histograms = false)
+      : moments_(num_channels),
+        histograms_(histograms ? num_channels * num_bins : 0, 0) {}
+
+  // Add num_samples values of channels first_ch to last_ch from a block of
+  // rows of stride values, one row per channel. Threads may fill disjoint
+  // channel ranges of the same accumulator.
+  void add(const adc_t* adcs, const size_t stride, const size_t num_samples,
+           const unsigned first_ch = 0,
+           const unsigned last_ch = num_channels) {
+    const bool avx2 = FelixReorder::avx_available();
+    for (unsigned ch = first_ch; ch < last_ch && ch < num_channels; ++ch) {
+      const adc_t* row = adcs + ch * stride;
+      if (avx2) {
+        add_row_avx2(row, num_samples, moments_[ch]);
+      } else {
+        add_row_baseline(row, num_samples, moments_[ch]);
+      }
+      if (!histograms_.empty()) {
+        uint64_t* hist = histograms_.data() + ch * num_bins;
+        for (size_t i = 0; i < num_samples; ++i) {
+          ++hist[std::min<unsigned>(row[i], num_bins - 1)];
+        }
+      }
+    }
+  }
+
+  // Add all frames of a fragment.
+  void add(const dune::FelixFragment& flxfrag) {
+    flxfrag.get_all_ADCs(buffer_);
+    add(buffer_.data(), flxfrag.total_frames(), flxfrag.total_frames());
+  }
+
+  void merge(const FelixChannelStats& other) {
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+      Moments& m = moments_[ch];
+      const Moments& o = other.moments_[ch];
+      m.count += o.count;
+      m.sum += o.sum;
+      m.sumsq += o.sumsq;
+      m.min = std::min(m.min, o.min);
+      m.max = std::max(m.max, o.max);
+    }
+    if (!histograms_.empty() && !other.histograms_.empty()) {
+      for (size_t i = 0; i < histograms_.size(); ++i) {
+        histograms_[i] += other.histograms_[i];
+      }
+    }
+  }
+
+  void clear() {
+    std::fill(moments_.begin(), moments_.end(), Moments());
+    std::fill(histograms_.begin(), histograms_.end(), 0);
+  }
+
+  uint64_t count(const unsigned ch) const { return moments_[ch].count; }
+  uint64_t sum(const unsigned ch) const { return moments_[ch].sum; }
+  double mean(const unsigned ch) const {
+    const Moments& m = moments_[ch];
+    return m.count ? (double)m.sum / m.count : 0;
+  }
+  // Population variance, from the exact integer sums.
+  double variance(const unsigned ch) const {
+    const Moments& m = moments_[ch];
+    if (m.count == 0) return 0;
+    // With sum = q * count + r the squared deviations are
+    // sumsq - q * (sum + r) - r^2 / count, the first part exactly in integers.
+    const uint64_t q = m.sum / m.count;
+    const uint64_t r = m.sum % m.count;
+    const double m2 = (m.sumsq - q * (m.sum + r)) - (double)r * r / m.count;
+    return m2 / m.count;
+  }
+  double rms(const unsigned ch) const { return sqrt(variance(ch)); }
+  adc_t min(const unsigned ch) const { return moments_[ch].min; }
+  adc_t max(const unsigned ch) const { return moments_[ch].max; }
+
+  bool has_histograms() const { return !histograms_.empty(); }
+  // Counts of the values 0 to num_bins - 1 of a channel.
+  const uint64_t* histogram(const unsigned ch) const {
+    return histograms_.empty() ? nullptr : histograms_.data() + ch * num_bins;
+  }
+
+ private:
+  struct Moments {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t sumsq = 0;
+    adc_t min = 0xffff;
+    adc_t max = 0;
+  };
+
+  std::vector<Moments> moments_;
+  std::vector<uint64_t> histograms_;
+  adc_aligned_v buffer_;
+
+  static void add_row_baseline(const adc_t* row, const size_t n, Moments& m) {
+    uint64_t sum = 0, sumsq = 0;
+    adc_t lo = m.min, hi = m.max;
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t v = row[i];
+      sum += v;
+      sumsq += v * v;
+      lo = std::min<adc_t>(lo, v);
+      hi = std::max<adc_t>(hi, v);
+    }
+    m.count += n;
+    m.sum += sum;
+    m.sumsq += sumsq;
+    m.min = lo;
+    m.max = hi;
+  }
+
+  // Sums and squares are built with pairwise multiply-adds into 32-bit
+  // lanes, which are widened to 64 bit before they can overflow.
+  FELIX_REORDER_AVX2 static void add_row_avx2(const adc_t* row, const size_t n,
+                                              Moments& m) {
+    // Each iteration adds at most 2 * 4095^2 to a lane of squares.
+    const size_t flush_iterations = 64;
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i lo = _mm256_set1_epi16((short)m.min);
+    __m256i hi = _mm256_set1_epi16((short)m.max);
+    __m256i sum64 = _mm256_setzero_si256(), sumsq64 = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 16 <= n) {
+      __m256i sum32 = _mm256_setzero_si256(), sumsq32 = _mm256_setzero_si256();
+      for (size_t it = 0; it < flush_iterations && i + 16 <= n;
+           ++it, i += 16) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        lo = _mm256_min_epu16(lo, v);
+        hi = _mm256_max_epu16(hi, v);
+        sum32 = _mm256_add_epi32(sum32, _mm256_madd_epi16(v, ones));
+        sumsq32 = _mm256_add_epi32(sumsq32, _mm256_madd_epi16(v, v));
+      }
+      const __m256i zero = _mm256_setzero_si256();
+      sum64 = _mm256_add_epi64(sum64, _mm256_unpacklo_epi32(sum32, zero));
+      sum64 = _mm256_add_epi64(sum64, _mm256_unpackhi_epi32(sum32, zero));
+      sumsq64 = _mm256_add_epi64(sumsq64, _mm256_unpacklo_epi32(sumsq32, zero));
+      sumsq64 = _mm256_add_epi64(sumsq64, _mm256_unpackhi_epi32(sumsq32, zero));
+    }
+
+    alignas(32) uint64_t sums[4], sumsqs[4];
+    alignas(32) adc_t los[16], his[16];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sum64);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sumsqs), sumsq64);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(los), lo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(his), hi);
+    Moments part;
+    part.count = i;
+    for (unsigned l = 0; l < 4; ++l) {
+      part.sum += sums[l];
+      part.sumsq += sumsqs[l];
+    }
+    part.min = *std::min_element(los, los + 16);
+    part.max = *std::max_element(his, his + 16);
+    add_row_baseline(row + i, n - i, part);
+
+    m.count += part.count;
+    m.sum += part.sum;
+    m.sumsq += part.sumsq;
+    m.min = part.min;
+    m.max = part.max;
+  }
+};
+
+}  // namespace dune
+
+#endif /* artdaq_dune_Overlays_FelixChannelStats_hh */
@@ -5,13 +5,12 @@
 #ifndef artdaq_dune_Overlays_FelixComp_hh
 #define artdaq_dune_Overlays_FelixComp_hh
 
-// Option for previous value subtraction.
-#define PREV
-
 #include <bitset>  // testing
 #include <cmath>   // log
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -19,8 +18,10 @@
 #include <chrono>
 
 #include "artdaq-core/Data/Fragment.hh"
+#include "cetlib_except/exception.h"
 #include "dunepdlegacy/Overlays/FelixFormat.hh"
 #include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
 
 namespace dune {
 
@@ -61,8 +62,8 @@ struct HuffTree {
     return one.value < other.value;
   }
 
-  Node* root;
-  Node* nodelist;
+  Node* root = NULL;
+  Node* nodelist = NULL;
   std::unordered_map<uint16_t, Node*> nodes;
 
   // Function to get a node from a value.
@@ -121,7 +122,7 @@ struct HuffTree {
     } else {
       // Move one node down.
       generate_codes(loc->left, buff, len + 1);
-      generate_codes(loc->right, buff | (1 << len), len + 1);
+      generate_codes(loc->right, buff | ((size_t)1 << len), len + 1);
     }
 
     // Move one node up.
@@ -191,8 +192,174 @@ struct HuffTree {
   ~HuffTree() { delete[] nodelist; }
 };
 
+// Table driven decoder for the codes of a Huffman tree. Codes are written
+// with their first bit in the least significant position, so the next bits of
+// the stream index a table directly. An entry of the primary table holds up
+// to two values whose codes fit in its index. Longer codes continue in
+// sub-tables indexed by the bits that follow.
+class HuffDecoder {
+ public:
+  static constexpr unsigned primary_bits = 11;
+  static constexpr unsigned secondary_bits = 8;
+
+  HuffDecoder(const HuffTree& tree) : table(1ul << primary_bits) {
+    fill_table(0, primary_bits, tree.root, 0, 0);
+    pair_entries();
+  }
+
+  // Decode num_values values from the bit stream [src, end) into dst.
+  void decode(adc_t* dst, const size_t num_values, const uint8_t* src,
+              const uint8_t* end) const {
+    uint64_t bitbuf = 0;
+    unsigned bitcount = 0;
+    auto refill = [&]() {
+      if (end - src >= 8) {
+        uint64_t word;
+        memcpy(&word, src, sizeof(word));
+        bitbuf |= word << bitcount;
+        src += (63 - bitcount) >> 3;
+        bitcount |= 56;
+      } else {
+        while (bitcount <= 56 && src < end) {
+          bitbuf |= (uint64_t)*src++ << bitcount;
+          bitcount += 8;
+        }
+        // Past the end of the stream only zeros follow.
+        if (src == end) bitcount = 64;
+      }
+    };
+    auto lookup = [&]() {
+      refill();
+      const Entry* e = &table[bitbuf & ((1ul << primary_bits) - 1)];
+      while (e->num_values == 0) {
+        // Continue in a sub-table.
+        bitbuf >>= e->length;
+        bitcount -= e->length;
+        if (bitcount < e->sub_bits) refill();
+        e = &table[e->sub + (bitbuf & ((1ul << e->sub_bits) - 1))];
+      }
+      return e;
+    };
+
+    size_t i = 0;
+    while (i + 1 < num_values) {
+      const Entry* e = lookup();
+      dst[i] = e->values[0];
+      dst[i + 1] = e->values[1];
+      i += e->num_values;
+      bitbuf >>= e->length;
+      bitcount -= e->length;
+    }
+    // A last value is taken from a pair entry without writing past dst.
+    if (i < num_values) {
+      dst[i] = lookup()->values[0];
+    }
+  }
+
+ private:
+  struct Entry {
+    adc_t values[2] = {0, 0};
+    // Number of decoded values, zero for a link to a sub-table.
+    uint8_t num_values = 0;
+    // Number of bits consumed by this entry.
+    uint8_t length = 0;
+    // Index bits and position of the sub-table.
+    uint8_t sub_bits = 0;
+    uint32_t sub = 0;
+  };
+  std::vector<Entry> table;
+
+  static unsigned height(const HuffTree::Node* node) {
+    if (node->left == NULL) return 0;
+    return 1 + std::max(height(node->left), height(node->right));
+  }
+
+  // Fill the table of 2^bits entries at offset with the leaves below node,
+  // which is reached after depth bits forming prefix.
+  void fill_table(const size_t offset, const unsigned bits,
+                  const HuffTree::Node* node, const unsigned depth,
+                  const size_t prefix) {
+    if (node->left == NULL) {
+      for (size_t idx = prefix; idx < (1ul << bits); idx += 1ul << depth) {
+        Entry& e = table[offset + idx];
+        e.values[0] = node->value;
+        e.num_values = 1;
+        e.length = depth;
+      }
+      return;
+    }
+    if (depth == bits) {
+      const unsigned sub_bits = std::min(secondary_bits, height(node));
+      const size_t sub = table.size();
+      table.resize(sub + (1ul << sub_bits));
+      fill_table(sub, sub_bits, node, 0, 0);
+      Entry& e = table[offset + prefix];
+      e.length = bits;
+      e.sub_bits = sub_bits;
+      e.sub = sub;
+      return;
+    }
+    fill_table(offset, bits, node->left, depth + 1, prefix);
+    fill_table(offset, bits, node->right, depth + 1, prefix | 1ul << depth);
+  }
+
+  // Append a second value to primary entries whose remaining bits hold a
+  // complete code.
+  void pair_entries() {
+    const std::vector<Entry> single(table.begin(),
+                                    table.begin() + (1ul << primary_bits));
+    for (size_t idx = 0; idx < single.size(); ++idx) {
+      const Entry& first = single[idx];
+      if (first.num_values != 1) continue;
+      const Entry& second = single[idx >> first.length];
+      if (second.num_values != 1 ||
+          first.length + second.length > primary_bits) {
+        continue;
+      }
+      Entry& e = table[idx];
+      e.values[1] = second.values[0];
+      e.num_values = 2;
+      e.length = first.length + second.length;
+    }
+  }
+};
+
+// The compression method doubles as the format version. Version 1 holds the
+// ADC values of all channels in a single bit stream. Version 2 starts the
+// values of every channel on a byte boundary and records the byte offsets of
+// the channels ahead of the stream, so that channels can be decoded on their
+// own and in parallel. Version 3 follows the metadata with the prediction
+// mode and, for pedestal prediction, the pedestals of all channels. Earlier
+// versions always encode differences to the previous value.
+//
+// The version is split into the two low bits, where versions 1 to 3 have
+// always been, and a high bit taken from the top of unique_values. That field
+// counts the leaves of the Huffman tree, one per distinct value, so it is at
+// most 4096 for 12-bit values. This fits in 13 bits, and the high bit was
+// zero in all data written so far. This leaves room for versions up to 7
+// without changing the layout.
 struct MetaData {
-  uint32_t comp_method : 2, unique_values : 14, num_frames : 16;
+  uint32_t comp_method : 2, unique_values : 13, comp_method_high : 1,
+      num_frames : 16;
+
+  static constexpr unsigned max_version = 7;
+  // The version written, and the latest the decompressor understands.
+  static constexpr unsigned latest_version = 3;
+
+  unsigned version() const { return comp_method | comp_method_high << 2; }
+  void set_version(const unsigned v) {
+    comp_method = v & 3;
+    comp_method_high = v >> 2;
+  }
+};
+static_assert(sizeof(MetaData) == 4, "MetaData layout changed");
+
+// Prediction applied to the ADC values of a channel before encoding. The
+// difference to the prediction is encoded modulo 2^12.
+enum class Prediction : uint8_t {
+  raw = 0,       // No prediction.
+  previous = 1,  // The previous value of the channel.
+  pedestal = 2   // The median value of the channel.
 };
 
 //========================
@@ -213,11 +380,40 @@ class FelixCompressor {
   // Huffman tree storage for easy access.
   HuffTree hufftree;
 
+  // ADC values are 12-bit, so are their differences modulo 2^12.
+  static constexpr size_t num_symbols = 1ul << 12;
+  // Number of frames checked and unpacked at a time.
+  static constexpr size_t chunk_frames = 64;
+
+  // The values of a chunk of frames in channel-major order are predicted as
+  // they are unpacked, once for the histogram and once for encoding. Only
+  // pedestal prediction needs all values of a channel at once.
+  adc_aligned_v chunk = adc_aligned_v(FelixFrame::num_ch_per_frame * chunk_frames);
+  adc_aligned_v values;
+  std::vector<adc_t> last;
+  std::vector<uint32_t> histogram = std::vector<uint32_t>(num_symbols, 0);
+  // Huffman code of every value with its length in the upper byte.
+  std::vector<uint64_t> codebook = std::vector<uint64_t>(num_symbols, 0);
+  static constexpr unsigned codebook_length_shift = 56;
+
+  // Prediction of the values and the pedestals it may use.
+  const Prediction prediction;
+  std::vector<adc_t> pedestals;
+
+  // Fields for storing which frames have faulty headers.
+  std::vector<uint8_t> bad_headers;
+
  public:
-  FelixCompressor(const uint8_t* data, const size_t num_frames = 10000)
-      : input(data), input_length(num_frames * sizeof(dune::FelixFrame)) {}
-  FelixCompressor(const dune::FelixFragment& frag)
-      : input(frag.dataBeginBytes()), input_length(frag.dataSizeBytes()) {}
+  FelixCompressor(const uint8_t* data, const size_t num_frames = 10000,
+                  const Prediction prediction = Prediction::previous)
+      : input(data),
+        input_length(num_frames * sizeof(dune::FelixFrame)),
+        prediction(prediction) {}
+  FelixCompressor(const dune::FelixFragment& frag,
+                  const Prediction prediction = Prediction::previous)
+      : input(frag.dataBeginBytes()),
+        input_length(frag.dataSizeBytes()),
+        prediction(prediction) {}
 
   // Function to store metadata in a recognisable format.
   void store_metadata(std::vector<char>& out) {
@@ -225,73 +421,158 @@ class FelixCompressor {
     // work with.
     out.clear();
 
-    MetaData meta = {1, 0, (uint32_t)num_frames};
+    MetaData meta = {0, 0, 0, (uint32_t)num_frames};
+    meta.set_version(MetaData::latest_version);
     out.resize(sizeof(meta));
     memcpy(&out[0], &meta, sizeof(meta));
   }
 
-  // Function to reduce headers and error fields upon error encounter.
-  void header_reduce(std::vector<char>& out) {
-    // Fields for storing which frames have faulty headers.
-    std::vector<uint8_t> bad_headers(num_frames/8 + 1);
-    // Check all error fields and increments of timestamp and CCC.
-    for (unsigned i = 1; i < num_frames; ++i) {
-      bool check_failed = false;
-
-      // WIB header checks.
-      check_failed |= frame_()->sof() ^ frame_(i)->sof();
-      check_failed |= frame_()->version() ^ frame_(i)->version();
-      check_failed |= frame_()->fiber_no() ^ frame_(i)->fiber_no();
-      check_failed |= frame_()->crate_no() ^ frame_(i)->crate_no();
-      check_failed |= frame_()->slot_no() ^ frame_(i)->slot_no();
-      check_failed |= frame_()->mm() ^ frame_(i)->mm();
-      check_failed |= frame_()->oos() ^ frame_(i)->oos();
-      check_failed |= frame_()->wib_errors() ^ frame_(i)->wib_errors();
-      check_failed |= frame_()->z() ^ frame_(i)->z();
+  // Function to check whether the headers of a frame differ from what is
+  // expected from the first frame.
+  bool header_differs(const unsigned i) const {
+    bool check_failed = false;
+
+    // WIB header checks.
+    check_failed |= frame_()->sof() ^ frame_(i)->sof();
+    check_failed |= frame_()->version() ^ frame_(i)->version();
+    check_failed |= frame_()->fiber_no() ^ frame_(i)->fiber_no();
+    check_failed |= frame_()->crate_no() ^ frame_(i)->crate_no();
+    check_failed |= frame_()->slot_no() ^ frame_(i)->slot_no();
+    check_failed |= frame_()->mm() ^ frame_(i)->mm();
+    check_failed |= frame_()->oos() ^ frame_(i)->oos();
+    check_failed |= frame_()->wib_errors() ^ frame_(i)->wib_errors();
+    check_failed |= frame_()->z() ^ frame_(i)->z();
+
+    check_failed |=
+        (uint64_t)(frame_()->timestamp() + 25 * i) ^ frame_(i)->timestamp();
+
+    // COLDATA header checks.
+    for (unsigned j = 0; j < 4; ++j) {
+      check_failed |= frame_()->s1_error(j) ^ frame_(i)->s1_error(j);
+      check_failed |= frame_()->s2_error(j) ^ frame_(i)->s2_error(j);
+      check_failed |= frame_()->checksum_a(j) ^ frame_(i)->checksum_a(j);
+      check_failed |= frame_()->checksum_b(j) ^ frame_(i)->checksum_b(j);
+      check_failed |=
+          frame_()->error_register(j) ^ frame_(i)->error_register(j);
+      for (unsigned h = 0; h < 8; ++h) {
+        check_failed |= frame_()->hdr(j, h) ^ frame_(i)->hdr(j, h);
+      }
 
       check_failed |=
-          (uint64_t)(frame_()->timestamp() + 25 * i) ^ frame_(i)->timestamp();
-
-      // COLDATA header checks.
-      for (unsigned j = 0; j < 4; ++j) {
-        check_failed |= frame_()->s1_error(j) ^ frame_(i)->s1_error(j);
-        check_failed |= frame_()->s2_error(j) ^ frame_(i)->s2_error(j);
-        check_failed |= frame_()->checksum_a(j) ^ frame_(i)->checksum_a(j);
-        check_failed |= frame_()->checksum_b(j) ^ frame_(i)->checksum_b(j);
-        check_failed |=
-            frame_()->error_register(j) ^ frame_(i)->error_register(j);
-        for (unsigned h = 0; h < 8; ++h) {
-          check_failed |= frame_()->hdr(j, h) ^ frame_(i)->hdr(j, h);
-        }
+          (uint16_t)(frame_()->coldata_convert_count(j) + 25 * i) ^
+          frame_(i)->coldata_convert_count(j);
+    }
+
+    return check_failed;
+  }
+
+  // Function to provide the predicted values of frames [begin, end) as rows
+  // of stride values per channel. Chunks are requested in order.
+  const adc_t* predict_chunk(const size_t begin, const size_t end,
+                             size_t& stride) {
+    if (prediction == Prediction::pedestal) {
+      stride = num_frames;
+      return values.data() + begin;
+    }
 
-        check_failed |=
-            (uint16_t)(frame_()->coldata_convert_count(j) + 25 * i) ^
-            frame_(i)->coldata_convert_count(j);
+    // Unpack this chunk into the channel rows.
+    stride = chunk_frames;
+    FelixReorder::unpack(chunk.data(),
+                         reinterpret_cast<uint8_t const*>(frame_(begin)),
+                         end - begin, chunk_frames);
+    if (prediction != Prediction::previous) return chunk.data();
+
+    if (begin == 0) {
+      // The first value of a channel is stored as is.
+      last.assign(FelixFrame::num_ch_per_frame, 0);
+    }
+    for (unsigned ch = 0; ch < FelixFrame::num_ch_per_frame; ++ch) {
+      adc_t* row = chunk.data() + ch * chunk_frames;
+      adc_t prev = last[ch];
+      for (size_t i = 0; i < end - begin; ++i) {
+        const adc_t curr_val = row[i];
+        row[i] = (curr_val - prev) & (num_symbols - 1);
+        prev = curr_val;
       }
+      last[ch] = prev;
+    }
+    return chunk.data();
+  }
 
-      // Set a bit if anything failed.
-      if (check_failed) {
-        bad_headers[i/8] |= 1 << (i%8);
+  // Function to go through the fragment once, checking the headers of every
+  // frame and building the histogram of the predicted values.
+  void scan_frames() {
+    bad_headers.assign(num_frames / 8 + 1, 0);
+    if (prediction == Prediction::pedestal) {
+      subtract_pedestals();
+    }
+
+    for (size_t begin = 0; begin < num_frames; begin += chunk_frames) {
+      const size_t end = std::min(num_frames, begin + chunk_frames);
 
-        // std::cout << "Check failed at the " << i << "th frame.\n";
+      // Set a bit if anything failed.
+      for (size_t i = std::max(begin, (size_t)1); i < end; ++i) {
+        if (header_differs(i)) {
+          bad_headers[i / 8] |= 1 << (i % 8);
+        }
+      }
 
-        // std::cout << "First frame:\n";
-        // frame_(i - 1)->print();
-        // std::cout << "Second frame:\n";
-        // frame_(i)->print();
+      size_t stride;
+      const adc_t* rows = predict_chunk(begin, end, stride);
+      for (unsigned ch = 0; ch < FelixFrame::num_ch_per_frame; ++ch) {
+        const adc_t* row = rows + ch * stride;
+        for (size_t i = 0; i < end - begin; ++i) {
+          ++histogram[row[i]];
+        }
+      }
+    }
+  }
 
-        // exit(1);
+  // Function to unpack all values and subtract the median of every channel.
+  void subtract_pedestals() {
+    values.resize(num_frames * FelixFrame::num_ch_per_frame);
+    FelixReorder::unpack(values.data(),
+                         reinterpret_cast<uint8_t const*>(frame_()),
+                         num_frames, num_frames);
+
+    pedestals.resize(FelixFrame::num_ch_per_frame);
+    std::vector<adc_t> sorted(num_frames);
+    for (unsigned ch = 0; ch < FelixFrame::num_ch_per_frame; ++ch) {
+      adc_t* row = values.data() + ch * num_frames;
+      std::copy(row, row + num_frames, sorted.begin());
+      std::nth_element(sorted.begin(), sorted.begin() + num_frames / 2,
+                       sorted.end());
+      pedestals[ch] = num_frames == 0 ? 0 : sorted[num_frames / 2];
+      for (size_t i = 0; i < num_frames; ++i) {
+        row[i] = (row[i] - pedestals[ch]) & (num_symbols - 1);
       }
-    }  // Loop over all frames.
+    }
+  }
+
+  // Function to record the prediction mode and the pedestals it needs.
+  void store_prediction(std::vector<char>& out) {
+    size_t tail = out.size();
+    out.resize(tail + 1);
+    out[tail] = static_cast<char>(prediction);
+
+    if (prediction == Prediction::pedestal) {
+      tail = out.size();
+      out.resize(tail + pedestals.size() * sizeof(adc_t));
+      memcpy(&out[tail], pedestals.data(), pedestals.size() * sizeof(adc_t));
+    }
+  }
 
+  // Function to reduce headers and error fields upon error encounter.
+  void header_reduce(std::vector<char>& out) {
     // Record faulty frame field.
     size_t tail = out.size();
     out.resize(tail + num_frames/8+1);
     memcpy(&out[tail], &bad_headers[0], bad_headers.size());
 
-    // Record first headers.
+    // Record first headers. Without frames they are left zero.
     tail = out.size();
     out.resize(tail + sizeof(WIBHeader) + 4*sizeof(ColdataHeader));
+    if (num_frames == 0) return;
 
     memcpy(&out[tail], frame_()->wib_header(), sizeof(WIBHeader));
     memcpy(&out[tail + sizeof(WIBHeader)], frame_()->coldata_header(0),
@@ -305,7 +586,7 @@ class FelixCompressor {
 
     // Loop over frames again to record faulty headers.
     for(unsigned i = 1; i < num_frames; ++i) {
-      bool check_failed = (bad_headers[i / 8] >> (7 - (i % 8))) & 1;
+      bool check_failed = (bad_headers[i / 8] >> (i % 8)) & 1;
       if(!check_failed) { continue; }
 
       tail = out.size();
@@ -313,96 +594,136 @@ class FelixCompressor {
 
       memcpy(&out[tail], frame_(i)->wib_header(), sizeof(WIBHeader));
       for(unsigned j = 0; j < 4; ++j) {
-        memcpy(&out[tail + sizeof(WIBHeader)], frame_(i)->coldata_header(j),
-              sizeof(ColdataHeader));
+        memcpy(&out[tail + sizeof(WIBHeader) + j * sizeof(ColdataHeader)],
+               frame_(i)->coldata_header(j), sizeof(ColdataHeader));
       }
     }
   }
 
   // Function to generate a Huffman table and tree.
   void generate_Huff_tree(std::vector<char>& out) {
-    // Build a frequency table.
-    std::unordered_map<adc_t, uint32_t> freq_table;
-    for (unsigned vi = 0; vi < frame_()->num_ch_per_frame; ++vi) {
-      freq_table[frame_(0)->channel(vi)]++;
-      for (unsigned fri = 1; fri < num_frames; ++fri) {
-#ifdef PREV
-        adc_t curr_val = frame_(fri)->channel(vi) - frame_(fri - 1)->channel(vi);
-#else
-        adc_t curr_val = frame_(fri)->channel(vi);
-#endif
-        freq_table[curr_val]++;
-      }
+    // Insert the non-zero histogram entries into Huffman tree nodes.
+    std::vector<HuffTree::Node> nodes;
+    for (size_t v = 0; v < num_symbols; ++v) {
+      if (histogram[v] == 0) continue;
+      HuffTree::Node curr_node;
+      curr_node.value = v;
+      curr_node.frequency = histogram[v];
+      nodes.push_back(curr_node);
     }
 
     // Save the number of unique values to the metadata.
     MetaData* meta = reinterpret_cast<MetaData*>(&out[0]);
-    meta->unique_values = freq_table.size();
+    meta->unique_values = nodes.size();
 
     // Save the frequency table to the outgoing buffer so that the decompressor
     // can make a Huffman tree of its own.
     size_t tail = out.size();
-    out.resize(tail + freq_table.size() * (sizeof(adc_t) + 4));
-    for (auto p : freq_table) {
-      memcpy(&out[tail], &p.first, sizeof(p.first));
-      memcpy(&out[tail + sizeof(p.first)], &p.second, sizeof(p.second));
-      tail += sizeof(p.first) + sizeof(p.second);
+    out.resize(tail + nodes.size() * (sizeof(adc_t) + 4));
+    for (const auto& n : nodes) {
+      const adc_t value = n.value;
+      const uint32_t frequency = n.frequency;
+      memcpy(&out[tail], &value, sizeof(value));
+      memcpy(&out[tail + sizeof(value)], &frequency, sizeof(frequency));
+      tail += sizeof(value) + sizeof(frequency);
     }
 
-    // Insert the frequency table into Huffman tree nodes and calculate the
-    // information entropy according to Shannon.
-    // trj -- but since it's not printed out, clang complains.  Commenting it out.
-    std::vector<HuffTree::Node> nodes;
-    //double entropy = 0;
-    //const unsigned num_vals = num_frames * frame_()->num_ch_per_frame;
-    for (auto p : freq_table) {
-      HuffTree::Node curr_node;
-      curr_node.value = p.first;
-      curr_node.frequency = p.second;
-      nodes.push_back(curr_node);
-
-      //entropy += (double)p.second / num_vals * log((double)num_vals / p.second);
-    }
-    // std::cout << "ADC value entropy: " << entropy << " bits.\n";
-
-    // Connect the nodes in the tree according to Huffman's method.
+    // Connect the nodes in the tree according to Huffman's method and store
+    // the resulting codes in the codebook. Without frames there are none.
+    if (nodes.empty()) return;
     hufftree.make_tree(nodes);
+    for (auto p : hufftree.nodes) {
+      codebook[p.first] =
+          p.second->huffcode |
+          (uint64_t)p.second->hufflength << codebook_length_shift;
+    }
   }
 
   // Function to write ADC values using the Huffman table.
   void ADC_compress(std::vector<char>& out) {
-    // Resize the output buffer appropriately for the worst case.
-    const size_t tail = out.size();
-    out.resize(tail + sizeof(adc_t) * num_frames * 256);
-    // Record the encoded ADC values into the buffer.
-    unsigned rec_bits = 0;
-    const char* dest = &out[0] + tail;
-
-    for(unsigned j = 0; j < 256; ++j) {
-      adc_t curr_val = frame_(0)->channel(j);
-      *(unsigned long*)(dest + (rec_bits/8)) |= hufftree(curr_val)->huffcode << (rec_bits%8);
-      rec_bits += hufftree(curr_val)->hufflength;
-
-      for (unsigned i = 1; i < num_frames; ++i) {
-#ifdef PREV
-        adc_t curr_val = frame_(i)->channel(j) - frame_(i - 1)->channel(j);
-#else
-        adc_t curr_val = frame_(i)->channel(j);
-#endif
-
-        // No code is longer than 64 bits.
-        *(uint64_t*)(dest + (rec_bits/8)) |= hufftree(curr_val)->huffcode << (rec_bits%8);
-        rec_bits += hufftree(curr_val)->hufflength;
+    const size_t num_channels = FelixFrame::num_ch_per_frame;
+    const uint64_t code_mask = (1ul << codebook_length_shift) - 1;
+
+    // Every channel is written to a buffer of its own as the chunks of frames
+    // come by. The buffers start out at the average encoded channel length.
+    size_t num_bits = 0;
+    unsigned max_length = 0;
+    for (size_t v = 0; v < num_symbols; ++v) {
+      const unsigned length = codebook[v] >> codebook_length_shift;
+      num_bits += (size_t)histogram[v] * length;
+      if (histogram[v] != 0) max_length = std::max(max_length, length);
+    }
+    const size_t max_chunk_bytes =
+        chunk_frames * max_length / 8 + 1 + sizeof(uint64_t);
+    struct ChannelStream {
+      std::vector<char> bytes;
+      size_t size = 0;
+      uint64_t bitbuf = 0;
+      unsigned bitcount = 0;
+    };
+    std::vector<ChannelStream> streams(num_channels);
+    for (auto& stream : streams) {
+      stream.bytes.resize(num_bits / 8 / num_channels + max_chunk_bytes);
+    }
+
+    // Record the encoded ADC values. No code is longer than 56 bits.
+    for (size_t begin = 0; begin < num_frames; begin += chunk_frames) {
+      const size_t end = std::min(num_frames, begin + chunk_frames);
+      size_t stride;
+      const adc_t* rows = predict_chunk(begin, end, stride);
+
+      for (size_t ch = 0; ch < num_channels; ++ch) {
+        ChannelStream& stream = streams[ch];
+        if (stream.bytes.size() < stream.size + max_chunk_bytes) {
+          stream.bytes.resize(2 * stream.bytes.size() + max_chunk_bytes);
+        }
+        char* dest = stream.bytes.data() + stream.size;
+        uint64_t bitbuf = stream.bitbuf;
+        unsigned bitcount = stream.bitcount;
+        const adc_t* row = rows + ch * stride;
+        for (size_t i = 0; i < end - begin; ++i) {
+          const uint64_t code = codebook[row[i]];
+          bitbuf |= (code & code_mask) << bitcount;
+          bitcount += code >> codebook_length_shift;
+
+          // Flush all complete bytes.
+          memcpy(dest, &bitbuf, sizeof(bitbuf));
+          dest += bitcount / 8;
+          bitbuf >>= bitcount & ~7u;
+          bitcount %= 8;
+        }
+        stream.size = dest - stream.bytes.data();
+        stream.bitbuf = bitbuf;
+        stream.bitcount = bitcount;
       }
     }
-    // Resize output buffer to actual data length.
-    out.resize(tail + rec_bits / 8 + 1);
+
+    // Record the channel offsets, followed by the channels with their last
+    // bytes completed.
+    size_t tail = out.size();
+    out.resize(tail + num_channels * sizeof(uint32_t));
+    uint32_t offset = 0;
+    for (size_t ch = 0; ch < num_channels; ++ch) {
+      memcpy(&out[tail + ch * sizeof(offset)], &offset, sizeof(offset));
+      offset += streams[ch].size + (streams[ch].bitcount + 7) / 8;
+    }
+    tail = out.size();
+    out.resize(tail + offset);
+    for (const auto& stream : streams) {
+      const size_t length = stream.size + (stream.bitcount + 7) / 8;
+      memcpy(&out[tail], stream.bytes.data(), length);
+      tail += length;
+    }
   }
 
   // Function that calls all others relevant for compression.
   void compress_copy(std::vector<char>& out) {
     // auto comp_begin = std::chrono::high_resolution_clock::now();
     store_metadata(out);
+    // Check all error fields and increments of timestamp and CCC, and predict
+    // the values.
+    scan_frames();
+    store_prediction(out);
     // auto meta_end = std::chrono::high_resolution_clock::now();
     // std::cout << "Meta time taken: "
     //           << std::chrono::duration_cast<std::chrono::microseconds>(
@@ -434,136 +755,315 @@ class FelixCompressor {
 };  // FelixCompressor
 
 // Single function for compressing data from a fragment.
-std::vector<char> FelixCompress(const dune::FelixFragment& frag) {
-  FelixCompressor compressor(frag);
+inline std::vector<char> FelixCompress(
+    const dune::FelixFragment& frag,
+    const Prediction prediction = Prediction::previous) {
+  FelixCompressor compressor(frag, prediction);
   std::vector<char> result;
   compressor.compress_copy(result);
 
   return result;
 }
 
-// Similarly, a function for decompressing data and returning an
-// artdaq::Fragment.
-artdaq::Fragment FelixDecompress(const std::vector<char>& buff) {
-  artdaq::Fragment result;
-  const char* src = buff.data();
-
-  // Read metadata and apply to fragment.
-  const MetaData* meta = reinterpret_cast<MetaData const*>(src);
-  size_t num_frames = meta->num_frames;
-  uint16_t unique_values = meta->unique_values;
-  result.resizeBytes(num_frames * sizeof(FelixFrame));
-  src += sizeof(MetaData);
-
-  // Handle for filling fragment data.
-  FelixFrame* frame = reinterpret_cast<FelixFrame*>(result.dataBeginBytes());
-
-  // Access error frames field.
-  std::vector<uint8_t> bad_headers(num_frames/8+1);
-  memcpy(&bad_headers[0], src, num_frames/8+1);
-  src += num_frames / 8 + 1;
-
-  // Access saved headers and generate headers.
-  unsigned sizeof_header_set = sizeof(WIBHeader) + 4 * sizeof(ColdataHeader);
-  const WIBHeader* whead = reinterpret_cast<WIBHeader const*>(src);
-  std::vector<const ColdataHeader*> chead(4);
-  for(unsigned i = 0; i < 4; ++i) {
-    chead[i] = reinterpret_cast<ColdataHeader const*>(
-        src + sizeof(WIBHeader) + i * sizeof(ColdataHeader));
-  }
-  size_t bad_header_counter = 0;
-  for (unsigned i = 0; i < num_frames; ++i) {
-    const WIBHeader* curr_whead;
-    std::vector<const ColdataHeader*> curr_chead(4);
-    // See if the current headers were bad.
-    bool bad_header = (bad_headers[i / 8] >> (7 - (1 % 8))) & 1;
-    if(bad_header) {
-      ++bad_header_counter;
-      // Set current headers to be the bad one.
-      std::cout << "BAD HEADER\n";
-      curr_whead = reinterpret_cast<WIBHeader const*>(
-          src + bad_header_counter * sizeof_header_set);
-      for (unsigned j = 0; j < 4; ++j) {
-        curr_chead[j] = reinterpret_cast<ColdataHeader const*>(
-            src + bad_header_counter * sizeof_header_set +
-            sizeof(WIBHeader) + j * sizeof(ColdataHeader));
-      }
-    } else {
-      // Set current headers to be the first.
-      curr_whead = whead;
-      for(unsigned j = 0; j < 4; ++j) {
-        curr_chead[j] = chead[j];
+// Function for compressing raw frames without wrapping them in a fragment.
+inline std::vector<char> FelixCompress(
+    const uint8_t* frames, const size_t num_frames,
+    const Prediction prediction = Prediction::previous) {
+  FelixCompressor compressor(frames, num_frames, prediction);
+  std::vector<char> result;
+  compressor.compress_copy(result);
+
+  return result;
+}
+
+//==========================
+// FELIX decompressor class
+//==========================
+class FelixDecompressor {
+ public:
+  static constexpr unsigned num_channels = FelixFrame::num_ch_per_frame;
+
+  // Throws cet::exception for data of a version or prediction mode this
+  // decompressor does not know, or data too short for the sizes its
+  // metadata and faulty frame field give.
+  FelixDecompressor(const std::vector<char>& buff)
+      : FelixDecompressor(buff.data(), buff.size()) {}
+  FelixDecompressor(const char* data, const size_t size)
+      : end(data + size),
+        meta(read_metadata(data, size)),
+        prediction(read_prediction(meta, data, size)),
+        pedestals(data + sizeof(MetaData) + (version() >= 3 ? 1 : 0)),
+        bad_headers(reinterpret_cast<uint8_t const*>(
+            pedestals + (prediction == Prediction::pedestal
+                             ? num_channels * sizeof(adc_t)
+                             : 0))),
+        headers(reinterpret_cast<char const*>(bad_headers) + num_frames() / 8 +
+                1),
+        num_bad_headers(read_bad_headers()),
+        freq_table(headers + (num_bad_headers + 1) * header_set_size),
+        decoder(read_tree()),
+        offsets(freq_table + meta.unique_values * freq_entry_size),
+        stream(reinterpret_cast<uint8_t const*>(
+            offsets +
+            (independent_channels() ? num_channels * sizeof(uint32_t) : 0))) {
+    check_offsets();
+  }
+
+  size_t num_frames() const { return meta.num_frames; }
+  unsigned version() const { return meta.version(); }
+  Prediction prediction_mode() const { return prediction; }
+  // Channels can only be decoded on their own from version 2 onwards.
+  bool independent_channels() const { return version() >= 2; }
+
+  // Function to restore the headers of all frames.
+  void decompress_headers(FelixFrame* frame) const {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(frame);
+    const uint8_t* first = reinterpret_cast<uint8_t const*>(headers);
+    // The first header set is followed by those of faulty frames.
+    const uint8_t* bad_header_set = first;
+    unsigned run_start = 0;
+    for (unsigned i = 0; i <= num_frames(); ++i) {
+      // See if the current headers were bad.
+      if (i < num_frames() && !((bad_headers[i / 8] >> (i % 8)) & 1)) {
+        continue;
       }
+      // Timestamps and convert counts only increment from the first header.
+      FelixReorder::fill_headers_from_set(dst + run_start * sizeof(FelixFrame),
+                                          first, i - run_start, run_start, 25,
+                                          25);
+      run_start = i + 1;
+      if (i == num_frames()) break;
+      bad_header_set += header_set_size;
+      FelixReorder::fill_headers_from_set(dst + i * sizeof(FelixFrame),
+                                          bad_header_set, 1);
     }
-    // Assign header fields.
-    (frame + i)->set_sof(curr_whead->sof);
-    (frame + i)->set_version(curr_whead->version);
-    (frame + i)->set_fiber_no(curr_whead->fiber_no);
-    (frame + i)->set_crate_no(curr_whead->crate_no);
-    (frame + i)->set_slot_no(curr_whead->slot_no);
-    (frame + i)->set_mm(curr_whead->mm);
-    (frame + i)->set_oos(curr_whead->oos);
-    (frame + i)->set_wib_errors(curr_whead->wib_errors);
-    (frame + i)->set_timestamp(curr_whead->timestamp() + i * 25);
-    (frame + i)->set_wib_counter(curr_whead->wib_counter());
-    (frame + i)->set_z(curr_whead->z);
-    for(unsigned j = 0; j < 4; ++j) {
-      (frame + i)->set_s1_error(j, curr_chead[j]->s1_error);
-      (frame + i)->set_s2_error(j, curr_chead[j]->s2_error);
-      (frame + i)->set_coldata_convert_count(
-          j, curr_chead[j]->coldata_convert_count + i * 25);
-      (frame + i)->set_error_register(j, curr_chead[j]->error_register);
-    }
-  }
-  src += (bad_header_counter+1) * sizeof_header_set;
-
-  // Read frequency table and generate a Huffman tree.
-  std::unordered_map<uint16_t, unsigned> freq_table;
-  for (unsigned i = 0; i < unique_values; ++i) {
-    const uint16_t* v = reinterpret_cast<uint16_t const*>(src);
-    const uint32_t* f =
-        reinterpret_cast<uint32_t const*>(src + sizeof(uint16_t));
-    freq_table[*v] = *f;
-    src += sizeof(uint16_t) + sizeof(uint32_t);
-  }
-  std::vector<HuffTree::Node> nodes;
-  for (auto p : freq_table) {
-    HuffTree::Node curr_node;
-    curr_node.value = p.first;
-    curr_node.frequency = p.second;
-    nodes.push_back(curr_node);
   }
-  HuffTree hufftree;
-  hufftree.make_tree(nodes);
-
-  // Read ADC values from the buffer.
-  size_t bits_read = 0;
-  for (unsigned i = 0; i < num_frames * 256; ++i) {
-    // Pointer to walk through the tree.
-    HuffTree::Node* pnode = hufftree.root;
-    while (pnode->left != NULL) {
-      if (*src >> (bits_read % 8) & 1) {  // Next bit is 1.
-        pnode = pnode->right;
-      } else {  // Next bit is 0.
-        pnode = pnode->left;
+
+  // Function to decode the num_frames() ADC values of a single channel.
+  void decompress_channel(const unsigned ch, adc_t* dst) const {
+    if (!decoder) return;
+    if (!independent_channels()) {
+      return decompress_channels(dst, num_frames(), ch, ch + 1);
+    }
+    const uint8_t* channel_end = reinterpret_cast<uint8_t const*>(end);
+    if (ch + 1 < num_channels) {
+      channel_end = stream + channel_offset(ch + 1);
+    }
+    decoder->decode(dst, num_frames(), stream + channel_offset(ch),
+                   channel_end);
+    restore(ch, dst);
+  }
+
+  // Function to decode the channels [first, last) into the rows
+  // dst + (ch - first) * stride, one job per channel on the pool if given.
+  void decompress_channels(adc_t* dst, const size_t stride,
+                           const unsigned first = 0,
+                           const unsigned last = num_channels,
+                           ReorderThreadPool* pool = nullptr) const {
+    if (!decoder) return;
+    if (!independent_channels()) {
+      // A single stream has to be decoded from its start.
+      adc_v adcs(last * num_frames());
+      decoder->decode(adcs.data(), adcs.size(), stream,
+                     reinterpret_cast<uint8_t const*>(end));
+      for (unsigned ch = first; ch < last; ++ch) {
+        adc_t* row = adcs.data() + ch * num_frames();
+        restore(ch, row);
+        std::copy(row, row + num_frames(), dst + (ch - first) * stride);
       }
-      // Increment bits read and possibly the source pointer.
-      ++bits_read;
-      if (bits_read % 8 == 0) {
-        ++src;  // Next byte reached.
+      return;
+    }
+
+    if (!pool) {
+      for (unsigned ch = first; ch < last; ++ch) {
+        decompress_channel(ch, dst + (ch - first) * stride);
       }
+      return;
     }
-    // Value reached.
-    adc_t found_val = pnode->value;
-#ifdef PREV
-    if (i % num_frames != 0) {
-      found_val += (frame + i % num_frames - 1)->channel(i / num_frames);
+    pool->run(last - first, [&](const unsigned i) {
+      decompress_channel(first + i, dst + i * stride);
+    });
+  }
+
+  // Function to restore the complete fragment.
+  artdaq::Fragment decompress(ReorderThreadPool* pool = nullptr) const {
+    artdaq::Fragment result;
+    result.resizeBytes(num_frames() * sizeof(FelixFrame));
+    decompress_headers(reinterpret_cast<FelixFrame*>(result.dataBeginBytes()));
+
+    // Decode the ADC values channel by channel and pack them into the frames.
+    adc_aligned_v adcs(num_channels * num_frames());
+    decompress_channels(adcs.data(), num_frames(), 0, num_channels, pool);
+    FelixReorder::pack(result.dataBeginBytes(), adcs.data(), num_frames(),
+                       num_frames());
+
+    return result;
+  }
+
+ private:
+  static constexpr size_t header_set_size =
+      sizeof(WIBHeader) + 4 * sizeof(ColdataHeader);
+  static constexpr size_t freq_entry_size = sizeof(adc_t) + sizeof(uint32_t);
+  static constexpr size_t num_symbols = 1ul << 12;
+
+  const char* const end;
+  const MetaData meta;
+  // Prediction of the values and the pedestals it may use.
+  const Prediction prediction;
+  const char* const pedestals;
+  // Faulty frame field, header sets and frequency table.
+  const uint8_t* const bad_headers;
+  const char* const headers;
+  const size_t num_bad_headers;
+  const char* const freq_table;
+  const std::unique_ptr<const HuffDecoder> decoder;
+  // Channel offsets, if present, and the start of the encoded values.
+  const char* const offsets;
+  const uint8_t* const stream;
+
+  // Data from a later writer or a corrupted header cannot be decoded.
+  static MetaData read_metadata(const char* data, const size_t size) {
+    MetaData meta;
+    if (size < sizeof(meta)) {
+      throw cet::exception("FelixDecompressor")
+          << "Compressed data of " << size << " bytes has no metadata";
+    }
+    memcpy(&meta, data, sizeof(meta));
+    if (meta.version() < 1 || meta.version() > MetaData::latest_version) {
+      throw cet::exception("FelixDecompressor")
+          << "Unknown compression version " << meta.version();
     }
-#endif
-    (frame + i % num_frames)->set_channel(i / num_frames, found_val);
+    if (meta.unique_values > num_symbols ||
+        (meta.unique_values == 0) != (meta.num_frames == 0)) {
+      throw cet::exception("FelixDecompressor")
+          << "Inconsistent metadata: " << meta.num_frames << " frames, "
+          << meta.unique_values << " unique values";
+    }
+    return meta;
   }
 
-  return result;
+  static Prediction read_prediction(const MetaData& meta, const char* data,
+                                    const size_t size) {
+    if (meta.version() < 3) return Prediction::previous;
+    if (size <= sizeof(MetaData)) {
+      throw cet::exception("FelixDecompressor")
+          << "Compressed data of " << size << " bytes has no prediction mode";
+    }
+    const uint8_t mode = data[sizeof(MetaData)];
+    if (mode > static_cast<uint8_t>(Prediction::pedestal)) {
+      throw cet::exception("FelixDecompressor")
+          << "Unknown prediction mode " << (unsigned)mode;
+    }
+    if (mode == static_cast<uint8_t>(Prediction::pedestal) &&
+        size < sizeof(MetaData) + 1 + num_channels * sizeof(adc_t)) {
+      throw cet::exception("FelixDecompressor")
+          << "Compressed data of " << size << " bytes has no pedestals";
+    }
+    return static_cast<Prediction>(mode);
+  }
+
+  // The faulty frame field may only mark the frames after the first, and
+  // the data has to hold everything up to the encoded stream: the header
+  // sets of the marked frames, the frequency table and the channel offsets.
+  // Returns the number of marked frames.
+  size_t read_bad_headers() const {
+    const size_t field_size = num_frames() / 8 + 1;
+    const char* field = reinterpret_cast<char const*>(bad_headers);
+    if ((size_t)(end - field) < field_size) {
+      throw cet::exception("FelixDecompressor")
+          << "Compressed data ends within the faulty frame field of "
+          << num_frames() << " frames";
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < field_size; ++i) {
+      count += __builtin_popcount(bad_headers[i]);
+    }
+    if ((bad_headers[0] & 1) ||
+        bad_headers[field_size - 1] >> (num_frames() % 8)) {
+      throw cet::exception("FelixDecompressor")
+          << "Faulty frame field marks frames outside 1 to "
+          << num_frames() - 1;
+    }
+
+    const size_t needed =
+        (count + 1) * header_set_size + meta.unique_values * freq_entry_size +
+        (independent_channels() ? num_channels * sizeof(uint32_t) : 0);
+    if ((size_t)(end - headers) < needed) {
+      throw cet::exception("FelixDecompressor")
+          << "Compressed data ends " << needed - (end - headers)
+          << " bytes before the encoded values of " << count
+          << " faulty frames and " << meta.unique_values << " unique values";
+    }
+    return count;
+  }
+
+  // Every channel has to start within the encoded stream, in order.
+  void check_offsets() const {
+    if (!independent_channels()) return;
+    const size_t stream_size = reinterpret_cast<uint8_t const*>(end) - stream;
+    uint32_t prev = 0;
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+      const uint32_t offset = channel_offset(ch);
+      if (offset < prev || offset > stream_size) {
+        throw cet::exception("FelixDecompressor")
+            << "Channel " << ch << " starts at byte " << offset
+            << " of an encoded stream of " << stream_size << " bytes";
+      }
+      prev = offset;
+    }
+  }
+
+  // Function to generate a Huffman tree from the frequency table. Without
+  // frames there is nothing to decode.
+  std::unique_ptr<const HuffDecoder> read_tree() const {
+    if (meta.unique_values == 0) return nullptr;
+    std::vector<HuffTree::Node> nodes(meta.unique_values);
+    for (unsigned i = 0; i < meta.unique_values; ++i) {
+      uint32_t frequency;
+      memcpy(&nodes[i].value, freq_table + i * freq_entry_size, sizeof(adc_t));
+      memcpy(&frequency, freq_table + i * freq_entry_size + sizeof(adc_t),
+             sizeof(frequency));
+      nodes[i].frequency = frequency;
+    }
+    HuffTree hufftree;
+    hufftree.make_tree(nodes);
+    return std::unique_ptr<const HuffDecoder>(new HuffDecoder(hufftree));
+  }
+
+  uint32_t channel_offset(const unsigned ch) const {
+    uint32_t offset;
+    memcpy(&offset, offsets + ch * sizeof(offset), sizeof(offset));
+    return offset;
+  }
+
+  // Function to undo the prediction of the values of a channel.
+  void restore(const unsigned ch, adc_t* row) const {
+    switch (prediction) {
+      case Prediction::previous:
+        for (size_t i = 1; i < num_frames(); ++i) {
+          row[i] = (row[i] + row[i - 1]) & 0xfff;
+        }
+        break;
+      case Prediction::pedestal: {
+        adc_t pedestal;
+        memcpy(&pedestal, pedestals + ch * sizeof(adc_t), sizeof(adc_t));
+        for (size_t i = 0; i < num_frames(); ++i) {
+          row[i] = (row[i] + pedestal) & 0xfff;
+        }
+        break;
+      }
+      case Prediction::raw:
+        break;
+    }
+  }
+};  // FelixDecompressor
+
+// Similarly, a function for decompressing data and returning an
+// artdaq::Fragment.
+inline artdaq::Fragment FelixDecompress(const std::vector<char>& buff,
+                                        ReorderThreadPool* pool = nullptr) {
+  FelixDecompressor decompressor(buff);
+  return decompressor.decompress(pool);
 }
 
 }  // namespace dune
@@ -6,23 +6,167 @@
 
 #include <math.h>
 #include <stdint.h>
-#include <complex>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <valarray>
 #include <vector>
 #include "art/Framework/Principal/Handle.h"
 #include "artdaq-core/Data/ContainerFragment.hh"
 #include "artdaq-core/Data/Fragment.hh"
 #include "canvas/Utilities/InputTag.h"
+#include "dunepdlegacy/Overlays/FelixChannelStats.hh"
 #include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixIntegrity.hh"
+#include "dunepdlegacy/Overlays/FelixNoiseSpectrum.hh"
 #include "dunepdlegacy/Overlays/FragmentType.hh"
 #include "gallery/Event.h"
 
 namespace dune {
 
+// Reads the FELIX fragments of a list of files event by event. A background
+// thread reads ahead while the caller processes the current event, keeping at
+// most max_buffered_fragments fragments (or a single event if it is larger)
+// waiting besides the event being read.
+class FelixEventStream {
+ public:
+  // Fills its argument with the fragments of the next event, returning false
+  // after the last one. It is only called on the reader thread.
+  typedef std::function<bool(std::vector<artdaq::Fragment>&)> EventReader;
+
+  FelixEventStream(const std::vector<std::string>& filenames,
+                   const art::InputTag& tag,
+                   const size_t max_buffered_fragments = 100)
+      : FelixEventStream(gallery_reader(filenames, tag),
+                         max_buffered_fragments) {}
+  FelixEventStream(const EventReader& read_event,
+                   const size_t max_buffered_fragments = 100)
+      : read_event_(read_event),
+        max_buffered_(max_buffered_fragments),
+        reader_([this] { read(); }) {}
+  FelixEventStream(const FelixEventStream&) = delete;
+  FelixEventStream& operator=(const FelixEventStream&) = delete;
+
+  ~FelixEventStream() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    not_full_.notify_all();
+    reader_.join();
+  }
+
+  // Replace frags with the non-empty FELIX fragments of the next event.
+  // Returns false once all events have been read. Errors from reading the
+  // files are rethrown here.
+  bool next(std::vector<artdaq::Fragment>& frags) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return !queue_.empty() || done_; });
+    if (queue_.empty()) {
+      if (error_) std::rethrow_exception(error_);
+      return false;
+    }
+    frags = std::move(queue_.front());
+    queue_.pop_front();
+    buffered_ -= frags.size();
+    ++events_read_;
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Number of events handed out by next().
+  size_t events_read() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_read_;
+  }
+
+ private:
+  const EventReader read_event_;
+  const size_t max_buffered_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_, not_full_;
+  std::deque<std::vector<artdaq::Fragment>> queue_;
+  size_t buffered_ = 0;
+  size_t events_read_ = 0;
+  bool done_ = false;
+  bool stop_ = false;
+  std::exception_ptr error_;
+
+  // Declared last so that it starts once everything else is set up.
+  std::thread reader_;
+
+  // Reader of the non-empty fragments in the containers under tag. The
+  // gallery::Event is opened on the first call, so that only the reader
+  // thread touches gallery.
+  static EventReader gallery_reader(const std::vector<std::string>& filenames,
+                                    const art::InputTag& tag) {
+    std::shared_ptr<gallery::Event> evt;
+    return [filenames, tag, evt](std::vector<artdaq::Fragment>& frags) mutable {
+      if (evt) {
+        evt->next();
+      } else {
+        evt = std::make_shared<gallery::Event>(filenames);
+      }
+      if (evt->atEnd()) {
+        return false;
+      }
+      gallery::ValidHandle<std::vector<artdaq::Fragment>> const& conts =
+          evt->getValidHandle<std::vector<artdaq::Fragment>>(tag);
+      for (const auto& cont : *conts) {
+        artdaq::ContainerFragment cont_frag(cont);
+        for (unsigned b = 0; b < cont_frag.block_count(); ++b) {
+          if (cont_frag[b]->dataSizeBytes() != 0) {
+            frags.push_back(*cont_frag[b]);
+          }
+        }
+      }
+      return true;
+    };
+  }
+
+  // Body of the reader thread.
+  void read() {
+    try {
+      for (;;) {
+        std::vector<artdaq::Fragment> frags;
+        if (!read_event_(frags)) {
+          break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] {
+          return stop_ || queue_.empty() ||
+                 buffered_ + frags.size() <= max_buffered_;
+        });
+        if (stop_) break;
+        buffered_ += frags.size();
+        queue_.push_back(std::move(frags));
+        lock.unlock();
+        not_empty_.notify_one();
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    not_empty_.notify_all();
+  }
+};  // class FelixEventStream
+
 class FelixDecoder {
  private:
   art::InputTag tag = "daq:ContainerFELIX:DAQ";
@@ -45,6 +189,8 @@ class FelixDecoder {
   std::vector<unsigned> ch_freqW;
   // Vector to contain fragment test results.
   std::vector<bool> frag_good;
+  std::vector<FelixIntegrity> integrity_;
+  FelixIntegritySummary integrity_summary_;
   // Vector to contain FFT results per FEMB.
   std::vector<std::vector<double>> FEMB_FFT;
   // Number of fragments to be analysed.
@@ -53,6 +199,12 @@ class FelixDecoder {
   const unsigned bad_channel_threshold_ = 400000;
   const unsigned bad_channel_threshold_lower_ = 1;
   std::vector<bool> bad_channel_;
+  // Number of events in the input files, counted on first use.
+  mutable size_t total_events_ = 0;
+
+  // Channel statistics of good fragments, one accumulator per fiber at
+  // index slot * 2 + fiber - 1.
+  std::vector<FelixChannelStats> ch_stats_;
 
  public:
   // General information accessors.
@@ -64,179 +216,77 @@ class FelixDecoder {
   }
 
   size_t total_events() const {
-    gallery::Event evt(filenames);
-    return evt.numberOfEventsInFile();
+    if (total_events_ == 0) {
+      gallery::Event evt(filenames);
+      total_events_ = evt.numberOfEventsInFile();
+    }
+    return total_events_;
   }
 
-  // Check functions.
-  bool check_timestamps(unsigned frag_num) const {
-    bool failed = false;
-
-    dune::FelixFragment flxfrag(frags_[frag_num]);
-    // Loop over frames in the fragment and check the timestamps.
-    uint64_t prevtimestamp = flxfrag.timestamp(0);
-    for (unsigned fr = 1; fr < flxfrag.total_frames(); ++fr) {
-      // Check timestamp.
-      if (flxfrag.timestamp(fr) - prevtimestamp != 25) {
-        std::cout << "Timestamp does not increase by 25 at frame " << fr
-                  << " in fragment " << frag_num << "!\n";
-        std::cout << "It instead increases by "
-                  << flxfrag.timestamp(fr) - prevtimestamp << "\n";
-        std::cout << "Fiber " << (unsigned)flxfrag.fiber_no(fr) << ", slot "
-                  << (unsigned)flxfrag.slot_no(fr) << ", crate "
-                  << (unsigned)flxfrag.crate_no(fr) << '\n';
-        failed = true;
-        break;
-      }
-      // std::cout << flxfrag.timestamp(fr) - prevtimestamp << "\t";
-      prevtimestamp = flxfrag.timestamp(fr);
-    }  // Loop over frames.
+  // Stream over the events of the input files, keeping at most a window of
+  // max_buffered_fragments fragments in memory.
+  std::unique_ptr<FelixEventStream> stream(
+      const size_t max_buffered_fragments = 100) const {
+    return std::unique_ptr<FelixEventStream>(
+        new FelixEventStream(filenames, tag, max_buffered_fragments));
+  }
 
-    return !failed;
+  // Check functions. All header checks of a fragment are done in one fused
+  // scan; the single checks test the kinds of errors they cover. Each takes
+  // either the index of a stored fragment or, for streamed events, the
+  // fragment itself.
+  FelixIntegrity integrity(unsigned frag_num) const {
+    return integrity(dune::FelixFragment(frags_[frag_num]));
+  }
+  static FelixIntegrity integrity(const dune::FelixFragment& flxfrag) {
+    return FelixCheckIntegrity(flxfrag);
   }
 
+  bool check_timestamps(unsigned frag_num) const {
+    return check_timestamps(dune::FelixFragment(frags_[frag_num]));
+  }
+  static bool check_timestamps(const dune::FelixFragment& flxfrag) {
+    return integrity(flxfrag).good(FelixIntegrity::timestamp_step);
+  }
   bool check_all_timestamps() const {
-    bool failed = false;
-    // Loop over fragments within an event.
     std::cout << "Going through " << frags_.size() << " fragments.\n";
-    for (unsigned i = 0; i < frags_.size(); ++i) {
-      std::cout << i << '\r';
-      failed |= !(check_timestamps(i));
-    }
-
-    if (failed) {
-      std::cout << "Timestamp check failed.\n";
-    } else {
-      std::cout << "Timestamp check succeeded.\n";
-    }
-
-    return !failed;
+    return check_all(FelixIntegrity::timestamp_step, "Timestamp");
   }
 
   bool check_CCCs(unsigned frag_num) const {
-    bool failed = false;
-
-    dune::FelixFragment flxfrag(frags_[frag_num]);
-    // Loop over frames in the fragment and check the COLDATA convert
-    // counts.
-    uint16_t prevCCC1 = flxfrag.coldata_convert_count(0, 0);
-    uint16_t prevCCC2 = flxfrag.coldata_convert_count(0, 2);
-    for (unsigned fr = 1; fr < flxfrag.total_frames(); ++fr) {
-      // Check CCC1.
-      if (flxfrag.coldata_convert_count(fr, 0) - prevCCC1 != 1 &&
-          flxfrag.coldata_convert_count(fr, 0) - prevCCC1 != -33919 &&
-          flxfrag.coldata_convert_count(fr, 0) - prevCCC1 != -65535) {
-        std::cout << "CCC1 does not increase by 1 at frame " << fr
-                  << " in fragment " << frag_num << "!\n";
-        std::cout << "It instead increases by "
-                  << flxfrag.coldata_convert_count(fr, 0) - prevCCC1 << '\n';
-        failed = true;
-        break;
-
-        // Check CCC2.
-        if (flxfrag.coldata_convert_count(fr, 2) - prevCCC2 != 1 &&
-            flxfrag.coldata_convert_count(fr, 2) - prevCCC2 != -33919 &&
-            flxfrag.coldata_convert_count(fr, 0) - prevCCC2 != -65535) {
-          std::cout << "CCC2 does not increase by 1 at frame " << fr
-                    << " in fragment " << frag_num << "!\n";
-          std::cout << "It instead increases by "
-                    << flxfrag.coldata_convert_count(fr, 2) - prevCCC2 << '\n';
-          failed = true;
-          break;
-        }
-        prevCCC2 = flxfrag.coldata_convert_count(fr, 2);
-      }
-      prevCCC1 = flxfrag.coldata_convert_count(fr, 0);
-
-      // Check whether other CCCs correspond.
-      if (flxfrag.coldata_convert_count(fr, 0) !=
-              flxfrag.coldata_convert_count(fr, 1) ||
-          flxfrag.coldata_convert_count(fr, 2) !=
-              flxfrag.coldata_convert_count(fr, 3)) {
-        std::cout << "CCC in frame " << fr << " do not correspond!\n";
-        failed = true;
-        break;
-      }
-    }  // Loop over frames.
-
-    return !failed;
+    return check_CCCs(dune::FelixFragment(frags_[frag_num]));
+  }
+  static bool check_CCCs(const dune::FelixFragment& flxfrag) {
+    return integrity(flxfrag).good(FelixIntegrity::ccc_step |
+                                   FelixIntegrity::ccc_mismatch);
   }
-
   bool check_all_CCCs() const {
-    bool failed = false;
-    for (unsigned i = 0; i < frags_.size(); ++i) {
-      failed |= !(check_CCCs(i));
-    }
-
-    if (failed) {
-      std::cout << "CCC check failed.\n";
-    } else {
-      std::cout << "CCC check succeeded.\n";
-    }
-
-    return !failed;
+    return check_all(FelixIntegrity::ccc_step | FelixIntegrity::ccc_mismatch,
+                     "CCC");
   }
 
   bool check_IDs(unsigned frag_num) const {
-    bool failed = false;
-
-    dune::FelixFragment flxfrag(frags_[frag_num]);
-    // Output a fragment's fiber, crate and slot number.
-    unsigned fiber_no = flxfrag.fiber_no();
-    unsigned crate_no = flxfrag.crate_no();
-    unsigned slot_no = flxfrag.slot_no();
-    // std::cout << "Fragment " << i << " has:\nfiber_no: " << fiber_no <<
-    // '\n'; std::cout << "crate_no: " << crate_no << '\n'; std::cout <<
-    // "slot_no: " << slot_no << '\n';
-
-    // Check whether fragments have logical
-    // fiber, crate and slot numbers between frames.
-    for (unsigned fi = 1; fi < flxfrag.total_frames(); ++fi) {
-      // The fiber_no has to stay constant
-      if (flxfrag.fiber_no(fi) != fiber_no) {
-        std::cout << "Non-constant fiber_no in fragment " << frag_num
-                  << " frame " << fi << ": " << (unsigned)(flxfrag.fiber_no(fi))
-                  << " instead of " << fiber_no << '\n';
-        fiber_no = flxfrag.fiber_no(fi);
-        failed = true;
-        break;
-      }
-      // The crate_no has to stay constant.
-      if (flxfrag.crate_no(fi) != crate_no) {
-        std::cout << "Non-constant crate_no in fragment " << frag_num
-                  << " frame " << fi << ": " << (unsigned)(flxfrag.crate_no(fi))
-                  << " instead of " << crate_no << '\n';
-        crate_no = flxfrag.crate_no(fi);
-        failed = true;
-        break;
-      }
-      // The slot_no has to stay constant.
-      if (flxfrag.slot_no(fi) != slot_no) {
-        std::cout << "Non-constant slot_no in fragment " << frag_num
-                  << " frame " << fi << ": " << (unsigned)(flxfrag.slot_no(fi))
-                  << " instead of " << slot_no << '\n';
-        slot_no = flxfrag.slot_no(fi);
-        failed = true;
-        break;
-      }
-    }  // Loop over frames.
-
-    return !failed;
+    return check_IDs(dune::FelixFragment(frags_[frag_num]));
+  }
+  static bool check_IDs(const dune::FelixFragment& flxfrag) {
+    return integrity(flxfrag).good(FelixIntegrity::fiber_changed |
+                                   FelixIntegrity::crate_changed |
+                                   FelixIntegrity::slot_changed);
   }
-
   bool check_all_IDs() const {
-    bool failed = false;
-    for (unsigned i = 0; i < frags_.size(); ++i) {
-      failed |= !(check_IDs(i));
-    }
-
-    if (failed) {
-      std::cout << "ID check failed.\n";
-    } else {
-      std::cout << "ID check succeeded.\n";
-    }
+    return check_all(FelixIntegrity::fiber_changed |
+                         FelixIntegrity::crate_changed |
+                         FelixIntegrity::slot_changed,
+                     "ID");
+  }
 
-    return !failed;
+  // Results of the integrity checks of the last analysis, per fragment and
+  // summed over all fragments.
+  const std::vector<FelixIntegrity>& integrity_results() const {
+    return integrity_;
+  }
+  const FelixIntegritySummary& integrity_summary() const {
+    return integrity_summary_;
   }
 
   // Accessor for artdaq::Fragments.
@@ -249,169 +299,54 @@ class FelixDecoder {
     return frags_[frag_num];
   }
 
-  // Cooley-Tukey FFT (in-place, breadth-first, decimation-in-frequency)
-  // Copied from rosettacode.org and modified here. Perform FFT over the first
-  // fragment and print to file for plotting.
-  void FFT(std::vector<std::complex<double>>& x) {
-    typedef std::complex<double> Complex;
-
-    // Determine the length of the vector to be processed.
-    unsigned N = 1;
-    for (unsigned i = 0; i < 16; ++i) {
-      if (N << 1 < x.size()) {
-        N <<= 1;
-      }
-    }
-    // Resize original vector.
-    x.resize(N);
-
-    // DFT
-    unsigned int k = N, n;
-    double thetaT = 3.14159265358979323846264338328L / N;
-    Complex phiT = Complex(cos(thetaT), -sin(thetaT)), T;
-    while (k > 1) {
-      n = k;
-      k /= 2;
-      phiT = phiT * phiT;
-      T = 1.0L;
-      for (unsigned int l = 0; l < k; l++) {
-        for (unsigned int a = l; a < N; a += n) {
-          unsigned int b = a + k;
-          Complex t = x[a] - x[b];
-          x[a] += x[b];
-          x[b] = t * T;
-        }
-        T *= phiT;
-      }
-    }
-    // Decimate
-    unsigned int m = (unsigned int)log2(N);
-    for (unsigned int a = 0; a < N; a++) {
-      unsigned int b = a;
-      // Reverse bits
-      b = (((b & 0xaaaaaaaa) >> 1) | ((b & 0x55555555) << 1));
-      b = (((b & 0xcccccccc) >> 2) | ((b & 0x33333333) << 2));
-      b = (((b & 0xf0f0f0f0) >> 4) | ((b & 0x0f0f0f0f) << 4));
-      b = (((b & 0xff00ff00) >> 8) | ((b & 0x00ff00ff) << 8));
-      b = ((b >> 16) | (b << 16)) >> (32 - m);
-      if (b > a) {
-        Complex t = x[a];
-        x[a] = x[b];
-        x[b] = t;
-      }
-    }
-    // // Normalize
-    // Complex f = 1.0 / sqrt(N);
-    // for (unsigned int i = 0; i < N; i++) {
-    //   x[i] *= f;
-    // }
-  }
-
   // Check the integrity of all stored fragments and store the information.
-  void checkFragments() {
-    // Test fragments for data integrity.
+  // Fragments are rejected for header errors but not for WIB error bits.
+  void checkFragments(const unsigned num_threads = 1) {
     std::cout << "Testing fragments for integrity.\n";
+    FelixIntegrityScanner scanner(num_threads);
+    scanner.scan(frags_.data(), num_frags_ana, integrity_);
     for (unsigned frag_num = 0; frag_num < num_frags_ana; ++frag_num) {
-      bool data_good = true;
-      data_good |= check_timestamps(frag_num);  // Checks increments by 25.
-      data_good |= check_CCCs(
-          frag_num);  // Checks increments by 1 and correspondence between CCCs.
-      data_good |= check_IDs(frag_num);  // Check the identifier fields of
-                                         // all the frames in fragments.
-      frag_good[frag_num] = data_good;
+      frag_good[frag_num] =
+          integrity_[frag_num].good(FelixIntegrity::header_errors);
     }
+    integrity_summary_ = scanner.summary();
+    printIntegritySummary();
   }
 
-  // Fill the channel averages and frequencies for good fragments.
+  void printIntegritySummary() const {
+    const FelixIntegritySummary& summary = integrity_summary_;
+    std::cout << summary.bad_fragments << " out of " << summary.fragments
+              << " fragments have errors.\n";
+    for (unsigned k = 0; k < FelixIntegrity::num_errors; ++k) {
+      if (summary.fragment_counts[k] == 0) {
+        continue;
+      }
+      std::cout << FelixIntegrity::error_name(k) << ": "
+                << summary.fragment_counts[k] << " fragments, "
+                << summary.frame_counts[k] << " frames.\n";
+    }
+  }
+
+  // Fill the channel statistics for good fragments in a single pass.
   void calculateAveragesAndFreqs() {
-    // Record the average of all channels of good fragments.
     std::cout << "Calculating channel averages.\n";
+    resetStats();
     for (unsigned frag_num = 0; frag_num < num_frags_ana; ++frag_num) {
       if (!frag_good[frag_num]) {
         continue;
       }
-
-      // Load the fragment and put it in the overlay.
-      artdaq::Fragment frag = Fragment(frag_num);
-      dune::FelixFragment flxfrag(frag);
-      unsigned ch_num_base =
-          flxfrag.slot_no() * 512 + (flxfrag.fiber_no() - 1) * 256;
-      // Loop through frames and channels.
-      for (unsigned fr_num = 0; fr_num < flxfrag.total_frames(); ++fr_num) {
-        for (unsigned u = 0; u < Uch.size(); ++u) {
-          ch_avgsU[ch_num_base + Uch[u]] += flxfrag.get_ADC(fr_num, Uch[u]);
-          ch_freqU[ch_num_base + Uch[u]]++;
-        }
-        for (unsigned v = 0; v < Vch.size(); ++v) {
-          ch_avgsV[ch_num_base + Vch[v]] += flxfrag.get_ADC(fr_num, Vch[v]);
-          ch_freqV[ch_num_base + Vch[v]]++;
-        }
-        for (unsigned w = 0; w < Wch.size(); ++w) {
-          ch_avgsW[ch_num_base + Wch[w]] += flxfrag.get_ADC(fr_num, Wch[w]);
-          ch_freqW[ch_num_base + Wch[w]]++;
-        }
-      }
-    }
-    for (unsigned ch_num = 0; ch_num < ch_avgsU.size(); ++ch_num) {
-      if (ch_freqU[ch_num] != 0) {
-        ch_avgsU[ch_num] /= ch_freqU[ch_num];
-      }
-    }
-    for (unsigned ch_num = 0; ch_num < ch_avgsV.size(); ++ch_num) {
-      if (ch_freqV[ch_num] != 0) {
-        ch_avgsV[ch_num] /= ch_freqV[ch_num];
-      }
-    }
-    for (unsigned ch_num = 0; ch_num < ch_avgsW.size(); ++ch_num) {
-      if (ch_freqW[ch_num] != 0) {
-        ch_avgsW[ch_num] /= ch_freqW[ch_num];
-      }
+      accumulateStats(dune::FelixFragment(frags_[frag_num]));
     }
+    fillPlaneStats();
   }
 
   void calculateNoiseRMS() {
-    // Record the RMS of each channel.
     std::cout << "Calculating noise RMS values per channel.\n";
-    for (unsigned frag_num = 0; frag_num < num_frags_ana; ++frag_num) {
-      if (!frag_good[frag_num]) {
-        continue;
-      }
-
-      // Load the fragment and put it in the overlay.
-      artdaq::Fragment frag = Fragment(frag_num);
-      dune::FelixFragment flxfrag(frag);
-      // std::cout << "Fragment " << frag_num << " has crate " <<
-      // (unsigned)flxfrag.crate_no()
-      //           << " slot " << (unsigned)flxfrag.slot_no() << " and fiber "
-      //           << (unsigned)flxfrag.fiber_no() << '\n';
-      unsigned ch_num_base =
-          flxfrag.slot_no() * 512 + (flxfrag.fiber_no() - 1) * 256;
-      // Loop through channels and frames.
-      // Add to noise RMS vectors.
-      for (unsigned u = 0; u < Uch.size(); ++u) {
-        for (unsigned fr_num = 0; fr_num < flxfrag.total_frames(); ++fr_num) {
-          ch_rmsU[ch_num_base + Uch[u]] += pow(
-              ch_avgsU[ch_num_base + Uch[u]] - flxfrag.get_ADC(fr_num, Uch[u]),
-              2);
-        }
-      }
-      for (unsigned v = 0; v < Vch.size(); ++v) {
-        for (unsigned fr_num = 0; fr_num < flxfrag.total_frames(); ++fr_num) {
-          ch_rmsV[ch_num_base + Vch[v]] += pow(
-              ch_avgsV[ch_num_base + Vch[v]] - flxfrag.get_ADC(fr_num, Vch[v]),
-              2);
-        }
-      }
-      for (unsigned w = 0; w < Wch.size(); ++w) {
-        for (unsigned fr_num = 0; fr_num < flxfrag.total_frames(); ++fr_num) {
-          ch_rmsW[ch_num_base + Wch[w]] += pow(
-              ch_avgsW[ch_num_base + Wch[w]] - flxfrag.get_ADC(fr_num, Wch[w]),
-              2);
-        }
-      }
-    }
+    finaliseNoiseRMS();
+  }
 
-    // Final value manipulation.
+  // Turn the summed squared deviations into RMS values and flag bad channels.
+  void finaliseNoiseRMS() {
     unsigned num_bad_channels = 0;
     for (unsigned ch = 0; ch < 2560; ++ch) {
       ch_rmsU[ch] = sqrt(ch_rmsU[ch] / ch_freqU[ch]);
@@ -429,63 +364,29 @@ class FelixDecoder {
     std::cout << "Number of bad channels: " << num_bad_channels << ".\n";
   }
 
-  void calculateFFT() {
-    // Track how many occurrences of every FEMB there are.
-    std::vector<unsigned> FEMB_freq(20, 0);
+  // Fill the FEMB spectra from the good fragments, leaving out bad channels.
+  void calculateFFT(const unsigned num_threads = 1) {
+    FelixNoiseSpectrum spectra(total_frames(), num_threads);
     for (unsigned frag_num = 0; frag_num < num_frags_ana; ++frag_num) {
       if (!frag_good[frag_num]) {
         continue;
       }
-
-      // Load the fragment and put it in the overlay.
-      artdaq::Fragment frag = Fragment(frag_num);
-      dune::FelixFragment flxfrag(frag);
-
-      // Increment the frequency of the two FEMBs contained within a fragment.
-      ++FEMB_freq[flxfrag.slot_no() * 4 + (flxfrag.fiber_no() - 1) * 2];
-      ++FEMB_freq[flxfrag.slot_no() * 4 + (flxfrag.fiber_no() - 1) * 2 + 1];
+      spectra.add(dune::FelixFragment(frags_[frag_num]), bad_channel_);
     }
-    // for(unsigned i = 0; i < FEMB_freq.size(); ++i) {
-    //   std::cout << "FEMB " << i << " occurred " << FEMB_freq[i] << "
-    //   times.\n";
-    // }
-
-    for (unsigned frag_num = 0; frag_num < num_frags_ana; ++frag_num) {
-      if (!frag_good[frag_num]) {
-        continue;
-      }
+    fillSpectra(spectra);
+  }
 
-      // Load the fragment and put it in the overlay.
-      artdaq::Fragment frag = Fragment(frag_num);
-      dune::FelixFragment flxfrag(frag);
-      // FFT calculations.
-      for (unsigned ch_num = 0; ch_num < 256; ++ch_num) {
-        // FFT vector.
-        std::vector<std::complex<double>> ch_fft_waveform(
-            flxfrag.total_frames(), 0);
-        for (unsigned fr_num = 0; fr_num < flxfrag.total_frames(); ++fr_num) {
-          // Add to FFT vector.
-          ch_fft_waveform[fr_num] = flxfrag.get_ADC(fr_num, ch_num);
-        }
-        FFT(ch_fft_waveform);
-        // Add to master FFT waveform.
-        unsigned FEMB_num = (flxfrag.slot_no() - 0) * 4 +
-                            (flxfrag.fiber_no() - 1) * 2 + ch_num / 128;
-        if(bad_channel_[FEMB_num*128 + ch_num]) { continue; }
-        // if (std::abs(ch_fft_waveform[5000]) / (FEMB_freq[FEMB_num] * 128) >
-        //     4.3) {
-        //   std::cout << "BAD CHANNEL: " << ch_num << " IN FEMB " << FEMB_num << '\n';
-        // }
-        for (unsigned i = 0; i < ch_fft_waveform.size(); ++i) {
-          FEMB_FFT[FEMB_num][i] +=
-              std::abs(ch_fft_waveform[i])/(FEMB_freq[FEMB_num]*128);
-        }
-      }
+  // Copy the averaged spectra of all FEMBs.
+  void fillSpectra(const FelixNoiseSpectrum& spectra) {
+    FEMB_FFT.resize(spectra.num_FEMBs());
+    for (unsigned femb = 0; femb < spectra.num_FEMBs(); ++femb) {
+      FEMB_FFT[femb] = spectra.spectrum(femb);
     }
   }
 
-  // Function to determine channel RMS and print to file.
-  void analyse(std::string destination) {
+  // Function to determine channel RMS and print to file. The FFTs are spread
+  // over num_threads threads.
+  void analyse(std::string destination, const unsigned num_threads = 1) {
     // Number of fragments to run this code over.
     std::cout << "calculateNoiseRMS: found " << frags_.size()
               << " fragments.\n";
@@ -502,18 +403,156 @@ class FelixDecoder {
     ch_freqV.resize(2 * 5 * 256, 0);
     ch_freqW.resize(2 * 5 * 256, 0);
     frag_good.resize(num_frags_ana, false);
-    FEMB_FFT.resize(20, std::vector<double>(total_frames(), 0));
     bad_channel_.resize(2 * 5 * 256, 0);
 
     // Set integrity flags.
-    checkFragments();
+    checkFragments(num_threads);
     // Fill averages and frequencies for each channel.
     calculateAveragesAndFreqs();
     // Populate noise RMS vectors.
     calculateNoiseRMS();
     // Populate FFT vectors.
-    calculateFFT();
+    calculateFFT(num_threads);
 
+    writeResults(destination);
+  }
+
+  // Streaming counterpart of analyse() that runs over every event of the
+  // input files without keeping them in memory. Integrity checks and channel
+  // statistics are done one fragment at a time as events arrive. The FFTs
+  // need the bad channels found over the whole run and take a second pass
+  // over the files unless fft is false. Returns the number of fragments
+  // analysed.
+  size_t analyse_stream(std::string destination, const bool fft = true,
+                        const size_t max_buffered_fragments = 100,
+                        const unsigned num_threads = 1) {
+    resetStats();
+    FEMB_FFT.clear();
+
+    // First pass: checks and channel statistics.
+    std::cout << "Streaming over events for integrity checks and noise.\n";
+    size_t num_frags = 0;
+    size_t num_good = 0;
+    frag_good.clear();
+    integrity_.clear();
+    FelixIntegrityScanner scanner;
+    std::vector<artdaq::Fragment> event_frags;
+    std::unique_ptr<FelixEventStream> events = stream(max_buffered_fragments);
+    while (events->next(event_frags)) {
+      for (const auto& frag : event_frags) {
+        dune::FelixFragment flxfrag(frag);
+        integrity_.push_back(scanner.scan(flxfrag));
+        frag_good.push_back(
+            integrity_.back().good(FelixIntegrity::header_errors));
+        ++num_frags;
+        if (frag_good.back()) {
+          accumulateStats(flxfrag);
+          ++num_good;
+        }
+      }
+      std::cout << "Event " << events->events_read() << " analysed.\r";
+    }
+    total_events_ = events->events_read();
+    events.reset();
+    std::cout << '\n' << num_good << " out of " << num_frags
+              << " fragments passed the integrity checks.\n";
+    integrity_summary_ = scanner.summary();
+    printIntegritySummary();
+
+    fillPlaneStats();
+    finaliseNoiseRMS();
+    if (fft) {
+      // Second pass: spectra of the good channels in good fragments.
+      std::cout << "Streaming over events for FFTs.\n";
+      size_t frag_num = 0;
+      std::unique_ptr<FelixNoiseSpectrum> spectra;
+      events = stream(max_buffered_fragments);
+      while (events->next(event_frags)) {
+        for (const auto& frag : event_frags) {
+          if (frag_num < num_frags && frag_good[frag_num++]) {
+            dune::FelixFragment flxfrag(frag);
+            if (!spectra) {
+              spectra.reset(
+                  new FelixNoiseSpectrum(flxfrag.total_frames(), num_threads));
+            }
+            spectra->add(flxfrag, bad_channel_);
+          }
+        }
+      }
+      events.reset();
+      if (spectra) {
+        fillSpectra(*spectra);
+      }
+    }
+
+    writeResults(destination);
+    return num_frags;
+  }
+
+  // Check all stored fragments for the errors in mask.
+  bool check_all(const uint16_t mask, const std::string& name) const {
+    FelixIntegrityScanner scanner;
+    std::vector<FelixIntegrity> results;
+    scanner.scan(frags_.data(), frags_.size(), results);
+    const bool failed =
+        std::any_of(results.begin(), results.end(),
+                    [&](const FelixIntegrity& r) { return !r.good(mask); });
+
+    if (failed) {
+      std::cout << name << " check failed.\n";
+    } else {
+      std::cout << name << " check succeeded.\n";
+    }
+
+    return !failed;
+  }
+
+  void resetStats() {
+    ch_stats_.clear();
+    ch_stats_.resize(2 * 5);
+  }
+
+  // Add all channels of one fragment to the statistics of its fiber.
+  void accumulateStats(const dune::FelixFragment& flxfrag) {
+    const unsigned fiber = flxfrag.slot_no() * 2 + flxfrag.fiber_no() - 1;
+    if (fiber < ch_stats_.size()) {
+      ch_stats_[fiber].add(flxfrag);
+    }
+  }
+
+  // Fill the per-plane averages, summed squared deviations and frequencies
+  // from the channel statistics.
+  void fillPlaneStats() {
+    ch_avgsU.assign(2 * 5 * 256, 0);
+    ch_avgsV.assign(2 * 5 * 256, 0);
+    ch_avgsW.assign(2 * 5 * 256, 0);
+    ch_rmsU.assign(2 * 5 * 256, 0);
+    ch_rmsV.assign(2 * 5 * 256, 0);
+    ch_rmsW.assign(2 * 5 * 256, 0);
+    ch_freqU.assign(2 * 5 * 256, 0);
+    ch_freqV.assign(2 * 5 * 256, 0);
+    ch_freqW.assign(2 * 5 * 256, 0);
+    bad_channel_.assign(2 * 5 * 256, false);
+
+    auto fill = [this](const std::vector<unsigned>& plane,
+                       std::vector<double>& avgs, std::vector<double>& rms,
+                       std::vector<unsigned>& freq) {
+      for (unsigned fiber = 0; fiber < ch_stats_.size(); ++fiber) {
+        const FelixChannelStats& stats = ch_stats_[fiber];
+        for (unsigned ch : plane) {
+          avgs[fiber * 256 + ch] = stats.mean(ch);
+          rms[fiber * 256 + ch] = stats.variance(ch) * stats.count(ch);
+          freq[fiber * 256 + ch] = stats.count(ch);
+        }
+      }
+    };
+    fill(Uch, ch_avgsU, ch_rmsU, ch_freqU);
+    fill(Vch, ch_avgsV, ch_rmsV, ch_freqV);
+    fill(Wch, ch_avgsW, ch_rmsW, ch_freqW);
+  }
+
+  // Write the noise RMS values and FEMB spectra to files in destination.
+  void writeResults(const std::string& destination) const {
     // Write noise RMS to file.
     std::cout << "Writing to file " << destination + "/RMSU.dat"
               << ".\n";
@@ -580,6 +619,10 @@ class FelixDecoder {
     }
     fftfile << '\n';
 
+    if (FEMB_FFT.empty()) {
+      return;
+    }
+
     // Write the first row a little wider.
     fftfile << std::left << std::setw(5) << 0 << std::right;
     for (unsigned femb = 0; femb < 20; ++femb) {
@@ -587,7 +630,7 @@ class FelixDecoder {
     }
     fftfile << '\n';
 
-    for (unsigned tick = 1; tick < total_frames(); ++tick) {
+    for (unsigned tick = 1; tick < FEMB_FFT[0].size(); ++tick) {
       // std::cout << "Tick" << tick << " written.\n";
       fftfile << std::left << std::setw(10) << tick << std::right;
       // Write FFT for each FEMB.
@@ -620,9 +663,15 @@ class FelixDecoder {
   // Constructors that load a file.
   FelixDecoder() = delete;
 
+  // Without load_fragments no fragments are held in memory and the decoder
+  // is meant for streaming through stream() and analyse_stream().
   template <class T>
-  FelixDecoder(const T& input_files) {
+  FelixDecoder(const T& input_files, const bool load_fragments = true) {
     loadFiles(input_files);
+    fillChannelMap();
+    if (!load_fragments) {
+      return;
+    }
     unsigned num_evts = 0;
     for (gallery::Event evt(filenames); !evt.atEnd(); evt.next()) {
       ++num_evts;
@@ -643,7 +692,10 @@ class FelixDecoder {
     }
     std::cout << "Loaded " << total_fragments() << " fragments in " << num_evts
               << " events.\n";
+  }
 
+ private:
+  void fillChannelMap() {
     // Ugly way to get the rest of the channel map from a repeating pattern.
     unsigned Usize = Uch.size();
     unsigned Vsize = Vch.size();
@@ -12,11 +12,16 @@
 #include <iostream>
 #include <vector>
 
+#include "dunepdlegacy/rce/dam/util/AlignedAllocator.hh"
+
 namespace dune {
 
 typedef uint32_t word_t;
 typedef uint16_t adc_t;
 typedef std::vector<uint16_t> adc_v;
+// Cache line aligned ADC buffer for the channel-major bulk accessors.
+typedef std::vector<uint16_t, pdd::AlignedAllocator<64, uint16_t> >
+    adc_aligned_v;
 
 //===================
 // WIB header struct
@@ -6,12 +6,16 @@
 
 #include "FragmentType.hh"
 #include "artdaq-core/Data/Fragment.hh"
+#include "dunepdlegacy/Overlays/BitRank.hh"
 #include "dunepdlegacy/Overlays/FelixFormat.hh"
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
 #include <zlib.h>
 #include <iostream>
 #include <map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 // Implementation of "FelixFragment", an artdaq::FelixFragment overlay
@@ -19,6 +23,12 @@
 //
 // The intention of this class is to provide an Overlay for a 12-bit ADC
 // module.
+//
+// The three data layouts (bare frames, reordered and compressed) are final
+// classes held by value in a std::variant. Per-sample loops can be written
+// once as a generic callable and handed to FelixFragment::visit, which calls
+// them with the concrete layout so that every accessor is inlined. The
+// FelixFragmentBase interface is kept for code that does not care.
 
 namespace dune {
 // fwd declare FelixFragment
@@ -110,6 +120,12 @@ class dune::FelixFragmentBase {
   // Function to return a certain ADC value.
   virtual adc_t get_ADC(const unsigned& frame_ID,
                         const uint8_t channel_ID) const = 0;
+  // Function to decode the ADC values of num_frames frames starting at
+  // frame_ID into a channel-major buffer: channel ch of frame frame_ID + i
+  // ends up at dst[ch * stride + i].
+  virtual void get_ADC_block(adc_t* dst, const size_t& stride,
+                             const unsigned& frame_ID,
+                             const unsigned& num_frames) const = 0;
 
   // Function to print all timestamps.
   virtual void print_timestamps() const = 0;
@@ -200,7 +216,7 @@ class dune::FelixFragmentBase {
 //==================================================
 // FELIX fragment for an array of bare FELIX frames
 //==================================================
-class dune::FelixFragmentUnordered : public dune::FelixFragmentBase {
+class dune::FelixFragmentUnordered final : public dune::FelixFragmentBase {
  public:
   /* Frame field and accessors. */
   uint8_t sof(const unsigned& frame_ID = 0) const {
@@ -266,6 +282,15 @@ class dune::FelixFragmentUnordered : public dune::FelixFragmentBase {
   adc_t get_ADC(const unsigned& frame_ID, const uint8_t channel_ID) const {
     return frame_(frame_ID)->channel(channel_ID);
   }
+  void get_ADC_block(adc_t* dst, const size_t& stride,
+                     const unsigned& frame_ID,
+                     const unsigned& num_frames) const {
+    FelixReorder::unpack(dst, reinterpret_cast<uint8_t const*>(frame_(frame_ID)),
+                         num_frames, stride);
+  }
+
+  // The frame array itself, for bulk scans over the frame headers.
+  FelixFrame const* frames() const { return frame_(); }
 
   // Function to print all timestamps.
   void print_timestamps() const {
@@ -313,7 +338,7 @@ class dune::FelixFragmentUnordered : public dune::FelixFragmentBase {
 //=======================================================
 // FELIX fragment for an array of reordered FELIX frames
 //=======================================================
-class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
+class dune::FelixFragmentReordered final : public dune::FelixFragmentBase {
  public:
   /* Frame field and accessors. */
   uint8_t sof(const unsigned& frame_ID = 0) const {
@@ -387,6 +412,15 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
   adc_t get_ADC(const unsigned& frame_ID, const uint8_t channel_ID) const {
     return channel_(frame_ID, channel_ID);
   }
+  void get_ADC_block(adc_t* dst, const size_t& stride,
+                     const unsigned& frame_ID,
+                     const unsigned& num_frames) const {
+    // Channels are stored contiguously already.
+    for (unsigned ch = 0; ch < FelixFrame::num_ch_per_frame; ++ch) {
+      memcpy(dst + ch * stride, &channel_(frame_ID, ch),
+             num_frames * sizeof(adc_t));
+    }
+  }
 
   // Function to print all timestamps.
   void print_timestamps() const {
@@ -411,16 +445,7 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
   // The constructor simply sets its const private member "artdaq_Fragment_"
   // to refer to the artdaq::Fragment object
   FelixFragmentReordered(artdaq::Fragment const& fragment)
-      : FelixFragmentBase(fragment), bad_header_num(meta_.num_frames, 0) {
-    // Go through the bad headers and assign each a number.
-    unsigned int bad_header_count = 1;
-    for (unsigned int i = 0; i < meta_.num_frames; ++i) {
-      if (header_is_faulty(i)) {
-        bad_header_num[i] = bad_header_count++;
-      }
-      // std::cout << bad_header_num[i] << '\n';
-    }
-  }
+      : FelixFragmentBase(fragment) {}
 
   // The number of words in the current event minus the header.
   size_t total_words() const { return sizeBytes_ / sizeof(word_t); }
@@ -433,6 +458,17 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
     return total_frames() * FelixFrame::num_ch_per_frame;
   }
 
+  // Faulty header information. Frames with faulty headers store their own
+  // headers, all others follow from the headers of the first frame.
+  bool header_is_faulty(const unsigned int frame_num) const {
+    return faulty_headers.test(frame_num);
+  }
+  // Bitfield of faulty headers, one bit per frame from the least significant
+  // bit of the first byte on.
+  const uint8_t* faulty_header_bits() const {
+    return static_cast<uint8_t const*>(artdaq_Fragment_) + bitlist_start;
+  }
+
  protected:
   // Important positions within the data buffer.
   const unsigned int adc_start = 0;
@@ -443,14 +479,16 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
   const unsigned int header_set_size =
       sizeof(dune::WIBHeader) + 4 * sizeof(dune::ColdataHeader);
 
-  // Faulty header information.
-  bool header_is_faulty(const unsigned int frame_num) const {
-    const uint8_t* curr_byte = static_cast<uint8_t const*>(artdaq_Fragment_) +
-                               bitlist_start + frame_num / 8;
-    return ((*curr_byte) >> (frame_num % 8)) & 1;
-  }
+  // Faulty header bitfield. The stored headers of a faulty frame follow
+  // those of the first frame and of the faulty frames before it.
+  const BitRank faulty_headers = BitRank(
+      static_cast<uint8_t const*>(artdaq_Fragment_) + bitlist_start,
+      meta_.num_frames);
+
   // Number of the faulty header (0 if header is good).
-  std::vector<unsigned int> bad_header_num;
+  unsigned int bad_header_num(const unsigned int frame_num) const {
+    return header_is_faulty(frame_num) ? faulty_headers.rank(frame_num) + 1 : 0;
+  }
 
   // Reordered frame format overlaid on the data.
   dune::WIBHeader const* head_(const unsigned int frame_num) const {
@@ -458,7 +496,7 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
       // Return faulty header.
       return reinterpret_cast<dune::WIBHeader const*>(
           static_cast<uint8_t const*>(artdaq_Fragment_) + header_start +
-          bad_header_num[frame_num] * header_set_size);
+          bad_header_num(frame_num) * header_set_size);
     } else {
       // Return the first header unchanged if requested header is good.
       return reinterpret_cast<dune::WIBHeader const*>(
@@ -473,7 +511,7 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
       return reinterpret_cast<dune::ColdataHeader const*>(
                  static_cast<uint8_t const*>(artdaq_Fragment_) + header_start +
                  sizeof(dune::WIBHeader) +
-                 bad_header_num[frame_num] * header_set_size) +
+                 bad_header_num(frame_num) * header_set_size) +
              block_num;
     } else {
       // Return the first header unchanged if the requested header is good.
@@ -484,8 +522,8 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
     }
   }
 
-  dune::adc_t channel_(const unsigned int frame_num,
-                       const uint8_t ch_num) const {
+  dune::adc_t const& channel_(const unsigned int frame_num,
+                              const uint8_t ch_num) const {
     return *(reinterpret_cast<dune::adc_t const*>(
                  static_cast<uint8_t const*>(artdaq_Fragment_) + adc_start) +
              frame_num + ch_num * meta_.num_frames);
@@ -495,8 +533,29 @@ class dune::FelixFragmentReordered : public dune::FelixFragmentBase {
 //=======================================
 // FELIX fragment for compressed frames.
 //=======================================
-class dune::FelixFragmentCompressed : public FelixFragmentBase {
+class dune::FelixFragmentCompressed final : public FelixFragmentBase {
+ public:
+  typedef std::variant<FelixFragmentUnordered, FelixFragmentReordered> layout_t;
+
  private:
+  artdaq::Fragment uncompressed_copy_(const artdaq::Fragment& src) {
+    artdaq::Fragment dst;
+    decompress_copy(src, dst);
+
+    // Update metadata.
+    meta_.compressed = 0;
+    dst.setMetadata(meta_);
+    return dst;
+  }
+
+  static layout_t make_layout_(const artdaq::Fragment& fragment,
+                               const bool reordered) {
+    if (reordered) {
+      return layout_t(std::in_place_type<FelixFragmentReordered>, fragment);
+    }
+    return layout_t(std::in_place_type<FelixFragmentUnordered>, fragment);
+  }
+
   int decompress_copy(const artdaq::Fragment& src, artdaq::Fragment& dst) {
     // Determine and reserve new fragment size.
     long unsigned int uncompSizeBytes;
@@ -571,102 +630,126 @@ class dune::FelixFragmentCompressed : public FelixFragmentBase {
 
  public:
   FelixFragmentCompressed(const artdaq::Fragment& fragment)
-      : FelixFragmentBase(fragment) {
-    // Decompress.
-    decompress_copy(fragment, uncompfrag_);
-    // std::cout << decompress_copy(fragment, uncompfrag_) << " returned from
-    // decompress_copy\n";
+      : FelixFragmentBase(fragment),
+        uncompfrag_(uncompressed_copy_(fragment)),
+        flxfrag(make_layout_(uncompfrag_, meta_.reordered)) {}
 
-    // Update metadata.
-    meta_.compressed = 0;
-    uncompfrag_.setMetadata(meta_);
-    if (meta_.reordered) {
-      flxfrag = new FelixFragmentReordered(uncompfrag_);
-    } else {
-      flxfrag = new FelixFragmentUnordered(uncompfrag_);
-    }
-  }
+  // The layout points into uncompfrag_, so copies would dangle.
+  FelixFragmentCompressed(const FelixFragmentCompressed&) = delete;
+  FelixFragmentCompressed& operator=(const FelixFragmentCompressed&) = delete;
 
-  ~FelixFragmentCompressed() { delete flxfrag; }
+  // Call f with the layout of the uncompressed data.
+  template <typename F>
+  decltype(auto) visit(F&& f) const {
+    return std::visit(std::forward<F>(f), flxfrag);
+  }
 
   /* Frame field and accessors. */
   uint8_t sof(const unsigned& frame_ID = 0) const {
-    return flxfrag->sof(frame_ID);
+    return visit([&](auto const& l) { return l.sof(frame_ID); });
   }
   uint8_t version(const unsigned& frame_ID = 0) const {
-    return flxfrag->version(frame_ID);
+    return visit([&](auto const& l) { return l.version(frame_ID); });
   }
   uint8_t fiber_no(const unsigned& frame_ID = 0) const {
-    return flxfrag->fiber_no(frame_ID);
+    return visit([&](auto const& l) { return l.fiber_no(frame_ID); });
   }
   uint8_t slot_no(const unsigned& frame_ID = 0) const {
-    return flxfrag->slot_no(frame_ID);
+    return visit([&](auto const& l) { return l.slot_no(frame_ID); });
   }
   uint8_t crate_no(const unsigned& frame_ID = 0) const {
-    return flxfrag->crate_no(frame_ID);
+    return visit([&](auto const& l) { return l.crate_no(frame_ID); });
   }
   uint8_t mm(const unsigned& frame_ID = 0) const {
-    return flxfrag->mm(frame_ID);
+    return visit([&](auto const& l) { return l.mm(frame_ID); });
   }
   uint8_t oos(const unsigned& frame_ID = 0) const {
-    return flxfrag->oos(frame_ID);
+    return visit([&](auto const& l) { return l.oos(frame_ID); });
   }
   uint16_t wib_errors(const unsigned& frame_ID = 0) const {
-    return flxfrag->wib_errors(frame_ID);
+    return visit([&](auto const& l) { return l.wib_errors(frame_ID); });
   }
   uint64_t timestamp(const unsigned& frame_ID = 0) const {
-    return flxfrag->timestamp(frame_ID);
+    return visit([&](auto const& l) { return l.timestamp(frame_ID); });
   }
   uint16_t wib_counter(const unsigned& frame_ID = 0) const {
-    return flxfrag->wib_counter(frame_ID);
+    return visit([&](auto const& l) { return l.wib_counter(frame_ID); });
   }
 
   /* Coldata block accessors. */
   uint8_t s1_error(const unsigned& frame_ID, const uint8_t& block_num) const {
-    return flxfrag->s1_error(frame_ID, block_num);
+    return visit(
+        [&](auto const& l) { return l.s1_error(frame_ID, block_num); });
   }
   uint8_t s2_error(const unsigned& frame_ID, const uint8_t& block_num) const {
-    return flxfrag->s2_error(frame_ID, block_num);
+    return visit(
+        [&](auto const& l) { return l.s2_error(frame_ID, block_num); });
   }
   uint16_t checksum_a(const unsigned& frame_ID,
                       const uint8_t& block_num) const {
-    return flxfrag->checksum_a(frame_ID, block_num);
+    return visit(
+        [&](auto const& l) { return l.checksum_a(frame_ID, block_num); });
   }
   uint16_t checksum_b(const unsigned& frame_ID,
                       const uint8_t& block_num) const {
-    return flxfrag->checksum_b(frame_ID, block_num);
+    return visit(
+        [&](auto const& l) { return l.checksum_b(frame_ID, block_num); });
   }
   uint16_t coldata_convert_count(const unsigned& frame_ID,
                                  const uint8_t& block_num) const {
-    return flxfrag->coldata_convert_count(frame_ID, block_num);
+    return visit([&](auto const& l) {
+      return l.coldata_convert_count(frame_ID, block_num);
+    });
   }
   uint16_t error_register(const unsigned& frame_ID,
                           const uint8_t& block_num) const {
-    return flxfrag->error_register(frame_ID, block_num);
+    return visit(
+        [&](auto const& l) { return l.error_register(frame_ID, block_num); });
   }
   uint8_t hdr(const unsigned& frame_ID, const uint8_t& block_num,
               const uint8_t& hdr_num) const {
-    return flxfrag->hdr(frame_ID, block_num, hdr_num);
+    return visit(
+        [&](auto const& l) { return l.hdr(frame_ID, block_num, hdr_num); });
   }
 
   // Function to return a certain ADC value.
   adc_t get_ADC(const unsigned& frame_ID, const uint8_t channel_ID) const {
-    return flxfrag->get_ADC(frame_ID, channel_ID);
+    return visit(
+        [&](auto const& l) { return l.get_ADC(frame_ID, channel_ID); });
+  }
+  void get_ADC_block(adc_t* dst, const size_t& stride,
+                     const unsigned& frame_ID,
+                     const unsigned& num_frames) const {
+    visit([&](auto const& l) {
+      l.get_ADC_block(dst, stride, frame_ID, num_frames);
+    });
   }
 
   // Function to print all timestamps.
-  void print_timestamps() const { return flxfrag->print_timestamps(); }
+  void print_timestamps() const {
+    visit([&](auto const& l) { l.print_timestamps(); });
+  }
 
-  void print(const unsigned i) const { return flxfrag->print(i); }
+  void print(const unsigned i) const {
+    visit([&](auto const& l) { l.print(i); });
+  }
 
-  void print_frames() const { return flxfrag->print_frames(); }
+  void print_frames() const {
+    visit([&](auto const& l) { l.print_frames(); });
+  }
 
   // The number of words in the current event minus the header.
-  size_t total_words() const { return flxfrag->total_words(); }
+  size_t total_words() const {
+    return visit([&](auto const& l) { return l.total_words(); });
+  }
   // The number of frames in the current event.
-  size_t total_frames() const { return flxfrag->total_frames(); }
+  size_t total_frames() const {
+    return visit([&](auto const& l) { return l.total_frames(); });
+  }
   // The number of ADC values describing data beyond the header
-  size_t total_adc_values() const { return flxfrag->total_adc_values(); }
+  size_t total_adc_values() const {
+    return visit([&](auto const& l) { return l.total_adc_values(); });
+  }
 
   // Const function to return the uncompressed fragment.
   const artdaq::Fragment uncompressed_fragment() const { return uncompfrag_; }
@@ -674,8 +757,8 @@ class dune::FelixFragmentCompressed : public FelixFragmentBase {
  protected:
   // Uncompressed data fragment.
   artdaq::Fragment uncompfrag_;
-  // Member pointer to access uncompressed data.
-  const FelixFragmentBase* flxfrag;
+  // Layout of the uncompressed data.
+  const layout_t flxfrag;
 };  // class dune::FelixFragmentCompressed
 
 //======================
@@ -683,101 +766,153 @@ class dune::FelixFragmentCompressed : public FelixFragmentBase {
 //======================
 class dune::FelixFragment : public FelixFragmentBase {
  public:
+  typedef std::variant<FelixFragmentUnordered, FelixFragmentReordered,
+                       FelixFragmentCompressed>
+      layout_t;
+
   FelixFragment(const artdaq::Fragment& fragment)
-      : FelixFragmentBase(fragment) {
-    if (meta_.compressed) {
-      flxfrag = new FelixFragmentCompressed(fragment);
-    } else if (meta_.reordered) {
-      flxfrag = new FelixFragmentReordered(fragment);
-    } else {
-      flxfrag = new FelixFragmentUnordered(fragment);
-    }
+      : FelixFragmentBase(fragment), flxfrag(make_layout_(fragment, meta_)) {
+    const uint64_t first_timestamp = timestamp();
 
     // Try to set the timestamp offset to the metadata offset.
     bool shift_good = true;
     // Is the first requested frame in the data?
     shift_good &=
-        fragment.timestamp() - meta_.offset_frames * 25 >= flxfrag->timestamp();
+        fragment.timestamp() - meta_.offset_frames * 25 >= first_timestamp;
     // Is the data big enough to accommodate the window size?
     shift_good &= fragment.timestamp() -
                       (meta_.offset_frames + meta_.window_frames) * 25 <=
-                  flxfrag->timestamp() + meta_.num_frames * 25;
+                  first_timestamp + meta_.num_frames * 25;
 
     if (shift_good) {
-      trig_offset = (fragment.timestamp() - flxfrag->timestamp()) / 25 - meta_.offset_frames;
+      trig_offset = (fragment.timestamp() - first_timestamp) / 25 -
+                    meta_.offset_frames;
     } else {
       mf::LogWarning("dune::FelixFragment")
           << "Can't find the trigger window in FELIX fragment "
           << fragment.fragmentID() << ".\nFragment TS: " << fragment.timestamp()
-          << " first frame TS: " << flxfrag->timestamp() << '\n';
+          << " first frame TS: " << first_timestamp << '\n';
     }
   }
 
-  ~FelixFragment() { delete flxfrag; }
+ private:
+  // Compressed fragments forward to the layout of their uncompressed data.
+  template <typename F>
+  static decltype(auto) visit_layout_(const FelixFragmentCompressed& l, F& f) {
+    return l.visit(f);
+  }
+  template <typename L, typename F>
+  static decltype(auto) visit_layout_(const L& l, F& f) {
+    return f(l);
+  }
+
+ public:
+  // Call f with the layout holding the (uncompressed) data, either a
+  // FelixFragmentUnordered or a FelixFragmentReordered. Loops over frames
+  // inside f are compiled for each layout and calls on it are not virtual.
+  // Frame numbers of the layout count from the start of the data, so add
+  // trigger_offset() to address the trigger window.
+  template <typename F>
+  decltype(auto) visit(F&& f) const {
+    return std::visit(
+        [&f](auto const& l) -> decltype(auto) { return visit_layout_(l, f); },
+        flxfrag);
+  }
+  size_t trigger_offset() const { return trig_offset; }
 
   /* Frame field and accessors. */
   uint8_t sof(const unsigned& frame_ID = 0) const {
-    return flxfrag->sof(frame_ID + trig_offset);
+    return visit([&](auto const& l) { return l.sof(frame_ID + trig_offset); });
   }
   uint8_t version(const unsigned& frame_ID = 0) const {
-    return flxfrag->version(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.version(frame_ID + trig_offset); });
   }
   uint8_t fiber_no(const unsigned& frame_ID = 0) const {
-    return flxfrag->fiber_no(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.fiber_no(frame_ID + trig_offset); });
   }
   uint8_t slot_no(const unsigned& frame_ID = 0) const {
-    return flxfrag->slot_no(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.slot_no(frame_ID + trig_offset); });
   }
   uint8_t crate_no(const unsigned& frame_ID = 0) const {
-    return flxfrag->crate_no(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.crate_no(frame_ID + trig_offset); });
   }
   uint8_t mm(const unsigned& frame_ID = 0) const {
-    return flxfrag->mm(frame_ID + trig_offset);
+    return visit([&](auto const& l) { return l.mm(frame_ID + trig_offset); });
   }
   uint8_t oos(const unsigned& frame_ID = 0) const {
-    return flxfrag->oos(frame_ID + trig_offset);
+    return visit([&](auto const& l) { return l.oos(frame_ID + trig_offset); });
   }
   uint16_t wib_errors(const unsigned& frame_ID = 0) const {
-    return flxfrag->wib_errors(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.wib_errors(frame_ID + trig_offset); });
   }
   uint64_t timestamp(const unsigned& frame_ID = 0) const {
-    return flxfrag->timestamp(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.timestamp(frame_ID + trig_offset); });
   }
   uint16_t wib_counter(const unsigned& frame_ID = 0) const {
-    return flxfrag->wib_counter(frame_ID + trig_offset);
+    return visit(
+        [&](auto const& l) { return l.wib_counter(frame_ID + trig_offset); });
   }
 
   /* Coldata block accessors. */
   uint8_t s1_error(const unsigned& frame_ID, const uint8_t& block_num) const {
-    return flxfrag->s1_error(frame_ID + trig_offset, block_num);
+    return visit([&](auto const& l) {
+      return l.s1_error(frame_ID + trig_offset, block_num);
+    });
   }
   uint8_t s2_error(const unsigned& frame_ID, const uint8_t& block_num) const {
-    return flxfrag->s2_error(frame_ID + trig_offset, block_num);
+    return visit([&](auto const& l) {
+      return l.s2_error(frame_ID + trig_offset, block_num);
+    });
   }
   uint16_t checksum_a(const unsigned& frame_ID,
                       const uint8_t& block_num) const {
-    return flxfrag->checksum_a(frame_ID + trig_offset, block_num);
+    return visit([&](auto const& l) {
+      return l.checksum_a(frame_ID + trig_offset, block_num);
+    });
   }
   uint16_t checksum_b(const unsigned& frame_ID,
                       const uint8_t& block_num) const {
-    return flxfrag->checksum_b(frame_ID + trig_offset, block_num);
+    return visit([&](auto const& l) {
+      return l.checksum_b(frame_ID + trig_offset, block_num);
+    });
   }
   uint16_t coldata_convert_count(const unsigned& frame_ID,
                                  const uint8_t& block_num) const {
-    return flxfrag->coldata_convert_count(frame_ID + trig_offset, block_num);
+    return visit([&](auto const& l) {
+      return l.coldata_convert_count(frame_ID + trig_offset, block_num);
+    });
   }
   uint16_t error_register(const unsigned& frame_ID,
                           const uint8_t& block_num) const {
-    return flxfrag->error_register(frame_ID + trig_offset, block_num);
+    return visit([&](auto const& l) {
+      return l.error_register(frame_ID + trig_offset, block_num);
+    });
   }
   uint8_t hdr(const unsigned& frame_ID, const uint8_t& block_num,
               const uint8_t& hdr_num) const {
-    return flxfrag->hdr(frame_ID + trig_offset, block_num, hdr_num);
+    return visit([&](auto const& l) {
+      return l.hdr(frame_ID + trig_offset, block_num, hdr_num);
+    });
   }
 
   // Functions to return a certain ADC value.
   adc_t get_ADC(const unsigned& frame_ID, const uint8_t channel_ID) const {
-    return flxfrag->get_ADC(frame_ID + trig_offset, channel_ID);
+    return visit([&](auto const& l) {
+      return l.get_ADC(frame_ID + trig_offset, channel_ID);
+    });
+  }
+  void get_ADC_block(adc_t* dst, const size_t& stride,
+                     const unsigned& frame_ID,
+                     const unsigned& num_frames) const {
+    visit([&](auto const& l) {
+      l.get_ADC_block(dst, stride, frame_ID + trig_offset, num_frames);
+    });
   }
   adc_t get_ADC(const unsigned& frame_ID, const uint8_t block_ID,
                 const uint8_t channel_ID) const {
@@ -799,29 +934,65 @@ class dune::FelixFragment : public FelixFragmentBase {
 
   // Function to return all ADC values for all channels in a map.
   std::map<uint8_t, adc_v> get_all_ADCs() const {
+    adc_aligned_v buffer;
+    get_all_ADCs(buffer);
     std::map<uint8_t, adc_v> output;
     for (int i = 0; i < 256; i++)
-      output.insert(std::pair<uint8_t, adc_v>(i, get_ADCs_by_channel(i)));
+      output.insert(std::pair<uint8_t, adc_v>(
+          i, adc_v(buffer.begin() + i * total_frames(),
+                   buffer.begin() + (i + 1) * total_frames())));
     return output;
   }
+  // Function to decode all ADC values into a channel-major buffer of 256 rows
+  // of stride values (total_frames() if zero), one row per channel.
+  void get_all_ADCs(adc_t* dst, size_t stride = 0) const {
+    if (stride == 0) stride = total_frames();
+    get_ADC_block(dst, stride, 0, total_frames());
+  }
+  void get_all_ADCs(adc_aligned_v& dst) const {
+    dst.resize(FelixFrame::num_ch_per_frame * total_frames());
+    get_all_ADCs(dst.data());
+  }
 
   // Function to print all timestamps.
-  void print_timestamps() const { return flxfrag->print_timestamps(); }
+  void print_timestamps() const {
+    visit([&](auto const& l) { l.print_timestamps(); });
+  }
 
-  void print(const unsigned i) const { return flxfrag->print(i); }
+  void print(const unsigned i) const {
+    visit([&](auto const& l) { l.print(i); });
+  }
 
-  void print_frames() const { return flxfrag->print_frames(); }
+  void print_frames() const {
+    visit([&](auto const& l) { l.print_frames(); });
+  }
 
   // The number of words in the current event minus the header.
-  size_t total_words() const { return flxfrag->total_words(); }
+  size_t total_words() const {
+    return visit([&](auto const& l) { return l.total_words(); });
+  }
   // The number of frames in the current event.
-  size_t total_frames() const { return flxfrag->total_frames(); }
+  size_t total_frames() const {
+    return visit([&](auto const& l) { return l.total_frames(); });
+  }
   // The number of ADC values describing data beyond the header
-  size_t total_adc_values() const { return flxfrag->total_adc_values(); }
+  size_t total_adc_values() const {
+    return visit([&](auto const& l) { return l.total_adc_values(); });
+  }
 
  private:
+  static layout_t make_layout_(const artdaq::Fragment& fragment,
+                               const Metadata& meta) {
+    if (meta.compressed) {
+      return layout_t(std::in_place_type<FelixFragmentCompressed>, fragment);
+    } else if (meta.reordered) {
+      return layout_t(std::in_place_type<FelixFragmentReordered>, fragment);
+    }
+    return layout_t(std::in_place_type<FelixFragmentUnordered>, fragment);
+  }
+
   size_t trig_offset = 0;
-  const FelixFragmentBase* flxfrag;
+  const layout_t flxfrag;
 };  // class dune::FelixFragment
 
 #endif /* artdaq_dune_Overlays_FelixFragment_hh */
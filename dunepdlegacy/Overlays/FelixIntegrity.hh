@@ -0,0 +1,456 @@
+// FelixIntegrity.hh checks the frame headers of FELIX fragments for
+// consistency in a single pass and summarises the errors found.
+
+#ifndef artdaq_dune_Overlays_FelixIntegrity_hh
+#define artdaq_dune_Overlays_FelixIntegrity_hh
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "artdaq-core/Data/Fragment.hh"
+#include "dunepdlegacy/Overlays/FelixFormat.hh"
+#include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
+
+namespace dune {
+
+// Result of the integrity check of one fragment: a bitmap of the kinds of
+// errors found, the number of frames showing each kind and the first frame
+// with any error. Frame numbers count from the first checked frame.
+struct FelixIntegrity {
+  enum Error : uint16_t {
+    // The timestamp does not increase by 25.
+    timestamp_step = 1 << 0,
+    // The COLDATA convert count of block 0 or 2 does not increase by one.
+    ccc_step = 1 << 1,
+    // The convert counts of blocks 0 and 1 or of blocks 2 and 3 differ.
+    ccc_mismatch = 1 << 2,
+    // Fiber, crate or slot number differ from those of the first frame.
+    fiber_changed = 1 << 3,
+    crate_changed = 1 << 4,
+    slot_changed = 1 << 5,
+    // WIB error bits, the mismatch or the out of sync flag are set.
+    wib_error = 1 << 6
+  };
+  static constexpr unsigned num_errors = 7;
+  static constexpr uint16_t all_errors = (1 << num_errors) - 1;
+  // Every header error but the WIB error bits, the mask FelixDecoder
+  // rejects fragments for.
+  static constexpr uint16_t header_errors = all_errors & ~wib_error;
+
+  uint16_t errors = 0;
+  unsigned num_frames = 0;
+  unsigned first_bad_frame = 0;
+  unsigned frame_counts[num_errors] = {};
+
+  bool good(const uint16_t mask = all_errors) const {
+    return (errors & mask) == 0;
+  }
+
+  // Record the errors e for count frames from frame on.
+  void flag(const unsigned frame, const uint16_t e, const unsigned count = 1) {
+    if (e == 0 || count == 0) return;
+    if (errors == 0 || frame < first_bad_frame) first_bad_frame = frame;
+    errors |= e;
+    for (unsigned k = 0; k < num_errors; ++k) {
+      if (e & (1 << k)) frame_counts[k] += count;
+    }
+  }
+
+  static const char* error_name(const unsigned k) {
+    static const char* const names[num_errors] = {
+        "timestamp step", "CCC step",      "CCC mismatch", "fiber changed",
+        "crate changed",  "slot changed", "WIB error"};
+    return k < num_errors ? names[k] : "";
+  }
+};
+
+// Error counts over many fragments.
+struct FelixIntegritySummary {
+  uint64_t fragments = 0;
+  uint64_t bad_fragments = 0;
+  uint64_t frames = 0;
+  // Number of fragments and of frames showing each kind of error.
+  uint64_t fragment_counts[FelixIntegrity::num_errors] = {};
+  uint64_t frame_counts[FelixIntegrity::num_errors] = {};
+
+  void add(const FelixIntegrity& result) {
+    ++fragments;
+    bad_fragments += !result.good();
+    frames += result.num_frames;
+    for (unsigned k = 0; k < FelixIntegrity::num_errors; ++k) {
+      fragment_counts[k] += (result.errors >> k) & 1;
+      frame_counts[k] += result.frame_counts[k];
+    }
+  }
+
+  void merge(const FelixIntegritySummary& other) {
+    fragments += other.fragments;
+    bad_fragments += other.bad_fragments;
+    frames += other.frames;
+    for (unsigned k = 0; k < FelixIntegrity::num_errors; ++k) {
+      fragment_counts[k] += other.fragment_counts[k];
+      frame_counts[k] += other.frame_counts[k];
+    }
+  }
+};
+
+// Checks of the headers of consecutive frames. Bare frames are scanned with
+// AVX2 gathers of the header words of eight frames at a time where
+// available. Reordered frames only need their faulty headers checked, as all
+// others follow from the first header by construction.
+class FelixIntegrityCheck {
+ public:
+  // Check num_frames bare frames.
+  static FelixIntegrity check(const FelixFrame* frames,
+                              const size_t num_frames) {
+    if (FelixReorder::avx_available()) {
+      return check_avx2(frames, num_frames);
+    }
+    return check_baseline(frames, num_frames);
+  }
+
+  // Check frames first_frame to first_frame + num_frames - 1 of a layout.
+  static FelixIntegrity check(const FelixFragmentUnordered& l,
+                              const size_t first_frame,
+                              const size_t num_frames) {
+    return check(l.frames() + first_frame, num_frames);
+  }
+  static FelixIntegrity check(const FelixFragmentReordered& l,
+                              const size_t first_frame,
+                              const size_t num_frames) {
+    FelixIntegrity result;
+    result.num_frames = num_frames;
+    if (num_frames == 0) return result;
+
+    const uint8_t* bits = l.faulty_header_bits();
+    const size_t end = first_frame + num_frames;
+    const Header first = header(l, first_frame);
+    result.flag(0, frame_errors(first, first));
+
+    // Frames with good headers all share the headers of frame 0.
+    const uint16_t good_errors = frame_errors(first, header(l, 0));
+    size_t num_good = 0, first_good = end;
+    bool prev_faulty = l.header_is_faulty(first_frame);
+    size_t fr = first_frame + 1;
+    while (fr < end) {
+      // Skip runs of 64 good frames following a good frame.
+      if (fr % 64 == 0 && fr + 64 <= end && !prev_faulty) {
+        uint64_t word;
+        memcpy(&word, bits + fr / 8, sizeof(word));
+        if (word == 0) {
+          first_good = std::min(first_good, fr);
+          num_good += 64;
+          fr += 64;
+          continue;
+        }
+      }
+      const bool faulty = (bits[fr / 8] >> (fr % 8)) & 1;
+      if (faulty) {
+        const Header h = header(l, fr);
+        result.flag(fr - first_frame, frame_errors(first, h) |
+                                          step_errors(header(l, fr - 1), h));
+      } else {
+        if (prev_faulty) {
+          result.flag(fr - first_frame,
+                      step_errors(header(l, fr - 1), header(l, fr)));
+        }
+        first_good = std::min(first_good, fr);
+        ++num_good;
+      }
+      prev_faulty = faulty;
+      ++fr;
+    }
+    if (num_good != 0) {
+      result.flag(first_good - first_frame, good_errors, num_good);
+    }
+    return result;
+  }
+
+  static FelixIntegrity check_baseline(const FelixFrame* frames,
+                                       const size_t num_frames) {
+    FelixIntegrity result;
+    result.num_frames = num_frames;
+    if (num_frames == 0) return result;
+    const Header first = header(frames[0]);
+    result.flag(0, frame_errors(first, first));
+    check_scalar(frames, 1, num_frames, first, result);
+    return result;
+  }
+
+  FELIX_REORDER_AVX2 static FelixIntegrity check_avx2(
+      const FelixFrame* frames, const size_t num_frames) {
+    FelixIntegrity result;
+    result.num_frames = num_frames;
+    if (num_frames == 0) return result;
+    const Header first = header(frames[0]);
+    result.flag(0, frame_errors(first, first));
+
+    // Word offsets of the checked header fields within a frame.
+    const int frame_words = sizeof(FelixFrame) / sizeof(word_t);
+    const int block_words = sizeof(ColdataBlock) / sizeof(word_t);
+    const int wib_words = sizeof(WIBHeader) / sizeof(word_t);
+    const __m256i index = _mm256_mullo_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(frame_words));
+    const __m256i rotate = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+
+    const int* words = reinterpret_cast<const int*>(frames);
+    const __m256i id_mask = _mm256_set1_epi32(0x00ffe000);
+    const __m256i first_id =
+        _mm256_and_si256(_mm256_set1_epi32(words[0]), id_mask);
+    const __m256i wib_mask = _mm256_set1_epi32((int)0xffff0003);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi32(1);
+
+    // Header fields of the frame before the group, in the last lane.
+    __m256i prev_ts_lo = _mm256_set1_epi32((int)(uint32_t)first.timestamp);
+    __m256i prev_ts_hi =
+        _mm256_set1_epi32((int)(uint32_t)(first.timestamp >> 32));
+    __m256i prev_ccc0 = _mm256_set1_epi32(first.ccc[0]);
+    __m256i prev_ccc2 = _mm256_set1_epi32(first.ccc[2]);
+
+    size_t fr = 1;
+    for (; fr + 8 <= num_frames; fr += 8) {
+      const int* base = words + fr * frame_words;
+      const __m256i id = _mm256_i32gather_epi32(base, index, 4);
+      const __m256i wib = _mm256_i32gather_epi32(base + 1, index, 4);
+      const __m256i ts_lo = _mm256_i32gather_epi32(base + 2, index, 4);
+      const __m256i ts_word = _mm256_i32gather_epi32(base + 3, index, 4);
+      __m256i ccc[4];
+      for (int b = 0; b < 4; ++b) {
+        ccc[b] = _mm256_srli_epi32(
+            _mm256_i32gather_epi32(base + wib_words + b * block_words + 1,
+                                   index, 4),
+            16);
+      }
+      // Without the z flag the WIB counter extends the timestamp.
+      const __m256i z = _mm256_srai_epi32(ts_word, 31);
+      const __m256i ts_hi = _mm256_and_si256(
+          ts_word, _mm256_xor_si256(_mm256_set1_epi32(0x7fffffff),
+                                    _mm256_and_si256(
+                                        z, _mm256_set1_epi32(0x7fff0000))));
+
+      // Values of the previous frames.
+      const __m256i p_ts_lo = previous(ts_lo, prev_ts_lo, rotate);
+      const __m256i p_ts_hi = previous(ts_hi, prev_ts_hi, rotate);
+      const __m256i p_ccc0 = previous(ccc[0], prev_ccc0, rotate);
+      const __m256i p_ccc2 = previous(ccc[2], prev_ccc2, rotate);
+
+      // The timestamp difference is 25 if the low words differ by 25 and the
+      // high words by the carry of that addition.
+      const __m256i carry = _mm256_cmpeq_epi32(
+          _mm256_min_epu32(ts_lo, _mm256_set1_epi32(24)), ts_lo);
+      const __m256i ts_ok = _mm256_and_si256(
+          _mm256_cmpeq_epi32(ts_lo,
+                             _mm256_add_epi32(p_ts_lo, _mm256_set1_epi32(25))),
+          _mm256_cmpeq_epi32(ts_hi,
+                             _mm256_sub_epi32(p_ts_hi, carry)));
+      const __m256i ccc_ok = _mm256_and_si256(
+          ccc_step_ok(p_ccc0, ccc[0], ones), ccc_step_ok(p_ccc2, ccc[2], ones));
+      const __m256i ccc_same =
+          _mm256_and_si256(_mm256_cmpeq_epi32(ccc[0], ccc[1]),
+                           _mm256_cmpeq_epi32(ccc[2], ccc[3]));
+      const __m256i id_diff =
+          _mm256_xor_si256(_mm256_and_si256(id, id_mask), first_id);
+      const __m256i wib_set = _mm256_and_si256(wib, wib_mask);
+
+      const unsigned masks[FelixIntegrity::num_errors] = {
+          ~movemask(ts_ok) & 0xffu,
+          ~movemask(ccc_ok) & 0xffu,
+          ~movemask(ccc_same) & 0xffu,
+          ~movemask(_mm256_cmpeq_epi32(
+              _mm256_and_si256(id_diff, _mm256_set1_epi32(0x0000e000)),
+              zero)) & 0xffu,
+          ~movemask(_mm256_cmpeq_epi32(
+              _mm256_and_si256(id_diff, _mm256_set1_epi32(0x001f0000)),
+              zero)) & 0xffu,
+          ~movemask(_mm256_cmpeq_epi32(
+              _mm256_and_si256(id_diff, _mm256_set1_epi32(0x00e00000)),
+              zero)) & 0xffu,
+          ~movemask(_mm256_cmpeq_epi32(wib_set, zero)) & 0xffu};
+      unsigned any = 0;
+      for (unsigned k = 0; k < FelixIntegrity::num_errors; ++k) {
+        any |= masks[k];
+      }
+      if (any != 0) {
+        if (result.errors == 0) {
+          result.first_bad_frame = fr + __builtin_ctz(any);
+        }
+        for (unsigned k = 0; k < FelixIntegrity::num_errors; ++k) {
+          if (masks[k] != 0) {
+            result.errors |= 1 << k;
+            result.frame_counts[k] += __builtin_popcount(masks[k]);
+          }
+        }
+      }
+
+      prev_ts_lo = ts_lo;
+      prev_ts_hi = ts_hi;
+      prev_ccc0 = ccc[0];
+      prev_ccc2 = ccc[2];
+    }
+    check_scalar(frames, fr, num_frames, first, result);
+    return result;
+  }
+
+ private:
+  // The checked fields of one frame.
+  struct Header {
+    uint64_t timestamp;
+    uint16_t ccc[4];
+    uint8_t fiber_no, crate_no, slot_no;
+    bool wib_error;
+  };
+
+  static Header header(const FelixFrame& f) {
+    Header h;
+    h.timestamp = f.timestamp();
+    for (uint8_t b = 0; b < 4; ++b) {
+      h.ccc[b] = f.coldata_convert_count(b);
+    }
+    h.fiber_no = f.fiber_no();
+    h.crate_no = f.crate_no();
+    h.slot_no = f.slot_no();
+    h.wib_error = f.wib_errors() != 0 || f.mm() || f.oos();
+    return h;
+  }
+  static Header header(const FelixFragmentReordered& l, const unsigned fr) {
+    Header h;
+    h.timestamp = l.timestamp(fr);
+    for (uint8_t b = 0; b < 4; ++b) {
+      h.ccc[b] = l.coldata_convert_count(fr, b);
+    }
+    h.fiber_no = l.fiber_no(fr);
+    h.crate_no = l.crate_no(fr);
+    h.slot_no = l.slot_no(fr);
+    h.wib_error = l.wib_errors(fr) != 0 || l.mm(fr) || l.oos(fr);
+    return h;
+  }
+
+  // Steps of one, including the wrap around at 2^16, and resets by 33919
+  // are accepted.
+  static bool ccc_step_ok(const uint16_t prev, const uint16_t cur) {
+    const int step = (int)cur - prev;
+    return step == 1 || step == -65535 || step == -33919;
+  }
+  FELIX_REORDER_AVX2 static __m256i ccc_step_ok(const __m256i prev,
+                                                const __m256i cur,
+                                                const __m256i ones) {
+    const __m256i step = _mm256_sub_epi32(cur, prev);
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi32(step, ones),
+                        _mm256_cmpeq_epi32(step, _mm256_set1_epi32(-65535))),
+        _mm256_cmpeq_epi32(step, _mm256_set1_epi32(-33919)));
+  }
+
+  // Errors of a frame on its own and against the first frame.
+  static uint16_t frame_errors(const Header& first, const Header& h) {
+    uint16_t e = 0;
+    if (h.ccc[0] != h.ccc[1] || h.ccc[2] != h.ccc[3]) {
+      e |= FelixIntegrity::ccc_mismatch;
+    }
+    if (h.fiber_no != first.fiber_no) e |= FelixIntegrity::fiber_changed;
+    if (h.crate_no != first.crate_no) e |= FelixIntegrity::crate_changed;
+    if (h.slot_no != first.slot_no) e |= FelixIntegrity::slot_changed;
+    if (h.wib_error) e |= FelixIntegrity::wib_error;
+    return e;
+  }
+  // Errors in the step from one frame to the next.
+  static uint16_t step_errors(const Header& prev, const Header& h) {
+    uint16_t e = 0;
+    if (h.timestamp - prev.timestamp != 25) {
+      e |= FelixIntegrity::timestamp_step;
+    }
+    if (!ccc_step_ok(prev.ccc[0], h.ccc[0]) ||
+        !ccc_step_ok(prev.ccc[2], h.ccc[2])) {
+      e |= FelixIntegrity::ccc_step;
+    }
+    return e;
+  }
+
+  static void check_scalar(const FelixFrame* frames, const size_t begin,
+                           const size_t end, const Header& first,
+                           FelixIntegrity& result) {
+    if (begin >= end) return;
+    Header prev = header(frames[begin - 1]);
+    for (size_t fr = begin; fr < end; ++fr) {
+      const Header h = header(frames[fr]);
+      result.flag(fr, frame_errors(first, h) | step_errors(prev, h));
+      prev = h;
+    }
+  }
+
+  // Lanes shifted up by one, with the last lane of before in the first.
+  FELIX_REORDER_AVX2 static __m256i previous(const __m256i v,
+                                             const __m256i before,
+                                             const __m256i rotate) {
+    return _mm256_blend_epi32(_mm256_permutevar8x32_epi32(v, rotate),
+                              _mm256_permutevar8x32_epi32(before, rotate), 1);
+  }
+  FELIX_REORDER_AVX2 static unsigned movemask(const __m256i v) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(v));
+  }
+};
+
+// Check the frames of the trigger window of a fragment.
+inline FelixIntegrity FelixCheckIntegrity(const FelixFragment& flxfrag) {
+  const size_t first_frame = flxfrag.trigger_offset();
+  const size_t num_frames = flxfrag.total_frames();
+  return flxfrag.visit([&](auto const& l) {
+    return FelixIntegrityCheck::check(l, first_frame, num_frames);
+  });
+}
+
+// Checks whole batches of fragments in parallel and keeps a running summary.
+class FelixIntegrityScanner {
+ public:
+  FelixIntegrityScanner(const unsigned num_threads = 1)
+      : pool_(num_threads > 1 ? new ReorderThreadPool(num_threads - 1)
+                              : nullptr) {}
+
+  // Check num_frags fragments, writing the result for frags[i] to
+  // results[i].
+  void scan(const artdaq::Fragment* frags, const size_t num_frags,
+            std::vector<FelixIntegrity>& results) {
+    results.resize(num_frags);
+    std::function<void(unsigned)> job = [&](const unsigned i) {
+      results[i] = FelixCheckIntegrity(FelixFragment(frags[i]));
+    };
+    if (pool_) {
+      pool_->run(num_frags, job);
+    } else {
+      for (unsigned i = 0; i < num_frags; ++i) job(i);
+    }
+    for (const FelixIntegrity& result : results) {
+      summary_.add(result);
+    }
+  }
+  void scan(const std::vector<artdaq::Fragment>& frags,
+            std::vector<FelixIntegrity>& results) {
+    scan(frags.data(), frags.size(), results);
+  }
+
+  // Check a single fragment on the calling thread.
+  FelixIntegrity scan(const FelixFragment& flxfrag) {
+    const FelixIntegrity result = FelixCheckIntegrity(flxfrag);
+    summary_.add(result);
+    return result;
+  }
+
+  const FelixIntegritySummary& summary() const { return summary_; }
+  void clear() { summary_ = FelixIntegritySummary(); }
+
+ private:
+  std::unique_ptr<ReorderThreadPool> pool_;
+  FelixIntegritySummary summary_;
+};
+
+}  // namespace dune
+
+#endif /* artdaq_dune_Overlays_FelixIntegrity_hh */
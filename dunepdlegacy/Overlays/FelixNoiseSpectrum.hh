@@ -0,0 +1,316 @@
+// FelixNoiseSpectrum.hh computes averaged noise spectra per FEMB from FELIX
+// fragments with batched single precision real-input FFTs.
+
+#ifndef artdaq_dune_Overlays_FelixNoiseSpectrum_hh
+#define artdaq_dune_Overlays_FelixNoiseSpectrum_hh
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
+
+namespace dune {
+
+// Plan for real-input FFTs of a fixed power-of-two length. Twiddle factors
+// and the bit reversal permutation are computed once and reused for every
+// transform. A transform handles a batch of lanes channels at once with the
+// samples of all channels interleaved, so that every butterfly works on SIMD
+// vectors of lanes. An AVX2 version is picked at run time where available.
+class FelixFFTPlan {
+ public:
+  static constexpr unsigned lanes = 8;
+
+  // The length has to be a power of two of at least four.
+  FelixFFTPlan(const size_t n) : n_(n), half_(n / 2) {
+    const double pi = 3.14159265358979323846;
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < half_) ++bits;
+    rev_.resize(half_);
+    for (size_t m = 0; m < half_; ++m) {
+      size_t r = 0;
+      for (unsigned b = 0; b < bits; ++b) {
+        r |= ((m >> b) & 1) << (bits - 1 - b);
+      }
+      rev_[m] = r;
+    }
+    // Twiddles of the half-length complex transform.
+    tw_re_.resize(half_ / 2);
+    tw_im_.resize(half_ / 2);
+    for (size_t j = 0; j < half_ / 2; ++j) {
+      tw_re_[j] = cos(2 * pi * j / half_);
+      tw_im_[j] = -sin(2 * pi * j / half_);
+    }
+    // Twiddles that split the complex result into the real-input spectrum.
+    split_re_.resize(half_ + 1);
+    split_im_.resize(half_ + 1);
+    for (size_t k = 0; k <= half_; ++k) {
+      split_re_[k] = cos(2 * pi * k / n_);
+      split_im_[k] = -sin(2 * pi * k / n_);
+    }
+  }
+
+  size_t size() const { return n_; }
+  // Number of frequency bins, from zero to the Nyquist frequency.
+  size_t num_bins() const { return half_ + 1; }
+  // Number of floats needed for each of the two work arrays.
+  size_t work_size() const { return half_ * lanes; }
+
+  // Transform lanes channels of ADC values, channel l starting at
+  // adcs[l * stride], and write the magnitudes of bin k of channel l to
+  // mags[k * lanes + l]. Channels for which skip is set are transformed as
+  // zeros. re and im are work arrays of work_size() floats.
+  void magnitudes(const adc_t* adcs, const size_t stride, const bool* skip,
+                  float* re, float* im, float* mags) const {
+    if (FelixReorder::avx_available()) {
+      magnitudes_avx2(adcs, stride, skip, re, im, mags);
+    } else {
+      magnitudes_baseline(adcs, stride, skip, re, im, mags);
+    }
+  }
+
+ private:
+  // All lanes of one sample, in as many registers as the target needs. The
+  // work arrays are only float aligned.
+  typedef float lanes_t
+      __attribute__((vector_size(lanes * sizeof(float)), aligned(4),
+                     may_alias));
+
+  // Broadcast explicitly, as mixing scalars into the arithmetic makes some
+  // targets build the vector on the stack.
+  __attribute__((always_inline)) static void splat(lanes_t& v, const float x) {
+    for (unsigned l = 0; l < lanes; ++l) v[l] = x;
+  }
+
+  void magnitudes_baseline(const adc_t* adcs, const size_t stride,
+                           const bool* skip, float* re, float* im,
+                           float* mags) const {
+    magnitudes_kernel(adcs, stride, skip, re, im, mags);
+  }
+  FELIX_REORDER_AVX2 void magnitudes_avx2(const adc_t* adcs,
+                                          const size_t stride,
+                                          const bool* skip, float* re,
+                                          float* im, float* mags) const {
+    magnitudes_kernel(adcs, stride, skip, re, im, mags);
+  }
+
+  // Inlined into each of the entry points above, so that the lane arithmetic
+  // is compiled for their instruction sets.
+  __attribute__((always_inline)) inline void magnitudes_kernel(
+      const adc_t* adcs, const size_t stride, const bool* skip, float* re,
+      float* im, float* mags) const {
+    // Pack even samples into the real and odd samples into the imaginary
+    // part, in bit reversed order.
+    for (size_t m = 0; m < half_; ++m) {
+      float* r = re + rev_[m] * lanes;
+      float* i = im + rev_[m] * lanes;
+      for (unsigned l = 0; l < lanes; ++l) {
+        const adc_t* ch = adcs + l * stride;
+        r[l] = skip[l] ? 0 : ch[2 * m];
+        i[l] = skip[l] ? 0 : ch[2 * m + 1];
+      }
+    }
+
+    // Radix-2 decimation in time.
+    for (size_t h = 1; h < half_; h <<= 1) {
+      const size_t step = half_ / (2 * h);
+      for (size_t start = 0; start < half_; start += 2 * h) {
+        for (size_t j = 0; j < h; ++j) {
+          lanes_t wr, wi;
+          splat(wr, tw_re_[j * step]);
+          splat(wi, tw_im_[j * step]);
+          lanes_t* ar = reinterpret_cast<lanes_t*>(re + (start + j) * lanes);
+          lanes_t* ai = reinterpret_cast<lanes_t*>(im + (start + j) * lanes);
+          lanes_t* br =
+              reinterpret_cast<lanes_t*>(re + (start + j + h) * lanes);
+          lanes_t* bi =
+              reinterpret_cast<lanes_t*>(im + (start + j + h) * lanes);
+          const lanes_t tr = wr * *br - wi * *bi;
+          const lanes_t ti = wr * *bi + wi * *br;
+          *br = *ar - tr;
+          *bi = *ai - ti;
+          *ar += tr;
+          *ai += ti;
+        }
+      }
+    }
+
+    // Split into the spectrum of the real input.
+    for (size_t k = 0; k <= half_; ++k) {
+      const lanes_t zr = *reinterpret_cast<lanes_t*>(re + (k % half_) * lanes);
+      const lanes_t zi = *reinterpret_cast<lanes_t*>(im + (k % half_) * lanes);
+      const lanes_t cr =
+          *reinterpret_cast<lanes_t*>(re + ((half_ - k) % half_) * lanes);
+      const lanes_t ci =
+          *reinterpret_cast<lanes_t*>(im + ((half_ - k) % half_) * lanes);
+      lanes_t c, s, half;
+      splat(c, split_re_[k]);
+      splat(s, split_im_[k]);
+      splat(half, 0.5f);
+      const lanes_t er = half * (zr + cr);
+      const lanes_t ei = half * (zi - ci);
+      const lanes_t or_ = half * (zi + ci);
+      const lanes_t oi = half * (cr - zr);
+      const lanes_t xr = er + c * or_ - s * oi;
+      const lanes_t xi = ei + c * oi + s * or_;
+      const lanes_t power = xr * xr + xi * xi;
+      float* mag = mags + k * lanes;
+      for (unsigned l = 0; l < lanes; ++l) {
+        mag[l] = sqrtf(power[l]);
+      }
+    }
+  }
+
+  const size_t n_;
+  const size_t half_;
+  std::vector<size_t> rev_;
+  std::vector<float> tw_re_, tw_im_;
+  std::vector<float> split_re_, split_im_;
+};
+
+// Averaged magnitude spectra per FEMB. Every fragment adds the spectra of its
+// 256 channels to the two FEMBs it reads out. The channels are transformed in
+// batches that are spread over a pool of threads.
+class FelixNoiseSpectrum {
+ public:
+  static constexpr unsigned num_ch_per_FEMB = 128;
+
+  // The transforms use the largest power of two below num_samples samples of
+  // each channel.
+  FelixNoiseSpectrum(const size_t num_samples, const unsigned num_threads = 1,
+                     const unsigned num_FEMBs = 20)
+      : plan_(fft_size(num_samples)),
+        num_FEMBs_(num_FEMBs),
+        sums_(num_FEMBs * batches_per_FEMB * plan_.num_bins(), 0),
+        counts_(num_FEMBs, 0),
+        pool_(num_threads > 1 ? new ReorderThreadPool(num_threads - 1)
+                              : nullptr) {}
+
+  static size_t fft_size(const size_t num_samples) {
+    size_t n = 4;
+    while (2 * n < num_samples) n <<= 1;
+    return n;
+  }
+
+  size_t num_bins() const { return plan_.num_bins(); }
+  unsigned num_FEMBs() const { return num_FEMBs_; }
+  // Number of fragments that contributed to a FEMB.
+  unsigned count(const unsigned FEMB) const { return counts_[FEMB]; }
+
+  // Add the 256 channels of a channel-major block of rows of stride ADC
+  // values, read out by FEMBs FEMB_base and FEMB_base + 1. Channels for which
+  // skip is set are left out, but still count towards the average.
+  bool add(const adc_t* adcs, const size_t stride, const unsigned FEMB_base,
+           const std::vector<bool>& skip = std::vector<bool>()) {
+    if (stride < plan_.size() || FEMB_base + 2 > num_FEMBs_) {
+      return false;
+    }
+    const unsigned num_batches = 2 * batches_per_FEMB;
+    std::function<void(unsigned)> job = [&](const unsigned b) {
+      thread_local std::vector<float> work;
+      work.resize(3 * plan_.work_size() + plan_.num_bins() * lanes);
+      float* re = work.data();
+      float* im = re + plan_.work_size();
+      float* mags = im + plan_.work_size();
+      bool skip_lane[lanes];
+      for (unsigned l = 0; l < lanes; ++l) {
+        const unsigned ch = b * lanes + l;
+        skip_lane[l] = ch < skip.size() && skip[ch];
+      }
+      plan_.magnitudes(adcs + b * lanes * stride, stride, skip_lane, re, im,
+                       mags);
+
+      // Every batch has its own sums, so threads never share them.
+      double* sum = sums_.data() +
+                    (FEMB_base * batches_per_FEMB + b) * plan_.num_bins();
+      for (size_t k = 0; k < plan_.num_bins(); ++k) {
+        float total = 0;
+        for (unsigned l = 0; l < lanes; ++l) {
+          total += mags[k * lanes + l];
+        }
+        sum[k] += total;
+      }
+    };
+    if (pool_) {
+      pool_->run(num_batches, job);
+    } else {
+      for (unsigned b = 0; b < num_batches; ++b) job(b);
+    }
+    ++counts_[FEMB_base];
+    ++counts_[FEMB_base + 1];
+    return true;
+  }
+
+  // Add a fragment. bad_channels is indexed by global channel number,
+  // slot * 512 + (fiber - 1) * 256 + channel.
+  bool add(const dune::FelixFragment& flxfrag,
+           const std::vector<bool>& bad_channels = std::vector<bool>()) {
+    if (flxfrag.total_frames() < plan_.size()) {
+      return false;
+    }
+    const unsigned ch_num_base =
+        flxfrag.slot_no() * 512 + (flxfrag.fiber_no() - 1) * 256;
+    std::vector<bool> skip(256, false);
+    for (unsigned ch = 0; ch < 256 && ch_num_base + ch < bad_channels.size();
+         ++ch) {
+      skip[ch] = bad_channels[ch_num_base + ch];
+    }
+    // Only the samples going into the transform are decoded.
+    buffer_.resize(256 * plan_.size());
+    flxfrag.get_ADC_block(buffer_.data(), plan_.size(), 0, plan_.size());
+    return add(buffer_.data(), plan_.size(),
+               flxfrag.slot_no() * 4 + (flxfrag.fiber_no() - 1) * 2, skip);
+  }
+
+  // Combine with the spectra of another engine of the same size.
+  void merge(const FelixNoiseSpectrum& other) {
+    for (size_t i = 0; i < sums_.size() && i < other.sums_.size(); ++i) {
+      sums_[i] += other.sums_[i];
+    }
+    for (unsigned f = 0; f < num_FEMBs_ && f < other.num_FEMBs_; ++f) {
+      counts_[f] += other.counts_[f];
+    }
+  }
+
+  void clear() {
+    std::fill(sums_.begin(), sums_.end(), 0);
+    std::fill(counts_.begin(), counts_.end(), 0);
+  }
+
+  // Average magnitude spectrum of the channels of a FEMB.
+  std::vector<double> spectrum(const unsigned FEMB) const {
+    std::vector<double> result(plan_.num_bins(), 0);
+    if (FEMB >= num_FEMBs_ || counts_[FEMB] == 0) {
+      return result;
+    }
+    const double norm = 1.0 / (counts_[FEMB] * num_ch_per_FEMB);
+    for (unsigned b = 0; b < batches_per_FEMB; ++b) {
+      const double* sum =
+          sums_.data() + (FEMB * batches_per_FEMB + b) * plan_.num_bins();
+      for (size_t k = 0; k < plan_.num_bins(); ++k) {
+        result[k] += sum[k] * norm;
+      }
+    }
+    return result;
+  }
+
+ private:
+  static constexpr unsigned lanes = FelixFFTPlan::lanes;
+  static constexpr unsigned batches_per_FEMB = num_ch_per_FEMB / lanes;
+
+  const FelixFFTPlan plan_;
+  const unsigned num_FEMBs_;
+  // Summed magnitudes per FEMB and channel batch.
+  std::vector<double> sums_;
+  std::vector<unsigned> counts_;
+  std::unique_ptr<ReorderThreadPool> pool_;
+  adc_aligned_v buffer_;
+};
+
+}  // namespace dune
+
+#endif /* artdaq_dune_Overlays_FelixNoiseSpectrum_hh */
@@ -5,8 +5,54 @@
 
 #define UNUSED(x) (void)(x)
 
+/// GCC 12 flags the vectors its own AVX-512F intrinsics leave undefined on
+/// purpose as uninitialized. Only the functions using such intrinsics are
+/// wrapped in these, so the warnings stay on for the rest of the file.
+#define FELIX_REORDER_AVX512_BEGIN                            \
+  _Pragma("GCC diagnostic push")                              \
+  _Pragma("GCC diagnostic ignored \"-Wuninitialized\"")       \
+  _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define FELIX_REORDER_AVX512_END _Pragma("GCC diagnostic pop")
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
 namespace dune {
 
+/// INSTRUCTION SET SELECTION ///
+FelixReorder::ISA FelixReorder::cpu_isa() noexcept {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return ISA::avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return ISA::avx2;
+  }
+  return ISA::baseline;
+}
+
+static std::atomic<FelixReorder::ISA> &selected_isa() {
+  static std::atomic<FelixReorder::ISA> isa([] {
+    FelixReorder::ISA cpu = FelixReorder::cpu_isa();
+    const char *env = std::getenv("FELIX_REORDER_ISA");
+    if (env == nullptr) return cpu;
+    const std::string requested(env);
+    if (requested == "baseline") return FelixReorder::ISA::baseline;
+    if (requested == "avx2") return std::min(cpu, FelixReorder::ISA::avx2);
+    return cpu;
+  }());
+  return isa;
+}
+
+FelixReorder::ISA FelixReorder::isa() noexcept {
+  return selected_isa().load(std::memory_order_relaxed);
+}
+
+void FelixReorder::set_isa(ISA isa) noexcept {
+  selected_isa().store(std::min(isa, cpu_isa()), std::memory_order_relaxed);
+}
+
 void FelixReorder::copy_headers(uint8_t *dst, const uint8_t *src) {
   /// WIB
   memcpy(dst, src, m_wib_header_size);
@@ -130,7 +176,7 @@ bool FelixReorder::do_reorder_part(uint8_t *dst, const uint8_t *src,
   return true;
 }
 
-#ifdef __AVX2__
+FELIX_REORDER_AVX2
 void FelixReorder::reorder_avx_handle_four_segments(
     const uint8_t *src, uint8_t *dst, const unsigned &num_frames) {
   /// Set up the two registers
@@ -192,6 +238,7 @@ void FelixReorder::reorder_avx_handle_four_segments(
   }
 }
 
+FELIX_REORDER_AVX2
 void FelixReorder::reorder_avx_handle_block(const uint8_t *src, uint8_t *dst,
                                             const unsigned &num_frames) {
   reorder_avx_handle_four_segments(src, dst, num_frames);
@@ -200,6 +247,7 @@ void FelixReorder::reorder_avx_handle_block(const uint8_t *src, uint8_t *dst,
       dst + 4 * m_num_bytes_per_reord_seg * num_frames, num_frames);
 }
 
+FELIX_REORDER_AVX2
 void FelixReorder::reorder_avx_handle_frame(const uint8_t *src, uint8_t *dst,
                                             unsigned frame_num,
                                             const unsigned &num_frames,
@@ -224,6 +272,7 @@ void FelixReorder::reorder_avx_handle_frame(const uint8_t *src, uint8_t *dst,
 bool FelixReorder::do_avx_reorder(uint8_t *dst, const uint8_t *src,
                                   const unsigned &num_frames,
                                   unsigned *num_faulty) noexcept {
+  if (!avx_available()) return false;
   try {
     for (unsigned i = 0; i < num_frames; i++) {
       reorder_avx_handle_frame(src + i * m_num_bytes_per_frame, dst, i,
@@ -240,6 +289,7 @@ bool FelixReorder::do_avx_reorder_part(uint8_t *dst, const uint8_t *src,
                                        const unsigned frames_stop,
                                        const unsigned &num_frames,
                                        unsigned *num_faulty) noexcept {
+  if (!avx_available()) return false;
   try {
     for (unsigned i = 0; i < frames_stop - frames_start; i++) {
       reorder_avx_handle_frame(src + i * m_num_bytes_per_frame, dst,
@@ -251,34 +301,9 @@ bool FelixReorder::do_avx_reorder_part(uint8_t *dst, const uint8_t *src,
   return true;
 }
 
-#else
-bool FelixReorder::do_avx_reorder(uint8_t *dst, const uint8_t *src,
-                                  const unsigned &num_frames,
-                                  unsigned *num_faulty) noexcept {
-  UNUSED(dst);
-  UNUSED(src);
-  UNUSED(num_frames);
-  UNUSED(num_faulty);
-  return false;
-}
-
-bool FelixReorder::do_avx_reorder_part(uint8_t *dst, const uint8_t *src,
-                                       const unsigned frames_start,
-                                       const unsigned frames_stop,
-                                       const unsigned &num_frames,
-                                       unsigned *num_faulty) noexcept {
-  UNUSED(dst);
-  UNUSED(src);
-  UNUSED(num_frames);
-  UNUSED(frames_start);
-  UNUSED(frames_stop);
-  UNUSED(num_faulty);
-
-  return false;
-}
-#endif
 
 #ifdef __AVX512__REMOVE_ME_AFTER_GCC_PATCH
+FELIX_REORDER_AVX512
 void FelixReorder::reorder_avx512_handle_four_frames_two_segments(
     const uint8_t *src, uint8_t *dst, const unsigned &num_frames) {
   /// Set up the two registers
@@ -450,6 +475,7 @@ void FelixReorder::reorder_avx512_handle_four_frames_two_segments(
   _mm512_i64scatter_epi64(dst, addr2, v2, m_adc_size);
 }
 
+FELIX_REORDER_AVX512
 void FelixReorder::reorder_avx512_handle_four_frames_one_block(
     const uint8_t *src, uint8_t *dst, const unsigned &num_frames) {
   for (unsigned i = 0; i < 4; ++i) {
@@ -459,6 +485,7 @@ void FelixReorder::reorder_avx512_handle_four_frames_one_block(
   }
 }
 
+FELIX_REORDER_AVX512
 void FelixReorder::reorder_avx512_handle_four_frames(const uint8_t *src,
                                                      uint8_t *dst,
                                                      unsigned frame_num,
@@ -488,6 +515,7 @@ void FelixReorder::reorder_avx512_handle_four_frames(const uint8_t *src,
 bool FelixReorder::do_avx512_reorder(uint8_t *dst, const uint8_t *src,
                                      const unsigned &num_frames,
                                      unsigned *num_faulty) noexcept {
+  if (!avx512_available()) return false;
   try {
     for (unsigned i = 0; i < num_frames; i += 4) {
       reorder_avx512_handle_four_frames(src + i * m_num_bytes_per_frame, dst, i,
@@ -504,6 +532,7 @@ bool FelixReorder::do_avx512_reorder_part(uint8_t *dst, const uint8_t *src,
                                           const unsigned frames_stop,
                                           const unsigned &num_frames,
                                           unsigned *num_faulty) noexcept {
+  if (!avx512_available()) return false;
   try {
     for (unsigned i = 0; i < frames_stop - frames_start; i += 4) {
       reorder_avx512_handle_four_frames(src + i * m_num_bytes_per_frame, dst,
@@ -541,6 +570,634 @@ bool FelixReorder::do_avx512_reorder_part(uint8_t *dst, const uint8_t *src,
 
   return false;
 }
+#endif
+
+/// CHANNEL-MAJOR UNPACKING ///
+// Every segment holds four channels of two ADCs: the even bytes form a
+// 12-bit little-endian stream for the first ADC, the odd bytes one for the
+// second. Segments 2p and 2p+1 of a block together hold its channels
+// 16p..16p+15.
+void FelixReorder::baseline_unpack_frame(uint16_t *dst, const uint8_t *src,
+                                         const size_t &stride) {
+  for (unsigned blk = 0; blk < m_num_blocks_per_frame; ++blk) {
+    const uint8_t *block = src + m_wib_header_size + m_coldata_header_size +
+                           blk * (m_coldata_header_size + m_num_bytes_per_block);
+    for (unsigned s = 0; s < m_num_seg_per_block; ++s) {
+      const uint8_t *seg = block + s * m_num_bytes_per_seg;
+      const unsigned ch0 = blk * m_num_ch_per_block + (s / 2) * 16 + (s % 2) * 4;
+      for (unsigned a = 0; a < 2; ++a) {
+        const uint8_t *b = seg + a;
+        uint16_t *d = dst + (ch0 + 8 * a) * stride;
+        d[0 * stride] = b[0] | (b[2] & 0xf) << 8;
+        d[1 * stride] = b[2] >> 4 | b[4] << 4;
+        d[2 * stride] = b[6] | (b[8] & 0xf) << 8;
+        d[3 * stride] = b[8] >> 4 | b[10] << 4;
+      }
+    }
+  }
+}
+
+bool FelixReorder::do_unpack(uint16_t *dst, const uint8_t *src,
+                             const unsigned &num_frames,
+                             const size_t &stride) noexcept {
+  for (unsigned fr = 0; fr < num_frames; ++fr) {
+    baseline_unpack_frame(dst + fr, src + fr * m_num_bytes_per_frame, stride);
+  }
+  return true;
+}
+
+FELIX_REORDER_AVX2
+__m256i FelixReorder::unpack_avx_segment_pair(const uint8_t *src) {
+  /// Both segments sit four bytes into their 128 bit lane. Loading from
+  /// four bytes before the pair stays within the frame.
+  const __m256i raw = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src - 4))),
+      _mm_loadu_si128((const __m128i *)(src + 8)), 1);
+
+  /// Gather the low and high byte of every ADC value
+  const __m256i order = _mm256_setr_epi8(
+      4, 6, 6, 8, 10, 12, 12, 14, 5, 7, 7, 9, 11, 13, 13, 15,
+      4, 6, 6, 8, 10, 12, 12, 14, 5, 7, 7, 9, 11, 13, 13, 15);
+  const __m256i values = _mm256_shuffle_epi8(raw, order);
+
+  /// Odd channels start at the upper nibble
+  const __m256i aligned =
+      _mm256_blend_epi16(values, _mm256_srli_epi16(values, 4), 0xaa);
+  const __m256i adcs = _mm256_and_si256(aligned, _mm256_set1_epi16(0x0fff));
+
+  /// Lanes hold channels 0-3, 8-11 | 4-7, 12-15
+  return _mm256_permute4x64_epi64(adcs, 0xd8);
+}
+
+FELIX_REORDER_AVX2
+void FelixReorder::transpose_avx_eight_rows(__m256i *rows) {
+  /// 8x8 transposes within each 128 bit lane
+  __m256i s[8], u[8];
+  for (unsigned i = 0; i < 4; ++i) {
+    s[2 * i] = _mm256_unpacklo_epi16(rows[2 * i], rows[2 * i + 1]);
+    s[2 * i + 1] = _mm256_unpackhi_epi16(rows[2 * i], rows[2 * i + 1]);
+  }
+  for (unsigned i = 0; i < 2; ++i) {
+    u[4 * i + 0] = _mm256_unpacklo_epi32(s[4 * i + 0], s[4 * i + 2]);
+    u[4 * i + 1] = _mm256_unpackhi_epi32(s[4 * i + 0], s[4 * i + 2]);
+    u[4 * i + 2] = _mm256_unpacklo_epi32(s[4 * i + 1], s[4 * i + 3]);
+    u[4 * i + 3] = _mm256_unpackhi_epi32(s[4 * i + 1], s[4 * i + 3]);
+  }
+  for (unsigned i = 0; i < 4; ++i) {
+    rows[2 * i] = _mm256_unpacklo_epi64(u[i], u[i + 4]);
+    rows[2 * i + 1] = _mm256_unpackhi_epi64(u[i], u[i + 4]);
+  }
+}
+
+FELIX_REORDER_AVX2
+void FelixReorder::unpack_avx_sixteen_frames(uint16_t *dst, const uint8_t *src,
+                                             const size_t &stride) {
+  const uint8_t *data_start = src + m_wib_header_size + m_coldata_header_size;
+
+  for (unsigned g = 0; g < m_num_ch_per_frame / 16; ++g) {
+    const uint8_t *pair = data_start +
+                          (g / 4) * (m_coldata_header_size + m_num_bytes_per_block) +
+                          (g % 4) * 2 * m_num_bytes_per_seg;
+
+    /// One row of 16 channels per frame
+    __m256i lo[8], hi[8];
+    for (unsigned f = 0; f < 8; ++f) {
+      lo[f] = unpack_avx_segment_pair(pair + f * m_num_bytes_per_frame);
+      hi[f] = unpack_avx_segment_pair(pair + (f + 8) * m_num_bytes_per_frame);
+    }
+    transpose_avx_eight_rows(lo);
+    transpose_avx_eight_rows(hi);
+
+    /// One row of 16 frames per channel
+    uint16_t *d = dst + g * 16 * stride;
+    for (unsigned c = 0; c < 8; ++c) {
+      _mm256_storeu_si256((__m256i *)(d + c * stride),
+                          _mm256_permute2x128_si256(lo[c], hi[c], 0x20));
+      _mm256_storeu_si256((__m256i *)(d + (c + 8) * stride),
+                          _mm256_permute2x128_si256(lo[c], hi[c], 0x31));
+    }
+  }
+}
+
+bool FelixReorder::do_avx_unpack(uint16_t *dst, const uint8_t *src,
+                                 const unsigned &num_frames,
+                                 const size_t &stride) noexcept {
+  if (!avx_available()) return false;
+  unsigned fr = 0;
+  for (; fr + 16 <= num_frames; fr += 16) {
+    unpack_avx_sixteen_frames(dst + fr, src + fr * m_num_bytes_per_frame,
+                              stride);
+  }
+  for (; fr < num_frames; ++fr) {
+    baseline_unpack_frame(dst + fr, src + fr * m_num_bytes_per_frame, stride);
+  }
+  return true;
+}
+
+FELIX_REORDER_AVX512_BEGIN
+FELIX_REORDER_AVX512
+__m512i FelixReorder::unpack_avx512_segment_pairs(const uint8_t *src_lo,
+                                                  const uint8_t *src_hi) {
+  /// The pair of src_lo fills the lower, that of src_hi the upper half
+  __m512i raw = _mm512_castsi128_si512(
+      _mm_loadu_si128((const __m128i *)(src_lo - 4)));
+  raw = _mm512_inserti32x4(raw, _mm_loadu_si128((const __m128i *)(src_lo + 8)),
+                           1);
+  raw = _mm512_inserti32x4(raw, _mm_loadu_si128((const __m128i *)(src_hi - 4)),
+                           2);
+  raw = _mm512_inserti32x4(raw, _mm_loadu_si128((const __m128i *)(src_hi + 8)),
+                           3);
+
+  const __m512i order =
+      _mm512_setr_epi64(0x0e0c0c0a08060604, 0x0f0d0d0b09070705,
+                        0x0e0c0c0a08060604, 0x0f0d0d0b09070705,
+                        0x0e0c0c0a08060604, 0x0f0d0d0b09070705,
+                        0x0e0c0c0a08060604, 0x0f0d0d0b09070705);
+  const __m512i shifts = _mm512_set1_epi32(0x00040000);
+  const __m512i values = _mm512_shuffle_epi8(raw, order);
+  const __m512i adcs = _mm512_and_si512(_mm512_srlv_epi16(values, shifts),
+                                        _mm512_set1_epi16(0x0fff));
+
+  /// Quarters hold channels 0-3, 8-11 | 4-7, 12-15 of both frames
+  return _mm512_permutex_epi64(adcs, 0xd8);
+}
+FELIX_REORDER_AVX512_END
+
+FELIX_REORDER_AVX512_BEGIN
+FELIX_REORDER_AVX512
+void FelixReorder::transpose_avx512_eight_rows(__m512i *rows) {
+  /// 8x8 transposes within each 128 bit lane
+  __m512i s[8], u[8];
+  for (unsigned i = 0; i < 4; ++i) {
+    s[2 * i] = _mm512_unpacklo_epi16(rows[2 * i], rows[2 * i + 1]);
+    s[2 * i + 1] = _mm512_unpackhi_epi16(rows[2 * i], rows[2 * i + 1]);
+  }
+  for (unsigned i = 0; i < 2; ++i) {
+    u[4 * i + 0] = _mm512_unpacklo_epi32(s[4 * i + 0], s[4 * i + 2]);
+    u[4 * i + 1] = _mm512_unpackhi_epi32(s[4 * i + 0], s[4 * i + 2]);
+    u[4 * i + 2] = _mm512_unpacklo_epi32(s[4 * i + 1], s[4 * i + 3]);
+    u[4 * i + 3] = _mm512_unpackhi_epi32(s[4 * i + 1], s[4 * i + 3]);
+  }
+  for (unsigned i = 0; i < 4; ++i) {
+    rows[2 * i] = _mm512_unpacklo_epi64(u[i], u[i + 4]);
+    rows[2 * i + 1] = _mm512_unpackhi_epi64(u[i], u[i + 4]);
+  }
+}
+FELIX_REORDER_AVX512_END
+
+FELIX_REORDER_AVX512_BEGIN
+FELIX_REORDER_AVX512
+void FelixReorder::unpack_avx512_thirtytwo_frames(uint16_t *dst,
+                                                  const uint8_t *src,
+                                                  const size_t &stride) {
+  const uint8_t *data_start = src + m_wib_header_size + m_coldata_header_size;
+  const __m512i first = _mm512_setr_epi64(0, 1, 8, 9, 4, 5, 12, 13);
+  const __m512i second = _mm512_setr_epi64(2, 3, 10, 11, 6, 7, 14, 15);
+
+  for (unsigned g = 0; g < m_num_ch_per_frame / 16; ++g) {
+    const uint8_t *pair = data_start +
+                          (g / 4) * (m_coldata_header_size + m_num_bytes_per_block) +
+                          (g % 4) * 2 * m_num_bytes_per_seg;
+
+    /// Rows hold frames f and f + 16
+    __m512i lo[8], hi[8];
+    for (unsigned f = 0; f < 8; ++f) {
+      lo[f] = unpack_avx512_segment_pairs(
+          pair + f * m_num_bytes_per_frame,
+          pair + (f + 16) * m_num_bytes_per_frame);
+      hi[f] = unpack_avx512_segment_pairs(
+          pair + (f + 8) * m_num_bytes_per_frame,
+          pair + (f + 24) * m_num_bytes_per_frame);
+    }
+    transpose_avx512_eight_rows(lo);
+    transpose_avx512_eight_rows(hi);
+
+    /// One row of 32 frames per channel
+    uint16_t *d = dst + g * 16 * stride;
+    for (unsigned c = 0; c < 8; ++c) {
+      _mm512_storeu_si512(d + c * stride,
+                          _mm512_permutex2var_epi64(lo[c], first, hi[c]));
+      _mm512_storeu_si512(d + (c + 8) * stride,
+                          _mm512_permutex2var_epi64(lo[c], second, hi[c]));
+    }
+  }
+}
+FELIX_REORDER_AVX512_END
+
+bool FelixReorder::do_avx512_unpack(uint16_t *dst, const uint8_t *src,
+                                    const unsigned &num_frames,
+                                    const size_t &stride) noexcept {
+  if (isa() < ISA::avx512) return false;
+  unsigned fr = 0;
+  for (; fr + 32 <= num_frames; fr += 32) {
+    unpack_avx512_thirtytwo_frames(dst + fr, src + fr * m_num_bytes_per_frame,
+                                   stride);
+  }
+  return do_avx_unpack(dst + fr, src + fr * m_num_bytes_per_frame,
+                       num_frames - fr, stride);
+}
+
+void FelixReorder::unpack(uint16_t *dst, const uint8_t *src,
+                          const unsigned &num_frames,
+                          const size_t &stride) noexcept {
+  if (do_avx512_unpack(dst, src, num_frames, stride)) return;
+  if (do_avx_unpack(dst, src, num_frames, stride)) return;
+  do_unpack(dst, src, num_frames, stride);
+}
+
+/// CHANNEL-MAJOR PACKING ///
+void FelixReorder::baseline_pack_frame(uint8_t *dst, const uint16_t *src,
+                                       const size_t &stride) {
+  for (unsigned blk = 0; blk < m_num_blocks_per_frame; ++blk) {
+    uint8_t *block = dst + m_wib_header_size + m_coldata_header_size +
+                     blk * (m_coldata_header_size + m_num_bytes_per_block);
+    for (unsigned s = 0; s < m_num_seg_per_block; ++s) {
+      uint8_t *seg = block + s * m_num_bytes_per_seg;
+      const unsigned ch0 = blk * m_num_ch_per_block + (s / 2) * 16 + (s % 2) * 4;
+      for (unsigned a = 0; a < 2; ++a) {
+        uint8_t *b = seg + a;
+        const uint16_t *d = src + (ch0 + 8 * a) * stride;
+        b[0] = d[0 * stride];
+        b[2] = (d[0 * stride] >> 8 & 0xf) | d[1 * stride] << 4;
+        b[4] = d[1 * stride] >> 4;
+        b[6] = d[2 * stride];
+        b[8] = (d[2 * stride] >> 8 & 0xf) | d[3 * stride] << 4;
+        b[10] = d[3 * stride] >> 4;
+      }
+    }
+  }
+}
+
+bool FelixReorder::do_pack(uint8_t *dst, const uint16_t *src,
+                           const unsigned &num_frames,
+                           const size_t &stride) noexcept {
+  for (unsigned fr = 0; fr < num_frames; ++fr) {
+    baseline_pack_frame(dst + fr * m_num_bytes_per_frame, src + fr, stride);
+  }
+  return true;
+}
+
+FELIX_REORDER_AVX2
+void FelixReorder::store_segment_pair(uint8_t *dst, const __m128i lo,
+                                      const __m128i hi) {
+  /// The second segment overwrites the four bytes past the first
+  _mm_storeu_si128((__m128i *)dst, lo);
+  _mm_storel_epi64((__m128i *)(dst + m_num_bytes_per_seg), hi);
+  const uint32_t last = _mm_extract_epi32(hi, 2);
+  memcpy(dst + m_num_bytes_per_seg + 8, &last, sizeof(last));
+}
+
+FELIX_REORDER_AVX2
+__m256i FelixReorder::pack_avx_segments(const __m256i adcs) {
+  /// Join the 12-bit values of both halves of every 32 bit word
+  const __m256i joined = _mm256_or_si256(
+      _mm256_and_si256(adcs, _mm256_set1_epi32(0x00000fff)),
+      _mm256_and_si256(_mm256_srli_epi32(adcs, 4),
+                       _mm256_set1_epi32(0x00fff000)));
+
+  /// Words hold channels 0-1, 2-3 of the first and 0-1, 2-3 of the second
+  /// ADC. Interleave their bytes into a segment at the start of each lane.
+  const __m256i order = _mm256_setr_epi8(
+      0, 8, 1, 9, 2, 10, 4, 12, 5, 13, 6, 14, -1, -1, -1, -1,
+      0, 8, 1, 9, 2, 10, 4, 12, 5, 13, 6, 14, -1, -1, -1, -1);
+  return _mm256_shuffle_epi8(joined, order);
+}
+
+FELIX_REORDER_AVX2
+void FelixReorder::pack_avx_sixteen_frames(
+    uint8_t *dst, const uint16_t *src, const size_t &stride) {
+  uint8_t *data_start = dst + m_wib_header_size + m_coldata_header_size;
+
+  for (unsigned g = 0; g < m_num_ch_per_frame / 16; ++g) {
+    uint8_t *pair = data_start +
+                    (g / 4) * (m_coldata_header_size + m_num_bytes_per_block) +
+                    (g % 4) * 2 * m_num_bytes_per_seg;
+
+    /// One row of 16 frames per channel
+    const uint16_t *s = src + g * 16 * stride;
+    __m256i lo[8], hi[8];
+    for (unsigned c = 0; c < 8; ++c) {
+      lo[c] = _mm256_loadu_si256((const __m256i *)(s + c * stride));
+      hi[c] = _mm256_loadu_si256((const __m256i *)(s + (c + 8) * stride));
+    }
+    transpose_avx_eight_rows(lo);
+    transpose_avx_eight_rows(hi);
+
+    /// Lanes hold channels 0-7 | 8-15 of frames f and f + 8
+    for (unsigned f = 0; f < 8; ++f) {
+      const __m256i seg0 = pack_avx_segments(_mm256_unpacklo_epi64(lo[f], hi[f]));
+      const __m256i seg1 = pack_avx_segments(_mm256_unpackhi_epi64(lo[f], hi[f]));
+      store_segment_pair(pair + f * m_num_bytes_per_frame,
+                         _mm256_castsi256_si128(seg0),
+                         _mm256_castsi256_si128(seg1));
+      store_segment_pair(pair + (f + 8) * m_num_bytes_per_frame,
+                         _mm256_extracti128_si256(seg0, 1),
+                         _mm256_extracti128_si256(seg1, 1));
+    }
+  }
+}
+
+bool FelixReorder::do_avx_pack(uint8_t *dst, const uint16_t *src,
+                               const unsigned &num_frames,
+                               const size_t &stride) noexcept {
+  if (!avx_available()) return false;
+  unsigned fr = 0;
+  for (; fr + 16 <= num_frames; fr += 16) {
+    pack_avx_sixteen_frames(dst + fr * m_num_bytes_per_frame, src + fr, stride);
+  }
+  for (; fr < num_frames; ++fr) {
+    baseline_pack_frame(dst + fr * m_num_bytes_per_frame, src + fr, stride);
+  }
+  return true;
+}
+
+FELIX_REORDER_AVX512_BEGIN
+FELIX_REORDER_AVX512
+__m512i FelixReorder::pack_avx512_segments(const __m512i adcs) {
+  const __m512i joined = _mm512_or_si512(
+      _mm512_and_si512(adcs, _mm512_set1_epi32(0x00000fff)),
+      _mm512_and_si512(_mm512_srli_epi32(adcs, 4),
+                       _mm512_set1_epi32(0x00fff000)));
+
+  const __m512i order = _mm512_broadcast_i32x4(
+      _mm_setr_epi8(0, 8, 1, 9, 2, 10, 4, 12, 5, 13, 6, 14, -1, -1, -1, -1));
+  return _mm512_shuffle_epi8(joined, order);
+}
+FELIX_REORDER_AVX512_END
+
+FELIX_REORDER_AVX512_BEGIN
+FELIX_REORDER_AVX512
+void FelixReorder::pack_avx512_thirtytwo_frames(
+    uint8_t *dst, const uint16_t *src, const size_t &stride) {
+  uint8_t *data_start = dst + m_wib_header_size + m_coldata_header_size;
+
+  for (unsigned g = 0; g < m_num_ch_per_frame / 16; ++g) {
+    uint8_t *pair = data_start +
+                    (g / 4) * (m_coldata_header_size + m_num_bytes_per_block) +
+                    (g % 4) * 2 * m_num_bytes_per_seg;
+
+    /// One row of 32 frames per channel
+    const uint16_t *s = src + g * 16 * stride;
+    __m512i lo[8], hi[8];
+    for (unsigned c = 0; c < 8; ++c) {
+      lo[c] = _mm512_loadu_si512(s + c * stride);
+      hi[c] = _mm512_loadu_si512(s + (c + 8) * stride);
+    }
+    transpose_avx512_eight_rows(lo);
+    transpose_avx512_eight_rows(hi);
+
+    /// Lanes hold channels 0-7 | 8-15 of frames f, f + 8, f + 16 and f + 24
+    for (unsigned f = 0; f < 8; ++f) {
+      const __m512i seg0 =
+          pack_avx512_segments(_mm512_unpacklo_epi64(lo[f], hi[f]));
+      const __m512i seg1 =
+          pack_avx512_segments(_mm512_unpackhi_epi64(lo[f], hi[f]));
+      store_segment_pair(pair + f * m_num_bytes_per_frame,
+                         _mm512_extracti32x4_epi32(seg0, 0),
+                         _mm512_extracti32x4_epi32(seg1, 0));
+      store_segment_pair(pair + (f + 8) * m_num_bytes_per_frame,
+                         _mm512_extracti32x4_epi32(seg0, 1),
+                         _mm512_extracti32x4_epi32(seg1, 1));
+      store_segment_pair(pair + (f + 16) * m_num_bytes_per_frame,
+                         _mm512_extracti32x4_epi32(seg0, 2),
+                         _mm512_extracti32x4_epi32(seg1, 2));
+      store_segment_pair(pair + (f + 24) * m_num_bytes_per_frame,
+                         _mm512_extracti32x4_epi32(seg0, 3),
+                         _mm512_extracti32x4_epi32(seg1, 3));
+    }
+  }
+}
+FELIX_REORDER_AVX512_END
+
+bool FelixReorder::do_avx512_pack(uint8_t *dst, const uint16_t *src,
+                                  const unsigned &num_frames,
+                                  const size_t &stride) noexcept {
+  if (isa() < ISA::avx512) return false;
+  unsigned fr = 0;
+  for (; fr + 32 <= num_frames; fr += 32) {
+    pack_avx512_thirtytwo_frames(dst + fr * m_num_bytes_per_frame, src + fr,
+                                 stride);
+  }
+  return do_avx_pack(dst + fr * m_num_bytes_per_frame, src + fr,
+                     num_frames - fr, stride);
+}
+
+void FelixReorder::pack(uint8_t *dst, const uint16_t *src,
+                        const unsigned &num_frames,
+                        const size_t &stride) noexcept {
+  if (do_avx512_pack(dst, src, num_frames, stride)) return;
+  if (do_avx_pack(dst, src, num_frames, stride)) return;
+  do_pack(dst, src, num_frames, stride);
+}
+
+/// FRAME-MAJOR PACKING ///
+bool FelixReorder::do_pack_frames(uint8_t *dst, const uint16_t *src,
+                                  const unsigned &num_frames,
+                                  const size_t &stride) noexcept {
+  for (unsigned fr = 0; fr < num_frames; ++fr) {
+    baseline_pack_frame(dst + fr * m_num_bytes_per_frame, src + fr * stride, 1);
+  }
+  return true;
+}
+
+FELIX_REORDER_AVX2
+void FelixReorder::pack_avx_frame(uint8_t *dst, const uint16_t *src) {
+  uint8_t *data_start = dst + m_wib_header_size + m_coldata_header_size;
+  const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+  for (unsigned g = 0; g < m_num_ch_per_frame / 16; ++g) {
+    uint8_t *pair = data_start +
+                    (g / 4) * (m_coldata_header_size + m_num_bytes_per_block) +
+                    (g % 4) * 2 * m_num_bytes_per_seg;
+
+    /// Lanes hold channels 0-3, 8-11 | 4-7, 12-15 of the segment pair
+    const __m256i adcs = _mm256_permute4x64_epi64(
+        _mm256_loadu_si256((const __m256i *)(src + g * 16)), 0xd8);
+    const __m256i segs =
+        _mm256_permutevar8x32_epi32(pack_avx_segments(adcs), compact);
+    _mm_storeu_si128((__m128i *)pair, _mm256_castsi256_si128(segs));
+    _mm_storel_epi64((__m128i *)(pair + 16), _mm256_extracti128_si256(segs, 1));
+  }
+}
+
+bool FelixReorder::do_avx_pack_frames(uint8_t *dst, const uint16_t *src,
+                                      const unsigned &num_frames,
+                                      const size_t &stride) noexcept {
+  if (!avx_available()) return false;
+  for (unsigned fr = 0; fr < num_frames; ++fr) {
+    pack_avx_frame(dst + fr * m_num_bytes_per_frame, src + fr * stride);
+  }
+  return true;
+}
+
+FELIX_REORDER_AVX512_BEGIN
+FELIX_REORDER_AVX512
+void FelixReorder::pack_avx512_frame(uint8_t *dst, const uint16_t *src) {
+  uint8_t *data_start = dst + m_wib_header_size + m_coldata_header_size;
+  const __m512i order = _mm512_setr_epi64(0, 2, 1, 3, 4, 6, 5, 7);
+  const __m512i compact = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13,
+                                            14, 15, 15, 15, 15);
+
+  /// Two segment pairs of the same block are adjacent
+  for (unsigned g = 0; g < m_num_ch_per_frame / 16; g += 2) {
+    uint8_t *pairs = data_start +
+                     (g / 4) * (m_coldata_header_size + m_num_bytes_per_block) +
+                     (g % 4) * 2 * m_num_bytes_per_seg;
+    const __m512i adcs =
+        _mm512_permutexvar_epi64(order, _mm512_loadu_si512(src + g * 16));
+    const __m512i segs =
+        _mm512_permutexvar_epi32(compact, pack_avx512_segments(adcs));
+    _mm512_mask_storeu_epi32(pairs, 0x0fff, segs);
+  }
+}
+FELIX_REORDER_AVX512_END
+
+bool FelixReorder::do_avx512_pack_frames(uint8_t *dst, const uint16_t *src,
+                                         const unsigned &num_frames,
+                                         const size_t &stride) noexcept {
+  if (isa() < ISA::avx512) return false;
+  for (unsigned fr = 0; fr < num_frames; ++fr) {
+    pack_avx512_frame(dst + fr * m_num_bytes_per_frame, src + fr * stride);
+  }
+  return true;
+}
+
+void FelixReorder::pack_frames(uint8_t *dst, const uint16_t *src,
+                               const unsigned &num_frames,
+                               const size_t &stride) noexcept {
+  if (do_avx512_pack_frames(dst, src, num_frames, stride)) return;
+  if (do_avx_pack_frames(dst, src, num_frames, stride)) return;
+  do_pack_frames(dst, src, num_frames, stride);
+}
+
+/// HEADER FILLING ///
+void FelixReorder::fill_headers(uint8_t *dst, const uint8_t *wib,
+                                const uint8_t *coldata,
+                                const size_t coldata_stride,
+                                const unsigned num_frames,
+                                const unsigned first_index,
+                                const unsigned timestamp_step,
+                                const unsigned convert_count_step) {
+  /// The headers are held in registers, so they may lie in dst. The
+  /// timestamp is the second quad word of the WIB header and only spans 48
+  /// bits when the z bit above it is set.
+  const __m128i head = _mm_loadu_si128((const __m128i *)wib);
+  const uint64_t z = (uint64_t)_mm_extract_epi16(head, 7) >> 15;
+  const __m128i keep = _mm_set_epi64x(
+      z ? ~((1ull << 48) - 1) : 1ull << 63, -1);
+  const __m128i ts_step = _mm_set_epi64x(timestamp_step, 0);
+  __m128i ts = _mm_add_epi64(
+      head, _mm_set_epi64x((uint64_t)first_index * timestamp_step, 0));
+
+  /// Convert counts are the fourth 16 bit word of the COLDATA headers
+  const __m128i ccc_step = _mm_set_epi16(0, 0, 0, 0, convert_count_step, 0, 0, 0);
+  __m128i blocks[m_num_blocks_per_frame];
+  for (unsigned j = 0; j < m_num_blocks_per_frame; ++j) {
+    blocks[j] = _mm_add_epi16(
+        _mm_loadu_si128((const __m128i *)(coldata + j * coldata_stride)),
+        _mm_set_epi16(0, 0, 0, 0, first_index * convert_count_step, 0, 0, 0));
+  }
+
+  for (unsigned i = 0; i < num_frames; ++i) {
+    uint8_t *frame = dst + i * m_num_bytes_per_frame;
+    _mm_storeu_si128((__m128i *)frame,
+                     _mm_or_si128(_mm_and_si128(keep, head),
+                                  _mm_andnot_si128(keep, ts)));
+    ts = _mm_add_epi64(ts, ts_step);
+    for (unsigned j = 0; j < m_num_blocks_per_frame; ++j) {
+      _mm_storeu_si128(
+          (__m128i *)(frame + m_wib_header_size +
+                      j * (m_num_bytes_per_block + m_coldata_header_size)),
+          blocks[j]);
+      blocks[j] = _mm_add_epi16(blocks[j], ccc_step);
+    }
+  }
+}
+
+void FelixReorder::fill_headers(uint8_t *dst, const uint8_t *head,
+                                const unsigned &num_frames,
+                                const unsigned &first_index,
+                                const unsigned &timestamp_step,
+                                const unsigned &convert_count_step) noexcept {
+  fill_headers(dst, head, head + m_wib_header_size,
+               m_num_bytes_per_block + m_coldata_header_size, num_frames,
+               first_index, timestamp_step, convert_count_step);
+}
+
+void FelixReorder::fill_headers_from_set(
+    uint8_t *dst, const uint8_t *header_set, const unsigned &num_frames,
+    const unsigned &first_index, const unsigned &timestamp_step,
+    const unsigned &convert_count_step) noexcept {
+  fill_headers(dst, header_set, header_set + m_wib_header_size,
+               m_coldata_header_size, num_frames, first_index, timestamp_step,
+               convert_count_step);
+}
+
+/// INVERSE REORDERING ///
+void FelixReorder::place_headers(uint8_t *dst, const uint8_t *src) {
+  /// WIB
+  memcpy(dst, src, m_wib_header_size);
+
+  /// ColData
+  for (unsigned i = 0; i < m_num_blocks_per_frame; ++i) {
+    memcpy(dst + m_wib_header_size +
+               i * (m_num_bytes_per_block + m_coldata_header_size),
+           src + m_wib_header_size + i * m_coldata_header_size,
+           m_coldata_header_size);
+  }
+}
+
+void FelixReorder::restore_headers(uint8_t *dst, const uint8_t *src,
+                                   const unsigned &num_frames) {
+  const uint8_t *bitfield = src + num_frames * m_num_bytes_per_data;
+  const uint8_t *first = bitfield + (num_frames + 7) / 8;
+  const uint8_t *faulty = first;
+
+  unsigned run_start = 0;
+  for (unsigned i = 0; i <= num_frames; ++i) {
+    if (i < num_frames && !((bitfield[i / 8] >> (i % 8)) & 1)) continue;
+
+    /// Timestamps and convert counts increment from the first frame
+    fill_headers_from_set(dst + run_start * m_num_bytes_per_frame, first,
+                          i - run_start, run_start);
+    run_start = i + 1;
+    if (i == num_frames) break;
+
+    /// Faulty headers are stored in order of appearance
+    faulty += m_wib_header_size +
+              m_num_blocks_per_frame * m_coldata_header_size;
+    place_headers(dst + i * m_num_bytes_per_frame, faulty);
+  }
+}
+
+bool FelixReorder::do_unreorder(uint8_t *dst, const uint8_t *src,
+                                const unsigned &num_frames) noexcept {
+  restore_headers(dst, src, num_frames);
+  return do_pack(dst, reinterpret_cast<const uint16_t *>(src), num_frames,
+                 num_frames);
+}
+
+bool FelixReorder::do_avx_unreorder(uint8_t *dst, const uint8_t *src,
+                                    const unsigned &num_frames) noexcept {
+  if (!avx_available()) return false;
+  restore_headers(dst, src, num_frames);
+  return do_avx_pack(dst, reinterpret_cast<const uint16_t *>(src),
+                     num_frames, num_frames);
+}
+
+bool FelixReorder::do_avx512_unreorder(uint8_t *dst, const uint8_t *src,
+                                       const unsigned &num_frames) noexcept {
+  if (isa() < ISA::avx512) return false;
+  restore_headers(dst, src, num_frames);
+  return do_avx512_pack(dst, reinterpret_cast<const uint16_t *>(src),
+                        num_frames, num_frames);
+}
+
+void FelixReorder::unreorder(uint8_t *dst, const uint8_t *src,
+                             const unsigned &num_frames) noexcept {
+  if (do_avx512_unreorder(dst, src, num_frames)) return;
+  if (do_avx_unreorder(dst, src, num_frames)) return;
+  do_unreorder(dst, src, num_frames);
+}
 
 } // namespace dune
-#endif
@@ -16,6 +16,12 @@
 #include <iomanip>
 #include <string>
 
+/// TARGET ATTRIBUTES ///
+// SIMD kernels are compiled for their instruction set whatever the compiler
+// flags, and are only entered after the CPU has been checked at run time.
+#define FELIX_REORDER_AVX2 __attribute__((target("avx2")))
+#define FELIX_REORDER_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+
 namespace dune {
 
 class FelixReorder {
@@ -35,6 +41,8 @@ class FelixReorder {
   static constexpr size_t m_wib_header_size = 4 * 4;
   static constexpr size_t m_num_bytes_per_data = m_num_ch_per_frame * 2;
   static constexpr size_t m_adc_size = 2;
+  // Timestamp ticks between consecutive frames.
+  static constexpr unsigned m_timestamp_step = 25;
 
   /// BIT OFFSET CONSTANTS ///
   // Segments //
@@ -97,6 +105,92 @@ class FelixReorder {
                                      const unsigned& num_frames,
                                      unsigned* num_faulty) noexcept;
 
+  /// CHANNEL-MAJOR UNPACKING ///
+  // Decode the ADC values of num_frames consecutive frames starting at src
+  // into dst, with channel ch of frame fr ending up at dst[ch * stride + fr].
+  // The caller provides room for 256 rows of stride values.
+  static bool do_unpack(uint16_t* dst, const uint8_t* src,
+                        const unsigned& num_frames,
+                        const size_t& stride) noexcept;
+  static bool do_avx_unpack(uint16_t* dst, const uint8_t* src,
+                            const unsigned& num_frames,
+                            const size_t& stride) noexcept;
+  static bool do_avx512_unpack(uint16_t* dst, const uint8_t* src,
+                               const unsigned& num_frames,
+                               const size_t& stride) noexcept;
+  // Unpack with the widest kernel isa() allows. The kernel is chosen at run
+  // time from the CPU, FELIX_REORDER_ISA and set_isa, not when building.
+  static void unpack(uint16_t* dst, const uint8_t* src,
+                     const unsigned& num_frames, const size_t& stride) noexcept;
+
+  /// CHANNEL-MAJOR PACKING ///
+  // Inverse of unpacking: write the 12-bit ADC values dst[ch * stride + fr]
+  // into the COLDATA segments of num_frames consecutive frames at dst. Header
+  // words are left untouched.
+  static bool do_pack(uint8_t* dst, const uint16_t* src,
+                      const unsigned& num_frames,
+                      const size_t& stride) noexcept;
+  static bool do_avx_pack(uint8_t* dst, const uint16_t* src,
+                          const unsigned& num_frames,
+                          const size_t& stride) noexcept;
+  static bool do_avx512_pack(uint8_t* dst, const uint16_t* src,
+                             const unsigned& num_frames,
+                             const size_t& stride) noexcept;
+  // Pack with the widest kernel isa() allows, chosen at run time.
+  static void pack(uint8_t* dst, const uint16_t* src,
+                   const unsigned& num_frames, const size_t& stride) noexcept;
+
+  /// FRAME-MAJOR PACKING ///
+  // Write the 12-bit ADC values src[fr * stride + ch] of 256 channels into the
+  // COLDATA segments of num_frames consecutive frames at dst, as when filling
+  // frames one at a time. Header words are left untouched.
+  static bool do_pack_frames(uint8_t* dst, const uint16_t* src,
+                             const unsigned& num_frames,
+                             const size_t& stride) noexcept;
+  static bool do_avx_pack_frames(uint8_t* dst, const uint16_t* src,
+                                 const unsigned& num_frames,
+                                 const size_t& stride) noexcept;
+  static bool do_avx512_pack_frames(uint8_t* dst, const uint16_t* src,
+                                    const unsigned& num_frames,
+                                    const size_t& stride) noexcept;
+  // Pack with the widest kernel isa() allows, chosen at run time.
+  static void pack_frames(uint8_t* dst, const uint16_t* src,
+                          const unsigned& num_frames,
+                          const size_t& stride = m_num_ch_per_frame) noexcept;
+
+  /// HEADER FILLING ///
+  // Write the headers of the frame at head into num_frames consecutive frames
+  // at dst. Frame i gets the timestamp advanced by (first_index + i) *
+  // timestamp_step and the convert counts by (first_index + i) *
+  // convert_count_step, everything else is copied unchanged. head may be
+  // the first frame at dst.
+  static void fill_headers(uint8_t* dst, const uint8_t* head,
+                           const unsigned& num_frames,
+                           const unsigned& first_index = 0,
+                           const unsigned& timestamp_step = m_timestamp_step,
+                           const unsigned& convert_count_step = 1) noexcept;
+  // The same from a header set as stored in reordered and compressed data:
+  // the WIB header followed by the four COLDATA headers.
+  static void fill_headers_from_set(
+      uint8_t* dst, const uint8_t* header_set, const unsigned& num_frames,
+      const unsigned& first_index = 0,
+      const unsigned& timestamp_step = m_timestamp_step,
+      const unsigned& convert_count_step = 1) noexcept;
+
+  /// INVERSE REORDERING ///
+  // Rebuild num_frames raw frames at dst from the reordered layout at src.
+  // Frames marked in the bitfield get their stored headers back, all others
+  // the first headers with incremented timestamps and convert counts.
+  static bool do_unreorder(uint8_t* dst, const uint8_t* src,
+                           const unsigned& num_frames) noexcept;
+  static bool do_avx_unreorder(uint8_t* dst, const uint8_t* src,
+                               const unsigned& num_frames) noexcept;
+  static bool do_avx512_unreorder(uint8_t* dst, const uint8_t* src,
+                                  const unsigned& num_frames) noexcept;
+  // Rebuild with the widest kernel isa() allows, chosen at run time.
+  static void unreorder(uint8_t* dst, const uint8_t* src,
+                        const unsigned& num_frames) noexcept;
+
   static unsigned calculate_reordered_size(unsigned num_frames,
                                            unsigned num_faulty) {
     return m_num_bytes_per_data * num_frames +
@@ -106,17 +200,25 @@ class FelixReorder {
            (num_frames + 7) / 8;
   }
 
-#ifdef __AVX2__
-  static const bool avx_available = true;
-#else
-  static const bool avx_available = false;
-#endif
+  /// INSTRUCTION SET SELECTION ///
+  // The kernels are picked from the instruction sets the CPU supports. Setting
+  // the environment variable FELIX_REORDER_ISA to baseline, avx2 or avx512, or
+  // calling set_isa, restricts the choice for testing.
+  enum class ISA { baseline = 0, avx2 = 1, avx512 = 2 };
+  static ISA isa() noexcept;
+  static ISA cpu_isa() noexcept;
+  // Select an instruction set, limited to what the CPU supports.
+  static void set_isa(ISA isa) noexcept;
 
+  static bool avx_available() noexcept { return isa() >= ISA::avx2; }
+  // The AVX512 reordering kernels wait for a compiler fix.
+  static bool avx512_available() noexcept {
 #ifdef __AVX512__REMOVE_ME_AFTER_GCC_PATCH
-  static const bool avx512_available = true;
+    return isa() >= ISA::avx512;
 #else
-  static const bool avx512_available = false;
+    return false;
 #endif
+  }
 
  private:
   /// FRAME OFFSETS ///
@@ -137,28 +239,73 @@ class FelixReorder {
                                      const unsigned& num_frames,
                                      unsigned* num_faulty);
 
-#ifdef __AVX2__
+  /// BASELINE UNPACKING ///
+  static void baseline_unpack_frame(uint16_t* dst, const uint8_t* src,
+                                    const size_t& stride);
+
+  /// BASELINE PACKING ///
+  static void baseline_pack_frame(uint8_t* dst, const uint16_t* src,
+                                  const size_t& stride);
+
+  /// HEADER RESTORATION ///
+  static void fill_headers(uint8_t* dst, const uint8_t* wib,
+                           const uint8_t* coldata, const size_t coldata_stride,
+                           const unsigned num_frames, const unsigned first_index,
+                           const unsigned timestamp_step,
+                           const unsigned convert_count_step);
+  static void place_headers(uint8_t* dst, const uint8_t* src);
+  static void restore_headers(uint8_t* dst, const uint8_t* src,
+                              const unsigned& num_frames);
+
+  /// AVX2 UNPACKING ///
+  FELIX_REORDER_AVX2 static __m256i unpack_avx_segment_pair(const uint8_t* src);
+  FELIX_REORDER_AVX2 static void transpose_avx_eight_rows(__m256i* rows);
+  FELIX_REORDER_AVX2 static void unpack_avx_sixteen_frames(
+      uint16_t* dst, const uint8_t* src, const size_t& stride);
+
+  /// AVX2 PACKING ///
+  FELIX_REORDER_AVX2 static void store_segment_pair(uint8_t* dst,
+                                                    const __m128i lo,
+                                                    const __m128i hi);
+  FELIX_REORDER_AVX2 static __m256i pack_avx_segments(const __m256i adcs);
+  FELIX_REORDER_AVX2 static void pack_avx_sixteen_frames(
+      uint8_t* dst, const uint16_t* src, const size_t& stride);
+  FELIX_REORDER_AVX2 static void pack_avx_frame(uint8_t* dst,
+                                                const uint16_t* src);
+
   /// AVX2 REORDERING ///
-  static void reorder_avx_handle_four_segments(const uint8_t* src, uint8_t* dst,
-                                               const unsigned& num_frames);
-  static void reorder_avx_handle_block(const uint8_t* src, uint8_t* dst,
-                                       const unsigned& num_frames);
-  static void reorder_avx_handle_frame(const uint8_t* src, uint8_t* dst,
-                                       unsigned frame_num,
-                                       const unsigned& num_frames,
-                                       unsigned* num_faulty);
-#endif
+  FELIX_REORDER_AVX2 static void reorder_avx_handle_four_segments(
+      const uint8_t* src, uint8_t* dst, const unsigned& num_frames);
+  FELIX_REORDER_AVX2 static void reorder_avx_handle_block(
+      const uint8_t* src, uint8_t* dst, const unsigned& num_frames);
+  FELIX_REORDER_AVX2 static void reorder_avx_handle_frame(
+      const uint8_t* src, uint8_t* dst, unsigned frame_num,
+      const unsigned& num_frames, unsigned* num_faulty);
+
+  /// AVX512 UNPACKING ///
+  FELIX_REORDER_AVX512 static __m512i unpack_avx512_segment_pairs(
+      const uint8_t* src_lo, const uint8_t* src_hi);
+  FELIX_REORDER_AVX512 static void transpose_avx512_eight_rows(__m512i* rows);
+  FELIX_REORDER_AVX512 static void unpack_avx512_thirtytwo_frames(
+      uint16_t* dst, const uint8_t* src, const size_t& stride);
+
+  /// AVX512 PACKING ///
+  FELIX_REORDER_AVX512 static __m512i pack_avx512_segments(const __m512i adcs);
+  FELIX_REORDER_AVX512 static void pack_avx512_thirtytwo_frames(
+      uint8_t* dst, const uint16_t* src, const size_t& stride);
+  FELIX_REORDER_AVX512 static void pack_avx512_frame(uint8_t* dst,
+                                                     const uint16_t* src);
 #ifdef __AVX512__REMOVE_ME_AFTER_GCC_PATCH
   /// AVX512 REORDERING ///
-  static void reorder_avx512_handle_four_frames_two_segments(
-      const uint8_t* src, uint8_t* dst, const unsigned& num_frames);
-  static void reorder_avx512_handle_four_frames_one_block(
+  FELIX_REORDER_AVX512 static void
+  reorder_avx512_handle_four_frames_two_segments(const uint8_t* src,
+                                                 uint8_t* dst,
+                                                 const unsigned& num_frames);
+  FELIX_REORDER_AVX512 static void reorder_avx512_handle_four_frames_one_block(
       const uint8_t* src, uint8_t* dst, const unsigned& num_frames);
-  static void reorder_avx512_handle_four_frames(const uint8_t* src,
-                                                uint8_t* dst,
-                                                unsigned frame_num,
-                                                const unsigned& num_frames,
-                                                unsigned* num_faulty);
+  FELIX_REORDER_AVX512 static void reorder_avx512_handle_four_frames(
+      const uint8_t* src, uint8_t* dst, unsigned frame_num,
+      const unsigned& num_frames, unsigned* num_faulty);
 #endif
 };
 
@@ -8,30 +8,51 @@
  * Date: July 2018
  */
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "FelixFormat.hh"
 #include "FelixReorder.hh"
 #include "artdaq-core/Data/Fragment.hh"
+#include "dunepdlegacy/rce/dam/util/ThreadPool.hh"
 
 namespace dune {
 
+// Persistent pool of worker threads that run a number of jobs together with
+// the calling thread, shared with the RCE decoding.
+typedef pdd::ThreadPool ReorderThreadPool;
+
 class ReorderFacility {
  public:
-  ReorderFacility(bool force_no_avx = false) : m_force_no_avx(force_no_avx) {}
+  // With more than one thread, whole fragments passed to do_reorder are split
+  // into frame ranges that are reordered in parallel.
+  ReorderFacility(bool force_no_avx = false, unsigned num_threads = 1)
+      : m_force_no_avx(force_no_avx),
+        m_pool(num_threads > 1 ? new ReorderThreadPool(num_threads - 1)
+                               : nullptr) {}
 
+  // The destination needs room for the reordered size with every frame but
+  // the first faulty, as in the serial case the number of faulty frames is
+  // only known afterwards.
   bool do_reorder(uint8_t *dst, const uint8_t *src, const unsigned num_frames) {
+    if (m_pool && num_frames >= 2 * m_min_frames_per_job) {
+      return do_parallel_reorder(dst, src, num_frames);
+    }
     if (m_force_no_avx) {
       return FelixReorder::do_reorder(dst, src, num_frames,
                                       &m_num_faulty_frames);
     }
-    if (FelixReorder::avx512_available) {
+    if (FelixReorder::avx512_available()) {
       return FelixReorder::do_avx512_reorder(dst, src, num_frames,
                                              &m_num_faulty_frames);
     }
-    if (FelixReorder::avx_available) {
+    if (FelixReorder::avx_available()) {
       return FelixReorder::do_avx_reorder(dst, src, num_frames,
                                           &m_num_faulty_frames);
     }
@@ -50,59 +71,184 @@ class ReorderFacility {
 
   bool do_reorder_part(uint8_t *dst, const uint8_t *src, const unsigned frames_start,
                        const unsigned frames_stop, const unsigned num_frames) {
+    return reorder_part(dst, src, frames_start, frames_stop, num_frames,
+                        &m_num_faulty_frames);
+  }
+
+  std::string get_info() {
+    std::string threads;
+    if (m_pool) {
+      threads = " Using " + std::to_string(m_pool->num_threads()) + " threads.";
+    }
+    if (m_force_no_avx) {
+      return "Forced by config to not use AVX." + threads;
+    }
+    if (FelixReorder::avx512_available()) {
+      return "Going to use AVX512." + threads;
+    }
+    if (FelixReorder::avx_available()) {
+      return "Going to use AVX2." + threads;
+    }
+    return "Going to use baseline." + threads;
+  }
+
+  unsigned m_num_faulty_frames;
+  unsigned m_num_frames;
+
+ private:
+  // Smallest frame range worth handing to another thread.
+  static constexpr unsigned m_min_frames_per_job = 256;
+
+  bool m_force_no_avx;
+  std::unique_ptr<ReorderThreadPool> m_pool;
+
+  bool reorder_part(uint8_t *dst, const uint8_t *src,
+                    const unsigned frames_start, const unsigned frames_stop,
+                    const unsigned num_frames, unsigned *num_faulty) {
     if (m_force_no_avx) {
       return FelixReorder::do_reorder_part(dst, src, frames_start, frames_stop,
-                                           num_frames, &m_num_faulty_frames);
+                                           num_frames, num_faulty);
     }
-    if (FelixReorder::avx512_available) {
-      return FelixReorder::do_avx512_reorder_part(dst, src, frames_start,
-                                                  frames_stop, num_frames,
-                                                  &m_num_faulty_frames);
+    if (FelixReorder::avx512_available()) {
+      return FelixReorder::do_avx512_reorder_part(
+          dst, src, frames_start, frames_stop, num_frames, num_faulty);
     }
-    if (FelixReorder::avx_available) {
+    if (FelixReorder::avx_available()) {
       return FelixReorder::do_avx_reorder_part(dst, src, frames_start,
                                                frames_stop, num_frames,
-                                               &m_num_faulty_frames);
+                                               num_faulty);
     }
     return FelixReorder::do_reorder_part(dst, src, frames_start, frames_stop,
-                                         num_frames, &m_num_faulty_frames);
+                                         num_frames, num_faulty);
   }
 
-  std::string get_info() {
-    if (m_force_no_avx) {
-      return "Forced by config to not use AVX.";
+  bool do_parallel_reorder(uint8_t *dst, const uint8_t *src,
+                           const unsigned num_frames) {
+    // The first frame clears the bitfield and provides the reference headers.
+    unsigned num_faulty = 0;
+    if (!reorder_part(dst, src, 0, 1, num_frames, &num_faulty)) {
+      return false;
     }
-    if (FelixReorder::avx512_available) {
-      return "Going to use AVX512.";
+
+    // Ranges are multiples of eight frames so that they share no byte of the
+    // bitfield. A range starting at frame b stores its faulty headers from
+    // header slot b on, which needs no more than the worst case room.
+    // Rounding the ranges up may leave the last ones with no frames.
+    const unsigned max_jobs = std::min(
+        4 * m_pool->num_threads(), num_frames / m_min_frames_per_job);
+    const unsigned job_frames =
+        ((num_frames + max_jobs - 1) / max_jobs + 7) / 8 * 8;
+    const unsigned num_jobs = (num_frames + job_frames - 1) / job_frames;
+    std::vector<unsigned> job_faulty(num_jobs);
+    std::vector<char> job_success(num_jobs);
+    std::function<void(unsigned)> job = [&](const unsigned j) {
+      const unsigned start = std::max(j * job_frames, 1u);
+      const unsigned stop = std::min((j + 1) * job_frames, num_frames);
+      unsigned faulty = start - 1;
+      job_success[j] =
+          start >= stop ||
+          reorder_part(dst, src + start * FelixReorder::m_num_bytes_per_frame,
+                       start, stop, num_frames, &faulty);
+      job_faulty[j] = faulty - (start - 1);
+    };
+    m_pool->run(num_jobs, job);
+
+    // Move the faulty headers of all ranges behind each other.
+    const size_t header_set_size = sizeof(WIBHeader) + 4 * sizeof(ColdataHeader);
+    uint8_t *headers = dst + num_frames * 256 * sizeof(adc_t) +
+                       (num_frames + 7) / 8 + header_set_size;
+    for (unsigned j = 0; j < num_jobs; ++j) {
+      if (!job_success[j]) return false;
+      const unsigned start = std::max(j * job_frames, 1u);
+      memmove(headers + num_faulty * header_set_size,
+              headers + (start - 1) * header_set_size,
+              job_faulty[j] * header_set_size);
+      num_faulty += job_faulty[j];
     }
-    if (FelixReorder::avx_available) {
-      return "Going to use AVX2.";
+    m_num_faulty_frames += num_faulty;
+    return true;
+  }
+};
+
+// Number of bytes a reordered fragment of num_frames frames can take up.
+inline size_t FelixReorderMaxSize(const unsigned num_frames) {
+  return FelixReorder::calculate_reordered_size(
+      num_frames, num_frames > 0 ? num_frames - 1 : 0);
+}
+
+// Reorder num_frames frames from src into the caller's buffer dst of dst_size
+// bytes. The size of the reordered data is returned, or zero if the buffer
+// may be too small or the reordering failed.
+inline size_t FelixReorder(uint8_t *dst, const size_t dst_size,
+                           const uint8_t *src, const unsigned num_frames,
+                           ReorderFacility &facility) {
+  if (dst_size < FelixReorderMaxSize(num_frames)) {
+    return 0;
+  }
+  facility.do_reorder_start(num_frames);
+  if (!facility.do_reorder(dst, src, num_frames)) {
+    return 0;
+  }
+  return facility.reorder_final_size();
+}
+
+// Reorder num_frames frames from src into an existing fragment, reusing its
+// allocation. The fragment is sized for the worst case while reordering and
+// shrunk afterwards, which keeps its capacity for the next use.
+inline bool FelixReorder(artdaq::Fragment &dst, const uint8_t *src,
+                         const unsigned num_frames,
+                         ReorderFacility &facility) {
+  const dune::FelixFragmentBase::Metadata meta = {0xabc, 1, 1, 0, num_frames,
+                                                  0, num_frames};
+  if (dst.hasMetadata()) {
+    dst.updateMetadata(meta);
+  } else {
+    dst.setMetadata(meta);
+  }
+
+  dst.resizeBytes(FelixReorderMaxSize(num_frames));
+  const size_t size = FelixReorder(dst.dataBeginBytes(), dst.dataSizeBytes(),
+                                   src, num_frames, facility);
+  dst.resizeBytes(size);
+  return size != 0;
+}
+
+// Pool of fragments to reorder into, which may be shared between threads.
+class ReorderFragmentPool {
+ public:
+  // Take a fragment from the pool, or a new one if the pool is empty.
+  std::unique_ptr<artdaq::Fragment> acquire() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fragments.empty()) {
+      return std::unique_ptr<artdaq::Fragment>(new artdaq::Fragment);
     }
-    return "Going to use baseline.";
+    std::unique_ptr<artdaq::Fragment> fragment = std::move(m_fragments.back());
+    m_fragments.pop_back();
+    return fragment;
   }
 
-  unsigned m_num_faulty_frames;
-  unsigned m_num_frames;
+  // Return a fragment, keeping its allocation for later use.
+  void release(std::unique_ptr<artdaq::Fragment> fragment) {
+    if (!fragment) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fragments.push_back(std::move(fragment));
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fragments.size();
+  }
 
  private:
-  bool m_force_no_avx;
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<artdaq::Fragment>> m_fragments;
 };
 
-artdaq::Fragment FelixReorder(const uint8_t *src,
+inline artdaq::Fragment FelixReorder(const uint8_t *src,
                               const uint16_t &num_frames = 6000) {
   artdaq::Fragment result;
-  dune::FelixFragmentBase::Metadata meta = {0xabc, 1, 1, 0, num_frames, 0, num_frames};
-  result.setMetadata(meta);
-  result.resizeBytes(num_frames * (256*sizeof(adc_t) + sizeof(WIBHeader) + 4*sizeof(ColdataHeader))+ (num_frames+7)/8);
-  uint8_t *dest = result.dataBeginBytes();
-
   ReorderFacility facility(false);
-  facility.do_reorder_start(num_frames);
-  facility.do_reorder(dest, src, num_frames);
-  std::cout << "INFO: " << facility.get_info() << '\n';
-  unsigned size = facility.reorder_final_size();
-  result.resizeBytes(size);
-
+  FelixReorder(result, src, num_frames, facility);
   return result;
 }
 
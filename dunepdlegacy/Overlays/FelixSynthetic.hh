@@ -0,0 +1,160 @@
+// FelixSynthetic.hh generates FELIX frames in memory, for tests, benchmarks
+// and emulators that should not depend on recorded data files.
+
+#ifndef artdaq_dune_Overlays_FelixSynthetic_hh
+#define artdaq_dune_Overlays_FelixSynthetic_hh
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include "artdaq-core/Data/Fragment.hh"
+#include "dunepdlegacy/Overlays/FelixFormat.hh"
+#include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
+#include "dunepdlegacy/Overlays/FragmentType.hh"
+
+namespace dune {
+
+// Description of the synthetic data. Every channel has a pedestal drawn
+// uniformly from pedestal +- pedestal_spread, Gaussian noise of rms noise and
+// unipolar Gaussian pulses of pulse_amplitude ADC counts and pulse_width
+// ticks width arriving at pulse_rate per channel and tick. The headers of a
+// fraction faulty_rate of the frames do not follow from the first frame; if
+// that is nonzero at least one frame after the first is faulty.
+// Convert counts advance by convert_count_step per frame: by one as
+// FelixReorder expects, FelixCompress expects 25.
+struct FelixSyntheticConfig {
+  unsigned num_frames = 6000;
+  double pedestal = 900;
+  double pedestal_spread = 300;
+  double noise = 4;
+  double pulse_rate = 1e-3;
+  double pulse_amplitude = 300;
+  double pulse_width = 3;
+  double faulty_rate = 1e-3;
+  uint64_t first_timestamp = 0x100000;
+  unsigned convert_count_step = 1;
+  unsigned crate_no = 1;
+  unsigned slot_no = 2;
+  unsigned fiber_no = 1;
+  unsigned seed = 1;
+};
+
+class FelixSynthetic {
+ public:
+  static constexpr unsigned num_channels = FelixFrame::num_ch_per_frame;
+
+  FelixSynthetic(const FelixSyntheticConfig& config = FelixSyntheticConfig())
+      : config_(config),
+        adcs_(num_channels * (size_t)config.num_frames),
+        frames_(config.num_frames * sizeof(FelixFrame)) {
+    generate_adcs();
+    generate_frames();
+  }
+
+  const FelixSyntheticConfig& config() const { return config_; }
+  unsigned num_frames() const { return config_.num_frames; }
+
+  // The ADC values, channel ch of frame i at adcs()[ch * num_frames() + i].
+  const adc_t* adcs() const { return adcs_.data(); }
+  // The raw frames, num_frames() * sizeof(FelixFrame) bytes.
+  const uint8_t* frames() const { return frames_.data(); }
+  size_t size_bytes() const { return frames_.size(); }
+  // Frames whose headers were made to differ from the first.
+  const std::vector<unsigned>& faulty_frames() const { return faulty_; }
+
+  // A FELIX fragment holding the raw frames.
+  std::unique_ptr<artdaq::Fragment> fragment() const {
+    FelixFragmentBase::Metadata meta = {0xabc, 1, 0, 0, num_frames(), 0,
+                                        num_frames()};
+    std::unique_ptr<artdaq::Fragment> frag(artdaq::Fragment::FragmentBytes(
+        size_bytes(), 1, 1, toFragmentType("FELIX"), meta));
+    memcpy(frag->dataBeginBytes(), frames(), size_bytes());
+    frag->setTimestamp(config_.first_timestamp);
+    return frag;
+  }
+
+ private:
+  const FelixSyntheticConfig config_;
+  adc_aligned_v adcs_;
+  std::vector<uint8_t> frames_;
+  std::vector<unsigned> faulty_;
+
+  void generate_adcs() {
+    const size_t frames = num_frames();
+    std::mt19937 gen(config_.seed);
+    std::uniform_real_distribution<double> pedestal(
+        config_.pedestal - config_.pedestal_spread,
+        config_.pedestal + config_.pedestal_spread);
+    std::normal_distribution<double> noise(0, config_.noise);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    // Pulses are drawn per channel from exponential arrival times.
+    const unsigned reach = ceil(4 * config_.pulse_width);
+    std::vector<double> signal(frames);
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+      std::fill(signal.begin(), signal.end(), pedestal(gen));
+      double t = 0;
+      while (config_.pulse_rate > 0) {
+        t -= log(1 - uniform(gen)) / config_.pulse_rate;
+        if (t >= frames) break;
+        const size_t begin = t > reach ? t - reach : 0;
+        const size_t end = std::min<size_t>(frames, t + reach + 1);
+        for (size_t i = begin; i < end; ++i) {
+          const double x = (i - t) / config_.pulse_width;
+          signal[i] += config_.pulse_amplitude * exp(-0.5 * x * x);
+        }
+      }
+      adc_t* row = adcs_.data() + ch * frames;
+      for (size_t i = 0; i < frames; ++i) {
+        row[i] = std::min(std::max(lround(signal[i] + noise(gen)), 0l), 4095l);
+      }
+    }
+  }
+
+  void generate_frames() {
+    if (num_frames() == 0) return;
+    uint8_t* dst = frames_.data();
+    memset(dst, 0, frames_.size());
+
+    FelixFrame* first = reinterpret_cast<FelixFrame*>(dst);
+    first->set_sof(0x3c);
+    first->set_version(3);
+    first->set_crate_no(config_.crate_no);
+    first->set_slot_no(config_.slot_no);
+    first->set_fiber_no(config_.fiber_no);
+    first->set_timestamp(config_.first_timestamp);
+    // All blocks convert together, so they share the convert count.
+    for (unsigned j = 0; j < 4; ++j) {
+      first->set_coldata_convert_count(j, 0x100);
+    }
+    FelixReorder::fill_headers(dst, dst, num_frames(), 0, 25,
+                               config_.convert_count_step);
+    FelixReorder::pack(dst, adcs_.data(), num_frames(), num_frames());
+
+    // Faulty frames get WIB errors or a jump in the timestamp. Short runs
+    // would mostly draw none, so the last frame is faulty then.
+    std::mt19937 gen(config_.seed + 1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (unsigned i = 1; i < num_frames(); ++i) {
+      const bool force = i + 1 == num_frames() && faulty_.empty() &&
+                         config_.faulty_rate > 0;
+      if (!force && uniform(gen) >= config_.faulty_rate) continue;
+      FelixFrame* frame = reinterpret_cast<FelixFrame*>(dst) + i;
+      if (faulty_.size() % 2) {
+        frame->set_timestamp(frame->timestamp() + 1);
+      } else {
+        frame->set_wib_errors(1 + faulty_.size());
+      }
+      faulty_.push_back(i);
+    }
+  }
+};
+
+}  // namespace dune
+
+#endif /* artdaq_dune_Overlays_FelixSynthetic_hh */
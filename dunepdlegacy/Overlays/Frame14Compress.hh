@@ -0,0 +1,347 @@
+// Frame14Compress.hh
+// Compression of reordered Frame14 (WIB2) data with the Huffman coder of
+// FelixCompress.
+
+#ifndef artdaq_dune_Overlays_Frame14Compress_hh
+#define artdaq_dune_Overlays_Frame14Compress_hh
+
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+#include "dunepdlegacy/Overlays/FelixCompress.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
+#include "dunepdlegacy/Overlays/Frame14Reorder.hh"
+
+namespace dune {
+
+// Compressed Frame14 data starts with this metadata, followed by
+//  - the reordered data after the samples: the crc20/flex12 words, the
+//    faulty header bitfield and the header sets,
+//  - the frequency table of the unique_values encoded values,
+//  - the byte offsets of the 256 channels in the encoded stream,
+//  - the encoded stream, every channel starting on a byte boundary.
+// Every sample is encoded as its difference to the previous sample of its
+// channel modulo 2^14, the first as is.
+struct Frame14CompMeta {
+  uint32_t version;
+  uint32_t num_frames;
+  uint32_t num_faulty;
+  uint32_t unique_values;
+};
+
+//==========================
+// Frame14 compressor class
+//==========================
+class Frame14Compressor {
+ public:
+  static constexpr uint32_t version = 1;
+  static constexpr unsigned num_channels = frame14::num_frame_samples;
+
+  // Compress the reordered data of num_frames frames.
+  Frame14Compressor(const uint8_t* reordered, const size_t num_frames)
+      : input(reordered), layout(num_frames) {}
+
+  void compress(std::vector<char>& out) {
+    const size_t num_frames = layout.num_frames();
+    Frame14CompMeta meta = {version, (uint32_t)num_frames,
+                            (uint32_t)layout.num_faulty(input), 0};
+
+    // Predict the values and build their histogram.
+    const adc_t* adcs = reinterpret_cast<adc_t const*>(input);
+    deltas.resize(num_channels * num_frames);
+    histogram.assign(num_symbols, 0);
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+      const adc_t* row = adcs + ch * num_frames;
+      adc_t* delta = deltas.data() + ch * num_frames;
+      adc_t prev = 0;
+      for (size_t i = 0; i < num_frames; ++i) {
+        delta[i] = (row[i] - prev) & (num_symbols - 1);
+        prev = row[i];
+        ++histogram[delta[i]];
+      }
+    }
+
+    std::vector<HuffTree::Node> nodes;
+    for (size_t v = 0; v < num_symbols; ++v) {
+      if (histogram[v] == 0) continue;
+      HuffTree::Node node;
+      node.value = v;
+      node.frequency = histogram[v];
+      nodes.push_back(node);
+    }
+    meta.unique_values = nodes.size();
+
+    // Record the metadata, the headers and the frequency table.
+    const size_t tail_size = layout.size(meta.num_faulty) - layout.crc_start();
+    out.resize(sizeof(meta) + tail_size + nodes.size() * freq_entry_size +
+               num_channels * sizeof(uint32_t));
+    char* dst = out.data();
+    memcpy(dst, &meta, sizeof(meta));
+    dst += sizeof(meta);
+    memcpy(dst, input + layout.crc_start(), tail_size);
+    dst += tail_size;
+    for (const auto& n : nodes) {
+      const adc_t value = n.value;
+      const uint32_t frequency = n.frequency;
+      memcpy(dst, &value, sizeof(value));
+      memcpy(dst + sizeof(value), &frequency, sizeof(frequency));
+      dst += freq_entry_size;
+    }
+    if (nodes.empty()) {
+      memset(dst, 0, num_channels * sizeof(uint32_t));
+      return;
+    }
+
+    HuffTree hufftree;
+    hufftree.make_tree(nodes);
+    size_t num_bits = 0;
+    for (auto p : hufftree.nodes) {
+      codebook[p.first] = p.second->huffcode |
+                          (uint64_t)p.second->hufflength << length_shift;
+      num_bits += (size_t)histogram[p.first] * p.second->hufflength;
+    }
+    encode(out, num_bits);
+  }
+
+ private:
+  static constexpr size_t num_symbols = 1ul << 14;
+  static constexpr size_t freq_entry_size = sizeof(adc_t) + sizeof(uint32_t);
+  // Huffman code of every value with its length in the upper byte.
+  static constexpr unsigned length_shift = 56;
+
+  const uint8_t* input;
+  const frame14::ReorderedLayout layout;
+  std::vector<adc_t> deltas;
+  std::vector<uint32_t> histogram;
+  std::vector<uint64_t> codebook = std::vector<uint64_t>(num_symbols, 0);
+
+  // Append the encoded channels to out, which ends with the channel offsets.
+  // The stream holds num_bits bits plus the padding of the channels.
+  void encode(std::vector<char>& out, const size_t num_bits) {
+    const size_t num_frames = layout.num_frames();
+    const uint64_t code_mask = (1ul << length_shift) - 1;
+    const size_t offsets = out.size() - num_channels * sizeof(uint32_t);
+    const size_t start = out.size();
+    out.resize(start + num_bits / 8 + num_channels + sizeof(uint64_t));
+
+    char* dest = out.data() + start;
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+      const uint32_t offset = dest - (out.data() + start);
+      memcpy(&out[offsets + ch * sizeof(offset)], &offset, sizeof(offset));
+      const adc_t* row = deltas.data() + ch * num_frames;
+      uint64_t bitbuf = 0;
+      unsigned bitcount = 0;
+      for (size_t i = 0; i < num_frames; ++i) {
+        const uint64_t code = codebook[row[i]];
+        bitbuf |= (code & code_mask) << bitcount;
+        bitcount += code >> length_shift;
+
+        // Flush all complete bytes.
+        memcpy(dest, &bitbuf, sizeof(bitbuf));
+        dest += bitcount / 8;
+        bitbuf >>= bitcount & ~7u;
+        bitcount %= 8;
+      }
+      // Complete the last byte.
+      memcpy(dest, &bitbuf, sizeof(bitbuf));
+      dest += (bitcount + 7) / 8;
+    }
+    out.resize(dest - out.data());
+  }
+};  // Frame14Compressor
+
+// Compress the reordered data of num_frames frames.
+inline std::vector<char> Frame14Compress(const uint8_t* reordered,
+                                         const size_t num_frames) {
+  std::vector<char> result;
+  Frame14Compressor(reordered, num_frames).compress(result);
+  return result;
+}
+
+// Compress num_frames raw frames, which are reordered first.
+inline std::vector<char> Frame14Compress(const frame14::frame14* frames,
+                                         const size_t num_frames) {
+  std::vector<uint8_t> reordered(
+      frame14::ReorderedLayout(num_frames).max_size());
+  frame14::reorder(reordered.data(), frames, num_frames);
+  return Frame14Compress(reordered.data(), num_frames);
+}
+
+//============================
+// Frame14 decompressor class
+//============================
+class Frame14Decompressor {
+ public:
+  static constexpr unsigned num_channels = frame14::num_frame_samples;
+
+  // Throws cet::exception for data of another version or data too short
+  // for the sizes its metadata gives.
+  Frame14Decompressor(const std::vector<char>& buff)
+      : Frame14Decompressor(buff.data(), buff.size()) {}
+  Frame14Decompressor(const char* data, const size_t size)
+      : end(reinterpret_cast<uint8_t const*>(data + size)),
+        meta(read_meta(data, size)),
+        layout(meta.num_frames),
+        tail(data + sizeof(meta)),
+        freq_table(tail + tail_size()),
+        decoder(read_tree()),
+        offsets(freq_table + meta.unique_values * freq_entry_size),
+        stream(reinterpret_cast<uint8_t const*>(
+            offsets + num_channels * sizeof(uint32_t))) {
+    check_offsets();
+  }
+
+  size_t num_frames() const { return meta.num_frames; }
+  size_t num_faulty() const { return meta.num_faulty; }
+  // Size of the reordered data restored by decompress.
+  size_t reordered_size() const { return layout.size(meta.num_faulty); }
+
+  // Function to decode the num_frames() values of a single channel.
+  void decompress_channel(const unsigned ch, adc_t* dst) const {
+    if (!decoder) return;
+    const uint8_t* channel_end =
+        ch + 1 < num_channels ? stream + channel_offset(ch + 1) : end;
+    decoder->decode(dst, num_frames(), stream + channel_offset(ch),
+                    channel_end);
+    for (size_t i = 1; i < num_frames(); ++i) {
+      dst[i] = (dst[i] + dst[i - 1]) & 0x3FFF;
+    }
+  }
+
+  // Function to decode the channels [first, last) into the rows
+  // dst + (ch - first) * stride, one job per channel on the pool if given.
+  void decompress_channels(adc_t* dst, const size_t stride,
+                           const unsigned first = 0,
+                           const unsigned last = num_channels,
+                           ReorderThreadPool* pool = nullptr) const {
+    if (!pool) {
+      for (unsigned ch = first; ch < last; ++ch) {
+        decompress_channel(ch, dst + (ch - first) * stride);
+      }
+      return;
+    }
+    pool->run(last - first, [&](const unsigned i) {
+      decompress_channel(first + i, dst + i * stride);
+    });
+  }
+
+  // Function to restore the reordered data into dst, which holds
+  // reordered_size() bytes.
+  void decompress(uint8_t* dst, ReorderThreadPool* pool = nullptr) const {
+    decompress_channels(reinterpret_cast<adc_t*>(dst + layout.adc_start()),
+                        num_frames(), 0, num_channels, pool);
+    memcpy(dst + layout.crc_start(), tail, tail_size());
+  }
+
+ private:
+  static constexpr size_t num_symbols = 1ul << 14;
+  static constexpr size_t freq_entry_size = sizeof(adc_t) + sizeof(uint32_t);
+
+  const uint8_t* const end;
+  const Frame14CompMeta meta;
+  const frame14::ReorderedLayout layout;
+  // Reordered data after the samples, and the frequency table.
+  const char* const tail;
+  const char* const freq_table;
+  const std::unique_ptr<const HuffDecoder> decoder;
+  const char* const offsets;
+  const uint8_t* const stream;
+
+  // Data from another writer or a truncated buffer cannot be decoded.
+  static Frame14CompMeta read_meta(const char* data, const size_t size) {
+    Frame14CompMeta meta;
+    if (size < sizeof(meta)) {
+      throw cet::exception("Frame14Decompressor")
+          << "Compressed data of " << size << " bytes has no metadata";
+    }
+    memcpy(&meta, data, sizeof(meta));
+    if (meta.version != Frame14Compressor::version) {
+      throw cet::exception("Frame14Decompressor")
+          << "Unknown compression version " << meta.version;
+    }
+    if (meta.num_faulty > (meta.num_frames ? meta.num_frames - 1 : 0) ||
+        meta.unique_values > num_symbols ||
+        (meta.unique_values == 0) != (meta.num_frames == 0)) {
+      throw cet::exception("Frame14Decompressor")
+          << "Inconsistent metadata: " << meta.num_frames << " frames, "
+          << meta.num_faulty << " faulty headers, " << meta.unique_values
+          << " unique values";
+    }
+
+    // Everything up to the encoded stream.
+    const frame14::ReorderedLayout layout(meta.num_frames);
+    const size_t tail_size = layout.size(meta.num_faulty) - layout.crc_start();
+    const size_t needed = sizeof(meta) + tail_size +
+                          meta.unique_values * freq_entry_size +
+                          num_channels * sizeof(uint32_t);
+    if (size < needed) {
+      throw cet::exception("Frame14Decompressor")
+          << "Compressed data of " << size << " bytes is shorter than the "
+          << needed << " bytes its metadata requires";
+    }
+    const uint8_t* bits = reinterpret_cast<uint8_t const*>(data) +
+                          sizeof(meta) + layout.bitfield_start() -
+                          layout.crc_start();
+    size_t num_faulty = 0;
+    for (size_t w = 0; w < layout.bitfield_size() / 4; ++w) {
+      uint32_t word;
+      memcpy(&word, bits + 4 * w, sizeof(word));
+      num_faulty += __builtin_popcount(word);
+    }
+    if (num_faulty != meta.num_faulty) {
+      throw cet::exception("Frame14Decompressor")
+          << "Faulty header bitfield marks " << num_faulty
+          << " frames, the metadata " << meta.num_faulty;
+    }
+    return meta;
+  }
+
+  // Every channel has to start within the encoded stream, in order.
+  void check_offsets() const {
+    const size_t stream_size = end - stream;
+    uint32_t prev = 0;
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+      const uint32_t offset = channel_offset(ch);
+      if (offset < prev || offset > stream_size) {
+        throw cet::exception("Frame14Decompressor")
+            << "Channel " << ch << " starts at byte " << offset
+            << " of an encoded stream of " << stream_size << " bytes";
+      }
+      prev = offset;
+    }
+  }
+
+  size_t tail_size() const {
+    return layout.size(meta.num_faulty) - layout.crc_start();
+  }
+
+  // Function to generate a Huffman tree from the frequency table. Without
+  // frames there is nothing to decode.
+  std::unique_ptr<const HuffDecoder> read_tree() const {
+    if (meta.unique_values == 0) return nullptr;
+    std::vector<HuffTree::Node> nodes(meta.unique_values);
+    for (unsigned i = 0; i < meta.unique_values; ++i) {
+      uint32_t frequency;
+      memcpy(&nodes[i].value, freq_table + i * freq_entry_size, sizeof(adc_t));
+      memcpy(&frequency, freq_table + i * freq_entry_size + sizeof(adc_t),
+             sizeof(frequency));
+      nodes[i].frequency = frequency;
+    }
+    HuffTree hufftree;
+    hufftree.make_tree(nodes);
+    return std::unique_ptr<const HuffDecoder>(new HuffDecoder(hufftree));
+  }
+
+  uint32_t channel_offset(const unsigned ch) const {
+    uint32_t offset;
+    memcpy(&offset, offsets + ch * sizeof(offset), sizeof(offset));
+    return offset;
+  }
+};  // Frame14Decompressor
+
+}  // namespace dune
+
+#endif /* artdaq_dune_Overlays_Frame14Compress_hh */
@@ -0,0 +1,224 @@
+// Frame14Crc.hh
+// Validation of the crc20 field of Frame14 (WIB2) frames.
+
+#ifndef artdaq_dune_Overlays_Frame14Crc_hh
+#define artdaq_dune_Overlays_Frame14Crc_hh
+
+#include <immintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "dunepdlegacy/Overlays/Frame14Format.hh"
+#include "dunepdlegacy/Overlays/Frame14Reorder.hh"
+
+#define FRAME14_CRC_CLMUL __attribute__((target("pclmul,sse4.1")))
+
+namespace dune {
+
+namespace frame14 {
+
+// Definition of the CRC of a frame. The CRC is computed least significant
+// bit first over the bytes [first_byte, last_byte) of the frame, by default
+// everything from the word after start_frame up to the CRC word. The
+// polynomial, initial value and final xor are those of the WIB firmware that
+// fills crc20. They are not recorded in this package, so there are no
+// defaults for them.
+struct Crc20Params {
+  Crc20Params(const uint32_t poly, const uint32_t init, const uint32_t xorout)
+      : poly(poly), init(init), xorout(xorout) {}
+
+  uint32_t poly;  // Without the x^20 term.
+  uint32_t init;
+  uint32_t xorout;
+  size_t first_byte = sizeof(uint32_t);
+  size_t last_byte = crc_word_offset;
+};
+
+// CRC-20 checker. The 20 bit CRC is computed as a 32 bit CRC with the
+// polynomial multiplied by x^12, which leaves it in the low 20 bits of the
+// register and lets the CRC-32 methods apply unchanged: slicing by eight
+// bytes, or folding sixteen bytes at a time with carry-less multiplication
+// where the CPU supports it.
+class Crc20 {
+ public:
+  explicit Crc20(const Crc20Params& params) : params_(params) {
+    uint32_t reflected = 0;
+    for (unsigned i = 0; i < 20; ++i) {
+      if ((params_.poly >> i) & 1) reflected |= 1u << (19 - i);
+    }
+    for (unsigned b = 0; b < 256; ++b) {
+      uint32_t crc = b;
+      for (unsigned k = 0; k < 8; ++k) {
+        crc = (crc >> 1) ^ (crc & 1 ? reflected : 0);
+      }
+      table_[0][b] = crc;
+    }
+    for (unsigned s = 1; s < 8; ++s) {
+      for (unsigned b = 0; b < 256; ++b) {
+        const uint32_t prev = table_[s - 1][b];
+        table_[s][b] = (prev >> 8) ^ table_[0][prev & 0xFF];
+      }
+    }
+    fold_512_[0] = x_pow_mod(512 + 64 - 1);
+    fold_512_[1] = x_pow_mod(512 - 1);
+    fold_128_[0] = x_pow_mod(128 + 64 - 1);
+    fold_128_[1] = x_pow_mod(128 - 1);
+  }
+
+  const Crc20Params& params() const { return params_; }
+
+  // Whether the CPU has the instructions compute_clmul is built for.
+  static bool clmul_available() noexcept {
+    static const bool available = __builtin_cpu_supports("pclmul") &&
+                                  __builtin_cpu_supports("sse4.1");
+    return available;
+  }
+
+  // CRC of len bytes.
+  uint32_t compute(const uint8_t* data, const size_t len) const {
+    uint32_t crc;
+    if (clmul_available()) {
+      crc = compute_clmul(data, len, params_.init);
+    } else {
+      crc = compute_baseline(data, len, params_.init);
+    }
+    return (crc ^ params_.xorout) & 0xFFFFF;
+  }
+
+  uint32_t frame_crc(const frame14& frame) const {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&frame);
+    return compute(bytes + params_.first_byte,
+                   params_.last_byte - params_.first_byte);
+  }
+
+  bool check(const frame14& frame) const {
+    return frame_crc(frame) == frame.crc20;
+  }
+
+  // Check num_frames frames. Bit i % 64 of bad_frames[i / 64] is set if frame
+  // i has the wrong CRC. Returns the number of such frames.
+  size_t check(const frame14* frames, const size_t num_frames,
+               std::vector<uint64_t>& bad_frames) const {
+    bad_frames.assign((num_frames + 63) / 64, 0);
+    return check(frames, num_frames, bad_frames.data(), 0);
+  }
+
+  // Check num_frames frames into an existing bitmap, starting at bit first.
+  size_t check(const frame14* frames, const size_t num_frames,
+               uint64_t* bad_frames, const size_t first) const {
+    size_t num_bad = 0;
+    for (size_t i = 0; i < num_frames; ++i) {
+      if (!check(frames[i])) {
+        bad_frames[(first + i) / 64] |= 1ul << ((first + i) % 64);
+        ++num_bad;
+      }
+    }
+    return num_bad;
+  }
+
+  // Slicing by eight bytes. The register is kept without the final xor.
+  uint32_t compute_baseline(const uint8_t* data, size_t len,
+                            uint32_t crc) const {
+    while (len >= 8) {
+      uint32_t lo, hi;
+      memcpy(&lo, data, sizeof(lo));
+      memcpy(&hi, data + 4, sizeof(hi));
+      lo ^= crc;
+      crc = table_[7][lo & 0xFF] ^ table_[6][(lo >> 8) & 0xFF] ^
+            table_[5][(lo >> 16) & 0xFF] ^ table_[4][lo >> 24] ^
+            table_[3][hi & 0xFF] ^ table_[2][(hi >> 8) & 0xFF] ^
+            table_[1][(hi >> 16) & 0xFF] ^ table_[0][hi >> 24];
+      data += 8;
+      len -= 8;
+    }
+    while (len--) {
+      crc = (crc >> 8) ^ table_[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+  }
+
+  // Folding with carry-less multiplication. The data is reduced to sixteen
+  // bytes with the same remainder, four blocks of sixteen bytes at a time
+  // and then one block at a time, and the CRC of those and the remaining
+  // bytes is taken from the tables.
+  FRAME14_CRC_CLMUL uint32_t compute_clmul(const uint8_t* data, size_t len,
+                                           const uint32_t crc) const {
+    if (len < 64) {
+      return compute_baseline(data, len, crc);
+    }
+    const __m128i k512 = _mm_set_epi64x(fold_512_[1], fold_512_[0]);
+    const __m128i k128 = _mm_set_epi64x(fold_128_[1], fold_128_[0]);
+    auto load = [](const uint8_t* p) {
+      return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    };
+
+    __m128i x0 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(crc));
+    __m128i x1 = load(data + 16);
+    __m128i x2 = load(data + 32);
+    __m128i x3 = load(data + 48);
+    data += 64;
+    len -= 64;
+    while (len >= 64) {
+      x0 = fold(x0, k512, load(data));
+      x1 = fold(x1, k512, load(data + 16));
+      x2 = fold(x2, k512, load(data + 32));
+      x3 = fold(x3, k512, load(data + 48));
+      data += 64;
+      len -= 64;
+    }
+    x0 = fold(x0, k128, x1);
+    x0 = fold(x0, k128, x2);
+    x0 = fold(x0, k128, x3);
+    while (len >= 16) {
+      x0 = fold(x0, k128, load(data));
+      data += 16;
+      len -= 16;
+    }
+
+    alignas(16) uint8_t folded[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(folded), x0);
+    return compute_baseline(data, len, compute_baseline(folded, 16, 0));
+  }
+
+ private:
+  Crc20Params params_;
+  uint32_t table_[8][256];
+  uint64_t fold_512_[2];
+  uint64_t fold_128_[2];
+
+  // Multiply the low half by x^(d+64) and the high half by x^d, modulo the
+  // polynomial, and add the next block. A function rather than a lambda so
+  // that it carries the pclmul target of compute_clmul.
+  static FRAME14_CRC_CLMUL inline __m128i fold(const __m128i x,
+                                               const __m128i k,
+                                               const __m128i next) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                                       _mm_clmulepi64_si128(x, k, 0x11)),
+                         next);
+  }
+
+  // x^n modulo the polynomial times x^12, bit reflected into 64 bits so that
+  // a carry-less product with a reflected 64 bit block is aligned to the
+  // 128 bit block that is n + 1 bits further on.
+  uint64_t x_pow_mod(const unsigned n) const {
+    const uint64_t poly = (1ul << 32) | ((uint64_t)params_.poly << 12);
+    uint64_t r = 1;
+    for (unsigned i = 0; i < n; ++i) {
+      r <<= 1;
+      if (r & (1ul << 32)) r ^= poly;
+    }
+    uint64_t reflected = 0;
+    for (unsigned i = 0; i < 32; ++i) {
+      if ((r >> i) & 1) reflected |= 1ul << (63 - i);
+    }
+    return reflected;
+  }
+};
+
+} // namespace frame14
+
+} // namespace dune
+
+#endif /* artdaq_dune_Overlays_Frame14Crc_hh */
@@ -6,8 +6,12 @@
 
 #include <cstddef>
 #include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
 #include <vector>
 
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
+
 namespace dune {
 
 namespace frame14 {
@@ -45,6 +49,178 @@ inline uint16_t unpack14(const uint32_t *packed, size_t i) {
     }
 }
 
+// Number of 14 bit samples in femb_a_seg or femb_b_seg, and in a frame.
+constexpr size_t num_seg_samples = 128;
+constexpr size_t num_frame_samples = 2 * num_seg_samples;
+
+// Timestamp increment between consecutive frames.
+constexpr uint64_t timestamp_step = 32;
+
+// Unpack all 128 samples of packed channel data (56 uint32 words) into dst.
+// Every sample lies within the four bytes from bit 14*i rounded down to a
+// byte, so it can be loaded without branches.
+inline void unpack14_seg_baseline(const uint32_t *packed, uint16_t *dst) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(packed);
+    for (size_t i = 0; i + 1 < num_seg_samples; ++i) {
+        uint32_t word;
+        memcpy(&word, bytes + i * 14 / 8, sizeof(word));
+        dst[i] = (word >> (i * 14 % 8)) & 0x3FFF;
+    }
+    // The four bytes of the last sample would reach past the data.
+    dst[num_seg_samples - 1] = unpack14(packed, num_seg_samples - 1);
+}
+
+// Sixteen samples take up 28 bytes. The AVX2 kernel loads the first eight
+// into the low and the second eight into the high 128 bit lane, copies the
+// four bytes holding each sample into a 32 bit element, shifts and masks
+// them and packs the result to sixteen 16 bit values. Nothing beyond the 56
+// words is read.
+FELIX_REORDER_AVX2 inline void unpack14_seg_avx2(const uint32_t *packed,
+                                                 uint16_t *dst) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(packed);
+    const __m256i first_four = _mm256_setr_epi8(
+        0, 1, 2, 3, 1, 2, 3, 4, 3, 4, 5, 6, 5, 6, 7, 8,
+        0, 1, 2, 3, 1, 2, 3, 4, 3, 4, 5, 6, 5, 6, 7, 8);
+    const __m256i second_four = _mm256_setr_epi8(
+        7, 8, 9, 10, 8, 9, 10, 11, 10, 11, 12, 13, 12, 13, 14, 15,
+        7, 8, 9, 10, 8, 9, 10, 11, 10, 11, 12, 13, 12, 13, 14, 15);
+    const __m256i shifts = _mm256_setr_epi32(0, 6, 4, 2, 0, 6, 4, 2);
+    const __m256i mask = _mm256_set1_epi32(0x3FFF);
+    for (size_t g = 0; g < num_seg_samples / 16; ++g) {
+        const uint8_t *src = bytes + g * 28;
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        const __m128i hi = _mm_srli_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12)), 2);
+        const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        const __m256i a = _mm256_and_si256(
+            _mm256_srlv_epi32(_mm256_shuffle_epi8(v, first_four), shifts), mask);
+        const __m256i b = _mm256_and_si256(
+            _mm256_srlv_epi32(_mm256_shuffle_epi8(v, second_four), shifts), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + g * 16),
+                            _mm256_packus_epi32(a, b));
+    }
+}
+
+inline void unpack14_seg(const uint32_t *packed, uint16_t *dst) {
+    if (FelixReorder::avx_available()) {
+        unpack14_seg_avx2(packed, dst);
+    } else {
+        unpack14_seg_baseline(packed, dst);
+    }
+}
+
+// Pack 128 samples into packed channel data (56 uint32 words), the inverse
+// of unpack14. Only the low 14 bits of every sample are kept.
+inline void pack14_seg(const uint16_t *src, uint32_t *packed) {
+    uint64_t buffer = 0;
+    unsigned bits = 0;
+    for (size_t i = 0; i < num_seg_samples; ++i) {
+        buffer |= (uint64_t)(src[i] & 0x3FFF) << bits;
+        bits += 14;
+        if (bits >= 32) {
+            *packed++ = (uint32_t)buffer;
+            buffer >>= 32;
+            bits -= 32;
+        }
+    }
+}
+
+// Unpack the 256 samples of a frame, those of femb_a_seg first.
+inline void unpack14_frame(const frame14 &frame, uint16_t *dst) {
+    unpack14_seg(frame.femb_a_seg, dst);
+    unpack14_seg(frame.femb_b_seg, dst + num_seg_samples);
+}
+
+inline void unpack14_frames_baseline(const frame14 *frames, size_t num_frames,
+                                     uint16_t *dst, size_t stride) {
+    uint16_t samples[num_frame_samples];
+    for (size_t f = 0; f < num_frames; ++f) {
+        unpack14_seg_baseline(frames[f].femb_a_seg, samples);
+        unpack14_seg_baseline(frames[f].femb_b_seg, samples + num_seg_samples);
+        for (size_t ch = 0; ch < num_frame_samples; ++ch) {
+            dst[ch * stride + f] = samples[ch];
+        }
+    }
+}
+
+// Transpose sixteen rows of sixteen 16 bit values in place.
+FELIX_REORDER_AVX2 inline void transpose16x16_epi16(__m256i *rows) {
+    __m256i b[16], c[16];
+    for (int k = 0; k < 8; ++k) {
+        b[k] = _mm256_unpacklo_epi16(rows[2 * k], rows[2 * k + 1]);
+        b[k + 8] = _mm256_unpackhi_epi16(rows[2 * k], rows[2 * k + 1]);
+    }
+    // c[4 * g + k] holds rows 4k to 4k+3 of columns 2g and 2g+1 (and 8 more).
+    for (int k = 0; k < 4; ++k) {
+        c[k] = _mm256_unpacklo_epi32(b[2 * k], b[2 * k + 1]);
+        c[k + 4] = _mm256_unpackhi_epi32(b[2 * k], b[2 * k + 1]);
+        c[k + 8] = _mm256_unpacklo_epi32(b[2 * k + 8], b[2 * k + 9]);
+        c[k + 12] = _mm256_unpackhi_epi32(b[2 * k + 8], b[2 * k + 9]);
+    }
+    for (int g = 0; g < 4; ++g) {
+        const __m256i *q = c + 4 * g;
+        const __m256i even_lo = _mm256_unpacklo_epi64(q[0], q[1]);
+        const __m256i odd_lo = _mm256_unpackhi_epi64(q[0], q[1]);
+        const __m256i even_hi = _mm256_unpacklo_epi64(q[2], q[3]);
+        const __m256i odd_hi = _mm256_unpackhi_epi64(q[2], q[3]);
+        rows[2 * g] = _mm256_permute2x128_si256(even_lo, even_hi, 0x20);
+        rows[2 * g + 1] = _mm256_permute2x128_si256(odd_lo, odd_hi, 0x20);
+        rows[2 * g + 8] = _mm256_permute2x128_si256(even_lo, even_hi, 0x31);
+        rows[2 * g + 9] = _mm256_permute2x128_si256(odd_lo, odd_hi, 0x31);
+    }
+}
+
+// Frames are unpacked 32 at a time into a buffer that stays in the L1 cache,
+// from which blocks of sixteen channels are transposed into dst. Writing 32
+// samples of a channel at once keeps the stores to whole cache lines.
+FELIX_REORDER_AVX2 inline void unpack14_frames_avx2(const frame14 *frames,
+                                                    size_t num_frames,
+                                                    uint16_t *dst,
+                                                    size_t stride) {
+    constexpr size_t block = 32;
+    alignas(32) uint16_t samples[block][num_frame_samples];
+    size_t f = 0;
+    for (; f + block <= num_frames; f += block) {
+        for (size_t i = 0; i < block; ++i) {
+            unpack14_seg_avx2(frames[f + i].femb_a_seg, samples[i]);
+            unpack14_seg_avx2(frames[f + i].femb_b_seg, samples[i] + num_seg_samples);
+        }
+        for (size_t ch = 0; ch < num_frame_samples; ch += 16) {
+            __m256i rows[2][16];
+            for (size_t h = 0; h < 2; ++h) {
+                for (size_t i = 0; i < 16; ++i) {
+                    rows[h][i] = _mm256_load_si256(
+                        reinterpret_cast<const __m256i *>(samples[16 * h + i] + ch));
+                }
+                transpose16x16_epi16(rows[h]);
+            }
+            for (size_t i = 0; i < 16; ++i) {
+                __m256i *row = reinterpret_cast<__m256i *>(dst + (ch + i) * stride + f);
+                _mm256_storeu_si256(row, rows[0][i]);
+                _mm256_storeu_si256(row + 1, rows[1][i]);
+            }
+        }
+    }
+    for (; f < num_frames; ++f) {
+        unpack14_seg_avx2(frames[f].femb_a_seg, samples[0]);
+        unpack14_seg_avx2(frames[f].femb_b_seg, samples[0] + num_seg_samples);
+        for (size_t ch = 0; ch < num_frame_samples; ++ch) {
+            dst[ch * stride + f] = samples[0][ch];
+        }
+    }
+}
+
+// Unpack num_frames frames into 256 channel-major rows of stride samples,
+// channels 0 to 127 from femb_a_seg and 128 to 255 from femb_b_seg.
+inline void unpack14_frames(const frame14 *frames, size_t num_frames,
+                            uint16_t *dst, size_t stride) {
+    if (FelixReorder::avx_available()) {
+        unpack14_frames_avx2(frames, num_frames, dst, stride);
+    } else {
+        unpack14_frames_baseline(frames, num_frames, dst, stride);
+    }
+}
+
 } // namespace frame14
 
 } // namespace dune
@@ -5,11 +5,17 @@
 
 #include "FragmentType.hh"
 #include "artdaq-core/Data/Fragment.hh"
+#include "dunepdlegacy/Overlays/BitRank.hh"
+#include "dunepdlegacy/Overlays/Frame14Compress.hh"
+#include "dunepdlegacy/Overlays/Frame14Crc.hh"
 #include "dunepdlegacy/Overlays/Frame14Format.hh"
+#include "dunepdlegacy/Overlays/Frame14Reorder.hh"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 #include <zlib.h>
 
@@ -70,6 +76,16 @@ class Frame14Fragment {
   
   // Function to return all ADC values for all channels in a map.
   virtual std::map<uint8_t, adc_v> get_all_ADCs() const = 0;
+  // Function to decode all ADC values into a channel-major buffer of 256 rows
+  // of stride values (total_frames() if zero), one row per channel.
+  virtual void get_all_ADCs(adc_t* dst, size_t stride = 0) const = 0;
+
+  // Function to validate the crc20 field of all frames against crc, which
+  // must use the parameters of the firmware. Bit i % 64 of
+  // bad_frames[i / 64] is set if frame i has the wrong CRC, and the number
+  // of such frames is returned.
+  virtual size_t crc_errors(std::vector<uint64_t>& bad_frames,
+                            const frame14::Crc20& crc) const = 0;
 
   Frame14Fragment(const artdaq::Fragment& fragment)
       : meta_(*(fragment.metadata<Metadata>())),
@@ -166,11 +182,24 @@ class Frame14FragmentUnordered : public Frame14Fragment {
   }
   // Function to return all ADC values for all channels in a map.
   std::map<uint8_t, adc_v> get_all_ADCs() const {
+    adc_v buffer(frame14::num_frame_samples * total_frames());
+    get_all_ADCs(buffer.data());
     std::map<uint8_t, adc_v> output;
     for (int i = 0; i < 256; i++)
-      output.insert(std::pair<uint8_t, adc_v>(i, get_ADCs_by_channel(i)));
+      output.insert(std::pair<uint8_t, adc_v>(
+          i, adc_v(buffer.begin() + i * total_frames(),
+                   buffer.begin() + (i + 1) * total_frames())));
     return output;
   }
+  void get_all_ADCs(adc_t* dst, size_t stride = 0) const {
+    if (stride == 0) stride = total_frames();
+    frame14::unpack14_frames(frame_(), total_frames(), dst, stride);
+  }
+
+  size_t crc_errors(std::vector<uint64_t>& bad_frames,
+                    const frame14::Crc20& crc) const {
+    return crc.check(frame_(), total_frames(), bad_frames);
+  }
   
   
 
@@ -184,12 +213,318 @@ class Frame14FragmentUnordered : public Frame14Fragment {
   }
 }; // class dune::Frame14FragmentUnordered
 
-const Frame14Fragment* ParseFrame14Fragment(const artdaq::Fragment& fragment) {
-  // const Frame14Fragment::Metadata *meta = fragment.metadata<Frame14Fragment::Metadata>();
-  // Check meta and potentially return a different unpacker 
+//===========================================================
+// Frame fragment for reordered frames, see Frame14Reorder.hh
+//===========================================================
+class Frame14FragmentReordered : public Frame14Fragment {
+ public:
+  /* Frame field and accessors. */
+  uint8_t link_mask(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->link_mask;
+  }
+  uint8_t femb_valid(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->femb_valid;
+  }
+  uint8_t fiber_no(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->fiber_num;
+  }
+  uint8_t slot_no(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->slot_num;
+  }
+  uint8_t crate_no(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->crate_num;
+  }
+  uint8_t frame_version(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->frame_version;
+  }
+
+  uint32_t wib_data(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->wib_data;
+  }
+  uint64_t timestamp(const unsigned& frame_ID = 0) const {
+    uint64_t result = head_(frame_ID)->timestamp;
+    if (header_is_faulty(frame_ID) == false) {
+      // Deduce timestamp from first header.
+      result += frame_ID * frame14::timestamp_step;
+    }
+    return result;
+  }
+  uint32_t crc20(const unsigned& frame_ID = 0) const {
+    return crc_word_(frame_ID) & 0xFFFFF;
+  }
+  uint32_t flex12(const unsigned& frame_ID = 0) const {
+    return crc_word_(frame_ID) >> 20;
+  }
+  uint32_t flex24(const unsigned& frame_ID = 0) const {
+    return head_(frame_ID)->flex24;
+  }
+
+  size_t total_frames() const {
+    return meta_.num_frames;
+  }
+
+  // Functions to return a certain ADC value.
+  adc_t get_ADC(const unsigned& frame_ID, const uint8_t block_ID,
+                const uint8_t channel_ID) const {
+    if (block_ID > 1) {
+      return -1;
+    }
+    return channel_(frame_ID, block_ID * frame14::num_seg_samples + channel_ID);
+  }
+  adc_t get_ADC(const unsigned& frame_ID, const uint8_t channel_ID) const {
+    return channel_(frame_ID, channel_ID);
+  }
+
+  // Function to return all ADC values for a single channel.
+  adc_v get_ADCs_by_channel(const uint8_t block_ID,
+                            const uint8_t channel_ID) const {
+    if (block_ID > 1) {
+      return adc_v();
+    }
+    return get_ADCs_by_channel(block_ID * frame14::num_seg_samples + channel_ID);
+  }
+  adc_v get_ADCs_by_channel(const uint8_t channel_ID) const {
+    const adc_t* row = &channel_(0, channel_ID);
+    return adc_v(row, row + total_frames());
+  }
+  // Function to return all ADC values for all channels in a map.
+  std::map<uint8_t, adc_v> get_all_ADCs() const {
+    std::map<uint8_t, adc_v> output;
+    for (int i = 0; i < 256; i++)
+      output.insert(std::pair<uint8_t, adc_v>(i, get_ADCs_by_channel(i)));
+    return output;
+  }
+  void get_all_ADCs(adc_t* dst, size_t stride = 0) const {
+    if (stride == 0) stride = total_frames();
+    // Channels are stored contiguously already.
+    for (unsigned ch = 0; ch < frame14::num_frame_samples; ++ch) {
+      memcpy(dst + ch * stride, &channel_(0, ch), total_frames() * sizeof(adc_t));
+    }
+  }
+
+  // The CRC covers the packed frames, which are rebuilt a block at a time.
+  size_t crc_errors(std::vector<uint64_t>& bad_frames,
+                    const frame14::Crc20& crc) const {
+    bad_frames.assign((total_frames() + 63) / 64, 0);
+    frame14::frame14 frames[64];
+    size_t num_bad = 0;
+    for (size_t first = 0; first < total_frames(); first += 64) {
+      const size_t count = std::min<size_t>(64, total_frames() - first);
+      frame14::unreorder(frames, data_(), total_frames(), first, count);
+      num_bad += crc.check(frames, count, bad_frames.data(), first);
+    }
+    return num_bad;
+  }
+
+  // Faulty header information. Frames with faulty headers store their own
+  // headers, all others follow from the headers of the first frame.
+  bool header_is_faulty(const unsigned frame_num) const {
+    return (faulty_header_bits()[frame_num / 32] >> (frame_num % 32)) & 1;
+  }
+  // Bitfield of faulty headers, one bit per frame from the least significant
+  // bit of the first word on.
+  const uint32_t* faulty_header_bits() const {
+    return reinterpret_cast<uint32_t const*>(data_() + layout_.bitfield_start());
+  }
+
+  Frame14FragmentReordered(artdaq::Fragment const& fragment)
+      : Frame14Fragment(fragment), layout_(meta_.num_frames) {}
+
+ protected:
+  const frame14::ReorderedLayout layout_;
+  // The words of the bitfield hold its bits in byte order as well.
+  const BitRank faulty_headers_ = BitRank(
+      data_() + layout_.bitfield_start(), meta_.num_frames);
+
+  // Number of the faulty header (0 if header is good).
+  unsigned bad_header_num(const unsigned frame_num) const {
+    return header_is_faulty(frame_num) ? faulty_headers_.rank(frame_num) + 1
+                                       : 0;
+  }
+
+  uint8_t const* data_() const {
+    return static_cast<uint8_t const*>(artdaq_Fragment_);
+  }
+  frame14::header14 const* head_(const unsigned frame_num) const {
+    return reinterpret_cast<frame14::header14 const*>(
+               data_() + layout_.header_start()) +
+           bad_header_num(frame_num);
+  }
+  uint32_t crc_word_(const unsigned frame_num) const {
+    return reinterpret_cast<uint32_t const*>(
+        data_() + layout_.crc_start())[frame_num];
+  }
+  adc_t const& channel_(const unsigned frame_num, const unsigned ch_num) const {
+    return reinterpret_cast<adc_t const*>(data_() + layout_.adc_start())
+        [frame_num + ch_num * meta_.num_frames];
+  }
+}; // class dune::Frame14FragmentReordered
+
+//=============================================================
+// Frame fragment for compressed frames, see Frame14Compress.hh
+//=============================================================
+class Frame14FragmentCompressed : public Frame14Fragment {
+ public:
+  /* Frame field and accessors. */
+  uint8_t link_mask(const unsigned& frame_ID = 0) const {
+    return reordered_.link_mask(frame_ID);
+  }
+  uint8_t femb_valid(const unsigned& frame_ID = 0) const {
+    return reordered_.femb_valid(frame_ID);
+  }
+  uint8_t fiber_no(const unsigned& frame_ID = 0) const {
+    return reordered_.fiber_no(frame_ID);
+  }
+  uint8_t slot_no(const unsigned& frame_ID = 0) const {
+    return reordered_.slot_no(frame_ID);
+  }
+  uint8_t crate_no(const unsigned& frame_ID = 0) const {
+    return reordered_.crate_no(frame_ID);
+  }
+  uint8_t frame_version(const unsigned& frame_ID = 0) const {
+    return reordered_.frame_version(frame_ID);
+  }
+
+  uint32_t wib_data(const unsigned& frame_ID = 0) const {
+    return reordered_.wib_data(frame_ID);
+  }
+  uint64_t timestamp(const unsigned& frame_ID = 0) const {
+    return reordered_.timestamp(frame_ID);
+  }
+  uint32_t crc20(const unsigned& frame_ID = 0) const {
+    return reordered_.crc20(frame_ID);
+  }
+  uint32_t flex12(const unsigned& frame_ID = 0) const {
+    return reordered_.flex12(frame_ID);
+  }
+  uint32_t flex24(const unsigned& frame_ID = 0) const {
+    return reordered_.flex24(frame_ID);
+  }
+
+  size_t total_frames() const {
+    return reordered_.total_frames();
+  }
+
+  // Functions to return a certain ADC value.
+  adc_t get_ADC(const unsigned& frame_ID, const uint8_t block_ID,
+                const uint8_t channel_ID) const {
+    return reordered_.get_ADC(frame_ID, block_ID, channel_ID);
+  }
+  adc_t get_ADC(const unsigned& frame_ID, const uint8_t channel_ID) const {
+    return reordered_.get_ADC(frame_ID, channel_ID);
+  }
+
+  // Function to return all ADC values for a single channel.
+  adc_v get_ADCs_by_channel(const uint8_t block_ID,
+                            const uint8_t channel_ID) const {
+    return reordered_.get_ADCs_by_channel(block_ID, channel_ID);
+  }
+  adc_v get_ADCs_by_channel(const uint8_t channel_ID) const {
+    return reordered_.get_ADCs_by_channel(channel_ID);
+  }
+  // Function to return all ADC values for all channels in a map.
+  std::map<uint8_t, adc_v> get_all_ADCs() const {
+    return reordered_.get_all_ADCs();
+  }
+  void get_all_ADCs(adc_t* dst, size_t stride = 0) const {
+    reordered_.get_all_ADCs(dst, stride);
+  }
+
+  size_t crc_errors(std::vector<uint64_t>& bad_frames,
+                    const frame14::Crc20& crc) const {
+    return reordered_.crc_errors(bad_frames, crc);
+  }
+
+  bool header_is_faulty(const unsigned frame_num) const {
+    return reordered_.header_is_faulty(frame_num);
+  }
+
+  // The fragment is decompressed into the reordered layout on construction,
+  // with the channels decoded on the pool if given.
+  Frame14FragmentCompressed(artdaq::Fragment const& fragment,
+                            ReorderThreadPool* pool = nullptr)
+      : Frame14Fragment(fragment),
+        uncompfrag_(decompress_(fragment, pool)),
+        reordered_(uncompfrag_) {}
+
+  // The reordered overlay points into uncompfrag_, so copies would dangle.
+  Frame14FragmentCompressed(const Frame14FragmentCompressed&) = delete;
+  Frame14FragmentCompressed& operator=(const Frame14FragmentCompressed&) = delete;
+
+ private:
+  artdaq::Fragment uncompfrag_;
+  Frame14FragmentReordered reordered_;
+
+  static artdaq::Fragment decompress_(const artdaq::Fragment& src,
+                                      ReorderThreadPool* pool) {
+    const Frame14Decompressor decompressor(
+        reinterpret_cast<char const*>(src.dataBeginBytes()),
+        src.dataSizeBytes());
+    Metadata meta = *src.metadata<Metadata>();
+    meta.num_frames = decompressor.num_frames();
+    meta.reordered = 1;
+    meta.compressed = 0;
+    artdaq::Fragment dst;
+    dst.setMetadata(meta);
+    dst.resizeBytes(decompressor.reordered_size());
+    decompressor.decompress(dst.dataBeginBytes(), pool);
+    return dst;
+  }
+}; // class dune::Frame14FragmentCompressed
+
+// Return the overlay matching the reordered and compressed flags of the
+// metadata. Compressed data always decompresses into the reordered layout.
+inline const Frame14Fragment* ParseFrame14Fragment(const artdaq::Fragment& fragment) {
+  const Frame14Fragment::Metadata *meta = fragment.metadata<Frame14Fragment::Metadata>();
+  if (meta->compressed) {
+    return new Frame14FragmentCompressed(fragment);
+  }
+  if (meta->reordered) {
+    return new Frame14FragmentReordered(fragment);
+  }
   return new Frame14FragmentUnordered(fragment);
 }
 
+// Reorder a fragment of raw frames. The result carries the metadata of the
+// input with the reordered flag set.
+inline std::unique_ptr<artdaq::Fragment> Frame14Reorder(
+    const artdaq::Fragment& fragment) {
+  Frame14Fragment::Metadata meta = *fragment.metadata<Frame14Fragment::Metadata>();
+  const frame14::ReorderedLayout layout(meta.num_frames);
+  meta.reordered = 1;
+  meta.compressed = 0;
+  std::unique_ptr<artdaq::Fragment> result(artdaq::Fragment::FragmentBytes(
+      layout.max_size(), fragment.sequenceID(), fragment.fragmentID(),
+      fragment.type(), meta));
+  result->setTimestamp(fragment.timestamp());
+  result->resizeBytes(frame14::reorder(
+      result->dataBeginBytes(),
+      reinterpret_cast<frame14::frame14 const*>(fragment.dataBeginBytes()),
+      meta.num_frames));
+  return result;
+}
+
+// Compress a fragment of raw or reordered frames. The result carries the
+// metadata of the input with both flags set.
+inline std::unique_ptr<artdaq::Fragment> Frame14Compress(
+    const artdaq::Fragment& fragment) {
+  Frame14Fragment::Metadata meta = *fragment.metadata<Frame14Fragment::Metadata>();
+  const std::vector<char> compressed =
+      meta.reordered
+          ? Frame14Compress(fragment.dataBeginBytes(), meta.num_frames)
+          : Frame14Compress(reinterpret_cast<frame14::frame14 const*>(
+                                fragment.dataBeginBytes()),
+                            meta.num_frames);
+  meta.reordered = 1;
+  meta.compressed = 1;
+  std::unique_ptr<artdaq::Fragment> result(artdaq::Fragment::FragmentBytes(
+      compressed.size(), fragment.sequenceID(), fragment.fragmentID(),
+      fragment.type(), meta));
+  result->setTimestamp(fragment.timestamp());
+  memcpy(result->dataBeginBytes(), compressed.data(), compressed.size());
+  return result;
+}
+
 }
 
 #endif /* artdaq_dune_Overlays_Frame14Fragment_hh */
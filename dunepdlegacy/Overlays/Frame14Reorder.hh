@@ -0,0 +1,209 @@
+// Frame14Reorder.hh
+// Reordered layout of Frame14 (WIB2) frames. Headers are grouped and only
+// kept where they differ from what follows from the first frame, and the
+// samples of every channel are stored contiguously as 16 bit values.
+
+#ifndef artdaq_dune_Overlays_Frame14Reorder_hh
+#define artdaq_dune_Overlays_Frame14Reorder_hh
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dunepdlegacy/Overlays/Frame14Format.hh"
+
+namespace dune {
+
+namespace frame14 {
+
+// Header words of a frame14: everything but the channel data and the word
+// holding crc20 and flex12, which changes from frame to frame.
+typedef struct {
+  uint32_t start_frame;
+  uint32_t crate_num : 8, frame_version : 4, slot_num : 3, fiber_num : 1;
+  uint32_t femb_valid : 2, link_mask : 8, reserved : 6;
+  uint32_t wib_data;
+  uint64_t timestamp;
+  uint32_t eof : 8, flex24 : 24;
+  uint32_t idle_frame;
+} __attribute__((packed, aligned(4))) header14;
+
+// The header words before the channel data, and the word holding the CRC.
+constexpr size_t head_bytes = offsetof(frame14, femb_a_seg);
+constexpr size_t crc_word_offset = head_bytes + 2 * 56 * sizeof(uint32_t);
+static_assert(sizeof(frame14) == crc_word_offset + 3 * sizeof(uint32_t),
+              "frame14 size changed");
+static_assert(sizeof(header14) == head_bytes + 2 * sizeof(uint32_t),
+              "header14 size changed");
+
+inline void get_header(const frame14 &frame, header14 &header) {
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(&frame);
+  uint8_t *dst = reinterpret_cast<uint8_t *>(&header);
+  memcpy(dst, src, head_bytes);
+  memcpy(dst + head_bytes, src + crc_word_offset + sizeof(uint32_t),
+         2 * sizeof(uint32_t));
+}
+
+inline void put_header(const header14 &header, frame14 &frame) {
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(&header);
+  uint8_t *dst = reinterpret_cast<uint8_t *>(&frame);
+  memcpy(dst, src, head_bytes);
+  memcpy(dst + crc_word_offset + sizeof(uint32_t), src + head_bytes,
+         2 * sizeof(uint32_t));
+}
+
+// The word holding crc20 in its low and flex12 in its high bits.
+inline uint32_t crc_word(const frame14 &frame) {
+  uint32_t word;
+  memcpy(&word, reinterpret_cast<const uint8_t *>(&frame) + crc_word_offset,
+         sizeof(word));
+  return word;
+}
+
+inline void set_crc_word(frame14 &frame, const uint32_t word) {
+  memcpy(reinterpret_cast<uint8_t *>(&frame) + crc_word_offset, &word,
+         sizeof(word));
+}
+
+// Whether the headers of frame i differ from those of the first frame with
+// the timestamp advanced by i steps.
+inline bool header_differs(const header14 &first, const header14 &header,
+                           const size_t i) {
+  header14 expected = first;
+  expected.timestamp += i * timestamp_step;
+  return memcmp(&expected, &header, sizeof(header14)) != 0;
+}
+
+//======================
+// Reordered data layout
+//======================
+// Reordered data of num_frames frames holds, at offsets that are multiples
+// of four bytes:
+//  - the 256 channels of num_frames 16 bit samples each,
+//  - the crc20/flex12 word of every frame,
+//  - one bit per frame, set for frames with faulty headers, from the least
+//    significant bit of the first word on,
+//  - the headers of the first frame followed by those of the faulty frames.
+class ReorderedLayout {
+ public:
+  explicit ReorderedLayout(const size_t num_frames) : num_frames_(num_frames) {}
+
+  size_t num_frames() const { return num_frames_; }
+  size_t adc_start() const { return 0; }
+  size_t crc_start() const {
+    return num_frames_ * num_frame_samples * sizeof(uint16_t);
+  }
+  size_t bitfield_start() const {
+    return crc_start() + num_frames_ * sizeof(uint32_t);
+  }
+  size_t bitfield_size() const { return (num_frames_ + 31) / 32 * 4; }
+  size_t header_start() const { return bitfield_start() + bitfield_size(); }
+
+  // Size of the data with num_faulty faulty headers.
+  size_t size(const size_t num_faulty) const {
+    return header_start() + (num_faulty + 1) * sizeof(header14);
+  }
+  size_t max_size() const { return size(num_frames_ ? num_frames_ - 1 : 0); }
+
+  // Number of faulty headers recorded in the bitfield of reordered data.
+  size_t num_faulty(const uint8_t *reordered) const {
+    size_t count = 0;
+    for (size_t w = 0; w < bitfield_size() / 4; ++w) {
+      uint32_t word;
+      memcpy(&word, reordered + bitfield_start() + 4 * w, sizeof(word));
+      count += __builtin_popcount(word);
+    }
+    return count;
+  }
+
+ private:
+  size_t num_frames_;
+};
+
+// Reorder num_frames frames from src into dst, which holds at least
+// ReorderedLayout(num_frames).max_size() bytes. Returns the size of the
+// reordered data.
+inline size_t reorder(uint8_t *dst, const frame14 *src,
+                      const size_t num_frames) {
+  const ReorderedLayout layout(num_frames);
+  unpack14_frames(src, num_frames,
+                  reinterpret_cast<uint16_t *>(dst + layout.adc_start()),
+                  num_frames);
+
+  uint32_t *crcs = reinterpret_cast<uint32_t *>(dst + layout.crc_start());
+  uint32_t *bits = reinterpret_cast<uint32_t *>(dst + layout.bitfield_start());
+  header14 *headers = reinterpret_cast<header14 *>(dst + layout.header_start());
+  memset(bits, 0, layout.bitfield_size());
+  if (num_frames == 0) {
+    memset(headers, 0, sizeof(header14));
+    return layout.size(0);
+  }
+
+  get_header(src[0], headers[0]);
+  size_t num_faulty = 0;
+  for (size_t i = 0; i < num_frames; ++i) {
+    crcs[i] = crc_word(src[i]);
+    if (i == 0) continue;
+    header14 header;
+    get_header(src[i], header);
+    if (header_differs(headers[0], header, i)) {
+      bits[i / 32] |= 1u << (i % 32);
+      headers[++num_faulty] = header;
+    }
+  }
+  return layout.size(num_faulty);
+}
+
+// Rebuild the count frames from first on of the num_frames frames of the
+// reordered data at src into dst.
+inline void unreorder(frame14 *dst, const uint8_t *src, const size_t num_frames,
+                      const size_t first, const size_t count) {
+  const ReorderedLayout layout(num_frames);
+  const uint16_t *adcs =
+      reinterpret_cast<const uint16_t *>(src + layout.adc_start());
+  const uint32_t *crcs =
+      reinterpret_cast<const uint32_t *>(src + layout.crc_start());
+  const uint32_t *bits =
+      reinterpret_cast<const uint32_t *>(src + layout.bitfield_start());
+  const header14 *headers =
+      reinterpret_cast<const header14 *>(src + layout.header_start());
+
+  // Faulty headers before the first frame.
+  size_t num_faulty = 0;
+  for (size_t w = 0; w < first / 32; ++w) {
+    num_faulty += __builtin_popcount(bits[w]);
+  }
+  if (first % 32) {
+    num_faulty += __builtin_popcount(bits[first / 32] & ((1u << (first % 32)) - 1));
+  }
+
+  uint16_t samples[num_frame_samples];
+  for (size_t i = first; i < first + count; ++i) {
+    frame14 &frame = dst[i - first];
+    if ((bits[i / 32] >> (i % 32)) & 1) {
+      put_header(headers[++num_faulty], frame);
+    } else {
+      header14 header = headers[0];
+      header.timestamp += i * timestamp_step;
+      put_header(header, frame);
+    }
+    set_crc_word(frame, crcs[i]);
+    for (size_t ch = 0; ch < num_frame_samples; ++ch) {
+      samples[ch] = adcs[ch * num_frames + i];
+    }
+    pack14_seg(samples, frame.femb_a_seg);
+    pack14_seg(samples + num_seg_samples, frame.femb_b_seg);
+  }
+}
+
+// Rebuild num_frames raw frames at dst from the reordered data at src.
+inline void unreorder(frame14 *dst, const uint8_t *src,
+                      const size_t num_frames) {
+  unreorder(dst, src, num_frames, 0, num_frames);
+}
+
+} // namespace frame14
+
+} // namespace dune
+
+#endif /* artdaq_dune_Overlays_Frame14Reorder_hh */
@@ -0,0 +1,113 @@
+#include "dunepdlegacy/Overlays/RceEventUnpack.hh"
+
+#include "dunepdlegacy/rce/dam/TpcStreamUnpack.hh"
+#include "dunepdlegacy/rce/dam/access/TpcCompressed.hh"
+#include "dunepdlegacy/rce/dam/util/ThreadPool.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    // Rows are padded to a cache line and streams start on a page
+    constexpr size_t row_align = 64 / sizeof(int16_t);
+    constexpr size_t page_bytes = 4096;
+}
+
+dune::RceEventUnpack::RceEventUnpack(unsigned num_threads)
+    : _parallel(num_threads > 1)
+{
+    // Resizing restarts the workers, so only when the size changes
+    using pdd::access::TpcCompressed;
+    if (_parallel && TpcCompressed::getNThreads() != int(num_threads))
+        TpcCompressed::setNThreads(num_threads);
+}
+
+dune::RceEventUnpack::~RceEventUnpack() = default;
+
+size_t dune::RceEventUnpack::unpack(RceFragments const& rces)
+{
+    std::vector<RceFragment const*> ptrs;
+    ptrs.reserve(rces.size());
+    for (auto const& rce: rces)
+        ptrs.push_back(&rce);
+    return unpack(ptrs);
+}
+
+size_t dune::RceEventUnpack::unpack(std::vector<RceFragment const*> const& rces)
+{
+    _streams.clear();
+    for (auto const* rce: rces)
+    {
+        for (int i = 0; i < rce->size(); ++i)
+        {
+            TpcStreamUnpack const* stream = rce->get_stream(i);
+            if (stream)
+                _streams.push_back({stream, 0, false});
+        }
+    }
+
+    // Finding the trimmed range walks the stream's table of contents, so
+    // it is done by the tasks too
+    _run(_streams.size(), [this](unsigned i) {
+        _streams[i].n_ticks = _streams[i].stream->getNTicks();
+    });
+
+    _n_ticks = 0;
+    for (auto const& s: _streams)
+        _n_ticks = std::max(_n_ticks, s.n_ticks);
+    _stride = (_n_ticks + row_align - 1) / row_align * row_align;
+
+    size_t size = _streams.size() * n_channels * _stride;
+    if (size > _capacity)
+    {
+        // Not touched here; each task writes its own stream first
+        void* p = nullptr;
+        if (posix_memalign(&p, page_bytes, size * sizeof(int16_t)) != 0)
+            throw std::bad_alloc();
+        _adcs.reset(static_cast<int16_t*>(p));
+        _capacity = size;
+    }
+
+    _run(_streams.size(), [this](unsigned i) { _unpack_stream(i); });
+
+    return std::count_if(_streams.begin(), _streams.end(),
+                         [](Stream const& s) { return s.ok; });
+}
+
+void dune::RceEventUnpack::_run(unsigned num_jobs,
+                                std::function<void(unsigned)> const& job)
+{
+    if (_parallel && num_jobs > 1)
+    {
+        pdd::access::TpcCompressed::getThreadPool().run(num_jobs, job);
+        return;
+    }
+    for (unsigned i = 0; i < num_jobs; ++i)
+        job(i);
+}
+
+void dune::RceEventUnpack::_unpack_stream(size_t istream)
+{
+    Stream& s = _streams[istream];
+    int16_t* dst = _adcs.get() + istream * n_channels * _stride;
+
+    int16_t* rows[n_channels];
+    for (size_t ichan = 0; ichan < n_channels; ++ichan)
+        rows[ichan] = dst + ichan * _stride;
+
+    s.ok = s.n_ticks > 0 && s.stream->getMultiChannelData(rows);
+    if (!s.ok)
+    {
+        memset(dst, 0, n_channels * _stride * sizeof(int16_t));
+        return;
+    }
+
+    size_t pad = _stride - s.n_ticks;
+    if (pad)
+    {
+        for (size_t ichan = 0; ichan < n_channels; ++ichan)
+            memset(rows[ichan] + s.n_ticks, 0, pad * sizeof(int16_t));
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef artdaq_dune_Overlays_RceEventUnpack_hh
+#define artdaq_dune_Overlays_RceEventUnpack_hh
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "dunepdlegacy/Overlays/RceFragment.hh"
+
+namespace dune
+{
+    class RceEventUnpack;
+}
+
+class TpcStreamUnpack;
+
+/*
+ * Unpacks the trimmed data of every TPC stream of one or more RCE fragments
+ * into one matrix [stream][128 channels][ticks], one task per stream on a
+ * persistent thread pool.
+ *
+ * Streams are numbered in fragment order and, within a fragment, in stream
+ * order. Each channel row holds stride() ticks. This is the longest stream
+ * rounded up to a cache line, so rows never share a line and streams start
+ * on a page. Ticks past the end of a shorter stream are zero.
+ *
+ * The matrix is kept between calls and only grows. When it is allocated
+ * each task writes its own stream first, so the pages land on the memory
+ * node of the thread that unpacked it.
+ *
+ * The pool is the process-wide one TpcCompressed decodes channels on. A
+ * compressed stream unpacked by a task finds it busy and decodes its
+ * channels serially, so no more threads run than the pool has.
+ */
+class dune::RceEventUnpack
+{
+    public:
+
+        static constexpr size_t n_channels = 128;
+
+        // num_threads counts the calling thread, which takes part in
+        // unpacking. More than one sets the shared pool to that many
+        // threads, as TpcCompressed::setNThreads does, which must not
+        // happen while anything is decoded on it; 1 unpacks the streams
+        // serially.
+        explicit RceEventUnpack(unsigned num_threads = 1);
+        ~RceEventUnpack();
+
+        // Unpack all streams, returns the number of streams unpacked
+        // without errors.
+        size_t unpack(RceFragments const& rces);
+        size_t unpack(std::vector<RceFragment const*> const& rces);
+
+        size_t n_streams() const { return _streams.size(); }
+        size_t n_ticks() const { return _n_ticks; }
+        size_t stride() const { return _stride; }
+
+        // The whole matrix and the first tick of one channel of one stream
+        int16_t const* data() const { return _adcs.get(); }
+        int16_t const* adcs(size_t istream, size_t ichannel = 0) const
+        {
+            return _adcs.get() + (istream * n_channels + ichannel) * _stride;
+        }
+
+        TpcStreamUnpack const* stream(size_t istream) const
+        {
+            return _streams[istream].stream;
+        }
+        size_t n_ticks(size_t istream) const { return _streams[istream].n_ticks; }
+        bool ok(size_t istream) const { return _streams[istream].ok; }
+
+    private:
+        struct Stream
+        {
+            TpcStreamUnpack const* stream;
+            size_t n_ticks;
+            bool ok;
+        };
+
+        struct Free
+        {
+            void operator()(int16_t* p) const { free(p); }
+        };
+
+        void _run(unsigned num_jobs, std::function<void(unsigned)> const& job);
+        void _unpack_stream(size_t istream);
+
+        bool _parallel;
+        std::vector<Stream> _streams;
+        std::unique_ptr<int16_t[], Free> _adcs;
+        size_t _capacity = 0;
+        size_t _n_ticks = 0;
+        size_t _stride = 0;
+};
+#endif
@@ -59,6 +59,9 @@
 /* ---------------------------------------------------------------------- */
 
 namespace pdd    {
+
+   class    ThreadPool;
+
 namespace record {
 
    class    TpcCompressedHdrHeader;
@@ -346,6 +349,23 @@ public:
                         int            nticks);
 
 
+   // ----------------------------------------------------------
+   // The channels are decoded on one process-wide thread pool.
+   // Callers that decompress several records at once, such as
+   // dune::RceEventUnpack, run them on the same pool, so that the
+   // records and their channels never take more threads than it
+   // has. A decompress that finds the pool busy, including one
+   // run by a job of the pool, decodes serially on its own thread.
+   //
+   // The number of threads includes the caller's. The default, 1,
+   // decodes serially.
+   // ----------------------------------------------------------
+   static pdd::ThreadPool &getThreadPool ();
+   static int              getNThreads   ();
+   static void             setNThreads   (int nthreads);
+   // ----------------------------------------------------------
+
+
 
 private:
    pdd::record::TpcCompressedHdr        const    *m_hdr;
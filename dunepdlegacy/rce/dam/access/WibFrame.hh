@@ -303,6 +303,22 @@ public:
                                      int            ndstStride,
                                      WibFrame  const   *frames,
                                      int               nframes);
+   // ----------------------------------------------------------
+
+
+   // ----------------------------------------------------------
+   // Implementation of the expanders and transposers. The best
+   // one the CPU supports is selected when the library is loaded
+   //------------------------------------------------------------
+   enum class Simd { Generic, Avx2, Avx512 };
+
+   static Simd        getSimd     ();
+   static Simd        getCpuSimd  ();
+   static bool        setSimd     (Simd simd);
+   static bool        isSupported (Simd simd);
+   static char const *getName     (Simd simd);
+   // ----------------------------------------------------------
+
 public:
 #if 0
    uint64_t               m_header; /*!< W16  0 -  3, the WIB header word */
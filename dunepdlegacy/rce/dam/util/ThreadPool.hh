@@ -0,0 +1,278 @@
+// -*-Mode: C++;-*-
+
+#ifndef PDD_THREADPOOL_HH
+#define PDD_THREADPOOL_HH
+
+/* ---------------------------------------------------------------------- *//*!
+ *
+ *  @file     ThreadPool.hh
+ *  @brief    Persistent worker threads that run a number of jobs
+ *            together with the calling thread
+ *
+ *  @par Facility:
+ *  pdd
+ *
+ *  @par
+ *  This pool is shared by the channel decoding of TpcCompressed and the
+ *  FELIX and RCE code in Overlays.
+ *
+\* ---------------------------------------------------------------------- */
+
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pdd
+{
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \class ThreadPool
+  \brief Persistent worker threads that run job(0) to job(n - 1) together
+         with the calling thread.
+
+  \par
+   Only one caller uses the workers at a time.  Callers on other threads,
+   and jobs calling run() on the pool they run on, find the workers busy
+   and run their jobs serially on their own thread.  Nested use therefore
+   never waits, but only the outermost run() is spread over the workers.
+
+  \par
+   If jobs throw, no further jobs are started and the first exception is
+   rethrown by run() once the jobs already running have finished.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+class ThreadPool
+{
+public:
+   typedef std::function<void (unsigned int)> Job;
+
+   explicit ThreadPool (unsigned int nworkers = 0) { start (nworkers); }
+   ThreadPool (ThreadPool const &)            = delete;
+   ThreadPool &operator= (ThreadPool const &) = delete;
+  ~ThreadPool () { stop (); }
+
+   /* Number of threads running the jobs, including the calling thread */
+   unsigned int num_threads () const { return m_workers.size () + 1; }
+
+   void resize (unsigned int nworkers);
+   void run    (unsigned int njobs, Job const &job);
+
+private:
+   class RunGuard;
+
+   void start   (unsigned int nworkers);
+   void stop    ();
+   void work    ();
+   void runJobs (Job const &job, unsigned int njobs);
+
+private:
+   std::vector<std::thread>            m_workers;
+   std::mutex                            m_owner; /*!< Held by the user    */
+   std::atomic<std::thread::id>       m_ownerId{}; /*!< Thread holding it   */
+   std::mutex                            m_mutex; /*!< Guards the below    */
+   std::condition_variable               m_start; /*!< New jobs or stop    */
+   std::condition_variable                m_done; /*!< Workers finished    */
+   Job const                      *m_job = nullptr;
+   unsigned int                      m_njobs = 0;
+   std::atomic<unsigned int>          m_next{0}; /*!< Next job to run      */
+   unsigned int                       m_busy = 0; /*!< Threads running jobs */
+   unsigned long                m_generation = 0; /*!< Counts the runs      */
+   std::exception_ptr                    m_error; /*!< First job exception  */
+   bool                             m_stop = false;
+};
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Releases the workers from the current run when the calling
+         thread leaves it, however it does
+                                                                          */
+/* ---------------------------------------------------------------------- */
+class ThreadPool::RunGuard
+{
+public:
+   explicit RunGuard (ThreadPool &pool) : m_pool (pool) {}
+
+  ~RunGuard ()
+   {
+      std::unique_lock<std::mutex> lock (m_pool.m_mutex);
+      if (--m_pool.m_busy == 0) m_pool.m_done.notify_all ();
+      m_pool.m_done.wait (lock, [this] { return m_pool.m_busy == 0; });
+      m_pool.m_job     = nullptr;
+      m_pool.m_njobs   = 0;
+      m_pool.m_ownerId = std::thread::id ();
+   }
+
+private:
+   ThreadPool &m_pool;
+};
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Stop the current workers and start \a nworkers new ones
+
+  \param[in] nworkers  The number of worker threads
+
+  \warning
+   This waits for the current user of the workers and must not be called
+   by a job of this pool.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+inline void ThreadPool::resize (unsigned int nworkers)
+{
+   std::lock_guard<std::mutex> owner (m_owner);
+   stop  ();
+   start (nworkers);
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Run job(0) to job(njobs - 1) and return once all have finished
+
+  \param[in] njobs  The number of jobs
+  \param[in]   job  The job
+                                                                          */
+/* ---------------------------------------------------------------------- */
+inline void ThreadPool::run (unsigned int njobs, Job const &job)
+{
+   // A thread must not try_lock a mutex it already holds
+   std::unique_lock<std::mutex> owner;
+   if (m_ownerId != std::this_thread::get_id ())
+   {
+      owner = std::unique_lock<std::mutex> (m_owner, std::try_to_lock);
+   }
+
+   if (!owner || m_workers.empty ())
+   {
+      for (unsigned int idx = 0; idx < njobs; idx++) job (idx);
+      return;
+   }
+
+   {
+      std::unique_lock<std::mutex> lock (m_mutex);
+      m_done.wait (lock, [this] { return m_busy == 0; });
+      m_job   = &job;
+      m_njobs = njobs;
+      m_next  = 0;
+      m_error = nullptr;
+      m_generation++;
+      m_busy++;
+   }
+   m_ownerId = std::this_thread::get_id ();
+
+   {
+      RunGuard guard (*this);
+      m_start.notify_all ();
+      runJobs (job, njobs);
+   }
+
+   std::exception_ptr error;
+   std::swap (error, m_error);
+   if (error) std::rethrow_exception (error);
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+inline void ThreadPool::start (unsigned int nworkers)
+{
+   m_stop = false;
+   for (unsigned int idx = 0; idx < nworkers; idx++)
+   {
+      m_workers.emplace_back ([this] { work (); });
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+inline void ThreadPool::stop ()
+{
+   {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_stop = true;
+   }
+   m_start.notify_all ();
+   for (auto &worker : m_workers) worker.join ();
+   m_workers.clear ();
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+inline void ThreadPool::runJobs (Job const &job, unsigned int njobs)
+{
+   try
+   {
+      for (unsigned int idx = m_next++; idx < njobs; idx = m_next++)
+      {
+         job (idx);
+      }
+   }
+   catch (...)
+   {
+      m_next = njobs;
+      std::lock_guard<std::mutex> lock (m_mutex);
+      if (!m_error) m_error = std::current_exception ();
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+inline void ThreadPool::work ()
+{
+   // Workers join runs started after them
+   std::unique_lock<std::mutex> lock (m_mutex);
+   unsigned long generation = m_generation;
+   while (true)
+   {
+      m_start.wait (lock, [&] {
+         return m_stop || (m_job && m_generation != generation); });
+      if (m_stop) return;
+
+      generation                = m_generation;
+      Job const           &job = *m_job;
+      unsigned int        njobs = m_njobs;
+      m_busy++;
+
+      lock.unlock ();
+      runJobs (job, njobs);
+      lock.lock   ();
+
+      if (--m_busy == 0) m_done.notify_all ();
+   }
+}
+/* ---------------------------------------------------------------------- */
+
+}  /* Namespace:: pdd                                                     */
+
+#endif
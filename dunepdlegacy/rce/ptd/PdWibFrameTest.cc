@@ -238,78 +238,100 @@ int main (int /* argc */, char **const /* argv */)
 
 
    // ----------------------------------------------------------------------
-   // Integrity checks: contigious memory
-   // -----------------------------------
-   test = TestPatternSuite;
-   for (int itestPattern = 0; itestPattern < ntestPatterns; ++itestPattern, ++test)
+   // Integrity checks are done for every implementation the CPU supports
+   // -------------------------------------------------------------------
+   WibFrame::Simd const Simds[] = { WibFrame::Simd::Generic,
+                                    WibFrame::Simd::Avx2,
+                                    WibFrame::Simd::Avx512 };
+   for (WibFrame::Simd simd : Simds)
    {
+      if (!WibFrame::setSimd (simd)) continue;
+      printf ("\nImplementation: %s\n", WibFrame::getName (simd));
 
-      printf ("\nIntegrity check contiguous: using pattern = %s\n", test->name);
-      (*test->create) (patterns, npatterns);
 
-      for (int itrial = 0; itrial < ntrials; ++itrial)
+      // ----------------------------------------------------------------------
+      // Integrity checks: contigious memory
+      // -----------------------------------
+      test = TestPatternSuite;
+      for (int itestPattern = 0; itestPattern < ntestPatterns; ++itestPattern, ++test)
       {
-         fill (frames    + itrial * nframes_per_trial, 
-               nframes_per_trial, 
-               patterns  + itrial * npatterns_per_trial);
-      }
 
-      test_integrity   (dstBuf, frames,   nframes_per_trial, ntrials, 
-                        patterns, npatterns_per_trial, npatterns);
-   }
-   // ----------------------------------------------------------------------
+         printf ("\nIntegrity check contiguous: using pattern = %s\n", test->name);
+         (*test->create) (patterns, npatterns);
+
+         for (int itrial = 0; itrial < ntrials; ++itrial)
+         {
+            fill (frames    + itrial * nframes_per_trial, 
+                  nframes_per_trial, 
+                  patterns  + itrial * npatterns_per_trial);
+         }
 
+         test_integrity   (dstBuf, frames,   nframes_per_trial, ntrials, 
+                           patterns, npatterns_per_trial, npatterns);
+      }
+      // ----------------------------------------------------------------------
 
 
 
-   // ----------------------------------------------------------------------
-   // Integrity check: channel-by-channel memory
-   // ------------------------------------------ 
-   test = TestPatternSuite;
-   for (int itestPattern = 0; itestPattern < ntestPatterns; ++itestPattern, ++test)
-   {
-      printf ("\nIntegrity check channel-by-channel: using pattern = %s\n", 
-              test->name);
-      (*test->create) (patterns, npatterns);
 
-      for (int itrial = 0; itrial < ntrials; ++itrial)
+      // ----------------------------------------------------------------------
+      // Integrity check: channel-by-channel memory
+      // ------------------------------------------ 
+      test = TestPatternSuite;
+      for (int itestPattern = 0; itestPattern < ntestPatterns; ++itestPattern, ++test)
       {
-         fill (frames    + itrial * nframes_per_trial, 
-               nframes_per_trial, 
-               patterns  + itrial * npatterns_per_trial);
-      }
+         printf ("\nIntegrity check channel-by-channel: using pattern = %s\n", 
+                 test->name);
+         (*test->create) (patterns, npatterns);
 
-      test_integrityPtrArray  (dstPtrs,  frames,   nframes_per_trial, ntrials, 
-                               patterns, npatterns_per_trial, npatterns);
-   }
-   // ----------------------------------------------------------------------
+         for (int itrial = 0; itrial < ntrials; ++itrial)
+         {
+            fill (frames    + itrial * nframes_per_trial, 
+                  nframes_per_trial, 
+                  patterns  + itrial * npatterns_per_trial);
+         }
 
+         test_integrityPtrArray  (dstPtrs,  frames,   nframes_per_trial, ntrials, 
+                                  patterns, npatterns_per_trial, npatterns);
+      }
+      // ----------------------------------------------------------------------
 
 
-   // ----------------------------------------------------------------------
-   // Integrity check: vector memory
-   // ------------------------------
-   test = TestPatternSuite;
-   for (int itestPattern = 0; itestPattern < ntestPatterns; ++itestPattern, ++test)
-   {
-      printf ("\nIntegrity check vector: using pattern = %s\n", 
-              test->name);
-      (*test->create) (patterns, npatterns);
 
-      for (int itrial = 0; itrial < ntrials; ++itrial)
+      // ----------------------------------------------------------------------
+      // Integrity check: vector memory
+      // ------------------------------
+      test = TestPatternSuite;
+      for (int itestPattern = 0; itestPattern < ntestPatterns; ++itestPattern, ++test)
       {
-         fill (frames    + itrial * nframes_per_trial, 
-               nframes_per_trial, 
-               patterns  + itrial * npatterns_per_trial);
-      }
+         printf ("\nIntegrity check vector: using pattern = %s\n", 
+                 test->name);
+         (*test->create) (patterns, npatterns);
+
+         for (int itrial = 0; itrial < ntrials; ++itrial)
+         {
+            fill (frames    + itrial * nframes_per_trial, 
+                  nframes_per_trial, 
+                  patterns  + itrial * npatterns_per_trial);
+         }
 
-      test_integrityVector  (&dstVecs, frames,   nframes_per_trial, ntrials, 
-                             patterns, npatterns_per_trial, npatterns);
+         test_integrityVector  (&dstVecs, frames,   nframes_per_trial, ntrials, 
+                                patterns, npatterns_per_trial, npatterns);
+      }
+      // ----------------------------------------------------------------------
    }
    // ----------------------------------------------------------------------
 
 
 
+   // ----------------------------------------------------------------------
+   // Performance checks use the implementation selected for the CPU
+   // ----------------------------------------------------------------
+   WibFrame::setSimd (WibFrame::getCpuSimd ());
+   printf ("\nImplementation: %s\n", WibFrame::getName (WibFrame::getSimd ()));
+
+
+
    // ----------------------------------------------------------------------
    // Performanace checks
    // -------------------
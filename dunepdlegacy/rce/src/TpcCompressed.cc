@@ -48,6 +48,7 @@
 
 #include "TpcCompressed-Impl.hh"
 #include "BFU.h"
+#include "dunepdlegacy/rce/dam/util/ThreadPool.hh"
 #include  <cstdio>
 #include  <iostream>
 #include  <iomanip>
@@ -136,6 +137,64 @@ static inline void announce (int ichan, int next, int position)
 /* ---------------------------------------------------------------------- */
 
 
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief  Return the process-wide pool the channels are decoded on
+  \return The pool
+
+  \par
+   Only one caller uses the workers at a time.  The others, such as
+   jobs of the pool decompressing records of their own, find them busy
+   and decode serially.  Each channel is decoded into its own
+   destination, so the output does not depend on which thread decoded
+   it.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+pdd::ThreadPool &TpcCompressed::getThreadPool ()
+{
+   static pdd::ThreadPool Pool;
+   return Pool;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief  Return the number of threads the channels are decoded on
+  \return The number of threads, including the calling thread
+                                                                          */
+/* ---------------------------------------------------------------------- */
+int TpcCompressed::getNThreads ()
+{
+   return getThreadPool ().num_threads ();
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Set the number of threads the channels are decoded on
+
+  \param[in] nthreads  The number of threads, including the calling
+                       thread.  Values less than 1 are taken as 1,
+                       \e i.e. serial decoding.
+
+  \warning
+   This restarts the worker threads and must not be called while any
+   TpcCompressed record is being decompressed.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+void TpcCompressed::setNThreads (int nthreads)
+{
+   getThreadPool ().resize (nthreads > 1 ? nthreads - 1 : 0);
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
 /* ---------------------------------------------------------------------- *//*!
 
   \brief Constructs the accessor for a TpcCompressed Data record
@@ -245,6 +304,16 @@ static int16_t    restore (uint16_t       sym);
 static void print_decoded (uint16_t       sym, 
                            int            idy);
 
+template<class Locate>
+static void chans_decode (Locate const         &locate,
+                          uint64_t const          *buf,
+                          int                     nbuf,
+                          uint32_t const      *offsets,
+                          int                nchannels,
+                          int                  begTick,
+                          int                  endTick,
+                          int                 nsamples);
+
 
 ///static int    Value = 0;
 ///static int BegValue = 0;
@@ -272,20 +341,10 @@ uint32_t TpcCompressed::decompress (int16_t       *adcs,
    uint32_t const *offsets = TpcCompressedTocTrailer::getOffsets   (m_tocTlr);
    unsigned int        n64 = m_n64;
    uint64_t const     *buf = reinterpret_cast<decltype(buf)>(m_hdr);
-   uint32_t           next = (m_w64 - buf) * 64;
    int             endTick = nticks;
-   bool            printit = false;
-
-   for (int ichan = 0; ichan < nchannels; ichan++)
-   {
-      uint32_t position = offsets[ichan]; 
-
-      ///Value = BegValue;
-      if (printit) announce (ichan, next, position);
 
-      next  = chan_decode (adcs, buf, n64, position, 0, endTick, nsamples, printit);
-      adcs += nadcs;
-   }
+   chans_decode ([=] (int ichan) { return adcs + ichan * nadcs; },
+                 buf, n64, offsets, nchannels, 0, endTick, nsamples);
 
    ///BegValue = Value;
    int over     = nsamples - nticks;
@@ -320,20 +379,10 @@ uint32_t TpcCompressed::decompress (int16_t       *adcs,
    uint32_t const *offsets = TpcCompressedTocTrailer::getOffsets   (m_tocTlr);
    unsigned int        n64 = m_n64;
    uint64_t const     *buf = reinterpret_cast<decltype(buf)>(m_hdr);
-   uint32_t           next = (m_w64 - buf) * 64;
    int             endTick = begTick + nticks;
-   bool            printit = false;
-
-   for (int ichan = 0; ichan < nchannels; ichan++)
-   {
-      uint32_t position = offsets[ichan]; 
-
-      if (printit) announce (ichan, next, position);
 
-      ///Value = BegValue;
-      next  = chan_decode (adcs, buf, n64, position, begTick, endTick, nsamples, printit);
-      adcs += nadcs;
-   }
+   chans_decode ([=] (int ichan) { return adcs + ichan * nadcs; },
+                 buf, n64, offsets, nchannels, begTick, endTick, nsamples);
 
    ///BegValue = Value;
    nsamples    -= begTick;
@@ -368,20 +417,10 @@ uint32_t TpcCompressed::decompress (int16_t  *const *adcs,
    uint32_t const *offsets = TpcCompressedTocTrailer::getOffsets   (m_tocTlr);
    unsigned int        n64 = m_n64;
    uint64_t const     *buf = reinterpret_cast<decltype(buf)>(m_hdr);
-   uint32_t           next = (m_w64 - buf) * 64;
    int             endTick = nticks;
-   bool            printit = false;
-
-   for (int ichan = 0; ichan < nchannels; ichan++)
-   {
-      uint32_t position = offsets[ichan]; 
-
-      ///Value = BegValue;
-      if (printit) announce (ichan, next, position);
 
-      next  = chan_decode (adcs[ichan]+iadc, buf, n64, position, 
-                           0,       endTick, nsamples, printit);
-   }
+   chans_decode ([=] (int ichan) { return adcs[ichan] + iadc; },
+                 buf, n64, offsets, nchannels, 0, endTick, nsamples);
 
    ///BegValue = Value;
    int over     = nsamples - nticks;
@@ -415,20 +454,10 @@ uint32_t TpcCompressed::decompress (int16_t  *const *adcs,
    uint32_t const *offsets = TpcCompressedTocTrailer::getOffsets   (m_tocTlr);
    unsigned int        n64 = m_n64;
    uint64_t const     *buf = reinterpret_cast<decltype(buf)>(m_hdr);
-   uint32_t           next = (m_w64 - buf) * 64;
    int             endTick = begTick + nticks;
-   bool            printit = false;
-
-   for (int ichan = 0; ichan < nchannels; ichan++)
-   {
-      uint32_t position = offsets[ichan]; 
-
-      if (printit) announce (ichan, next, position);
 
-      ///Value = BegValue;
-      next  = chan_decode (adcs[ichan] + iadc, buf, n64, position, 
-                           begTick,   endTick, nsamples, printit);
-   }
+   chans_decode ([=] (int ichan) { return adcs[ichan] + iadc; },
+                 buf, n64, offsets, nchannels, begTick, endTick, nsamples);
 
    ///BegValue = Value;
    nsamples    -= begTick;
@@ -470,6 +499,47 @@ static int chan_decode (int16_t       *adcs,
 
 
 
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Decode all channels, one job per channel on the decoding pool
+
+  \par
+   This is the only decoding loop of the decompress methods.  The pool
+   runs the jobs serially on the calling thread when it has no workers or
+   they are busy.
+
+  \param[in]    locate  Returns the destination of a channel's first ADC
+  \param[in]       buf  The start of the TpcCompressed record
+  \param[in]      nbuf  The length of the record in 64-bit words
+  \param[in]   offsets  The bit offset of each channel in \a buf
+  \param[in] nchannels  The number of channels
+  \param[in]   begTick  The index of the first decoded ADC to store
+  \param[in]   endTick  The index past the last decoded ADC to store
+  \param[in]  nsamples  The number of ADCs encoded for each channel
+                                                                          */
+/* ---------------------------------------------------------------------- */
+template<class Locate>
+static void chans_decode (Locate const         &locate,
+                          uint64_t const          *buf,
+                          int                     nbuf,
+                          uint32_t const      *offsets,
+                          int                nchannels,
+                          int                  begTick,
+                          int                  endTick,
+                          int                 nsamples)
+{
+   TpcCompressed::getThreadPool ().run (nchannels, [&] (unsigned int ichan)
+   {
+      chan_decode (locate (ichan), buf, nbuf, offsets[ichan],
+                   begTick, endTick, nsamples, false);
+   });
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
 /* ---------------------------------------------------------------------- */
 static inline int table_decode (uint16_t     *table,
                                 int         *nrbins,
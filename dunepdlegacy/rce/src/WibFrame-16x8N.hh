@@ -0,0 +1,130 @@
+// -*-Mode: C++;-*-
+
+
+/* ---------------------------------------------------------------------- *//*!
+ *
+ *  @file     WibFrame-16x8N.hh
+ *  @brief    WibFrame 16x16 and 16x32 transposers built from the 16x8
+ *            transposer of an implementation
+ *
+ *  @par Facility:
+ *  DUNE
+ *
+ * @par
+ * This file has no include guard. It is included into each
+ * implementation namespace without its own 16x16 and 16x32 kernels,
+ * see WibFrame.cc, after the header defining transposeAdcs16x8_kernel.
+ *
+\* ---------------------------------------------------------------------- */
+
+
+
+/* ====================================================================== */
+/* BEGIN: CONTIGIOUS TRANSPOSITION                                        */
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief  Transpose 8N time samples for 16 channels
+
+  \param[out]   dst The destination array
+  \param[ in]    n8 The number of groups of 8 channels, \e i.e. the N in
+                    transpose16x8N
+  \param[in] offset The number of elements in on channel's destination
+                    array.
+  \param[in]    src The source array
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x8N_kernel (int16_t        *dst,
+                                              int              n8,
+                                              int          stride,
+                                              uint64_t const *src)
+{
+   for (int idx = 0; idx < n8; ++idx)
+   {
+      transposeAdcs16x8_kernel (dst, stride, src + idx * 8 * sizeof (WibFrame) / sizeof (*src));
+      dst += 8;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x16_kernel (int16_t        *dst,
+                                              int          stride,
+                                              uint64_t const *src)
+{
+   transposeAdcs16x8N_kernel (dst, 2, stride, src);
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x32_kernel (int16_t        *dst,
+                                              int          stride,
+                                              uint64_t const *src)
+{
+   transposeAdcs16x8N_kernel (dst, 4, stride, src);
+}
+/* ---------------------------------------------------------------------- */
+/* END: CONTIGIOUS TRANSPOSITION                                          */
+/* ====================================================================== */
+
+
+
+
+
+/* ====================================================================== */
+/* BEGIN: CHANNEL-BY-CHANNEL TRANSPOSITION                                */
+/* ---------------------------------------------------------------------- *//*!
+  \brief  Transpose 8N time samples for 16 channels
+
+  \param[out]   dst Pointers to 16 arrays to receive the transposed data
+  \param[ in]    n8 The number of groups of 8 channels, \e i.e. the N in
+                    transpose16x8N
+  \param[in] offset The number of elements in on channel's destination
+                    array.
+  \param[in]    src The source array
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x8N_kernel (int16_t  *const *dst,
+                                              int               n8,
+                                              int           offset,
+                                              uint64_t const  *src)
+{
+   for (int idx = 0; idx < n8; ++idx)
+   {
+      transposeAdcs16x8_kernel (dst, offset, src);
+      src    += 8 * sizeof (WibFrame) / sizeof (*src);
+      offset += 8;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x16_kernel (int16_t *const  *dst,
+                                              int           offset,
+                                              uint64_t const  *src)
+{
+   transposeAdcs16x8N_kernel (dst, 2, offset, src);
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x32_kernel (int16_t *const  *dst,
+                                              int           offset,
+                                              uint64_t const  *src)
+{
+   transposeAdcs16x8N_kernel (dst, 4, offset, src);
+}
+/* ---------------------------------------------------------------------- */
+/* END: CHANNEL-BY-CHANNEL TRANSPOSITION                                  */
+/* ====================================================================== */
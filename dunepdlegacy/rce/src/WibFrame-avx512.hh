@@ -0,0 +1,278 @@
+// -*-Mode: C++;-*-
+
+
+/* ---------------------------------------------------------------------- *//*!
+ *
+ *  @file     WibFrame-avx512.hh
+ *  @brief    WibFrame ADC expansion and unpacking - AVX-512 version
+ *
+ *  @par Facility:
+ *  DUNE
+ *
+ * @par
+ * This file has no include guard. It is included into the AVX-512
+ * implementation namespace, see WibFrame.cc, after the AVX2 kernels
+ * were included into the nested namespace avx2, and must be compiled
+ * with the AVX-512F and AVX-512BW instruction sets enabled.
+ *
+ * @par
+ * The zmm registers hold two of the ymm registers of the AVX2 version,
+ * so the expansion handles 32 channels at once and the 16x16 and 16x32
+ * transposes take half the instructions of two or four 16x8 transposes.
+ * The 16x8 transposes are those of the AVX2 version.
+ *
+\* ---------------------------------------------------------------------- */
+
+
+
+using avx2::expandAdcs16_init_kernel;
+using avx2::transposeAdcs16x8_kernel;
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Expand two groups of 16 densely packed 12-bit values into 32
+         16-bit values.
+  \return The 16 adcs of s0 in the low and those of s1 in the high 256
+          bits
+
+  \param[in] s0  The 24 bytes holding the first group of packed adcs
+  \param[in] s1  The 24 bytes holding the second group of packed adcs
+
+  \par
+   See expandAdcs16_kernel of the AVX2 version for the bit twiddling.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+WIBFRAME_AVX512_UNDEFINED_BEGIN
+static inline __m512i expandAdcs16x2_kernel (uint8_t const *s0,
+                                             uint8_t const *s1)
+{
+   __m512i const Shuffle = _mm512_broadcast_i64x4 (_mm256_setr_epi8 (
+      0x0, 0x2, 0x1, 0x3, 0x2, 0x4, 0x3, 0x5,
+      0x6, 0x8, 0x7, 0x9, 0x8, 0xa, 0x9, 0xb,
+      0x4, 0x6, 0x5, 0x7, 0x6, 0x8, 0x7, 0x9,
+      0xa, 0xc, 0xb, 0xd, 0xc, 0xe, 0xd, 0xf));
+
+   __m512i w = _mm512_castsi128_si512 (
+                  _mm_loadu_si128 (reinterpret_cast<__m128i const *>(s0)));
+   w = _mm512_inserti32x4 (w,
+                  _mm_loadu_si128 (reinterpret_cast<__m128i const *>(s0 + 8)), 1);
+   w = _mm512_inserti32x4 (w,
+                  _mm_loadu_si128 (reinterpret_cast<__m128i const *>(s1)),     2);
+   w = _mm512_inserti32x4 (w,
+                  _mm_loadu_si128 (reinterpret_cast<__m128i const *>(s1 + 8)), 3);
+   w = _mm512_shuffle_epi8 (w, Shuffle);
+
+   return _mm512_mask_blend_epi32 (0x5555,
+                                   _mm512_srli_epi16 (w, 4),
+                                   _mm512_and_si512  (w, _mm512_set1_epi16 (0xfff)));
+}
+WIBFRAME_AVX512_UNDEFINED_END
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief The kernel to unpack 64 densely packet 12-bit values into
+         64 16-bit values.
+
+  \param[in] dst  The destination address
+  \param[in] src  The source address
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static inline void expandAdcs64x1_kernel (int16_t        *dst,
+                                          uint64_t const *src)
+{
+   uint8_t const *s8 = reinterpret_cast<uint8_t const *>(src);
+
+   _mm512_storeu_si512 (dst +  0, expandAdcs16x2_kernel (s8 +  0, s8 + 24));
+   _mm512_storeu_si512 (dst + 32, expandAdcs16x2_kernel (s8 + 48, s8 + 72));
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Expand 16 channels for 16 successive frames and transpose them.
+
+  \param[out]   c  The transposed adcs. The 128-bit lanes of c[k] hold
+                   the time samples 0-7 of channels k and k + 8 followed
+                   by the time samples 8-15 of channels k and k + 8.
+  \param[in]  src  The packed adcs of the first frame
+
+  \par
+   Register t is loaded with frame t in its low and frame t + 8 in its
+   high 256 bits, after which the unpack sequence of the AVX2 version
+   transposes all four lanes at once.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+WIBFRAME_AVX512_UNDEFINED_BEGIN
+static inline void transposeAdcs16x16 (__m512i c[8], uint64_t const *src)
+{
+   uint8_t const *s8 = reinterpret_cast<uint8_t const *>(src);
+   __m512i r[8];
+   for (int t = 0; t < 8; ++t)
+   {
+      r[t] = expandAdcs16x2_kernel (s8 + (t + 0) * sizeof (WibFrame),
+                                    s8 + (t + 8) * sizeof (WibFrame));
+   }
+
+   // 16 -> 32 bit ordering
+   __m512i a0 = _mm512_unpacklo_epi16 (r[0], r[1]);
+   __m512i a1 = _mm512_unpackhi_epi16 (r[0], r[1]);
+   __m512i a2 = _mm512_unpacklo_epi16 (r[2], r[3]);
+   __m512i a3 = _mm512_unpackhi_epi16 (r[2], r[3]);
+   __m512i a4 = _mm512_unpacklo_epi16 (r[4], r[5]);
+   __m512i a5 = _mm512_unpackhi_epi16 (r[4], r[5]);
+   __m512i a6 = _mm512_unpacklo_epi16 (r[6], r[7]);
+   __m512i a7 = _mm512_unpackhi_epi16 (r[6], r[7]);
+
+   // 32 -> 64 bit ordering
+   __m512i b0 = _mm512_unpacklo_epi32 (a0, a2);
+   __m512i b1 = _mm512_unpackhi_epi32 (a0, a2);
+   __m512i b2 = _mm512_unpacklo_epi32 (a1, a3);
+   __m512i b3 = _mm512_unpackhi_epi32 (a1, a3);
+   __m512i b4 = _mm512_unpacklo_epi32 (a4, a6);
+   __m512i b5 = _mm512_unpackhi_epi32 (a4, a6);
+   __m512i b6 = _mm512_unpacklo_epi32 (a5, a7);
+   __m512i b7 = _mm512_unpackhi_epi32 (a5, a7);
+
+   // 64 -> 128 bit ordering
+   c[0] = _mm512_unpacklo_epi64 (b0, b4);
+   c[1] = _mm512_unpackhi_epi64 (b0, b4);
+   c[2] = _mm512_unpacklo_epi64 (b1, b5);
+   c[3] = _mm512_unpackhi_epi64 (b1, b5);
+   c[4] = _mm512_unpacklo_epi64 (b2, b6);
+   c[5] = _mm512_unpackhi_epi64 (b2, b6);
+   c[6] = _mm512_unpacklo_epi64 (b3, b7);
+   c[7] = _mm512_unpackhi_epi64 (b3, b7);
+
+   return;
+}
+WIBFRAME_AVX512_UNDEFINED_END
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+WIBFRAME_AVX512_UNDEFINED_BEGIN
+static inline void transposeAdcs16x16_kernel (int16_t          *dst,
+                                              int            stride,
+                                              uint64_t const *src64)
+{
+   __m512i c[8];
+   transposeAdcs16x16 (c, src64);
+
+   // Gather the lanes of each channel: k in the low, k + 8 in the high half
+   for (int k = 0; k < 8; ++k)
+   {
+      c[k] = _mm512_shuffle_i64x2 (c[k], c[k], _MM_SHUFFLE (3, 1, 2, 0));
+      _mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst + (k + 0) * stride),
+                           _mm512_castsi512_si256 (c[k]));
+      _mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst + (k + 8) * stride),
+                           _mm512_extracti64x4_epi64 (c[k], 1));
+   }
+
+   return;
+}
+WIBFRAME_AVX512_UNDEFINED_END
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+WIBFRAME_AVX512_UNDEFINED_BEGIN
+static inline void transposeAdcs16x16_kernel (int16_t  *const  *dst,
+                                              int            offset,
+                                              uint64_t const *src64)
+{
+   __m512i c[8];
+   transposeAdcs16x16 (c, src64);
+
+   // Gather the lanes of each channel: k in the low, k + 8 in the high half
+   for (int k = 0; k < 8; ++k)
+   {
+      c[k] = _mm512_shuffle_i64x2 (c[k], c[k], _MM_SHUFFLE (3, 1, 2, 0));
+      _mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst[k + 0] + offset),
+                           _mm512_castsi512_si256 (c[k]));
+      _mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst[k + 8] + offset),
+                           _mm512_extracti64x4_epi64 (c[k], 1));
+   }
+
+   return;
+}
+WIBFRAME_AVX512_UNDEFINED_END
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief Expand 16 channels for 32 successive frames and transpose them.
+
+  \param[out]   c  The transposed adcs. c[k] holds the 32 time samples of
+                   channel k and c[k+8] those of channel k + 8.
+  \param[in]  src  The packed adcs of the first frame
+                                                                          */
+/* ---------------------------------------------------------------------- */
+WIBFRAME_AVX512_UNDEFINED_BEGIN
+static inline void transposeAdcs16x32 (__m512i c[16], uint64_t const *src)
+{
+   __m512i lo[8];
+   __m512i hi[8];
+   transposeAdcs16x16 (lo, src);
+   transposeAdcs16x16 (hi, src + 16 * sizeof (WibFrame) / sizeof (*src));
+
+   for (int k = 0; k < 8; ++k)
+   {
+      c[k + 0] = _mm512_shuffle_i64x2 (lo[k], hi[k], _MM_SHUFFLE (2, 0, 2, 0));
+      c[k + 8] = _mm512_shuffle_i64x2 (lo[k], hi[k], _MM_SHUFFLE (3, 1, 3, 1));
+   }
+
+   return;
+}
+WIBFRAME_AVX512_UNDEFINED_END
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x32_kernel (int16_t          *dst,
+                                              int            stride,
+                                              uint64_t const *src64)
+{
+   __m512i c[16];
+   transposeAdcs16x32 (c, src64);
+
+   for (int k = 0; k < 16; ++k)
+   {
+      _mm512_storeu_si512 (dst + k * stride, c[k]);
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- */
+static inline void transposeAdcs16x32_kernel (int16_t  *const  *dst,
+                                              int            offset,
+                                              uint64_t const *src64)
+{
+   __m512i c[16];
+   transposeAdcs16x32 (c, src64);
+
+   for (int k = 0; k < 16; ++k)
+   {
+      _mm512_storeu_si512 (dst[k] + offset, c[k]);
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
@@ -210,7 +210,9 @@ static inline uint64_t expandC_F (uint64_t w2)
 /* ---------------------------------------------------------------------- */
 static inline void expandAdcs16x1_kernel (int16_t *dst, uint64_t const *src)
 {
-   uint64_t *dst64 = reinterpret_cast<uint64_t *>(dst);
+   // Assembled in 64-bit words and copied, storing them through a
+   // uint64_t pointer lets the optimizer drop reads of dst as int16_t
+   uint64_t dst64[4];
 
    uint64_t w0 = *src++;  
    dst64[0]    = expand0_3 (w0);
@@ -222,6 +224,8 @@ static inline void expandAdcs16x1_kernel (int16_t *dst, uint64_t const *src)
    dst64[2]    = expand8_B (w2, w1);
    dst64[3]    = expandC_F (w2);
 
+   memcpy (dst, dst64, sizeof (dst64));
+
 /*
    for (int idx = 0; idx < 16; idx++)
    {
@@ -0,0 +1,676 @@
+// -*-Mode: C++;-*-
+
+
+/* ---------------------------------------------------------------------- *//*!
+ *
+ *  @file     WibFrame-loops.hh
+ *  @brief    WibFrame expansion and transposition loops, common to all
+ *            implementations
+ *
+ *  @par Facility:
+ *  DUNE
+ *
+ * @par
+ * This file has no include guard. It is included last into each
+ * implementation namespace, see WibFrame.cc, and builds the loops over
+ * the frames and the table of entry points of that implementation from
+ * its kernels,
+ *
+ *   - expandAdcs16_init_kernel
+ *   - expandAdcs64x1_kernel
+ *   - transposeAdcs16x8_kernel
+ *   - transposeAdcs16x16_kernel
+ *   - transposeAdcs16x32_kernel
+ *
+ * the transposers in both their contiguous and channel-by-channel forms.
+ *
+\* ---------------------------------------------------------------------- */
+
+
+
+/* ====================================================================== */
+/* BEGIN: CONTIGIOUS TRANSPOSERS                                          */
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for nframes time samples, a
+          multiple of 8.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128x8N (int16_t              *dst,
+                                    int            ndstStride,
+                                    WibFrame const    *frames,
+                                    int               nframes)
+{
+   //puts ("transposeAcs128x16");
+
+
+   // ----------------------------------
+   // Locate the cold data in this frame
+   // ----------------------------------
+   WibColdData const (& coldData)[2] = frames->getColdData ();
+
+   // ------------------------------------------------
+   // Locate the packed data for each cold data stream
+   // ------------------------------------------------
+   uint64_t const *src0 = coldData[0].locateAdcs12b ();
+   uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+   // ----------------------------------------------------------------
+   // Locate where in the output data for the 2 cold data streams goes
+   // ----------------------------------------------------------------
+   int16_t *dst0 = dst;
+   int16_t *dst1 = dst + 64 * ndstStride;
+   int n8frames  = nframes/8;
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+   // ------------------------------=-----
+   // Loop over the frames in groups of 8
+   // ------------------------------------
+   for (int iframe = 0; iframe < n8frames; ++iframe)
+   { 
+      uint64_t const *lclsrc0 = src0;
+      uint64_t const *lclsrc1 = src1;
+
+      int16_t        *lcldst0 = dst0;
+      int16_t        *lcldst1 = dst1;
+
+
+      // ----------------------------------
+      // Loop over the adcs in groups of 16
+      // ----------------------------------
+      for (int iadcs = 0; iadcs < 64; iadcs += 16)
+      {
+         // ----------------------------------------------------------------
+         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
+         // ----------------------------------------------------------------
+         transposeAdcs16x8_kernel (lcldst0, ndstStride, lclsrc0);
+         lcldst0 += 16*ndstStride;
+         lclsrc0 +=  3;
+
+         transposeAdcs16x8_kernel (lcldst1, ndstStride, lclsrc1);
+         lcldst1 += 16*ndstStride;
+         lclsrc1 +=  3;
+      }
+
+      // Advance the source and destination by the 8 time frames
+      src0 += 8 * sizeof (WibFrame) / sizeof (*src0);
+      src1 += 8 * sizeof (WibFrame) / sizeof (*src1);
+
+      // Advance the destination by the same 
+      dst0 += 8;
+      dst1 += 8;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for nframes time samples, a
+          multiple of 16.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128x16N (int16_t              *dst,
+                                     int            ndstStride,
+                                     WibFrame const    *frames,
+                                     int               nframes)
+{
+   //puts ("transposeAcs128x16");
+
+   // ----------------------------------
+   // Locate the cold data in this frame
+   // ----------------------------------
+   WibColdData const (& coldData)[2] = frames->getColdData ();
+
+
+   // ------------------------------------------------
+   // Locate the packed data for each cold data stream
+   // ------------------------------------------------
+   uint64_t const *src0 = coldData[0].locateAdcs12b ();
+   uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+   // ----------------------------------------------------------------
+   // Locate where in the output data for the 2 cold data streams goes
+   // ----------------------------------------------------------------
+   int16_t *dst0 = dst;
+   int16_t *dst1 = dst + 64 * ndstStride;
+
+
+   int n16frames = nframes/16;
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+   // ------------------------------=-----
+   // Loop over the frames in groups of 16
+   // ------------------------------------
+   for (int iframe = 0; iframe < n16frames; ++iframe)
+   { 
+      uint64_t const *lclsrc0 = src0;
+      uint64_t const *lclsrc1 = src1;
+
+      int16_t        *lcldst0 = dst0;
+      int16_t        *lcldst1 = dst1;
+
+
+      // ----------------------------------
+      // Loop over the adcs in groups of 16
+      // ----------------------------------
+      for (int iadcs = 0; iadcs < 64; iadcs += 16)
+      {
+         // ----------------------------------------------------------------
+         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
+         // ----------------------------------------------------------------
+         transposeAdcs16x16_kernel (lcldst0, ndstStride, lclsrc0);
+         lcldst0 += 16*ndstStride;
+         lclsrc0 +=  3;
+
+         transposeAdcs16x16_kernel (lcldst1, ndstStride, lclsrc1);
+         lcldst1 += 16*ndstStride;
+         lclsrc1 +=  3;
+      }
+
+      // Advance the source and destination by the 8 time frames
+      src0 += 16 * sizeof (WibFrame) / sizeof (*src0);
+      src1 += 16 * sizeof (WibFrame) / sizeof (*src1);
+
+      // Advance the destination by the same 
+      dst0 += 16;
+      dst1 += 16;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for nframes time samples, a
+          multiple of 32.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128x32N (int16_t              *dst,
+                                     int            ndstStride,
+                                     WibFrame const    *frames,
+                                     int               nframes)
+{
+   // ----------------------------------
+   // Locate the cold data in this frame
+   // ----------------------------------
+   WibColdData const (& coldData)[2] = frames->getColdData ();
+
+
+   // ------------------------------------------------
+   // Locate the packed data for each cold data stream
+   // ------------------------------------------------
+   uint64_t const *src0 = coldData[0].locateAdcs12b ();
+   uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+   // ----------------------------------------------------------------
+   // Locate where in the output data for the 2 cold data streams goes
+   // ----------------------------------------------------------------
+   int16_t *dst0 = dst;
+   int16_t *dst1 = dst + 64 * ndstStride;
+
+
+   int n32frames = nframes/32;
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+   // ------------------------------=-----
+   // Loop over the frames in groups of 32
+   // ------------------------------------
+   for (int iframe = 0; iframe < n32frames; ++iframe)
+   { 
+      uint64_t const *lclsrc0 = src0;
+      uint64_t const *lclsrc1 = src1;
+
+      int16_t        *lcldst0 = dst0;
+      int16_t        *lcldst1 = dst1;
+
+      // ----------------------------------
+      // Loop over the adcs in groups of 16
+      // ----------------------------------
+      for (int iadcs = 0; iadcs < 64; iadcs += 16)
+      {
+         // ----------------------------------------------------------------
+         // Transpose the cold data stream 0 & 1  for 16 channels x 32 times
+         // ----------------------------------------------------------------
+         transposeAdcs16x32_kernel (lcldst0, ndstStride, lclsrc0);
+         lcldst0 += 16*ndstStride;
+         lclsrc0 +=  3;
+
+         transposeAdcs16x32_kernel (lcldst1, ndstStride, lclsrc1);
+         lcldst1 += 16*ndstStride;
+         lclsrc1 +=  3;
+      }
+
+      // Advance the source and destination by the 8 time frames
+      src0 += 32 * sizeof (WibFrame) / sizeof (*src0);
+      src1 += 32 * sizeof (WibFrame) / sizeof (*src1);
+
+      // Advance the destination by the same 
+      dst0 += 32;
+      dst1 += 32;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for any number of time
+          samples, one frame at a time.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128xN_kernel (int16_t              *dst,
+                                       int            ndstStride,
+                                       WibFrame const    *frames,
+                                       int               nframes)
+{
+   //puts ("transposeAcs128xXN_kernel);
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+
+   for (int iframe = 0; iframe < nframes;  iframe++)
+   {
+      // ----------------------------------
+      // Locate the cold data in this frame
+      // ----------------------------------
+      WibColdData const (& coldData)[2] = frames[iframe].getColdData ();
+
+
+      // ------------------------------------------------
+      // Locate the packed data for each cold data stream
+      // ------------------------------------------------
+      uint64_t const *src0 = coldData[0].locateAdcs12b ();
+      uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+      // ------------------------------
+      // Decode into a local Adc buffer
+      // ------------------------------ 
+      int16_t                adcBuf[128];
+      expandAdcs64x1_kernel (adcBuf+ 0, src0);
+      expandAdcs64x1_kernel (adcBuf+64, src1);
+
+
+      // ---------------------------------------------------------------
+      // Copy the decoded channel ordered Adcs into sample ordered array
+      // ---------------------------------------------------------------
+      for (int idx = 0; idx < 128; idx++)
+      {
+         int chnOffset           = idx * ndstStride;
+         dst[chnOffset + iframe] = adcBuf[idx];
+      }
+   } 
+   
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+/* END: CONTIGIOUS TRANSPOSERS                                            */
+/* ====================================================================== */
+
+
+
+
+/* ====================================================================== */
+/* BEGIN: CHANNEL-BY-CHANNEL TRANSPOSERS                                  */
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for nframes time samples, a
+          multiple of 8.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128x8N  (int16_t  *const  dst[128],
+                                     int                offset,
+                                     WibFrame  const   *frames,
+                                     int               nframes)
+{
+   // ----------------------------------
+   // Locate the cold data in this frame
+   // ----------------------------------
+   WibColdData const (& coldData)[2] = frames->getColdData ();
+
+
+   // ------------------------------------------------
+   // Locate the packed data for each cold data stream
+   // ------------------------------------------------
+   uint64_t const *src0 = coldData[0].locateAdcs12b ();
+   uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+   // ----------------------------------------------------------------
+   // Locate where in the output data for the 2 cold data streams goes
+   // ----------------------------------------------------------------
+   int16_t *const *dst0 = dst;
+   int16_t *const *dst1 = dst + 64;
+   int         n8frames = nframes/8;
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+
+   // ------------------------------=----
+   // Loop over the frames in groups of 8
+   // -----------------------------------
+   for (int iframe = 0; iframe < n8frames; ++iframe)
+   { 
+      uint64_t const *lclsrc0 = src0;
+      uint64_t const *lclsrc1 = src1;
+
+      int16_t *const *lcldst0 = dst0;
+      int16_t *const *lcldst1 = dst1;
+
+
+      // ----------------------------------
+      // Loop over the adcs in groups of 16
+      // ----------------------------------
+      for (int iadcs = 0; iadcs < 64; iadcs += 16)
+      {
+         // ----------------------------------------------------------------
+         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
+         // ----------------------------------------------------------------
+         transposeAdcs16x8_kernel  (lcldst0, offset, lclsrc0);
+         lcldst0 += 16;
+         lclsrc0 +=  3;
+
+         transposeAdcs16x8_kernel  (lcldst1, offset, lclsrc1);
+         lcldst1 += 16;
+         lclsrc1 +=  3;
+      }
+
+      // Advance the source and destination by the 16 time frames
+      src0   += 8 * sizeof (WibFrame) / sizeof (*src0);
+      src1   += 8 * sizeof (WibFrame) / sizeof (*src1);
+
+      // Advance the destination by the same 
+      offset += 8;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for nframes time samples, a
+          multiple of 16.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128x16N (int16_t *const   dst[128],
+                                     int                offset,
+                                     WibFrame const    *frames,
+                                     int               nframes)
+{
+   // ----------------------------------
+   // Locate the cold data in this frame
+   // ----------------------------------
+   WibColdData const (& coldData)[2] = frames->getColdData ();
+
+
+   // ------------------------------------------------
+   // Locate the packed data for each cold data stream
+   // ------------------------------------------------
+   uint64_t const *src0 = coldData[0].locateAdcs12b ();
+   uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+   // ----------------------------------------------------------------
+   // Locate where in the output data for the 2 cold data streams goes
+   // ----------------------------------------------------------------
+   int16_t *const *dst0 = dst;
+   int16_t *const *dst1 = dst + 64;
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+
+   // ------------------------------=-----
+   // Loop over the frames in groups of 16
+   // ------------------------------------
+   int n16frames = nframes/16;
+   for (int iframe = 0; iframe < n16frames; ++iframe)
+   { 
+      uint64_t const *lclsrc0 = src0;
+      uint64_t const *lclsrc1 = src1;
+
+      int16_t *const *lcldst0 = dst0;
+      int16_t *const *lcldst1 = dst1;
+
+      // ----------------------------------
+      // Loop over the adcs in groups of 16
+      // ----------------------------------
+      for (int iadcs = 0; iadcs < 64; iadcs += 16)
+      {
+         // ----------------------------------------------------------------
+         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
+         // ----------------------------------------------------------------
+         transposeAdcs16x16_kernel (lcldst0, offset, lclsrc0);
+         lcldst0 += 16;
+         lclsrc0 +=  3;
+
+         transposeAdcs16x16_kernel (lcldst1, offset, lclsrc1);
+         lcldst1 += 16;
+         lclsrc1 +=  3;
+      }
+
+
+      // Advance the source and destination by the 16 time frames
+      src0   += 16 * sizeof (WibFrame) / sizeof (*src0);
+      src1   += 16 * sizeof (WibFrame) / sizeof (*src1);
+      offset += 16;
+
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for nframes time samples, a
+          multiple of 32.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128x32N (int16_t  *const  dst[128],
+                                     int                offset,
+                                     WibFrame  const   *frames,
+                                     int               nframes)
+{
+   // ----------------------------------
+   // Locate the cold data in this frame
+   // ----------------------------------
+   WibColdData const (& coldData)[2] = frames->getColdData ();
+
+
+   // ------------------------------------------------
+   // Locate the packed data for each cold data stream
+   // ------------------------------------------------
+   uint64_t const *src0 = coldData[0].locateAdcs12b ();
+   uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+   // ----------------------------------------------------------------
+   // Locate where in the output data for the 2 cold data streams goes
+   // ----------------------------------------------------------------
+   int16_t *const *dst0 = dst;
+   int16_t *const *dst1 = dst + 64;
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+   // ------------------------------=-----
+   // Loop over the frames in groups of 16
+   // ------------------------------------
+   int n32frames = nframes/32;
+   for (int iframe = 0; iframe < n32frames; ++iframe)
+   { 
+      uint64_t  const *lclsrc0 = src0;
+      uint64_t  const *lclsrc1 = src1;
+
+      int16_t  *const *lcldst0 = dst0;
+      int16_t  *const *lcldst1 = dst1;
+
+      // ----------------------------------
+      // Loop over the adcs in groups of 16
+      // ----------------------------------
+      for (int iadcs = 0; iadcs < 64; iadcs += 16)
+      {
+         // ----------------------------------------------------------------
+         // Transpose the cold data stream 0 & 1  for 16 channels x 32 times
+         // ----------------------------------------------------------------
+         transposeAdcs16x32_kernel (lcldst0, offset, lclsrc0);
+         lcldst0 += 16;
+         lclsrc0 +=  3;
+
+         transposeAdcs16x32_kernel (lcldst1, offset, lclsrc1);
+         lcldst1 += 16;
+         lclsrc1 +=  3;
+      }
+
+      // Advance the source and destination by the 32 time frames
+      src0   += 32 * sizeof (WibFrame) / sizeof (*src0);
+      src1   += 32 * sizeof (WibFrame) / sizeof (*src1);
+      offset += 32;
+   }
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief Transposes the 128 ADC channels for any number of time
+          samples, one frame at a time.
+
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static void transposeAdcs128xN_kernel (int16_t *const       *dst,
+                                       int                offset,
+                                       WibFrame const    *frames,
+                                       int               nframes)
+{
+   //puts ("transposeAcs128xXN);
+
+
+   // ---------------------------------
+   // Initialize the expander registers
+   // ---------------------------------
+   expandAdcs16_init_kernel ();
+
+
+   for (int iframe = 0; iframe < nframes;  iframe++)
+   {
+      // ----------------------------------
+      // Locate the cold data in this frame
+      // ----------------------------------
+      WibColdData const (& coldData)[2] = frames[iframe].getColdData ();
+
+
+      // ------------------------------------------------
+      // Locate the packed data for each cold data stream
+      // ------------------------------------------------
+      uint64_t const *src0 = coldData[0].locateAdcs12b ();
+      uint64_t const *src1 = coldData[1].locateAdcs12b ();
+
+
+      // -----------------------------
+      // Decode into a local Adc buffer
+      // ----------------------------- 
+      int16_t                adcBuf[128] = {0};
+      expandAdcs64x1_kernel (adcBuf+ 0, src0);
+      expandAdcs64x1_kernel (adcBuf+64, src1);
+
+
+      // ---------------------------------------------------------------
+      // Copy the decoded channel ordered Adcs into sample ordered array
+      // ---------------------------------------------------------------
+      for (int idx = 0; idx < 128; idx++)
+      {
+         dst[idx][offset + iframe] = adcBuf[idx];
+      }
+   } 
+   
+
+   return;
+}
+/* ---------------------------------------------------------------------- */
+/* END: CHANNEL-BY-CHANNEL TRANSPOSERS                                  */
+/* ====================================================================== */
+
+
+
+
+/* ---------------------------------------------------------------------- *//*!
+
+   \brief The entry points of this implementation
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static WibFrameKernels const Kernels =
+{
+   expandAdcs64x1_kernel,
+   {
+      transposeAdcs128xN_kernel,
+      transposeAdcs128x8N,
+      transposeAdcs128x16N,
+      transposeAdcs128x32N
+   },
+   {
+      transposeAdcs128xN_kernel,
+      transposeAdcs128x8N,
+      transposeAdcs128x16N,
+      transposeAdcs128x32N
+   }
+};
+/* ---------------------------------------------------------------------- */
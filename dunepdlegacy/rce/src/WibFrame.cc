@@ -56,82 +56,114 @@
 #include "dunepdlegacy/rce/dam/access/WibFrame.hh"
 #include <cinttypes>
 #include <cstdio>
+#include <cstring>
+
+#if defined (__x86_64__) || defined (__i386__)
+#define WIBFRAME_X86 1
+#include <immintrin.h>
+#else
+#define WIBFRAME_X86 0
+#endif
 
 
 namespace pdd    {
 namespace access {
 
 
-static inline void expandAdcs16_init_kernel () __attribute__ ((always_inline));
+/* ---------------------------------------------------------------------- *//*!
 
-// ------------------------------
-// EXPANDERS:   Contigious Memory
-// ------------------------------
-static inline void expandAdcs16x1_kernel  (int16_t        *dst,
-                                           uint64_t const *src) __attribute__ ((always_inline));
+  \brief The entry points of one implementation of the expanders and
+         transposers.
 
-static void expandAdcs64x1_kernel  (int16_t        *dst, 
-                                    uint64_t const *src);
+  \par
+   Each implementation is compiled from the kernel headers into its own
+   namespace, see the end of this file. The one used is selected by the
+   instruction sets the CPU supports when a kernel is first used.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+struct WibFrameKernels
+{
+   void (*expandAdcs64x1)  (int16_t              *dst,
+                            uint64_t const       *src);
 
-static inline void expandAdcs16x4_kernel  (int16_t        *dst, 
-                                           uint64_t const *src) __attribute__ ((always_inline));
+   // ------------------------------
+   // TRANSPOSERS: Contigious Memory
+   // ------------------------------
+   struct
+   {
+      void (*transposeAdcs128xN)   (int16_t              *dst,
+                                    int            ndstStride,
+                                    WibFrame const    *frames,
+                                    int               nframes);
 
+      void (*transposeAdcs128x8N)  (int16_t              *dst,
+                                    int            ndstStride,
+                                    WibFrame const    *frames,
+                                    int               nframes);
 
-// ------------------------------
-// TRANSPOSERS: Contigious Memory
-// ------------------------------
-static inline void transposeAdcs128xN_kernel (int16_t              *dst,
-                                              int            ndstStride,
-                                              WibFrame const    *frames,
-                                              int               nframes) __attribute__ ((always_inline));
+      void (*transposeAdcs128x16N) (int16_t              *dst,
+                                    int            ndstStride,
+                                    WibFrame const    *frames,
+                                    int               nframes);
 
-static inline void transposeAdcs16x8_kernel  (int16_t        *dst, 
-                                              int          offset, 
-                                              uint64_t const *src) __attribute__ ((always_inline));
+      void (*transposeAdcs128x32N) (int16_t              *dst,
+                                    int            ndstStride,
+                                    WibFrame const    *frames,
+                                    int               nframes);
+   } contiguous;
 
-static inline void transposeAdcs16x8_kernel  (int16_t        *dst, 
-                                              int          offset, 
-                                              uint64_t const *src) __attribute__ ((always_inline));
+   // --------------------------------------
+   // TRANSPOSERS: Channel-by-Channel Memory
+   // --------------------------------------
+   struct
+   {
+      void (*transposeAdcs128xN)   (int16_t  *const      *dst,
+                                    int                offset,
+                                    WibFrame const    *frames,
+                                    int               nframes);
 
-static inline void transposeAdcs16x8N_kernel (int16_t        *dst, 
-                                              int              n8,
-                                              int          stride, 
-                                              uint64_t const *src) __attribute__ ((always_inline));
+      void (*transposeAdcs128x8N)  (int16_t  *const      *dst,
+                                    int                offset,
+                                    WibFrame const    *frames,
+                                    int               nframes);
 
-static inline void transposeAdcs16x16_kernel (int16_t        *dst, 
-                                              int          offset, 
-                                              uint64_t const *src) __attribute__ ((always_inline));
+      void (*transposeAdcs128x16N) (int16_t  *const      *dst,
+                                    int                offset,
+                                    WibFrame const    *frames,
+                                    int               nframes);
 
-static inline void transposeAdcs16x32_kernel (int16_t        *dst, 
-                                              int          offset, 
-                                              uint64_t const *src) __attribute__ ((always_inline));
+      void (*transposeAdcs128x32N) (int16_t  *const      *dst,
+                                    int                offset,
+                                    WibFrame const    *frames,
+                                    int               nframes);
+   } ptrArray;
+};
 
 
+static WibFrameKernels const *selectKernels (WibFrame::Simd simd);
+/* ---------------------------------------------------------------------- */
 
-// --------------------------------------
-// TRANSPOSERS: Channel-by-Channel Memory
-// --------------------------------------
-static inline void transposeAdcs128xN_kernel (int16_t *const       *dst,
-                                              WibFrame const    *frames,
-                                              int               nframes) __attribute__ ((always_inline));
 
-static inline void transposeAdcs16x8_kernel  (int16_t  *const *dst, 
-                                              int           offset, 
-                                              uint64_t const  *src) __attribute__ ((always_inline));
 
-static inline void transposeAdcs16x8N_kernel (int16_t  *const *dst, 
-                                              int               n8,
-                                              int           offset, 
-                                              uint64_t const  *src) __attribute__ ((always_inline));
+/* ---------------------------------------------------------------------- *//*!
 
-static inline void transposeAdcs16x16_kernel (int16_t  *const *dst, 
-                                              int           offset, 
-                                              uint64_t  const *src) __attribute__ ((always_inline));
+  \brief  Return the implementation in use, selecting the best the CPU
+          supports on first use
+  \return A reference to the pointer to its entry points
 
-static inline void transposeAdcs16x32_kernel (int16_t  *const *dst, 
-                                              int           offset, 
-                                              uint64_t  const *src) __attribute__ ((always_inline));
-     
+  \par
+   The selection is made on first use rather than while the library is
+   loaded, so that frames can be transposed from the static initializers
+   of other translation units.
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static WibFrameKernels const *&selected ()
+{
+   static WibFrameKernels const *Selected =
+                                 selectKernels (WibFrame::getCpuSimd ());
+   return Selected;
+}
+/* ---------------------------------------------------------------------- */
 
 
 /* ---------------------------------------------------------------------- *//*!
@@ -216,7 +248,7 @@ void WibFrame::transposeAdcs128xN  (int16_t              *dst,
    {
       dst    += mframes - rframes;
       frames += mframes - rframes;
-      transposeAdcs128xN_kernel (dst, ndstStride, frames, rframes);
+      selected ()->contiguous.transposeAdcs128xN (dst, ndstStride, frames, rframes);
    }
    
 
@@ -249,72 +281,7 @@ void WibFrame::transposeAdcs128x8N (int16_t              *dst,
                                     WibFrame const    *frames,
                                     int               nframes)
 {
-   //puts ("transposeAcs128x16");
-
-
-   // ----------------------------------
-   // Locate the cold data in this frame
-   // ----------------------------------
-   WibColdData const (& coldData)[2] = frames->getColdData ();
-
-   // ------------------------------------------------
-   // Locate the packed data for each cold data stream
-   // ------------------------------------------------
-   uint64_t const *src0 = coldData[0].locateAdcs12b ();
-   uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-   // ----------------------------------------------------------------
-   // Locate where in the output data for the 2 cold data streams goes
-   // ----------------------------------------------------------------
-   int16_t *dst0 = dst;
-   int16_t *dst1 = dst + 64 * ndstStride;
-   int n8frames  = nframes/8;
-
-
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
-
-   // ------------------------------=-----
-   // Loop over the frames in groups of 8
-   // ------------------------------------
-   for (int iframe = 0; iframe < n8frames; ++iframe)
-   { 
-      uint64_t const *lclsrc0 = src0;
-      uint64_t const *lclsrc1 = src1;
-
-      int16_t        *lcldst0 = dst0;
-      int16_t        *lcldst1 = dst1;
-
-
-      // ----------------------------------
-      // Loop over the adcs in groups of 16
-      // ----------------------------------
-      for (int iadcs = 0; iadcs < 64; iadcs += 16)
-      {
-         // ----------------------------------------------------------------
-         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
-         // ----------------------------------------------------------------
-         transposeAdcs16x8_kernel (lcldst0, ndstStride, lclsrc0);
-         lcldst0 += 16*ndstStride;
-         lclsrc0 +=  3;
-
-         transposeAdcs16x8_kernel (lcldst1, ndstStride, lclsrc1);
-         lcldst1 += 16*ndstStride;
-         lclsrc1 +=  3;
-      }
-
-      // Advance the source and destination by the 8 time frames
-      src0 += 8 * sizeof (WibFrame) / sizeof (*src0);
-      src1 += 8 * sizeof (WibFrame) / sizeof (*src1);
-
-      // Advance the destination by the same 
-      dst0 += 8;
-      dst1 += 8;
-   }
-
+   selected ()->contiguous.transposeAdcs128x8N (dst, ndstStride, frames, nframes);
    return;
 }
 /* ---------------------------------------------------------------------- */
@@ -344,79 +311,13 @@ void WibFrame::transposeAdcs128x16N (int16_t              *dst,
                                      WibFrame const    *frames,
                                      int               nframes)
 {
-   //puts ("transposeAcs128x16");
-
-   // ----------------------------------
-   // Locate the cold data in this frame
-   // ----------------------------------
-   WibColdData const (& coldData)[2] = frames->getColdData ();
-
-
-   // ------------------------------------------------
-   // Locate the packed data for each cold data stream
-   // ------------------------------------------------
-   uint64_t const *src0 = coldData[0].locateAdcs12b ();
-   uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-   // ----------------------------------------------------------------
-   // Locate where in the output data for the 2 cold data streams goes
-   // ----------------------------------------------------------------
-   int16_t *dst0 = dst;
-   int16_t *dst1 = dst + 64 * ndstStride;
-
-
-   int n16frames = nframes/16;
-
-
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
-
-   // ------------------------------=-----
-   // Loop over the frames in groups of 16
-   // ------------------------------------
-   for (int iframe = 0; iframe < n16frames; ++iframe)
-   { 
-      uint64_t const *lclsrc0 = src0;
-      uint64_t const *lclsrc1 = src1;
-
-      int16_t        *lcldst0 = dst0;
-      int16_t        *lcldst1 = dst1;
-
-
-      // ----------------------------------
-      // Loop over the adcs in groups of 16
-      // ----------------------------------
-      for (int iadcs = 0; iadcs < 64; iadcs += 16)
-      {
-         // ----------------------------------------------------------------
-         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
-         // ----------------------------------------------------------------
-         transposeAdcs16x16_kernel (lcldst0, ndstStride, lclsrc0);
-         lcldst0 += 16*ndstStride;
-         lclsrc0 +=  3;
-
-         transposeAdcs16x16_kernel (lcldst1, ndstStride, lclsrc1);
-         lcldst1 += 16*ndstStride;
-         lclsrc1 +=  3;
-      }
-
-      // Advance the source and destination by the 8 time frames
-      src0 += 16 * sizeof (WibFrame) / sizeof (*src0);
-      src1 += 16 * sizeof (WibFrame) / sizeof (*src1);
-
-      // Advance the destination by the same 
-      dst0 += 16;
-      dst1 += 16;
-   }
-
+   selected ()->contiguous.transposeAdcs128x16N (dst, ndstStride, frames, nframes);
    return;
 }
 /* ---------------------------------------------------------------------- */
 
 
+
 /* ---------------------------------------------------------------------- *//*!
 
    \brief Transposes the 128 ADC channels serviced by a WibFrame for
@@ -439,71 +340,7 @@ void WibFrame::transposeAdcs128x32N (int16_t              *dst,
                                      WibFrame const    *frames,
                                      int               nframes)
 {
-   // ----------------------------------
-   // Locate the cold data in this frame
-   // ----------------------------------
-   WibColdData const (& coldData)[2] = frames->getColdData ();
-
-
-   // ------------------------------------------------
-   // Locate the packed data for each cold data stream
-   // ------------------------------------------------
-   uint64_t const *src0 = coldData[0].locateAdcs12b ();
-   uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-   // ----------------------------------------------------------------
-   // Locate where in the output data for the 2 cold data streams goes
-   // ----------------------------------------------------------------
-   int16_t *dst0 = dst;
-   int16_t *dst1 = dst + 64 * ndstStride;
-
-
-   int n32frames = nframes/32;
-
-
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
-
-   // ------------------------------=-----
-   // Loop over the frames in groups of 32
-   // ------------------------------------
-   for (int iframe = 0; iframe < n32frames; ++iframe)
-   { 
-      uint64_t const *lclsrc0 = src0;
-      uint64_t const *lclsrc1 = src1;
-
-      int16_t        *lcldst0 = dst0;
-      int16_t        *lcldst1 = dst1;
-
-      // ----------------------------------
-      // Loop over the adcs in groups of 16
-      // ----------------------------------
-      for (int iadcs = 0; iadcs < 64; iadcs += 16)
-      {
-         // ----------------------------------------------------------------
-         // Transpose the cold data stream 0 & 1  for 16 channels x 32 times
-         // ----------------------------------------------------------------
-         transposeAdcs16x32_kernel (lcldst0, ndstStride, lclsrc0);
-         lcldst0 += 16*ndstStride;
-         lclsrc0 +=  3;
-
-         transposeAdcs16x32_kernel (lcldst1, ndstStride, lclsrc1);
-         lcldst1 += 16*ndstStride;
-         lclsrc1 +=  3;
-      }
-
-      // Advance the source and destination by the 8 time frames
-      src0 += 32 * sizeof (WibFrame) / sizeof (*src0);
-      src1 += 32 * sizeof (WibFrame) / sizeof (*src1);
-
-      // Advance the destination by the same 
-      dst0 += 32;
-      dst1 += 32;
-   }
-
+   selected ()->contiguous.transposeAdcs128x32N (dst, ndstStride, frames, nframes);
    return;
 }
 /* ---------------------------------------------------------------------- */
@@ -551,9 +388,9 @@ void WibFrame::transposeAdcs128xN  (int16_t  *const  dst[128],
    int rframes = mframes & 0x7;
    if (rframes)
    {
-      dst    += mframes - rframes;
+      offset += mframes - rframes;
       frames += mframes - rframes;
-      transposeAdcs128xN_kernel (dst, frames, rframes);
+      selected ()->ptrArray.transposeAdcs128xN (dst, offset, frames, rframes);
    }
 
 
@@ -583,69 +420,7 @@ void WibFrame::transposeAdcs128x8N  (int16_t  *const  dst[128],
                                      WibFrame  const   *frames,
                                      int               nframes)
 {
-   // ----------------------------------
-   // Locate the cold data in this frame
-   // ----------------------------------
-   WibColdData const (& coldData)[2] = frames->getColdData ();
-
-
-   // ------------------------------------------------
-   // Locate the packed data for each cold data stream
-   // ------------------------------------------------
-   uint64_t const *src0 = coldData[0].locateAdcs12b ();
-   uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-   // ----------------------------------------------------------------
-   // Locate where in the output data for the 2 cold data streams goes
-   // ----------------------------------------------------------------
-   int16_t *const *dst0 = dst;
-   int16_t *const *dst1 = dst + 64;
-   int         n8frames = nframes/8;
-
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
-
-
-   // ------------------------------=----
-   // Loop over the frames in groups of 8
-   // -----------------------------------
-   for (int iframe = 0; iframe < n8frames; ++iframe)
-   { 
-      uint64_t const *lclsrc0 = src0;
-      uint64_t const *lclsrc1 = src1;
-
-      int16_t *const *lcldst0 = dst0;
-      int16_t *const *lcldst1 = dst1;
-
-
-      // ----------------------------------
-      // Loop over the adcs in groups of 16
-      // ----------------------------------
-      for (int iadcs = 0; iadcs < 64; iadcs += 16)
-      {
-         // ----------------------------------------------------------------
-         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
-         // ----------------------------------------------------------------
-         transposeAdcs16x8_kernel  (lcldst0, offset, lclsrc0);
-         lcldst0 += 16;
-         lclsrc0 +=  3;
-
-         transposeAdcs16x8_kernel  (lcldst1, offset, lclsrc1);
-         lcldst1 += 16;
-         lclsrc1 +=  3;
-      }
-
-      // Advance the source and destination by the 16 time frames
-      src0   += 8 * sizeof (WibFrame) / sizeof (*src0);
-      src1   += 8 * sizeof (WibFrame) / sizeof (*src1);
-
-      // Advance the destination by the same 
-      offset += 8;
-   }
-
+   selected ()->ptrArray.transposeAdcs128x8N (dst, offset, frames, nframes);
    return;
 }
 /* ---------------------------------------------------------------------- */
@@ -672,74 +447,13 @@ void WibFrame::transposeAdcs128x16N (int16_t *const   dst[128],
                                      WibFrame const    *frames,
                                      int               nframes)
 {
-   // ----------------------------------
-   // Locate the cold data in this frame
-   // ----------------------------------
-   WibColdData const (& coldData)[2] = frames->getColdData ();
-
-
-   // ------------------------------------------------
-   // Locate the packed data for each cold data stream
-   // ------------------------------------------------
-   uint64_t const *src0 = coldData[0].locateAdcs12b ();
-   uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-   // ----------------------------------------------------------------
-   // Locate where in the output data for the 2 cold data streams goes
-   // ----------------------------------------------------------------
-   int16_t *const *dst0 = dst;
-   int16_t *const *dst1 = dst + 64;
-
-
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
-
-
-   // ------------------------------=-----
-   // Loop over the frames in groups of 16
-   // ------------------------------------
-   int n16frames = nframes/16;
-   for (int iframe = 0; iframe < n16frames; ++iframe)
-   { 
-      uint64_t const *lclsrc0 = src0;
-      uint64_t const *lclsrc1 = src1;
-
-      int16_t *const *lcldst0 = dst0;
-      int16_t *const *lcldst1 = dst1;
-
-      // ----------------------------------
-      // Loop over the adcs in groups of 16
-      // ----------------------------------
-      for (int iadcs = 0; iadcs < 64; iadcs += 16)
-      {
-         // ----------------------------------------------------------------
-         // Transpose the cold data stream 0 & 1  for 16 channels x 16 times
-         // ----------------------------------------------------------------
-         transposeAdcs16x16_kernel (lcldst0, offset, lclsrc0);
-         lcldst0 += 16;
-         lclsrc0 +=  3;
-
-         transposeAdcs16x16_kernel (lcldst1, offset, lclsrc1);
-         lcldst1 += 16;
-         lclsrc1 +=  3;
-      }
-
-
-      // Advance the source and destination by the 16 time frames
-      src0   += 16 * sizeof (WibFrame) / sizeof (*src0);
-      src1   += 16 * sizeof (WibFrame) / sizeof (*src1);
-      offset += 16;
-
-   }
-
+   selected ()->ptrArray.transposeAdcs128x16N (dst, offset, frames, nframes);
    return;
 }
 /* ---------------------------------------------------------------------- */
 
 
+
 /* ---------------------------------------------------------------------- *//*!
 
    \brief Transposes the 128 ADC channels serviced by a WibFrame for
@@ -763,66 +477,7 @@ void WibFrame::transposeAdcs128x32N (int16_t  *const  dst[128],
                                      WibFrame  const   *frames,
                                      int               nframes)
 {
-   // ----------------------------------
-   // Locate the cold data in this frame
-   // ----------------------------------
-   WibColdData const (& coldData)[2] = frames->getColdData ();
-
-
-   // ------------------------------------------------
-   // Locate the packed data for each cold data stream
-   // ------------------------------------------------
-   uint64_t const *src0 = coldData[0].locateAdcs12b ();
-   uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-   // ----------------------------------------------------------------
-   // Locate where in the output data for the 2 cold data streams goes
-   // ----------------------------------------------------------------
-   int16_t *const *dst0 = dst;
-   int16_t *const *dst1 = dst + 64;
-
-
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
-
-   // ------------------------------=-----
-   // Loop over the frames in groups of 16
-   // ------------------------------------
-   int n32frames = nframes/32;
-   for (int iframe = 0; iframe < n32frames; ++iframe)
-   { 
-      uint64_t  const *lclsrc0 = src0;
-      uint64_t  const *lclsrc1 = src1;
-
-      int16_t  *const *lcldst0 = dst0;
-      int16_t  *const *lcldst1 = dst1;
-
-      // ----------------------------------
-      // Loop over the adcs in groups of 16
-      // ----------------------------------
-      for (int iadcs = 0; iadcs < 64; iadcs += 16)
-      {
-         // ----------------------------------------------------------------
-         // Transpose the cold data stream 0 & 1  for 16 channels x 32 times
-         // ----------------------------------------------------------------
-         transposeAdcs16x32_kernel (lcldst0, offset, lclsrc0);
-         lcldst0 += 16;
-         lclsrc0 +=  3;
-
-         transposeAdcs16x32_kernel (lcldst1, offset, lclsrc1);
-         lcldst1 += 16;
-         lclsrc1 +=  3;
-      }
-
-      // Advance the source and destination by the 32 time frames
-      src0   += 32 * sizeof (WibFrame) / sizeof (*src0);
-      src1   += 32 * sizeof (WibFrame) / sizeof (*src1);
-      offset += 32;
-   }
-
+   selected ()->ptrArray.transposeAdcs128x32N (dst, offset, frames, nframes);
    return;
 }
 /* ---------------------------------------------------------------------- */
@@ -831,21 +486,6 @@ void WibFrame::transposeAdcs128x32N (int16_t  *const  dst[128],
 
 
 
-/*  Old switch -- include the implementation-specific header
-    New:  just build gen
-
-#ifdef __AVX2__
-#include "WibFrame-avx2.hh"
-#elif defined (__AVX__)
-#include "WibFrame-avx.hh"
-#else
-#include "WibFrame-gen.hh"
-#endif
-*/
-
-#include "WibFrame-gen.hh"
-
-#include <string.h>
 
 /* ---------------------------------------------------------------------- *//*!
 
@@ -859,81 +499,90 @@ void WibFrame::transposeAdcs128x32N (int16_t  *const  dst[128],
 void WibColdData::expandAdcs64x1 (int16_t              *dst,
                                   uint64_t const (&src)[12])
 {
-   expandAdcs16_init_kernel ();
-   expandAdcs64x1_kernel    (dst, reinterpret_cast<uint64_t const *>(&src));
+   selected ()->expandAdcs64x1 (dst, reinterpret_cast<uint64_t const *>(&src));
+   return;
 }
 /* ---------------------------------------------------------------------- */
 
 
 
 
-/* ---------------------------------------------------------------------- *//*!
+/* ====================================================================== */
+/* BEGIN: IMPLEMENTATIONS                                                 */
+/* ---------------------------------------------------------------------- *\
+ |
+ | Each implementation includes its kernels and then the loops built on
+ | them, compiled for its instruction set. Only the generic one is built
+ | on other architectures.
+ |
+\* ---------------------------------------------------------------------- */
+namespace gen {
+#include "WibFrame-gen.hh"
+#include "WibFrame-16x8N.hh"
+#include "WibFrame-loops.hh"
+}
 
-   \brief Transposes the 128 ADC channels serviced by a WibFrame for
-          \a nframes time samples.
 
+#if WIBFRAME_X86
+namespace avx2 {
+#pragma GCC push_options
+#pragma GCC target ("avx2")
+#include "WibFrame-avx2.hh"
+#include "WibFrame-16x8N.hh"
+#include "WibFrame-loops.hh"
+#pragma GCC pop_options
+}
 
-   \param[in]       dst[out]  The output destination array. 
-   \param[in] ndstStride[in]  The number of entries of each of the 128
-                              arrays of transposed ADC values.
-   \param[in]     frames[in]  The array of WibFrames
-   \param[in]    nframes[in]  The number frames, \e i.e. time samples
-                              to transpose. 
 
-   This output array should be thought of as a 2d array dst[128][ndstStride].
-   This allows each channel space for ndstStride contigous transposed
-   ADC values.
-                                                                          */
-/* ---------------------------------------------------------------------- */
-static void transposeAdcs128xN_kernel (int16_t              *dst,
-                                       int            ndstStride,
-                                       WibFrame const    *frames,
-                                       int               nframes)
-{
-   //puts ("transposeAcs128xXN_kernel);
+// GCC 12 reports the vectors its own AVX-512F intrinsics leave undefined
+// on purpose as uninitialized. The kernels whose intrinsics trigger this
+// switch the warnings off around themselves only.
+#define WIBFRAME_AVX512_UNDEFINED_BEGIN                                   \
+   _Pragma ("GCC diagnostic push")                                        \
+   _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")                 \
+   _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define WIBFRAME_AVX512_UNDEFINED_END                                     \
+   _Pragma ("GCC diagnostic pop")
+
+namespace avx512 {
+#pragma GCC push_options
+#pragma GCC target ("avx2,avx512f,avx512bw")
+namespace avx2 {
+#include "WibFrame-avx2.hh"
+}
+#include "WibFrame-avx512.hh"
+#include "WibFrame-loops.hh"
+#pragma GCC pop_options
+}
 
+#undef WIBFRAME_AVX512_UNDEFINED_BEGIN
+#undef WIBFRAME_AVX512_UNDEFINED_END
+#endif
+/* END: IMPLEMENTATIONS                                                   */
+/* ====================================================================== */
 
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
 
 
-   for (int iframe = 0; iframe < nframes;  iframe++)
-   {
-      // ----------------------------------
-      // Locate the cold data in this frame
-      // ----------------------------------
-      WibColdData const (& coldData)[2] = frames[iframe].getColdData ();
-
-
-      // ------------------------------------------------
-      // Locate the packed data for each cold data stream
-      // ------------------------------------------------
-      uint64_t const *src0 = coldData[0].locateAdcs12b ();
-      uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-      // ------------------------------
-      // Decode into a local Adc buffer
-      // ------------------------------ 
-      int16_t                adcBuf[128];
-      expandAdcs64x1_kernel (adcBuf+ 0, src0);
-      expandAdcs64x1_kernel (adcBuf+64, src1);
-
-
-      // ---------------------------------------------------------------
-      // Copy the decoded channel ordered Adcs into sample ordered array
-      // ---------------------------------------------------------------
-      for (int idx = 0; idx < 128; idx++)
-      {
-         int chnOffset           = idx * ndstStride;
-         dst[chnOffset + iframe] = adcBuf[idx];
-      }
-   } 
-   
 
-   return;
+/* ---------------------------------------------------------------------- *//*!
+
+  \brief  Return the entry points of an implementation
+  \retval nullptr if the implementation is not built
+
+  \param[in] simd  The implementation
+                                                                          */
+/* ---------------------------------------------------------------------- */
+static WibFrameKernels const *selectKernels (WibFrame::Simd simd)
+{
+   switch (simd)
+   {
+      case WibFrame::Simd::Generic: return &gen::Kernels;
+#if WIBFRAME_X86
+      case WibFrame::Simd::Avx2:    return &avx2::Kernels;
+      case WibFrame::Simd::Avx512:  return &avx512::Kernels;
+#endif
+      default:                      return nullptr;
+   }
 }
 /* ---------------------------------------------------------------------- */
 
@@ -942,181 +591,105 @@ static void transposeAdcs128xN_kernel (int16_t              *dst,
 
 /* ---------------------------------------------------------------------- *//*!
 
-  \brief  Transpose 8N time samples for 16 channels
+  \brief  Return whether the CPU supports an implementation
+  \retval true if the implementation is built and the CPU supports its
+          instruction sets
 
-  \param[out]   dst The destination array
-  \param[ in]    n8 The number of groups of 8 channels, \e i.e. the N in
-                    transpose16x8N
-  \param[in] offset The number of elements in on channel's destination
-                    array.
-  \param[in]    src The source array
+  \param[in] simd  The implementation
                                                                           */
 /* ---------------------------------------------------------------------- */
-static inline void transposeAdcs16x8N_kernel (int16_t        *dst, 
-                                              int              n8,
-                                              int          stride,
-                                              uint64_t const *src)
+bool WibFrame::isSupported (Simd simd)
 {
-   for (int idx = 0; idx < n8; ++idx)
+#if WIBFRAME_X86
+   // May be called from static initializers, before the cpu model
+   // is guaranteed to be initialized
+   __builtin_cpu_init ();
+   switch (simd)
    {
-      transposeAdcs16x8_kernel (dst, stride, src + idx * 8 * sizeof (WibFrame) / sizeof (*src));
-      dst += 8;
+      case Simd::Generic: return true;
+      case Simd::Avx2:    return __builtin_cpu_supports ("avx2");
+      case Simd::Avx512:  return __builtin_cpu_supports ("avx512f")
+                              && __builtin_cpu_supports ("avx512bw");
    }
-
-   return;
+#endif
+   return simd == Simd::Generic;
 }
 /* ---------------------------------------------------------------------- */
 
 
 
-/* ---------------------------------------------------------------------- */
-static inline void transposeAdcs16x16_kernel (int16_t        *dst, 
-                                              int          stride, 
-                                              uint64_t const *src)
-{
-   transposeAdcs16x8N_kernel (dst, 2, stride, src);
-}
-/* ---------------------------------------------------------------------- */
-
 
+/* ---------------------------------------------------------------------- *//*!
 
+  \brief  Return the best implementation the CPU supports
+                                                                          */
 /* ---------------------------------------------------------------------- */
-static inline void transposeAdcs16x32_kernel (int16_t        *dst, 
-                                              int          stride, 
-                                              uint64_t const *src)
+WibFrame::Simd WibFrame::getCpuSimd ()
 {
-   transposeAdcs16x8N_kernel (dst, 4, stride, src);
+   if (isSupported (Simd::Avx512)) return Simd::Avx512;
+   if (isSupported (Simd::Avx2  )) return Simd::Avx2;
+   return Simd::Generic;
 }
 /* ---------------------------------------------------------------------- */
-/* END: CONTIGIOUS TRANSPOSITION                                          */
-/* ====================================================================== */
-
 
 
 
 
-/* ====================================================================== */
-/* BEGIN: CHANNEL-BY-CHANNEL TRANSPOSITION                                */
 /* ---------------------------------------------------------------------- *//*!
 
-   \brief Transposes the 128 ADC channels serviced by a WibFrame for
-          \a nframes time samples.
-
-
-   \param[in]       dst[out]  The output destination array. 
-   \param[in] ndstStride[in]  The number of entries of each of the 128
-                              arrays of transposed ADC values.
-   \param[in]     frames[in]  The array of WibFrames
-   \param[in]    nframes[in]  The number frames, \e i.e. time samples
-                              to transpose. 
-
-   This output array should be thought of as a 2d array dst[128][ndstStride].
-   This allows each channel space for ndstStride contigous transposed
-   ADC values.
+  \brief  Return the implementation in use
                                                                           */
 /* ---------------------------------------------------------------------- */
-static void transposeAdcs128xN_kernel (int16_t *const       *dst,
-                                       WibFrame const    *frames,
-                                       int               nframes)
+WibFrame::Simd WibFrame::getSimd ()
 {
-   //puts ("transposeAcs128xXN);
-
+   if (selected () == selectKernels (Simd::Avx512)) return Simd::Avx512;
+   if (selected () == selectKernels (Simd::Avx2  )) return Simd::Avx2;
+   return Simd::Generic;
+}
+/* ---------------------------------------------------------------------- */
 
-   // ---------------------------------
-   // Initialize the expander registers
-   // ---------------------------------
-   expandAdcs16_init_kernel ();
 
 
-   for (int iframe = 0; iframe < nframes;  iframe++)
-   {
-      // ----------------------------------
-      // Locate the cold data in this frame
-      // ----------------------------------
-      WibColdData const (& coldData)[2] = frames[iframe].getColdData ();
-
-
-      // ------------------------------------------------
-      // Locate the packed data for each cold data stream
-      // ------------------------------------------------
-      uint64_t const *src0 = coldData[0].locateAdcs12b ();
-      uint64_t const *src1 = coldData[1].locateAdcs12b ();
-
-
-      // -----------------------------
-      // Decode into a local Adc buffer
-      // ----------------------------- 
-      int16_t                adcBuf[128] = {0};
-      expandAdcs64x1_kernel (adcBuf+ 0, src0);
-      expandAdcs64x1_kernel (adcBuf+64, src1);
-
-
-      // ---------------------------------------------------------------
-      // Copy the decoded channel ordered Adcs into sample ordered array
-      // ---------------------------------------------------------------
-      for (int idx = 0; idx < 128; idx++)
-      {
-         dst[idx][iframe] = adcBuf[idx];
-      }
-   } 
-   
 
-   return;
-}
-/* ---------------------------------------------------------------------- */
+/* ---------------------------------------------------------------------- *//*!
 
+  \brief  Select the implementation to use
+  \retval true if the implementation is supported and now in use
 
+  \param[in] simd  The implementation
 
-/* ---------------------------------------------------------------------- *//*!
-  \brief  Transpose 8N time samples for 16 channels
-
-  \param[out]   dst Pointers to 16 arrays to receive the transposed data
-  \param[ in]    n8 The number of groups of 8 channels, \e i.e. the N in
-                    transpose16x8N
-  \param[in] offset The number of elements in on channel's destination
-                    array.
-  \param[in]    src The source array
+  \warning
+   This is meant for tests and must not be called while other threads
+   expand or transpose frames.
                                                                           */
 /* ---------------------------------------------------------------------- */
-static inline void transposeAdcs16x8N_kernel (int16_t  *const *dst, 
-                                              int               n8,
-                                              int           offset,
-                                              uint64_t const  *src)
+bool WibFrame::setSimd (Simd simd)
 {
-   for (int idx = 0; idx < n8; ++idx)
-   {
-      transposeAdcs16x8_kernel (dst, offset, src);
-      src    += 8 * sizeof (WibFrame) / sizeof (*src);
-      offset += 8;
-   }
-
-   return;
+   if (!isSupported (simd)) return false;
+   selected () = selectKernels (simd);
+   return true;
 }
 /* ---------------------------------------------------------------------- */
 
 
 
-/* ---------------------------------------------------------------------- */
-static inline void transposeAdcs16x16_kernel (int16_t *const  *dst, 
-                                              int           offset,
-                                              uint64_t const  *src)
-{
-   transposeAdcs16x8N_kernel (dst, 2, offset, src);
-}
-/* ---------------------------------------------------------------------- */
-
 
+/* ---------------------------------------------------------------------- *//*!
 
+  \brief  Return the name of an implementation
+                                                                          */
 /* ---------------------------------------------------------------------- */
-static inline void transposeAdcs16x32_kernel (int16_t *const  *dst, 
-                                              int           offset, 
-                                              uint64_t const  *src)
+char const *WibFrame::getName (Simd simd)
 {
-   transposeAdcs16x8N_kernel (dst, 4, offset, src);
+   switch (simd)
+   {
+      case Simd::Generic: return "generic";
+      case Simd::Avx2:    return "avx2";
+      case Simd::Avx512:  return "avx512";
+   }
+   return "unknown";
 }
 /* ---------------------------------------------------------------------- */
-/* END: CONTIGIOUS TRANSPOSITION                                          */
-/* ====================================================================== */
 /*   END: IMPLEMENTATION: class WibFrame                                  */
 } /* END: namespace access                                                */
 } /* END: namespace pdd                                                   */
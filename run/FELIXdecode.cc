@@ -1,88 +1,277 @@
+// FELIXdecode decodes, decompresses and validates all FELIX fragments of a
+// list of art/root files on a number of worker threads, and reports the
+// throughput and the time spent in each stage. Decoded waveforms can be
+// written to a binary file.
+
 #include "dunepdlegacy/Overlays/FelixDecode.hh"
 #include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
-#include "art/Framework/Principal/Handle.h"
 #include "artdaq-core/Data/Fragment.hh"
 #include "canvas/Utilities/InputTag.h"
 #include "dunepdlegacy/Overlays/FelixFragment.hh"
-#include "gallery/Event.h"
+#include "dunepdlegacy/Overlays/FelixIntegrity.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
 
-int main(int argc, char *argv[]) {
-  // Checking of input arguments.
-  if (argc < 3) {
-    std::cout << "ERROR: need both inputfile(s) and destination.\n";
-    return 1;
-  }
+namespace {
+
+// Record preceding the waveforms of every fragment in the output file. The
+// waveforms follow as num_channels rows of num_samples little endian
+// uint16_t values, one row per channel.
+struct WaveformHeader {
+  uint32_t magic = 0x57584c46;  // "FLXW"
+  uint32_t version = 1;
+  uint64_t timestamp = 0;  // Of the first frame of the trigger window.
+  uint32_t fragment_id = 0;
+  uint8_t crate_no = 0, slot_no = 0, fiber_no = 0, reserved = 0;
+  uint32_t num_channels = 0;
+  uint32_t num_samples = 0;
+  uint32_t errors = 0;  // FelixIntegrity error bitmap.
+  uint32_t reserved_2 = 0;
+};
+
+enum Stage {
+  stage_decompress,
+  stage_validate,
+  stage_decode,
+  stage_write,
+  num_stages
+};
+const char* const stage_names[num_stages] = {"decompress", "validate",
+                                             "decode", "write"};
+
+typedef std::chrono::steady_clock clock_type;
+
+double seconds(const clock_type::time_point& start,
+               const clock_type::time_point& stop) {
+  return std::chrono::duration<double>(stop - start).count();
+}
+
+// State of the worker handling one fragment of a batch.
+struct Job {
+  dune::adc_aligned_v adcs;
+  WaveformHeader header;
+  dune::FelixIntegrity integrity;
+  double stage_seconds[num_stages] = {};
+  std::exception_ptr error;  // Rethrown by the caller in fragment order.
+};
+
+void usage(const char* name) {
+  std::cout
+      << "Usage: " << name << " [options] file...\n"
+      << "Decode, decompress and validate all FELIX fragments of the input "
+         "files.\n\n"
+      << "Options:\n"
+      << "  -j, --threads N   Worker threads (default 1).\n"
+      << "  -o, --output F    Write the decoded channel-major waveforms of "
+         "every\n"
+      << "                    fragment to the binary file F.\n"
+      << "  -b, --buffer N    Fragments to read ahead (default 100).\n"
+      << "  -t, --tag T       Input tag (default daq:ContainerFELIX:DAQ).\n"
+      << "  -q, --quiet       Do not report progress.\n"
+      << "  -h, --help        Show this message.\n\n"
+      << "The exit status is 0 if all fragments pass the header checks, 2 "
+         "if any\n"
+      << "fail and 1 on other errors.\n";
+}
 
-  // Number of files to be considered.
-  const unsigned total_files = 10;
+}  // namespace
 
-  // The user has to input both an input file and a destination.
+int main(int argc, char* argv[]) {
+  // Checking of input arguments.
+  unsigned num_threads = 1;
+  size_t max_buffered = 100;
+  std::string output;
+  std::string tag = "daq:ContainerFELIX:DAQ";
+  bool quiet = false;
   std::vector<std::string> filenames;
-  for(unsigned file = 1; file < std::min<unsigned>(total_files, argc-1); ++file) {
-    filenames.push_back(argv[file]);
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if ((arg == "-j" || arg == "--threads") && has_value) {
+      num_threads = std::max(1, atoi(argv[++i]));
+    } else if ((arg == "-o" || arg == "--output") && has_value) {
+      output = argv[++i];
+    } else if ((arg == "-b" || arg == "--buffer") && has_value) {
+      max_buffered = std::max(1, atoi(argv[++i]));
+    } else if ((arg == "-t" || arg == "--tag") && has_value) {
+      tag = argv[++i];
+    } else if (arg == "-q" || arg == "--quiet") {
+      quiet = true;
+    } else if (!arg.empty() && arg[0] == '-') {
+      std::cout << "ERROR: unknown or incomplete option " << arg << ".\n";
+      usage(argv[0]);
+      return 1;
+    } else {
+      filenames.push_back(arg);
+    }
   }
-  std::string destination = argv[argc-1];
-  std::string print = "";
-  if (argc == 4) {
-    print = argv[3];
+  if (filenames.empty()) {
+    std::cout << "ERROR: need at least one input file.\n";
+    usage(argv[0]);
+    return 1;
   }
 
-  // Initialise a decoder object from the file.
-  dune::FelixDecoder flxdec(filenames);
-
-  // Check fragment length here for now.
-  artdaq::Fragment frag = flxdec.Fragment(0);
-
-  dune::FelixFragment::Metadata meta =
-      *frag.metadata<dune::FelixFragment::Metadata>();
-  std::cout << "METADATA: " << (unsigned)meta.control_word << "   "
-            << (unsigned)meta.version << "   " << (unsigned)meta.reordered
-            << "   " << (unsigned)meta.compressed << "   "
-            << (unsigned)meta.num_frames << "   "
-            << (unsigned)meta.offset_frames << "   "
-            << (unsigned)meta.window_frames << '\n';
-  dune::FelixFragment flxfrag(frag);
-  if (flxfrag.total_frames() < 6000 || flxfrag.total_frames() > 6036) {
-    std::cout << "WARNING: first fragment has a strange size: "
-              << flxfrag.total_frames() << ".\n";
+  std::ofstream outfile;
+  if (!output.empty()) {
+    outfile.open(output, std::ios::binary);
+    if (!outfile) {
+      std::cout << "ERROR: cannot open " << output << " for writing.\n";
+      return 1;
+    }
   }
 
-  // // Print uncompressed fragment to file.
-  // std::cout << "Going to decompress fragment.\n";
-  // dune::FelixFragmentCompressed compflxfrag(frag);
-  // artdaq::Fragment uncompfrag = compflxfrag.uncompressed_fragment();
-  // std::ofstream ofile("outfrag.dat");
-  // ofile.write(reinterpret_cast<const char *>(uncompfrag.dataBeginBytes()),
-  //             uncompfrag.dataSizeBytes());
-  // ofile.close();
-  // std::cout << "Produced uncompressed fragment to file.\n";
-
-  // artdaq::Fragment newfrag;
-  // newfrag.setTimestamp(frag.timestamp());
-  // newfrag.resize(frag.dataSizeBytes());
-  // memcpy(newfrag.dataBeginBytes(), frag.dataBeginBytes(),
-  // frag.dataSizeBytes());
-
-  // dune::FelixFragment::Metadata newmeta = {0xabc, 1, 0, 0, 6024, 500, 6000};
-  // newfrag.setMetadata(newmeta);
-
-  // Print some value.
-  for (unsigned f = 0; f < flxdec.total_fragments(); ++f) {
-    artdaq::Fragment frag = flxdec.Fragment(f);
-    dune::FelixFragment flxfrag(frag);
-    std::cout << f << '\t' << flxfrag.get_ADC(259,37) << '\n';
+  // Fragments of an event are handled in batches of a few per thread, which
+  // bounds the memory taken by decoded waveforms.
+  std::unique_ptr<dune::ReorderThreadPool> pool(
+      num_threads > 1 ? new dune::ReorderThreadPool(num_threads - 1)
+                      : nullptr);
+  const size_t batch_size = 2 * num_threads;
+  std::vector<Job> jobs(batch_size);
+  const artdaq::Fragment* batch = nullptr;
+  const bool decode_adcs = outfile.is_open();
+  auto decode_job = [&](Job& job, const artdaq::Fragment& frag) {
+    const clock_type::time_point t0 = clock_type::now();
+    const dune::FelixFragment flxfrag(frag);
+    const clock_type::time_point t1 = clock_type::now();
+    job.integrity = dune::FelixCheckIntegrity(flxfrag);
+    const clock_type::time_point t2 = clock_type::now();
+    // Decoding is part of the benchmark even without output.
+    flxfrag.get_all_ADCs(job.adcs);
+    const clock_type::time_point t3 = clock_type::now();
+    job.stage_seconds[stage_decompress] += seconds(t0, t1);
+    job.stage_seconds[stage_validate] += seconds(t1, t2);
+    job.stage_seconds[stage_decode] += seconds(t2, t3);
+    if (decode_adcs) {
+      job.header.timestamp = flxfrag.timestamp();
+      job.header.fragment_id = frag.fragmentID();
+      job.header.crate_no = flxfrag.crate_no();
+      job.header.slot_no = flxfrag.slot_no();
+      job.header.fiber_no = flxfrag.fiber_no();
+      job.header.num_channels = dune::FelixFrame::num_ch_per_frame;
+      job.header.num_samples = flxfrag.total_frames();
+      job.header.errors = job.integrity.errors;
+    }
+  };
+  std::function<void(unsigned)> run_job = [&](const unsigned j) {
+    Job& job = jobs[j];
+    job.error = nullptr;
+    try {
+      decode_job(job, batch[j]);
+    } catch (...) {
+      job.error = std::current_exception();
+    }
+  };
+
+  dune::FelixIntegritySummary summary;
+  size_t num_frags = 0;
+  double input_bytes = 0, decoded_bytes = 0;
+  double read_seconds = 0;
+  double stage_seconds[num_stages] = {};
+
+  const clock_type::time_point start = clock_type::now();
+  try {
+    dune::FelixEventStream events(filenames, tag, max_buffered);
+    std::vector<artdaq::Fragment> frags;
+    while (true) {
+      const clock_type::time_point t0 = clock_type::now();
+      if (!events.next(frags)) break;
+      read_seconds += seconds(t0, clock_type::now());
+
+      for (size_t first = 0; first < frags.size(); first += batch_size) {
+        const size_t num_jobs = std::min(batch_size, frags.size() - first);
+        batch = frags.data() + first;
+        if (pool) {
+          pool->run(num_jobs, run_job);
+        } else {
+          for (unsigned j = 0; j < num_jobs; ++j) run_job(j);
+        }
+
+        // Write and count in fragment order.
+        const clock_type::time_point t1 = clock_type::now();
+        for (unsigned j = 0; j < num_jobs; ++j) {
+          const Job& job = jobs[j];
+          if (job.error) std::rethrow_exception(job.error);
+          summary.add(job.integrity);
+          input_bytes += batch[j].dataSizeBytes();
+          decoded_bytes += job.adcs.size() * sizeof(dune::adc_t);
+          if (decode_adcs) {
+            outfile.write(reinterpret_cast<const char*>(&job.header),
+                          sizeof(job.header));
+            outfile.write(reinterpret_cast<const char*>(job.adcs.data()),
+                          job.adcs.size() * sizeof(dune::adc_t));
+          }
+        }
+        stage_seconds[stage_write] += seconds(t1, clock_type::now());
+        num_frags += num_jobs;
+      }
+
+      if (!quiet) {
+        std::cout << "Event " << events.events_read() << ", " << num_frags
+                  << " fragments decoded.\r" << std::flush;
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cout << "\nERROR: " << e.what() << '\n';
+    return 1;
+  }
+  const double total_seconds = seconds(start, clock_type::now());
+  if (outfile.is_open()) {
+    outfile.close();
+    if (!outfile) {
+      std::cout << "ERROR: writing " << output << " failed.\n";
+      return 1;
+    }
+  }
+  for (const Job& job : jobs) {
+    for (unsigned s = 0; s < stage_write; ++s) {
+      stage_seconds[s] += job.stage_seconds[s];
+    }
   }
 
-  flxdec.check_all_timestamps();
-  flxdec.check_all_CCCs();
-  flxdec.check_all_IDs();
+  // Report.
+  const double MB = 1024. * 1024.;
+  std::cout << '\n'
+            << "Decoded " << num_frags << " fragments with " << num_threads
+            << (num_threads > 1 ? " threads" : " thread") << " in "
+            << total_seconds << " s.\n"
+            << "Throughput: " << num_frags / total_seconds << " fragments/s, "
+            << input_bytes / MB / total_seconds << " MB/s input, "
+            << decoded_bytes / MB / total_seconds << " MB/s decoded.\n"
+            << "Waiting for input: " << read_seconds << " s.\n"
+            << "Stage times, summed over threads:\n";
+  for (unsigned s = 0; s < num_stages; ++s) {
+    std::cout << "  " << std::left << std::setw(12) << stage_names[s]
+              << std::right << std::setw(12) << stage_seconds[s] << " s"
+              << std::setw(12)
+              << (num_frags ? 1e3 * stage_seconds[s] / num_frags : 0.)
+              << " ms/fragment\n";
+  }
 
-  // // Print RMS values to file.
-  // flxdec.analyse(destination);
+  std::cout << summary.bad_fragments << " out of " << summary.fragments
+            << " fragments have errors, " << summary.frames
+            << " frames decoded.\n";
+  bool header_errors = false;
+  for (unsigned k = 0; k < dune::FelixIntegrity::num_errors; ++k) {
+    if (summary.fragment_counts[k] == 0) {
+      continue;
+    }
+    header_errors |= (1 << k) & dune::FelixIntegrity::header_errors;
+    std::cout << "  " << dune::FelixIntegrity::error_name(k) << ": "
+              << summary.fragment_counts[k] << " fragments, "
+              << summary.frame_counts[k] << " frames.\n";
+  }
 
-  return 0;
+  return header_errors ? 2 : 0;
 }
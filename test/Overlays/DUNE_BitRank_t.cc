@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "dunepdlegacy/Overlays/BitRank.hh"
+
+#define BOOST_TEST_MODULE(BitRank_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+namespace {
+
+// Random bitfield of num_bits bits with roughly one in density bits set,
+// followed by set bits that must not be counted.
+std::vector<uint8_t> make_bits(const size_t num_bits, const unsigned density) {
+  std::mt19937 gen(num_bits + density);
+  std::vector<uint8_t> bits((num_bits + 7) / 8, 0);
+  for (size_t i = 0; i < num_bits; ++i) {
+    if (gen() % density == 0) bits[i / 8] |= 1 << (i % 8);
+  }
+  if (num_bits % 8) bits.back() |= 0xFF << (num_bits % 8);
+  return bits;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(BitRank_test)
+
+BOOST_AUTO_TEST_CASE(RankTest) {
+  for (const size_t num_bits :
+       {0, 1, 63, 64, 449, 511, 512, 513, 961, 1013, 1023, 6000}) {
+    for (const unsigned density : {1, 2, 50}) {
+      const std::vector<uint8_t> bits = make_bits(num_bits, density);
+      const dune::BitRank rank(bits.data(), num_bits);
+      BOOST_REQUIRE_EQUAL(rank.size(), num_bits);
+      size_t count = 0;
+      for (size_t i = 0; i < num_bits; ++i) {
+        BOOST_REQUIRE_EQUAL(rank.rank(i), count);
+        BOOST_REQUIRE_EQUAL(rank.test(i), ((bits[i / 8] >> (i % 8)) & 1) != 0);
+        count += rank.test(i);
+      }
+      BOOST_REQUIRE_EQUAL(rank.rank(num_bits), count);
+      BOOST_REQUIRE_EQUAL(rank.count(), count);
+
+      const dune::BitRank copy(rank);
+      BOOST_REQUIRE_EQUAL(copy.count(), count);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ThreadTest) {
+  const size_t num_bits = 100000;
+  const std::vector<uint8_t> bits = make_bits(num_bits, 7);
+  const dune::BitRank reference(bits.data(), num_bits);
+  const dune::BitRank rank(bits.data(), num_bits);
+
+  // The index is built by whichever thread comes first.
+  std::vector<size_t> counts(4);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < counts.size(); ++t) {
+    threads.emplace_back([&, t] {
+      for (size_t i = t; i < num_bits; i += 997) {
+        if (rank.rank(i) == reference.rank(i)) ++counts[t];
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (unsigned t = 0; t < counts.size(); ++t) {
+    BOOST_REQUIRE_EQUAL(counts[t], (num_bits - t + 996) / 997);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
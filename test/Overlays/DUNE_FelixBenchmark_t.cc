@@ -0,0 +1,278 @@
+// Throughput of the FELIX kernels on synthetic data. Every stage is timed
+// and checked against the generated values, and the results are written as
+// JSON. The environment controls the run:
+//   FELIX_BENCHMARK_FRAMES     frames per fragment (6000)
+//   FELIX_BENCHMARK_SECONDS    minimum time spent per measurement (0.2)
+//   FELIX_BENCHMARK_OUTPUT     file to write the results to
+//                              (FelixBenchmark.json in the temp directory)
+//   FELIX_BENCHMARK_BASELINE   results of an earlier run; the test fails if
+//                              a stage got slower than the tolerance allows
+//   FELIX_BENCHMARK_TOLERANCE  allowed relative slowdown (0.25)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dunepdlegacy/Overlays/FelixCompress.hh"
+#include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixIntegrity.hh"
+#include "dunepdlegacy/Overlays/FelixReorder.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
+#include "dunepdlegacy/Overlays/FelixSynthetic.hh"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+
+#define BOOST_TEST_MODULE(FelixBenchmark_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+namespace {
+
+double env_double(const char* name, const double fallback) {
+  const char* value = getenv(name);
+  return value ? atof(value) : fallback;
+}
+
+std::string env_string(const char* name, const std::string& fallback) {
+  const char* value = getenv(name);
+  return value ? value : fallback;
+}
+
+const char* isa_name(const dune::FelixReorder::ISA isa) {
+  switch (isa) {
+    case dune::FelixReorder::ISA::avx512: return "avx512";
+    case dune::FelixReorder::ISA::avx2: return "avx2";
+    default: return "baseline";
+  }
+}
+
+// Collects the best time of repeated runs of every stage. Throughput is
+// given in terms of the raw frames a stage handles.
+class Benchmark {
+ public:
+  struct Result {
+    std::string name;
+    double seconds;
+    unsigned frames;
+    size_t bytes;
+
+    double frames_per_s() const { return frames / seconds; }
+    double mb_per_s() const { return bytes / seconds * 1e-6; }
+  };
+
+  Benchmark(const double min_seconds) : min_seconds_(min_seconds) {}
+
+  void run(const std::string& name, const unsigned frames,
+           const std::function<void()>& stage) {
+    using clock = std::chrono::steady_clock;
+    double best = 1e30, total = 0;
+    for (unsigned i = 0; i < 3 || total < min_seconds_; ++i) {
+      const auto start = clock::now();
+      stage();
+      const double t =
+          std::chrono::duration<double>(clock::now() - start).count();
+      best = std::min(best, t);
+      total += t;
+    }
+    results_.push_back({name, best, frames, frames * sizeof(dune::FelixFrame)});
+    printf("%-20s %10.1f MB/s %12.0f frames/s\n", name.c_str(),
+           results_.back().mb_per_s(), results_.back().frames_per_s());
+  }
+
+  const std::vector<Result>& results() const { return results_; }
+
+  // One result per line, which read_baseline relies on.
+  void write(const std::string& path,
+             const std::map<std::string, std::string>& info) const {
+    std::ofstream out(path);
+    out << "{\n";
+    for (const auto& i : info) {
+      out << "  \"" << i.first << "\": \"" << i.second << "\",\n";
+    }
+    out << "  \"results\": {\n";
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const Result& r = results_[i];
+      char line[256];
+      snprintf(line, sizeof(line),
+               "    \"%s\": {\"mb_per_s\": %.3f, \"frames_per_s\": %.1f, "
+               "\"seconds\": %.9f}%s\n",
+               r.name.c_str(), r.mb_per_s(), r.frames_per_s(), r.seconds,
+               i + 1 < results_.size() ? "," : "");
+      out << line;
+    }
+    out << "  }\n}\n";
+  }
+
+  // Throughput in MB/s of every stage in a file written by write.
+  static std::map<std::string, double> read_baseline(const std::string& path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+      const size_t open = line.find('"');
+      const size_t close = line.find('"', open + 1);
+      const size_t value = line.find("\"mb_per_s\":");
+      if (open == std::string::npos || close == std::string::npos ||
+          value == std::string::npos) {
+        continue;
+      }
+      baseline[line.substr(open + 1, close - open - 1)] =
+          atof(line.c_str() + value + strlen("\"mb_per_s\":"));
+    }
+    return baseline;
+  }
+
+ private:
+  const double min_seconds_;
+  std::vector<Result> results_;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(FelixBenchmark_test)
+
+BOOST_AUTO_TEST_CASE(SyntheticTest) {
+  dune::FelixSyntheticConfig config;
+  config.num_frames = env_double("FELIX_BENCHMARK_FRAMES", 6000);
+  const dune::FelixSynthetic synthetic(config);
+  const unsigned frames = synthetic.num_frames();
+  const std::unique_ptr<artdaq::Fragment> raw(synthetic.fragment());
+  const dune::FelixFragment flxfrg(*raw);
+  BOOST_REQUIRE(!synthetic.faulty_frames().empty());
+  // Only the faulty frames have header errors, and none in the convert
+  // counts.
+  const dune::FelixIntegrity integrity = dune::FelixCheckIntegrity(flxfrg);
+  BOOST_REQUIRE(integrity.good(dune::FelixIntegrity::ccc_step |
+                               dune::FelixIntegrity::ccc_mismatch));
+  BOOST_REQUIRE_EQUAL(integrity.first_bad_frame,
+                      synthetic.faulty_frames().front());
+
+  Benchmark bench(env_double("FELIX_BENCHMARK_SECONDS", 0.2));
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  printf("%u synthetic frames, %s\n", frames, isa_name(cpu));
+
+  // Reordering with every kernel the CPU supports, which must agree.
+  std::vector<uint8_t> reference(dune::FelixReorderMaxSize(frames));
+  std::vector<uint8_t> reordered(reference.size());
+  unsigned num_faulty = 0;
+  bench.run("reorder_baseline", frames, [&] {
+    num_faulty = 0;
+    dune::FelixReorder::do_reorder(reference.data(), synthetic.frames(), frames,
+                                   &num_faulty);
+  });
+  BOOST_REQUIRE_EQUAL(num_faulty, synthetic.faulty_frames().size());
+  const size_t reordered_size =
+      dune::FelixReorder::calculate_reordered_size(frames, num_faulty);
+  if (dune::FelixReorder::avx_available()) {
+    bench.run("reorder_avx2", frames, [&] {
+      num_faulty = 0;
+      dune::FelixReorder::do_avx_reorder(reordered.data(), synthetic.frames(),
+                                         frames, &num_faulty);
+    });
+    BOOST_REQUIRE(memcmp(reordered.data(), reference.data(), reordered_size) ==
+                  0);
+  }
+  if (dune::FelixReorder::avx512_available()) {
+    bench.run("reorder_avx512", frames, [&] {
+      num_faulty = 0;
+      dune::FelixReorder::do_avx512_reorder(reordered.data(),
+                                            synthetic.frames(), frames,
+                                            &num_faulty);
+    });
+    BOOST_REQUIRE(memcmp(reordered.data(), reference.data(), reordered_size) ==
+                  0);
+  }
+
+  std::vector<uint8_t> rebuilt(synthetic.size_bytes());
+  bench.run("unreorder", frames, [&] {
+    dune::FelixReorder::unreorder(rebuilt.data(), reference.data(), frames);
+  });
+  BOOST_REQUIRE(memcmp(rebuilt.data(), synthetic.frames(), rebuilt.size()) ==
+                0);
+
+  // Compression round trip, of the same samples with the convert counts
+  // the compressor predicts, so that only the faulty frames store headers.
+  dune::FelixSyntheticConfig comp_config = config;
+  comp_config.convert_count_step = 25;
+  const dune::FelixSynthetic comp_synthetic(comp_config);
+  const std::unique_ptr<artdaq::Fragment> comp_raw(comp_synthetic.fragment());
+  const dune::FelixFragment comp_flxfrg(*comp_raw);
+  std::vector<char> compressed;
+  bench.run("compress", frames,
+            [&] { compressed = dune::FelixCompress(comp_flxfrg); });
+  artdaq::Fragment decompressed;
+  bench.run("decompress", frames,
+            [&] { decompressed = dune::FelixDecompress(compressed); });
+  BOOST_REQUIRE_EQUAL(decompressed.dataSizeBytes(),
+                      comp_synthetic.size_bytes());
+  BOOST_REQUIRE(memcmp(decompressed.dataBeginBytes(), comp_synthetic.frames(),
+                       comp_synthetic.size_bytes()) == 0);
+  printf("compression factor %.2f\n",
+         (double)comp_synthetic.size_bytes() / compressed.size());
+
+  // Access to single values and bulk decoding of raw and reordered data.
+  artdaq::Fragment reordered_frag;
+  dune::ReorderFacility facility;
+  BOOST_REQUIRE(dune::FelixReorder(reordered_frag, synthetic.frames(), frames,
+                                   facility));
+  reordered_frag.setTimestamp(raw->timestamp());
+  const dune::FelixFragment reordfrg(reordered_frag);
+  uint64_t expected_sum = 0;
+  for (size_t i = 0; i < 256ul * frames; ++i) {
+    expected_sum += synthetic.adcs()[i];
+  }
+  std::vector<dune::adc_t> adcs(256ul * frames);
+  for (const auto& layout : {std::make_pair("raw", &flxfrg),
+                             std::make_pair("reordered", &reordfrg)}) {
+    const dune::FelixFragment& frag = *layout.second;
+    uint64_t sum = 0;
+    bench.run(std::string("get_ADC_") + layout.first, frames, [&] {
+      sum = 0;
+      for (unsigned i = 0; i < frames; ++i) {
+        for (unsigned ch = 0; ch < 256; ++ch) {
+          sum += frag.get_ADC(i, ch);
+        }
+      }
+    });
+    BOOST_REQUIRE_EQUAL(sum, expected_sum);
+
+    bench.run(std::string("decode_") + layout.first, frames,
+              [&] { frag.get_ADC_block(adcs.data(), frames, 0, frames); });
+    BOOST_REQUIRE(std::equal(adcs.begin(), adcs.end(), synthetic.adcs()));
+  }
+
+  std::ostringstream frames_str;
+  frames_str << frames;
+  const std::filesystem::path output =
+      std::filesystem::temp_directory_path() / "FelixBenchmark.json";
+  bench.write(env_string("FELIX_BENCHMARK_OUTPUT", output.string()),
+              {{"frames", frames_str.str()}, {"isa", isa_name(cpu)}});
+
+  // Regressions against a stored baseline.
+  const std::string baseline_path = env_string("FELIX_BENCHMARK_BASELINE", "");
+  if (baseline_path.empty()) return;
+  const auto baseline = Benchmark::read_baseline(baseline_path);
+  BOOST_REQUIRE_MESSAGE(!baseline.empty(),
+                        "no results in baseline " << baseline_path);
+  const double tolerance = env_double("FELIX_BENCHMARK_TOLERANCE", 0.25);
+  for (const auto& r : bench.results()) {
+    const auto b = baseline.find(r.name);
+    if (b == baseline.end()) continue;
+    BOOST_CHECK_MESSAGE(r.mb_per_s() >= (1 - tolerance) * b->second,
+                        r.name << " dropped from " << b->second << " to "
+                               << r.mb_per_s() << " MB/s");
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,86 @@
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "dunepdlegacy/Overlays/FelixChannelStats.hh"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+
+#define BOOST_TEST_MODULE(MilliSlice_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+BOOST_AUTO_TEST_SUITE(FelixChannelStats_test)
+
+BOOST_AUTO_TEST_CASE(StatsTest) {
+  // The sample count is no multiple of the kernel width to exercise the
+  // tails, and large enough to widen the kernel's sums several times.
+  const size_t samples = 6007;
+  const size_t stride = samples + 5;
+  std::vector<dune::adc_t> adcs(256 * stride);
+  std::mt19937 gen(samples);
+  for (unsigned ch = 0; ch < 256; ++ch) {
+    std::normal_distribution<double> noise(ch * 16, 1 + ch % 7);
+    for (size_t i = 0; i < samples; ++i) {
+      adcs[ch * stride + i] =
+          std::min(4095., std::max(0., std::round(noise(gen))));
+    }
+  }
+  adcs[3 * stride + 17] = 4095;
+  adcs[3 * stride + samples - 1] = 0;
+
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  for (auto isa :
+       {dune::FelixReorder::ISA::baseline, dune::FelixReorder::ISA::avx2}) {
+    dune::FelixReorder::set_isa(isa);
+    dune::FelixChannelStats stats(true);
+    stats.add(adcs.data(), stride, samples);
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      const dune::adc_t* row = adcs.data() + ch * stride;
+      double sum = 0;
+      for (size_t i = 0; i < samples; ++i) sum += row[i];
+      const double mean = sum / samples;
+      double sumsq = 0;
+      for (size_t i = 0; i < samples; ++i) {
+        sumsq += (row[i] - mean) * (row[i] - mean);
+      }
+      BOOST_REQUIRE_EQUAL(stats.count(ch), samples);
+      BOOST_REQUIRE_EQUAL(stats.sum(ch), (uint64_t)sum);
+      BOOST_REQUIRE_CLOSE(stats.mean(ch) + 1, mean + 1, 1e-9);
+      BOOST_REQUIRE_CLOSE(stats.rms(ch), sqrt(sumsq / samples), 1e-6);
+      BOOST_REQUIRE_EQUAL(stats.min(ch), *std::min_element(row, row + samples));
+      BOOST_REQUIRE_EQUAL(stats.max(ch), *std::max_element(row, row + samples));
+      const uint64_t* hist = stats.histogram(ch);
+      BOOST_REQUIRE_EQUAL(std::accumulate(hist, hist + 4096, uint64_t(0)),
+                          samples);
+      BOOST_REQUIRE_EQUAL(hist[row[0]], std::count(row, row + samples, row[0]));
+    }
+    BOOST_REQUIRE_EQUAL(stats.min(3), 0);
+    BOOST_REQUIRE_EQUAL(stats.max(3), 4095);
+  }
+  dune::FelixReorder::set_isa(cpu);
+
+  // Partial results from frame and channel ranges merge exactly.
+  dune::FelixChannelStats whole(true), first(true), second(true);
+  whole.add(adcs.data(), stride, samples);
+  first.add(adcs.data(), stride, 1000);
+  second.add(adcs.data() + 1000, stride, samples - 1000, 0, 128);
+  second.add(adcs.data() + 1000, stride, samples - 1000, 128, 256);
+  first.merge(second);
+  for (unsigned ch = 0; ch < 256; ++ch) {
+    BOOST_REQUIRE_EQUAL(first.count(ch), whole.count(ch));
+    BOOST_REQUIRE_EQUAL(first.mean(ch), whole.mean(ch));
+    BOOST_REQUIRE_EQUAL(first.variance(ch), whole.variance(ch));
+    BOOST_REQUIRE_EQUAL(first.min(ch), whole.min(ch));
+    BOOST_REQUIRE_EQUAL(first.max(ch), whole.max(ch));
+    BOOST_REQUIRE(std::equal(first.histogram(ch), first.histogram(ch) + 4096,
+                             whole.histogram(ch)));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma GCC diagnostic pop
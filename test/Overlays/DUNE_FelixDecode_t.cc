@@ -1,7 +1,13 @@
  #include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include "art/Framework/Principal/Handle.h"
 #include "artdaq-core/Data/Fragment.hh"
@@ -17,6 +23,30 @@
 #define BOOST_TEST_MODULE(MilliSlice_t)
 #include "cetlib/quiet_unit_test.hpp"
 
+namespace {
+
+// Event reader handing out num_events events, event n holding
+// fragments[n % size] fragments whose sequence IDs count the fragments read.
+// read counts the events read so far.
+dune::FelixEventStream::EventReader make_reader(
+    const unsigned num_events, const std::vector<unsigned>& fragments,
+    std::atomic<unsigned>& read) {
+  unsigned next_id = 0;
+  return [=, &read](std::vector<artdaq::Fragment>& frags) mutable {
+    if (read == num_events) {
+      return false;
+    }
+    for (unsigned f = 0; f < fragments[read % fragments.size()]; ++f) {
+      frags.emplace_back(1);
+      frags.back().setSequenceID(next_id++);
+    }
+    ++read;
+    return true;
+  };
+}
+
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(FelixDecode_test)
 
 BOOST_AUTO_TEST_CASE(BaselineTest) {
@@ -153,6 +183,114 @@ BOOST_AUTO_TEST_CASE(BaselineTest) {
   // flxdec.printFrames(3, 5, 7);
 }
 
+BOOST_AUTO_TEST_CASE(CheckTest) {
+  // The fragment overloads of the checks serve streamed events, which are
+  // not stored in a decoder.
+  const unsigned frames = 16;
+  dune::FelixFragmentBase::Metadata meta = {0xabc, 1, 0, 0, frames, 0, frames};
+  std::unique_ptr<artdaq::Fragment> frag(artdaq::Fragment::FragmentBytes(
+      frames * sizeof(dune::FelixFrame), 1, 1, dune::toFragmentType("FELIX"),
+      meta));
+  dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame*>(frag->dataBeginBytes());
+  for (unsigned i = 0; i < frames; ++i) {
+    memset(frame + i, 0, sizeof(dune::FelixFrame));
+    frame[i].set_fiber_no(1);
+    frame[i].set_crate_no(6);
+    frame[i].set_slot_no(3);
+    frame[i].set_timestamp(0x1000 + 25 * i);
+    for (unsigned b = 0; b < 4; ++b) {
+      frame[i].set_coldata_convert_count(b, i);
+    }
+  }
+  BOOST_REQUIRE(dune::FelixDecoder::check_timestamps(*frag));
+  BOOST_REQUIRE(dune::FelixDecoder::check_CCCs(*frag));
+  BOOST_REQUIRE(dune::FelixDecoder::check_IDs(*frag));
+
+  frame[5].set_timestamp(0x1000 + 25 * 5 + 1);
+  frame[9].set_coldata_convert_count(0, 0);
+  frame[12].set_slot_no(4);
+  BOOST_REQUIRE(!dune::FelixDecoder::check_timestamps(*frag));
+  BOOST_REQUIRE(!dune::FelixDecoder::check_CCCs(*frag));
+  BOOST_REQUIRE(!dune::FelixDecoder::check_IDs(*frag));
+}
+
+BOOST_AUTO_TEST_CASE(StreamBackPressureTest) {
+  // The reader must stop once max_buffered fragments are waiting, holding
+  // at most the event it has just read, so that whole runs fit in memory.
+  // An event larger than the window still passes once the queue is empty.
+  const unsigned max_buffered = 4;
+  const std::vector<unsigned> fragments = {1, 2, 1, 6, 0, 3};
+  const unsigned num_events = 60;
+  std::atomic<unsigned> read(0);
+  dune::FelixEventStream events(make_reader(num_events, fragments, read),
+                                max_buffered);
+
+  // Three events fill the window; the fourth waits on the reader thread.
+  for (unsigned i = 0; i < 500 && read < 4; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  BOOST_REQUIRE_EQUAL(read, 4u);
+
+  std::vector<artdaq::Fragment> frags;
+  unsigned next_id = 0;
+  for (unsigned e = 0; e < num_events; ++e) {
+    // All events read before the last one are queued or handed out, and
+    // only this thread takes them, so the queue is known exactly.
+    const unsigned was_read = read;
+    unsigned waiting = 0;
+    for (unsigned r = events.events_read(); r + 1 < was_read; ++r) {
+      waiting += fragments[r % fragments.size()];
+    }
+    BOOST_REQUIRE(waiting <= max_buffered ||
+                  events.events_read() + 2 == was_read);
+
+    BOOST_REQUIRE(events.next(frags));
+    BOOST_REQUIRE_EQUAL(frags.size(), fragments[e % fragments.size()]);
+    for (const auto& frag : frags) {
+      BOOST_REQUIRE_EQUAL(frag.sequenceID(), next_id++);
+    }
+  }
+  BOOST_REQUIRE(!events.next(frags));
+  BOOST_REQUIRE_EQUAL(events.events_read(), num_events);
+
+  // A stream destroyed with the reader waiting on a full window stops it.
+  read = 0;
+  {
+    dune::FelixEventStream unread(make_reader(num_events, {1}, read),
+                                  max_buffered);
+    for (unsigned i = 0; i < 500 && read < max_buffered + 1; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  BOOST_REQUIRE_EQUAL(read, max_buffered + 1);
+}
+
+BOOST_AUTO_TEST_CASE(StreamErrorTest) {
+  // An error on the reader thread reaches the consumer from next(), after
+  // the events read before it.
+  std::atomic<unsigned> read(0);
+  dune::FelixEventStream::EventReader good = make_reader(10, {2}, read);
+  dune::FelixEventStream events(
+      [&](std::vector<artdaq::Fragment>& frags) {
+        if (read == 3) {
+          throw std::runtime_error("Unreadable event");
+        }
+        return good(frags);
+      },
+      2);
+
+  std::vector<artdaq::Fragment> frags;
+  for (unsigned e = 0; e < 3; ++e) {
+    BOOST_REQUIRE(events.next(frags));
+    BOOST_REQUIRE_EQUAL(frags.size(), 2u);
+  }
+  BOOST_REQUIRE_THROW(events.next(frags), std::runtime_error);
+  BOOST_REQUIRE_THROW(events.next(frags), std::runtime_error);
+  BOOST_REQUIRE_EQUAL(events.events_read(), 3u);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #pragma GCC diagnostic pop
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <random>
 #include <string>
 #include <vector>
 #include "artdaq-core/Data/Fragment.hh"
@@ -17,6 +18,40 @@
 #define BOOST_TEST_MODULE(MilliSlice_t)
 #include "cetlib/quiet_unit_test.hpp"
 
+namespace {
+
+// A FELIX fragment of frames with timestamps and convert counts 25 apart, as
+// FelixCompress expects, and Gaussian noise of the given rms around a
+// pedestal of base + slope * ch for channel ch. The generator is seeded with
+// the frame count.
+std::unique_ptr<artdaq::Fragment> make_fragment(const unsigned frames,
+                                                const int base, const int slope,
+                                                const double rms) {
+  dune::FelixFragmentBase::Metadata meta = {0xabc, 1, 0, 0, frames, 0, frames};
+  std::unique_ptr<artdaq::Fragment> frag_ptr(artdaq::Fragment::FragmentBytes(
+      frames * sizeof(dune::FelixFrame), 1, 1, dune::toFragmentType("FELIX"),
+      meta));
+  dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+  std::mt19937 gen(frames);
+  std::normal_distribution<double> noise(0, rms);
+  for (unsigned i = 0; i < frames; ++i) {
+    memset(frame + i, 0, sizeof(dune::FelixFrame));
+    frame[i].set_timestamp(0x100000 + 25 * i);
+    for (unsigned j = 0; j < 4; ++j) {
+      frame[i].set_coldata_convert_count(j, 25 * i);
+    }
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      frame[i].set_channel(ch,
+                           (base + slope * (int)ch + (int)noise(gen)) & 0xfff);
+    }
+  }
+  frag_ptr->setTimestamp(0x100000);
+  return frag_ptr;
+}
+
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(FelixFragment_test)
 
 BOOST_AUTO_TEST_CASE(BaselineTest) {
@@ -204,6 +239,236 @@ BOOST_AUTO_TEST_CASE(BaselineTest) {
   std::cout << "### WOOF WOOF -> Done...\n";
 }
 
+BOOST_AUTO_TEST_CASE(RoundTripTest) {
+  // A full-size fragment of typical noise, with a few frames whose headers
+  // do not follow from the first and have to be stored separately.
+  const unsigned frames = 6000;
+  std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frames, 500, 3, 4);
+  dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+  frame[1234].set_wib_errors(5);
+  frame[4321].set_timestamp(0);
+  frame[4321].set_error_register(2, 7);
+  dune::FelixFragment flxfrg(*frag_ptr);
+
+  std::vector<char> compfrg(dune::FelixCompress(flxfrg));
+  artdaq::Fragment decompfrg(dune::FelixDecompress(compfrg));
+  BOOST_REQUIRE_EQUAL(decompfrg.dataSizeBytes(), frag_ptr->dataSizeBytes());
+
+  const dune::FelixFrame* decomp =
+      reinterpret_cast<dune::FelixFrame const*>(decompfrg.dataBeginBytes());
+  for (unsigned i = 0; i < frames; ++i) {
+    BOOST_REQUIRE_EQUAL(decomp[i].timestamp(), frame[i].timestamp());
+    BOOST_REQUIRE_EQUAL(decomp[i].wib_errors(), frame[i].wib_errors());
+    for (unsigned j = 0; j < 4; ++j) {
+      BOOST_REQUIRE_EQUAL(decomp[i].coldata_convert_count(j),
+                          frame[i].coldata_convert_count(j));
+      BOOST_REQUIRE_EQUAL(decomp[i].error_register(j),
+                          frame[i].error_register(j));
+    }
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      BOOST_REQUIRE_EQUAL(decomp[i].channel(ch), frame[i].channel(ch));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PartialDecompressTest) {
+  // Wide noise gives channel streams of different lengths, so a channel
+  // decoded on its own has to start at its recorded offset.
+  const unsigned frames = 3000;
+  const std::unique_ptr<artdaq::Fragment> frag_ptr =
+      make_fragment(frames, 2048, 7, 20);
+  const dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame const*>(frag_ptr->dataBeginBytes());
+  dune::FelixFragment flxfrg(*frag_ptr);
+
+  std::vector<char> compfrg(dune::FelixCompress(flxfrg));
+  dune::FelixDecompressor decompressor(compfrg);
+  BOOST_REQUIRE(decompressor.independent_channels());
+  BOOST_REQUIRE_EQUAL(decompressor.num_frames(), frames);
+
+  // Single channels, including the last one whose stream ends the buffer.
+  for (unsigned ch : {0u, 17u, 128u, 255u}) {
+    std::vector<dune::adc_t> adcs(frames);
+    decompressor.decompress_channel(ch, adcs.data());
+    for (unsigned i = 0; i < frames; ++i) {
+      BOOST_REQUIRE_EQUAL(adcs[i], frame[i].channel(ch));
+    }
+  }
+
+  // A range of channels spread over a pool of threads.
+  dune::ReorderThreadPool pool(3);
+  const unsigned first = 40, last = 200;
+  std::vector<dune::adc_t> rows((last - first) * frames);
+  decompressor.decompress_channels(rows.data(), frames, first, last, &pool);
+  for (unsigned ch = first; ch < last; ++ch) {
+    for (unsigned i = 0; i < frames; ++i) {
+      BOOST_REQUIRE_EQUAL(rows[(ch - first) * frames + i],
+                          frame[i].channel(ch));
+    }
+  }
+
+  // The full fragment is the same with and without the pool.
+  artdaq::Fragment serial(decompressor.decompress());
+  artdaq::Fragment parallel(dune::FelixDecompress(compfrg, &pool));
+  BOOST_REQUIRE_EQUAL(parallel.dataSizeBytes(), frag_ptr->dataSizeBytes());
+  BOOST_REQUIRE(memcmp(serial.dataBeginBytes(), frag_ptr->dataBeginBytes(),
+                       frag_ptr->dataSizeBytes()) == 0);
+  BOOST_REQUIRE(memcmp(parallel.dataBeginBytes(), frag_ptr->dataBeginBytes(),
+                       frag_ptr->dataSizeBytes()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(PredictionTest) {
+  // Pedestals spread over the whole range, the lowest so close to zero that
+  // the noise wraps them around when subtracted.
+  const unsigned frames = 2000;
+  const std::unique_ptr<artdaq::Fragment> frag_ptr =
+      make_fragment(frames, 4, 13, 5);
+  dune::FelixFragment flxfrg(*frag_ptr);
+
+  dune::ReorderThreadPool pool(1);
+  std::map<dune::Prediction, size_t> sizes;
+  for (auto prediction : {dune::Prediction::raw, dune::Prediction::previous,
+                          dune::Prediction::pedestal}) {
+    std::vector<char> compfrg(dune::FelixCompress(flxfrg, prediction));
+    sizes[prediction] = compfrg.size();
+    dune::FelixDecompressor decompressor(compfrg);
+    BOOST_REQUIRE(decompressor.prediction_mode() == prediction);
+    BOOST_REQUIRE_EQUAL(decompressor.version(), 3u);
+
+    artdaq::Fragment decompfrg(decompressor.decompress(&pool));
+    BOOST_REQUIRE_EQUAL(decompfrg.dataSizeBytes(), frag_ptr->dataSizeBytes());
+    BOOST_REQUIRE(memcmp(decompfrg.dataBeginBytes(),
+                         frag_ptr->dataBeginBytes(),
+                         frag_ptr->dataSizeBytes()) == 0);
+  }
+  // Noise around a pedestal is best described by the pedestal.
+  BOOST_CHECK_LT(sizes[dune::Prediction::previous],
+                 sizes[dune::Prediction::raw]);
+  BOOST_CHECK_LT(sizes[dune::Prediction::pedestal],
+                 sizes[dune::Prediction::previous]);
+}
+
+BOOST_AUTO_TEST_CASE(UnknownFormatTest) {
+  // Only the metadata and the prediction mode are changed, so any small
+  // valid fragment serves.
+  const std::unique_ptr<artdaq::Fragment> frag_ptr =
+      make_fragment(64, 800, 1, 3);
+  dune::FelixFragment flxfrg(*frag_ptr);
+  const std::vector<char> compfrg(dune::FelixCompress(flxfrg));
+  dune::FelixDecompressor decompressor(compfrg);
+
+  // Versions that were never written, or only by a later writer.
+  for (unsigned version : {0u, 4u, dune::MetaData::max_version}) {
+    std::vector<char> changed(compfrg);
+    dune::MetaData* meta = reinterpret_cast<dune::MetaData*>(changed.data());
+    meta->set_version(version);
+    BOOST_REQUIRE_THROW(dune::FelixDecompressor{changed}, cet::exception);
+  }
+  // Prediction modes past the known ones.
+  for (unsigned mode : {3u, 255u}) {
+    std::vector<char> changed(compfrg);
+    changed[sizeof(dune::MetaData)] = mode;
+    BOOST_REQUIRE_THROW(dune::FelixDecompressor{changed}, cet::exception);
+  }
+  BOOST_REQUIRE_THROW(dune::FelixDecompressor(compfrg.data(), 2),
+                      cet::exception);
+}
+
+BOOST_AUTO_TEST_CASE(TruncatedTest) {
+  // Faulty headers make the header sets part of the size checks.
+  const unsigned frames = 100;
+  std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frames, 700, 2, 3);
+  dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+  frame[9].set_wib_errors(1);
+  frame[99].set_timestamp(0);
+  dune::FelixFragment flxfrg(*frag_ptr);
+  const std::vector<char> compfrg(dune::FelixCompress(flxfrg));
+
+  // Everything up to the encoded stream has to be present, and each channel
+  // has to start within what is left. The channels that do start decode
+  // without reading past the data.
+  dune::MetaData meta;
+  memcpy(&meta, compfrg.data(), sizeof(meta));
+  const size_t header_set_size =
+      sizeof(dune::WIBHeader) + 4 * sizeof(dune::ColdataHeader);
+  const size_t stream_start = sizeof(meta) + 1 + frames / 8 + 1 +
+                              3 * header_set_size + meta.unique_values * 6 +
+                              256 * sizeof(uint32_t);
+  std::vector<dune::adc_t> adcs(frames);
+  for (size_t size = 0; size < compfrg.size(); ++size) {
+    const std::vector<char> truncated(compfrg.begin(), compfrg.begin() + size);
+    if (size < stream_start) {
+      BOOST_REQUIRE_THROW(dune::FelixDecompressor{truncated}, cet::exception);
+      continue;
+    }
+    try {
+      dune::FelixDecompressor decompressor(truncated);
+      decompressor.decompress_channel(255, adcs.data());
+    } catch (const cet::exception&) {
+    }
+  }
+
+  // Faulty frame fields marking the first frame or frames past the last.
+  for (unsigned bit : {0u, frames, frames / 8 * 8 + 7}) {
+    std::vector<char> changed(compfrg);
+    changed[sizeof(meta) + 1 + bit / 8] |= 1 << (bit % 8);
+    BOOST_REQUIRE_THROW(dune::FelixDecompressor{changed}, cet::exception);
+  }
+  // Channel offsets out of order or past the stream.
+  const size_t offsets = stream_start - 256 * sizeof(uint32_t);
+  for (uint32_t offset : {0u, 0xffffffffu}) {
+    std::vector<char> changed(compfrg);
+    memcpy(&changed[offsets + 100 * sizeof(offset)], &offset, sizeof(offset));
+    BOOST_REQUIRE_THROW(dune::FelixDecompressor{changed}, cet::exception);
+  }
+  // More unique values than 12-bit values, or none for a nonempty fragment.
+  for (unsigned unique_values : {0u, 4097u}) {
+    std::vector<char> changed(compfrg);
+    dune::MetaData* changed_meta =
+        reinterpret_cast<dune::MetaData*>(changed.data());
+    changed_meta->unique_values = unique_values;
+    BOOST_REQUIRE_THROW(dune::FelixDecompressor{changed}, cet::exception);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EmptyTest) {
+  // A fragment without frames has no values to build a Huffman tree from.
+  const dune::FelixFrame frame = {};
+  dune::ReorderThreadPool pool(1);
+  for (auto prediction : {dune::Prediction::raw, dune::Prediction::previous,
+                          dune::Prediction::pedestal}) {
+    const std::vector<char> compfrg(dune::FelixCompress(
+        reinterpret_cast<uint8_t const*>(&frame), 0, prediction));
+    dune::FelixDecompressor decompressor(compfrg);
+    BOOST_REQUIRE_EQUAL(decompressor.num_frames(), 0u);
+    decompressor.decompress_channel(0, nullptr);
+    artdaq::Fragment decompfrg(decompressor.decompress(&pool));
+    BOOST_REQUIRE_EQUAL(decompfrg.dataSizeBytes(), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MetaDataTest) {
+  // Metadata words written with the two-bit version field read the same.
+  for (uint32_t v = 1; v <= 3; ++v) {
+    const uint32_t word = v | 8191u << 2 | 6000u << 16;
+    dune::MetaData meta;
+    memcpy(&meta, &word, sizeof(meta));
+    BOOST_REQUIRE_EQUAL(meta.version(), v);
+    BOOST_REQUIRE_EQUAL(meta.unique_values, 8191u);
+    BOOST_REQUIRE_EQUAL(meta.num_frames, 6000u);
+  }
+  // Later versions fit without touching the other fields.
+  for (unsigned v = 1; v <= dune::MetaData::max_version; ++v) {
+    dune::MetaData meta = {0, 8191, 0, 6000};
+    meta.set_version(v);
+    BOOST_REQUIRE_EQUAL(meta.version(), v);
+    BOOST_REQUIRE_EQUAL(meta.unique_values, 8191u);
+    BOOST_REQUIRE_EQUAL(meta.num_frames, 6000u);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #pragma GCC diagnostic pop
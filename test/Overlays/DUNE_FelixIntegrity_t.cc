@@ -0,0 +1,223 @@
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "artdaq-core/Data/Fragment.hh"
+#include "dunepdlegacy/Overlays/FelixFragment.hh"
+#include "dunepdlegacy/Overlays/FelixIntegrity.hh"
+#include "dunepdlegacy/Overlays/FelixReordererFacility.hh"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+
+#define BOOST_TEST_MODULE(MilliSlice_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+namespace {
+
+// Frames with consecutive headers whose timestamps cross a 32-bit boundary
+// and whose convert counts wrap around.
+std::unique_ptr<artdaq::Fragment> make_fragment(const unsigned frames) {
+  const uint64_t first_timestamp = 0x1fffff000;
+  dune::FelixFragmentBase::Metadata meta = {0xabc, 1, 0, 0, frames, 0, frames};
+  std::unique_ptr<artdaq::Fragment> frag_ptr(artdaq::Fragment::FragmentBytes(
+      frames * sizeof(dune::FelixFrame), 1, 1, dune::toFragmentType("FELIX"),
+      meta));
+  frag_ptr->setTimestamp(first_timestamp);
+  dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+  for (unsigned i = 0; i < frames; ++i) {
+    memset(frame + i, 0, sizeof(dune::FelixFrame));
+    frame[i].set_fiber_no(1);
+    frame[i].set_crate_no(6);
+    frame[i].set_slot_no(3);
+    frame[i].set_z(1);
+    frame[i].set_timestamp(first_timestamp + 25 * i);
+    frame[i].set_wib_counter(7);
+    for (unsigned b = 0; b < 4; ++b) {
+      frame[i].set_coldata_convert_count(b, 65000 + i);
+    }
+  }
+  return frag_ptr;
+}
+
+// Errors of each frame from the frame accessors, one frame at a time.
+std::vector<uint16_t> reference_errors(const dune::FelixFrame* frame,
+                                       const unsigned frames) {
+  std::vector<uint16_t> errors(frames, 0);
+  for (unsigned i = 0; i < frames; ++i) {
+    uint16_t& e = errors[i];
+    if (i > 0) {
+      if (frame[i].timestamp() - frame[i - 1].timestamp() != 25) {
+        e |= dune::FelixIntegrity::timestamp_step;
+      }
+      for (unsigned b : {0, 2}) {
+        const int step = frame[i].coldata_convert_count(b) -
+                         frame[i - 1].coldata_convert_count(b);
+        if (step != 1 && step != -65535 && step != -33919) {
+          e |= dune::FelixIntegrity::ccc_step;
+        }
+      }
+    }
+    if (frame[i].coldata_convert_count(0) !=
+            frame[i].coldata_convert_count(1) ||
+        frame[i].coldata_convert_count(2) !=
+            frame[i].coldata_convert_count(3)) {
+      e |= dune::FelixIntegrity::ccc_mismatch;
+    }
+    if (frame[i].fiber_no() != frame[0].fiber_no()) {
+      e |= dune::FelixIntegrity::fiber_changed;
+    }
+    if (frame[i].crate_no() != frame[0].crate_no()) {
+      e |= dune::FelixIntegrity::crate_changed;
+    }
+    if (frame[i].slot_no() != frame[0].slot_no()) {
+      e |= dune::FelixIntegrity::slot_changed;
+    }
+    if (frame[i].wib_errors() || frame[i].mm() || frame[i].oos()) {
+      e |= dune::FelixIntegrity::wib_error;
+    }
+  }
+  return errors;
+}
+
+void require_equal(const dune::FelixIntegrity& result,
+                   const std::vector<uint16_t>& errors) {
+  dune::FelixIntegrity expected;
+  expected.num_frames = errors.size();
+  for (unsigned i = 0; i < errors.size(); ++i) {
+    expected.flag(i, errors[i]);
+  }
+  BOOST_REQUIRE_EQUAL(result.num_frames, expected.num_frames);
+  BOOST_REQUIRE_EQUAL(result.errors, expected.errors);
+  BOOST_REQUIRE_EQUAL(result.first_bad_frame, expected.first_bad_frame);
+  for (unsigned k = 0; k < dune::FelixIntegrity::num_errors; ++k) {
+    BOOST_REQUIRE_EQUAL(result.frame_counts[k], expected.frame_counts[k]);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(FelixIntegrity_test)
+
+BOOST_AUTO_TEST_CASE(GoodTest) {
+  const unsigned frames = 1013;
+  std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frames);
+  const dune::FelixFrame* frame =
+      reinterpret_cast<const dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  for (auto isa :
+       {dune::FelixReorder::ISA::baseline, dune::FelixReorder::ISA::avx2}) {
+    dune::FelixReorder::set_isa(isa);
+    const dune::FelixIntegrity result =
+        dune::FelixCheckIntegrity(dune::FelixFragment(*frag_ptr));
+    BOOST_REQUIRE(result.good());
+    require_equal(result, reference_errors(frame, frames));
+  }
+  dune::FelixReorder::set_isa(cpu);
+
+  artdaq::Fragment reordered(
+      dune::FelixReorder(frag_ptr->dataBeginBytes(), frames));
+  BOOST_REQUIRE(dune::FelixCheckIntegrity(dune::FelixFragment(reordered)).good());
+}
+
+BOOST_AUTO_TEST_CASE(ErrorTest) {
+  // Errors in the vectorised part and in the scalar tail.
+  const unsigned frames = 1013;
+  std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frames);
+  dune::FelixFrame* frame =
+      reinterpret_cast<dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+  frame[100].set_timestamp(frame[100].timestamp() + 1);
+  frame[205].set_coldata_convert_count(1, 3);
+  frame[333].set_crate_no(5);
+  frame[500].set_wib_errors(0x40);
+  frame[501].set_oos(1);
+  frame[640].set_z(0);
+  frame[701].set_coldata_convert_count(2, 12);
+  frame[701].set_coldata_convert_count(3, 12);
+  for (unsigned i = 300; i < frames; ++i) {
+    frame[i].set_coldata_convert_count(0, 65000 + i - 33920);
+    frame[i].set_coldata_convert_count(1, 65000 + i - 33920);
+  }
+  frame[1010].set_fiber_no(2);
+  frame[1012].set_slot_no(1);
+  const std::vector<uint16_t> errors = reference_errors(frame, frames);
+  BOOST_REQUIRE_EQUAL(errors[300], 0);
+
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  for (auto isa :
+       {dune::FelixReorder::ISA::baseline, dune::FelixReorder::ISA::avx2}) {
+    dune::FelixReorder::set_isa(isa);
+    const dune::FelixIntegrity result =
+        dune::FelixCheckIntegrity(dune::FelixFragment(*frag_ptr));
+    BOOST_REQUIRE(!result.good());
+    BOOST_REQUIRE(!result.good(dune::FelixIntegrity::header_errors));
+    BOOST_REQUIRE_EQUAL(result.first_bad_frame, 100);
+    require_equal(result, errors);
+  }
+  dune::FelixReorder::set_isa(cpu);
+
+  // Reordered fragments only store the faulty headers but give the same
+  // result.
+  artdaq::Fragment reordered(
+      dune::FelixReorder(frag_ptr->dataBeginBytes(), frames));
+  require_equal(dune::FelixCheckIntegrity(dune::FelixFragment(reordered)),
+                errors);
+
+  // Only the WIB errors are left.
+  std::unique_ptr<artdaq::Fragment> wib_ptr = make_fragment(frames);
+  reinterpret_cast<dune::FelixFrame*>(wib_ptr->dataBeginBytes())[7]
+      .set_mm(1);
+  const dune::FelixIntegrity wib =
+      dune::FelixCheckIntegrity(dune::FelixFragment(*wib_ptr));
+  BOOST_REQUIRE_EQUAL(wib.errors, dune::FelixIntegrity::wib_error);
+  BOOST_REQUIRE(wib.good(dune::FelixIntegrity::header_errors));
+}
+
+BOOST_AUTO_TEST_CASE(ScannerTest) {
+  const unsigned frames = 600;
+  std::vector<artdaq::Fragment> frags;
+  std::vector<std::vector<uint16_t>> errors;
+  for (unsigned f = 0; f < 12; ++f) {
+    std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frames);
+    dune::FelixFrame* frame =
+        reinterpret_cast<dune::FelixFrame*>(frag_ptr->dataBeginBytes());
+    if (f % 3 == 1) frame[f * 40].set_timestamp(0);
+    if (f % 4 == 2) frame[f * 30 + 1].set_slot_no(0);
+    errors.push_back(reference_errors(frame, frames));
+    if (f % 2) {
+      frags.push_back(dune::FelixReorder(frag_ptr->dataBeginBytes(), frames));
+    } else {
+      frags.push_back(*frag_ptr);
+    }
+  }
+
+  dune::FelixIntegrityScanner serial;
+  dune::FelixIntegrityScanner parallel(4);
+  std::vector<dune::FelixIntegrity> serial_results, parallel_results;
+  serial.scan(frags, serial_results);
+  parallel.scan(frags, parallel_results);
+  parallel.scan(frags, parallel_results);
+  for (unsigned f = 0; f < frags.size(); ++f) {
+    require_equal(serial_results[f], errors[f]);
+    require_equal(parallel_results[f], errors[f]);
+  }
+
+  const dune::FelixIntegritySummary& summary = serial.summary();
+  BOOST_REQUIRE_EQUAL(summary.fragments, frags.size());
+  BOOST_REQUIRE_EQUAL(summary.frames, frags.size() * frames);
+  BOOST_REQUIRE_EQUAL(summary.bad_fragments, 6);
+  BOOST_REQUIRE_EQUAL(summary.fragment_counts[0], 4);
+  BOOST_REQUIRE_EQUAL(summary.frame_counts[0], 8);
+  BOOST_REQUIRE_EQUAL(summary.fragment_counts[5], 3);
+  BOOST_REQUIRE_EQUAL(summary.frame_counts[5], 3);
+  BOOST_REQUIRE_EQUAL(parallel.summary().fragments, 2 * frags.size());
+  BOOST_REQUIRE_EQUAL(parallel.summary().frame_counts[0], 16);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <complex>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "dunepdlegacy/Overlays/FelixNoiseSpectrum.hh"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+
+#define BOOST_TEST_MODULE(MilliSlice_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+BOOST_AUTO_TEST_SUITE(FelixNoiseSpectrum_test)
+
+BOOST_AUTO_TEST_CASE(PlanTest) {
+  // Compare a batch of transforms with a direct DFT.
+  const size_t n = 256;
+  const unsigned lanes = dune::FelixFFTPlan::lanes;
+  dune::FelixFFTPlan plan(n);
+  BOOST_REQUIRE_EQUAL(plan.num_bins(), n / 2 + 1);
+  std::vector<dune::adc_t> adcs(lanes * n);
+  std::mt19937 gen(n);
+  for (auto& adc : adcs) {
+    adc = gen() & 0xfff;
+  }
+  bool skip[lanes] = {};
+  skip[1] = true;
+
+  std::vector<float> re(plan.work_size()), im(plan.work_size());
+  std::vector<float> mags(plan.num_bins() * lanes);
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  for (auto isa :
+       {dune::FelixReorder::ISA::baseline, dune::FelixReorder::ISA::avx2}) {
+    dune::FelixReorder::set_isa(isa);
+    plan.magnitudes(adcs.data(), n, skip, re.data(), im.data(), mags.data());
+    for (unsigned l = 0; l < lanes; ++l) {
+      for (size_t k = 0; k < plan.num_bins(); ++k) {
+        std::complex<double> x = 0;
+        for (size_t i = 0; i < n && !skip[l]; ++i) {
+          x += std::polar<double>(adcs[l * n + i], -2 * M_PI * k * i / n);
+        }
+        BOOST_REQUIRE_SMALL(mags[k * lanes + l] - std::abs(x),
+                            1e-5 * std::abs(x) + 1e-2);
+      }
+    }
+  }
+  dune::FelixReorder::set_isa(cpu);
+}
+
+BOOST_AUTO_TEST_CASE(FEMBTest) {
+  // A sine in every channel of the second FEMB of slot 1, fiber 2.
+  const size_t samples = 6000;
+  std::vector<dune::adc_t> adcs(256 * samples);
+  std::mt19937 gen(samples);
+  for (unsigned ch = 0; ch < 256; ++ch) {
+    for (size_t i = 0; i < samples; ++i) {
+      adcs[ch * samples + i] = 1000 + (gen() & 0x7) +
+                               (ch >= 128 ? 100 * sin(2 * M_PI * i / 64) : 0);
+    }
+  }
+
+  dune::FelixNoiseSpectrum serial(samples);
+  BOOST_REQUIRE_EQUAL(dune::FelixNoiseSpectrum::fft_size(samples), 4096u);
+  BOOST_REQUIRE(serial.add(adcs.data(), samples, 6));
+  BOOST_REQUIRE_EQUAL(serial.count(6), 1u);
+  BOOST_REQUIRE_EQUAL(serial.count(7), 1u);
+  const std::vector<double> noise = serial.spectrum(6);
+  const std::vector<double> signal = serial.spectrum(7);
+  BOOST_REQUIRE_EQUAL(signal.size(), 2049u);
+  BOOST_REQUIRE_CLOSE(noise[0], signal[0], 0.1);
+  BOOST_REQUIRE_CLOSE(signal[4096 / 64], 100 * 4096 / 2., 1.);
+  BOOST_REQUIRE_LT(noise[4096 / 64], 1000);
+
+  // Threads and merging give the same spectra, skipped channels count
+  // towards the average without contributing.
+  dune::FelixNoiseSpectrum parallel(samples, 4), merged(samples);
+  std::vector<bool> skip(256, false);
+  std::fill(skip.begin() + 128, skip.begin() + 192, true);
+  BOOST_REQUIRE(parallel.add(adcs.data(), samples, 6, skip));
+  merged.merge(parallel);
+  merged.merge(serial);
+  BOOST_REQUIRE_EQUAL(merged.count(7), 2u);
+  const std::vector<double> skipped = parallel.spectrum(7);
+  const std::vector<double> both = merged.spectrum(7);
+  BOOST_REQUIRE(parallel.spectrum(6) == noise);
+  for (size_t k = 0; k < signal.size(); ++k) {
+    BOOST_REQUIRE_CLOSE(both[k], (signal[k] + skipped[k]) / 2, 1e-6);
+  }
+  BOOST_REQUIRE_CLOSE(skipped[4096 / 64], signal[4096 / 64] / 2, 1.);
+
+  // Too few samples or unknown FEMBs are refused.
+  BOOST_REQUIRE(!serial.add(adcs.data(), 4000, 6));
+  BOOST_REQUIRE(!serial.add(adcs.data(), samples, 19));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma GCC diagnostic pop
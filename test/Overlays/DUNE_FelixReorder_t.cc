@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "dunepdlegacy/Overlays/FelixFragment.hh"
@@ -12,6 +18,44 @@
 #define BOOST_TEST_MODULE(MilliSlice_t)
 #include "cetlib/quiet_unit_test.hpp"
 
+namespace {
+
+// Frames with timestamps 25 apart, convert counts counting up by one from
+// first_ccc as FelixReorder expects, and random ADC values. The generator is
+// seeded with the frame count.
+std::vector<dune::FelixFrame> make_frames(const unsigned frames,
+                                          const unsigned first_ccc = 0) {
+  std::vector<dune::FelixFrame> frame(frames);
+  std::mt19937 gen(frames);
+  for (unsigned i = 0; i < frames; ++i) {
+    memset(&frame[i], 0, sizeof(dune::FelixFrame));
+    frame[i].set_timestamp(0x100000 + 25 * i);
+    for (unsigned j = 0; j < 4; ++j) {
+      frame[i].set_coldata_convert_count(j, first_ccc + i);
+    }
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      frame[i].set_channel(ch, gen() & 0xfff);
+    }
+  }
+  return frame;
+}
+
+// A FELIX fragment holding a copy of the frames.
+std::unique_ptr<artdaq::Fragment> make_fragment(
+    const std::vector<dune::FelixFrame>& frame) {
+  const unsigned frames = frame.size();
+  dune::FelixFragmentBase::Metadata meta = {0xabc, 1, 0, 0, frames, 0, frames};
+  std::unique_ptr<artdaq::Fragment> frag_ptr(artdaq::Fragment::FragmentBytes(
+      frames * sizeof(dune::FelixFrame), 1, 1, dune::toFragmentType("FELIX"),
+      meta));
+  memcpy(frag_ptr->dataBeginBytes(), frame.data(),
+         frames * sizeof(dune::FelixFrame));
+  if (frames > 0) frag_ptr->setTimestamp(frame[0].timestamp());
+  return frag_ptr;
+}
+
+}  // namespace
+
 BOOST_AUTO_TEST_SUITE(FelixReorder_test)
 
 BOOST_AUTO_TEST_CASE(BaselineTest) {
@@ -170,6 +214,337 @@ BOOST_AUTO_TEST_CASE(BaselineTest) {
   } // Loop over files.
 }
 
+BOOST_AUTO_TEST_CASE(UnpackTest) {
+  // A stride longer than the frame count checks that the unpackers write
+  // rows at the stride and leave the padding alone. With 1013 frames the
+  // SIMD unpackers also finish with a partial block.
+  const unsigned frames = 1013;
+  const std::vector<dune::FelixFrame> frame = make_frames(frames);
+  const std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frame);
+
+  // Every kernel this build provides must agree with the frame accessors.
+  const size_t stride = frames + 3;
+  std::vector<uint16_t> baseline(256 * stride), simd(256 * stride);
+  BOOST_REQUIRE(dune::FelixReorder::do_unpack(
+      baseline.data(), frag_ptr->dataBeginBytes(), frames, stride));
+  for (unsigned i = 0; i < frames; ++i) {
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      BOOST_REQUIRE_EQUAL(baseline[ch * stride + i], frame[i].channel(ch));
+    }
+  }
+  if (dune::FelixReorder::do_avx_unpack(
+          simd.data(), frag_ptr->dataBeginBytes(), frames, stride)) {
+    BOOST_REQUIRE(simd == baseline);
+  }
+  if (dune::FelixReorder::do_avx512_unpack(
+          simd.data(), frag_ptr->dataBeginBytes(), frames, stride)) {
+    BOOST_REQUIRE(simd == baseline);
+  }
+
+  // The bulk accessors of both layouts return the same buffer.
+  dune::FelixFragment flxfrg(*frag_ptr);
+  artdaq::Fragment reordfrg(
+      dune::FelixReorder(frag_ptr->dataBeginBytes(), frames));
+  dune::FelixFragment reordflxfrg(reordfrg);
+  dune::adc_aligned_v unordered_adcs, reordered_adcs;
+  flxfrg.get_all_ADCs(unordered_adcs);
+  reordflxfrg.get_all_ADCs(reordered_adcs);
+  BOOST_REQUIRE_EQUAL(unordered_adcs.size(), 256 * frames);
+  BOOST_REQUIRE(unordered_adcs == reordered_adcs);
+  for (unsigned ch = 0; ch < 256; ++ch) {
+    BOOST_REQUIRE(std::equal(unordered_adcs.begin() + ch * frames,
+                             unordered_adcs.begin() + (ch + 1) * frames,
+                             baseline.begin() + ch * stride));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(DispatchTest) {
+  const unsigned frames = 301;
+  const std::vector<dune::FelixFrame> frame = make_frames(frames);
+  const uint8_t* src = reinterpret_cast<uint8_t const*>(frame.data());
+
+  // Reference results of the baseline kernels.
+  const size_t reord_size =
+      dune::FelixReorder::calculate_reordered_size(frames, frames);
+  std::vector<uint8_t> reord_ref(reord_size), reord(reord_size);
+  dune::ReorderFacility baseline(true);
+  baseline.do_reorder_start(frames);
+  BOOST_REQUIRE(baseline.do_reorder(reord_ref.data(), src, frames));
+  std::vector<uint16_t> unpack_ref(256 * frames), unpacked(256 * frames);
+  BOOST_REQUIRE(
+      dune::FelixReorder::do_unpack(unpack_ref.data(), src, frames, frames));
+
+  // Every instruction set the CPU supports gives the same results.
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  for (auto isa : {dune::FelixReorder::ISA::baseline,
+                   dune::FelixReorder::ISA::avx2,
+                   dune::FelixReorder::ISA::avx512}) {
+    dune::FelixReorder::set_isa(isa);
+    BOOST_REQUIRE(dune::FelixReorder::isa() == std::min(isa, cpu));
+    BOOST_REQUIRE_EQUAL(
+        dune::FelixReorder::do_avx_unpack(unpacked.data(), src, frames, frames),
+        dune::FelixReorder::avx_available());
+
+    dune::ReorderFacility facility;
+    facility.do_reorder_start(frames);
+    std::fill(reord.begin(), reord.end(), 0);
+    BOOST_REQUIRE(facility.do_reorder(reord.data(), src, frames));
+    BOOST_REQUIRE_EQUAL(facility.m_num_faulty_frames,
+                        baseline.m_num_faulty_frames);
+    BOOST_REQUIRE(reord == reord_ref);
+
+    std::fill(unpacked.begin(), unpacked.end(), 0);
+    dune::FelixReorder::unpack(unpacked.data(), src, frames, frames);
+    BOOST_REQUIRE(unpacked == unpack_ref);
+  }
+  dune::FelixReorder::set_isa(cpu);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelReorderTest) {
+  // Frame counts that split evenly into the ranges and ones that do not.
+  for (const unsigned frames : {513u, 4097u, 6000u, 6145u}) {
+    std::vector<dune::FelixFrame> frame = make_frames(frames);
+    // Faulty headers around range boundaries and in bitfield bytes, and in
+    // the last frame.
+    for (unsigned i : {1u, 7u, 8u, 255u, 256u, 1000u, 1001u, 2999u, 5999u,
+                       frames - 1}) {
+      if (i < frames) frame[i].set_wib_errors(i & 0xffff);
+    }
+    for (unsigned i = 4000; i < 4100 && i < frames; i += 3) {
+      frame[i].set_timestamp(0);
+    }
+    const uint8_t* src = reinterpret_cast<uint8_t const*>(frame.data());
+
+    const size_t size =
+        dune::FelixReorder::calculate_reordered_size(frames, frames);
+    std::vector<uint8_t> serial(size), parallel(size);
+    dune::ReorderFacility serial_facility;
+    serial_facility.do_reorder_start(frames);
+    BOOST_REQUIRE(serial_facility.do_reorder(serial.data(), src, frames));
+    if (frames == 6000) {
+      BOOST_REQUIRE_EQUAL(serial_facility.m_num_faulty_frames, 43u);
+    }
+
+    // The pool is reused for consecutive fragments.
+    dune::ReorderFacility parallel_facility(false, 4);
+    for (unsigned rep = 0; rep < 3; ++rep) {
+      std::fill(parallel.begin(), parallel.end(), 0xa5);
+      parallel_facility.do_reorder_start(frames);
+      BOOST_REQUIRE(parallel_facility.do_reorder(parallel.data(), src, frames));
+      BOOST_REQUIRE_EQUAL(parallel_facility.m_num_faulty_frames,
+                          serial_facility.m_num_faulty_frames);
+      BOOST_REQUIRE_EQUAL(parallel_facility.reorder_final_size(),
+                          serial_facility.reorder_final_size());
+      BOOST_REQUIRE(std::equal(
+          serial.begin(), serial.begin() + serial_facility.reorder_final_size(),
+          parallel.begin()));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPoolTest) {
+  dune::ReorderThreadPool pool(3);
+  const unsigned jobs = 64;
+
+  // Concurrent callers each get all their jobs run exactly once.
+  std::vector<std::vector<unsigned>> counts(4, std::vector<unsigned>(jobs));
+  std::vector<std::thread> callers;
+  for (unsigned c = 0; c < counts.size(); ++c) {
+    callers.emplace_back([&, c] {
+      for (unsigned rep = 0; rep < 200; ++rep) {
+        pool.run(jobs, [&](unsigned i) { ++counts[c][i]; });
+      }
+    });
+  }
+  for (auto& caller : callers) caller.join();
+  for (const auto& count : counts) {
+    BOOST_REQUIRE(std::all_of(count.begin(), count.end(),
+                              [](unsigned n) { return n == 200; }));
+  }
+
+  // A job may use the pool it runs on.
+  std::vector<std::atomic<unsigned>> nested(jobs * jobs);
+  pool.run(jobs, [&](unsigned i) {
+    pool.run(jobs, [&](unsigned j) { ++nested[i * jobs + j]; });
+  });
+  BOOST_REQUIRE(std::all_of(nested.begin(), nested.end(),
+                            [](const std::atomic<unsigned>& n) { return n == 1; }));
+
+  // An exception thrown by a job on any thread reaches the caller, and the
+  // pool stays usable afterwards.
+  for (unsigned thrower = 0; thrower < jobs; thrower += 7) {
+    BOOST_REQUIRE_THROW(pool.run(jobs,
+                                 [&](unsigned i) {
+                                   if (i == thrower) throw std::runtime_error("job");
+                                 }),
+                        std::runtime_error);
+    std::vector<std::atomic<unsigned>> after(jobs);
+    pool.run(jobs, [&](unsigned i) { ++after[i]; });
+    BOOST_REQUIRE(std::all_of(after.begin(), after.end(),
+                              [](const std::atomic<unsigned>& n) { return n == 1; }));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(UnreorderTest) {
+  // Convert counts that wrap past 0xffff must be rebuilt from the first
+  // header, and faulty headers, one of them in the last frame, from their
+  // own. The last block of frames is a partial one for every kernel.
+  const unsigned frames = 1013;
+  std::vector<dune::FelixFrame> frame = make_frames(frames, 0xfff0);
+  for (auto& f : frame) f.set_crate_no(3);
+  for (unsigned i : {5u, 6u, 100u, 1012u}) {
+    frame[i].set_wib_errors(i);
+  }
+  frame[500].set_timestamp(0);
+  frame[501].set_error_register(1, 3);
+  const uint8_t* src = reinterpret_cast<uint8_t const*>(frame.data());
+
+  std::vector<uint8_t> reord(
+      dune::FelixReorder::calculate_reordered_size(frames, frames));
+  dune::ReorderFacility facility;
+  facility.do_reorder_start(frames);
+  BOOST_REQUIRE(facility.do_reorder(reord.data(), src, frames));
+  BOOST_REQUIRE_EQUAL(facility.m_num_faulty_frames, 6u);
+
+  // Every instruction set the CPU supports rebuilds the original frames.
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  std::vector<uint8_t> rebuilt(frames * sizeof(dune::FelixFrame));
+  for (auto isa : {dune::FelixReorder::ISA::baseline,
+                   dune::FelixReorder::ISA::avx2,
+                   dune::FelixReorder::ISA::avx512}) {
+    dune::FelixReorder::set_isa(isa);
+    std::fill(rebuilt.begin(), rebuilt.end(), 0xff);
+    dune::FelixReorder::unreorder(rebuilt.data(), reord.data(), frames);
+    BOOST_REQUIRE(memcmp(rebuilt.data(), frame.data(), rebuilt.size()) == 0);
+  }
+  dune::FelixReorder::set_isa(cpu);
+}
+
+BOOST_AUTO_TEST_CASE(PackFramesTest) {
+  // Frames built field by field, with a timestamp and convert counts that
+  // wrap within the frames.
+  const unsigned frames = 77;
+  std::vector<dune::FelixFrame> frame(frames);
+  std::vector<uint16_t> adcs(frames * 256);
+  std::mt19937 gen(frames);
+  for (unsigned i = 0; i < frames; ++i) {
+    memset(&frame[i], 0, sizeof(dune::FelixFrame));
+    frame[i].set_crate_no(5);
+    frame[i].set_slot_no(2);
+    frame[i].set_z(i >= frames / 2);
+    frame[i].set_wib_counter(0x1234);
+    frame[i].set_timestamp(0xffffffffff00ull + 25 * i);
+    for (unsigned j = 0; j < 4; ++j) {
+      frame[i].set_error_register(j, j);
+      frame[i].set_hdr(j, 1, 7);
+      frame[i].set_coldata_convert_count(j, 0xffe0 + j + 3 * i);
+    }
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      adcs[i * 256 + ch] = gen() & 0xfff;
+      frame[i].set_channel(ch, adcs[i * 256 + ch]);
+    }
+  }
+  const unsigned half = frames / 2;
+
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  std::vector<dune::FelixFrame> built(frames);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(built.data());
+  for (auto isa : {dune::FelixReorder::ISA::baseline,
+                   dune::FelixReorder::ISA::avx2,
+                   dune::FelixReorder::ISA::avx512}) {
+    dune::FelixReorder::set_isa(isa);
+    memset(dst, 0xff, frames * sizeof(dune::FelixFrame));
+    dune::FelixReorder::pack_frames(dst, adcs.data(), frames);
+    dune::FelixReorder::fill_headers(
+        dst, reinterpret_cast<uint8_t const*>(&frame[0]), half, 0, 25, 3);
+    dune::FelixReorder::fill_headers(
+        dst + half * sizeof(dune::FelixFrame),
+        reinterpret_cast<uint8_t const*>(&frame[0]), frames - half, half, 25,
+        3);
+    // The second half has a 48 bit timestamp.
+    BOOST_REQUIRE(memcmp(built.data(), frame.data(),
+                         half * sizeof(dune::FelixFrame)) == 0);
+    dune::FelixReorder::fill_headers(
+        dst + half * sizeof(dune::FelixFrame),
+        reinterpret_cast<uint8_t const*>(&frame[half]), frames - half, 0, 25,
+        3);
+    BOOST_REQUIRE(memcmp(built.data(), frame.data(),
+                         frames * sizeof(dune::FelixFrame)) == 0);
+  }
+  dune::FelixReorder::set_isa(cpu);
+}
+
+BOOST_AUTO_TEST_CASE(ReuseTest) {
+  const unsigned frames = 600;
+  std::vector<dune::FelixFrame> frame = make_frames(frames);
+  frame[300].set_wib_errors(1);
+  const uint8_t* src = reinterpret_cast<uint8_t const*>(frame.data());
+  artdaq::Fragment reference(dune::FelixReorder(src, frames));
+
+  // Caller buffers must be able to hold the worst case.
+  dune::ReorderFacility facility;
+  std::vector<uint8_t> buffer(dune::FelixReorderMaxSize(frames));
+  BOOST_REQUIRE_EQUAL(
+      dune::FelixReorder(buffer.data(), buffer.size() - 1, src, frames,
+                         facility),
+      0u);
+  // The fragment rounds its size up to words; the buffer gets the exact size.
+  const size_t size = dune::FelixReorder(buffer.data(), buffer.size(), src,
+                                         frames, facility);
+  BOOST_REQUIRE_EQUAL((size + 7) / 8 * 8, reference.dataSizeBytes());
+  BOOST_REQUIRE(memcmp(buffer.data(), reference.dataBeginBytes(), size) == 0);
+
+  // Pooled fragments keep their allocation.
+  dune::ReorderFragmentPool pool;
+  std::unique_ptr<artdaq::Fragment> fragment = pool.acquire();
+  BOOST_REQUIRE(dune::FelixReorder(*fragment, src, frames, facility));
+  const uint8_t* data = fragment->dataBeginBytes();
+  pool.release(std::move(fragment));
+  BOOST_REQUIRE_EQUAL(pool.size(), 1u);
+  fragment = pool.acquire();
+  BOOST_REQUIRE_EQUAL(pool.size(), 0u);
+  BOOST_REQUIRE(dune::FelixReorder(*fragment, src, frames, facility));
+  BOOST_REQUIRE(fragment->dataBeginBytes() == data);
+  BOOST_REQUIRE_EQUAL(fragment->dataSizeBytes(), reference.dataSizeBytes());
+  BOOST_REQUIRE(memcmp(fragment->dataBeginBytes(), reference.dataBeginBytes(),
+                       reference.dataSizeBytes()) == 0);
+  BOOST_REQUIRE(*fragment->metadata<dune::FelixFragmentBase::Metadata>() ==
+                *reference.metadata<dune::FelixFragmentBase::Metadata>());
+}
+
+BOOST_AUTO_TEST_CASE(VisitTest) {
+  const unsigned frames = 300;
+  const std::vector<dune::FelixFrame> frame = make_frames(frames);
+  const std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frame);
+
+  dune::FelixFragment flxfrg(*frag_ptr);
+  artdaq::Fragment reordfrg(
+      dune::FelixReorder(frag_ptr->dataBeginBytes(), frames));
+  reordfrg.setTimestamp(frame[0].timestamp());
+  dune::FelixFragment reordflxfrg(reordfrg);
+
+  // The visitor sees the concrete layout and agrees with the accessors.
+  for (const dune::FelixFragment* f : {&flxfrg, &reordflxfrg}) {
+    const bool reordered = f == &reordflxfrg;
+    const uint64_t sum = f->visit([&](auto const& l) {
+      typedef std::decay_t<decltype(l)> layout_type;
+      BOOST_REQUIRE_EQUAL(
+          (std::is_same<layout_type, dune::FelixFragmentReordered>::value),
+          reordered);
+      uint64_t result = 0;
+      for (unsigned i = 0; i < l.total_frames(); ++i) {
+        result += l.get_ADC(i + f->trigger_offset(), 17) + l.timestamp(i);
+      }
+      return result;
+    });
+    uint64_t expected = 0;
+    for (unsigned i = 0; i < frames; ++i) {
+      expected += frame[i].channel(17) + frame[i].timestamp();
+    }
+    BOOST_REQUIRE_EQUAL(sum, expected);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #pragma GCC diagnostic pop
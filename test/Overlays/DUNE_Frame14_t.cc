@@ -0,0 +1,384 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "artdaq-core/Data/Fragment.hh"
+#include "cetlib_except/exception.h"
+#include "dunepdlegacy/Overlays/Frame14Format.hh"
+#include "dunepdlegacy/Overlays/Frame14Fragment.hh"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+
+#define BOOST_TEST_MODULE(MilliSlice_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+namespace {
+
+// Pack 128 samples of 14 bits into 56 words.
+void pack14(const uint16_t *samples, uint32_t *packed) {
+  memset(packed, 0, 56 * sizeof(uint32_t));
+  for (size_t i = 0; i < 128; ++i) {
+    for (size_t b = 0; b < 14; ++b) {
+      const size_t bit = i * 14 + b;
+      packed[bit / 32] |= uint32_t((samples[i] >> b) & 1) << (bit % 32);
+    }
+  }
+}
+
+// Frames of noise around channel pedestals with consecutive timestamps,
+// some of them with headers that differ from the first.
+std::vector<dune::frame14::frame14> make_frames(const unsigned frames) {
+  std::mt19937 gen(frames);
+  std::normal_distribution<double> noise(0, 4);
+  std::vector<dune::frame14::frame14> frame(frames);
+  uint16_t samples[256];
+  for (unsigned f = 0; f < frames; ++f) {
+    memset(&frame[f], 0, sizeof(frame[f]));
+    frame[f].start_frame = 0x3c;
+    frame[f].crate_num = 4;
+    frame[f].frame_version = 2;
+    frame[f].slot_num = 3;
+    frame[f].fiber_num = 1;
+    frame[f].femb_valid = 3;
+    frame[f].link_mask = 0xff;
+    frame[f].wib_data = 0x1234;
+    frame[f].timestamp = 0x7ffffff00 + dune::frame14::timestamp_step * f;
+    frame[f].crc20 = gen() & 0xFFFFF;
+    frame[f].flex12 = 0x5a;
+    frame[f].eof = 0xdc;
+    frame[f].flex24 = 0x10203;
+    frame[f].idle_frame = 0xbc;
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      samples[ch] = (1000 + 30 * ch + (int)round(noise(gen))) & 0x3FFF;
+    }
+    pack14(samples, frame[f].femb_a_seg);
+    pack14(samples + 128, frame[f].femb_b_seg);
+  }
+  if (frames > 40) {
+    frame[1].timestamp += 1;
+    frame[17].link_mask = 0x7f;
+    frame[32].flex24 = 0;
+    frame[frames - 1].wib_data = 0;
+  }
+  return frame;
+}
+
+std::unique_ptr<artdaq::Fragment> make_fragment(
+    const std::vector<dune::frame14::frame14>& frame) {
+  const unsigned frames = frame.size();
+  dune::Frame14Fragment::Metadata meta = {0xabc, 1, 0, 0, frames, 0, frames};
+  std::unique_ptr<artdaq::Fragment> frag_ptr(artdaq::Fragment::FragmentBytes(
+      frames * sizeof(dune::frame14::frame14), 1, 1,
+      dune::toFragmentType("FELIX"), meta));
+  if (frames) {
+    memcpy(frag_ptr->dataBeginBytes(), frame.data(),
+           frames * sizeof(dune::frame14::frame14));
+  }
+  return frag_ptr;
+}
+
+void require_equal(const dune::Frame14Fragment& a,
+                   const dune::Frame14Fragment& b) {
+  BOOST_REQUIRE_EQUAL(a.total_frames(), b.total_frames());
+  const unsigned frames = a.total_frames();
+  for (unsigned f = 0; f < frames; ++f) {
+    BOOST_REQUIRE_EQUAL(a.link_mask(f), b.link_mask(f));
+    BOOST_REQUIRE_EQUAL(a.femb_valid(f), b.femb_valid(f));
+    BOOST_REQUIRE_EQUAL(a.fiber_no(f), b.fiber_no(f));
+    BOOST_REQUIRE_EQUAL(a.slot_no(f), b.slot_no(f));
+    BOOST_REQUIRE_EQUAL(a.crate_no(f), b.crate_no(f));
+    BOOST_REQUIRE_EQUAL(a.frame_version(f), b.frame_version(f));
+    BOOST_REQUIRE_EQUAL(a.wib_data(f), b.wib_data(f));
+    BOOST_REQUIRE_EQUAL(a.timestamp(f), b.timestamp(f));
+    BOOST_REQUIRE_EQUAL(a.crc20(f), b.crc20(f));
+    BOOST_REQUIRE_EQUAL(a.flex12(f), b.flex12(f));
+    BOOST_REQUIRE_EQUAL(a.flex24(f), b.flex24(f));
+    BOOST_REQUIRE_EQUAL(a.get_ADC(f, 1, 5), b.get_ADC(f, 1, 5));
+  }
+  BOOST_REQUIRE(a.get_ADCs_by_channel(77) == b.get_ADCs_by_channel(77));
+  BOOST_REQUIRE(a.get_all_ADCs() == b.get_all_ADCs());
+  std::vector<uint16_t> rows_a(256 * (frames + 1)), rows_b(rows_a.size());
+  a.get_all_ADCs(rows_a.data(), frames + 1);
+  b.get_all_ADCs(rows_b.data(), frames + 1);
+  BOOST_REQUIRE(rows_a == rows_b);
+}
+
+// Bit by bit CRC, least significant bit first.
+uint32_t reference_crc(const uint8_t* data, const size_t len,
+                       const dune::frame14::Crc20Params& params) {
+  uint32_t reflected = 0;
+  for (unsigned i = 0; i < 20; ++i) {
+    if ((params.poly >> i) & 1) reflected |= 1u << (19 - i);
+  }
+  uint32_t crc = params.init;
+  for (size_t i = 0; i < len; ++i) {
+    for (unsigned b = 0; b < 8; ++b) {
+      const bool bit = ((crc ^ (data[i] >> b)) & 1) != 0;
+      crc = (crc >> 1) ^ (bit ? reflected : 0);
+    }
+  }
+  return (crc ^ params.xorout) & 0xFFFFF;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(Frame14_test)
+
+BOOST_AUTO_TEST_CASE(UnpackTest) {
+  // The frame count is no multiple of the transpose width to exercise the
+  // tail, and the stride is larger than the frame count.
+  const unsigned frames = 53;
+  const size_t stride = frames + 3;
+  std::mt19937 gen(frames);
+  std::vector<uint16_t> samples(frames * 256);
+  for (auto &s : samples) s = gen() & 0x3FFF;
+  samples[0] = 0x3FFF;
+  samples[127] = 0x3FFF;
+  std::vector<dune::frame14::frame14> frame(frames);
+  for (unsigned f = 0; f < frames; ++f) {
+    memset(&frame[f], 0, sizeof(frame[f]));
+    frame[f].timestamp = 1000 + 32 * f;
+    pack14(&samples[f * 256], frame[f].femb_a_seg);
+    pack14(&samples[f * 256 + 128], frame[f].femb_b_seg);
+    frame[f].crc20 = 0xFFFFF;
+  }
+
+  const auto cpu = dune::FelixReorder::cpu_isa();
+  for (auto isa :
+       {dune::FelixReorder::ISA::baseline, dune::FelixReorder::ISA::avx2}) {
+    dune::FelixReorder::set_isa(isa);
+    for (unsigned f = 0; f < frames; ++f) {
+      uint16_t unpacked[256];
+      dune::frame14::unpack14_frame(frame[f], unpacked);
+      for (unsigned ch = 0; ch < 256; ++ch) {
+        BOOST_REQUIRE_EQUAL(unpacked[ch], samples[f * 256 + ch]);
+        BOOST_REQUIRE_EQUAL(
+            dune::frame14::unpack14(
+                ch < 128 ? frame[f].femb_a_seg : frame[f].femb_b_seg,
+                ch % 128),
+            samples[f * 256 + ch]);
+      }
+    }
+
+    std::vector<uint16_t> rows(256 * stride, 0xFFFF);
+    dune::frame14::unpack14_frames(frame.data(), frames, rows.data(), stride);
+    for (unsigned ch = 0; ch < 256; ++ch) {
+      for (unsigned f = 0; f < frames; ++f) {
+        BOOST_REQUIRE_EQUAL(rows[ch * stride + f], samples[f * 256 + ch]);
+      }
+      for (unsigned f = frames; f < stride; ++f) {
+        BOOST_REQUIRE_EQUAL(rows[ch * stride + f], 0xFFFF);
+      }
+    }
+  }
+  dune::FelixReorder::set_isa(cpu);
+
+  // The bulk accessor agrees with the single sample one.
+  dune::Frame14Fragment::Metadata meta = {0xabc, 1, 0, 0, frames, 0, frames};
+  std::unique_ptr<artdaq::Fragment> frag_ptr(artdaq::Fragment::FragmentBytes(
+      frames * sizeof(dune::frame14::frame14), 1, 1,
+      dune::toFragmentType("FELIX"), meta));
+  memcpy(frag_ptr->dataBeginBytes(), frame.data(),
+         frames * sizeof(dune::frame14::frame14));
+  dune::Frame14FragmentUnordered frag14(*frag_ptr);
+  std::vector<uint16_t> rows(256 * frames);
+  frag14.get_all_ADCs(rows.data());
+  const std::map<uint8_t, dune::Frame14Fragment::adc_v> all =
+      frag14.get_all_ADCs();
+  for (unsigned ch = 0; ch < 256; ++ch) {
+    for (unsigned f = 0; f < frames; ++f) {
+      BOOST_REQUIRE_EQUAL(rows[ch * frames + f], frag14.get_ADC(f, ch));
+      BOOST_REQUIRE_EQUAL(all.at(ch)[f], rows[ch * frames + f]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ReorderTest) {
+  const unsigned frames = 1013;
+  const std::vector<dune::frame14::frame14> frame = make_frames(frames);
+  std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frame);
+  std::unique_ptr<artdaq::Fragment> reordered = dune::Frame14Reorder(*frag_ptr);
+  BOOST_REQUIRE_EQUAL(reordered->dataSizeBytes(),
+                      dune::frame14::ReorderedLayout(frames).size(4));
+
+  std::unique_ptr<const dune::Frame14Fragment> unordered14(
+      dune::ParseFrame14Fragment(*frag_ptr));
+  std::unique_ptr<const dune::Frame14Fragment> reordered14(
+      dune::ParseFrame14Fragment(*reordered));
+  BOOST_REQUIRE(dynamic_cast<const dune::Frame14FragmentReordered*>(
+      reordered14.get()));
+  require_equal(*unordered14, *reordered14);
+  const dune::Frame14FragmentReordered& r =
+      static_cast<const dune::Frame14FragmentReordered&>(*reordered14);
+  for (unsigned f = 0; f < frames; ++f) {
+    BOOST_REQUIRE_EQUAL(r.header_is_faulty(f),
+                        f == 1 || f == 17 || f == 32 || f == frames - 1);
+  }
+
+  // Reordering is lossless.
+  std::vector<dune::frame14::frame14> restored(frames);
+  dune::frame14::unreorder(restored.data(), reordered->dataBeginBytes(),
+                           frames);
+  BOOST_REQUIRE_EQUAL(memcmp(restored.data(), frame.data(),
+                             frames * sizeof(dune::frame14::frame14)),
+                      0);
+}
+
+BOOST_AUTO_TEST_CASE(CompressTest) {
+  for (unsigned frames : {0u, 1u, 1013u}) {
+    const std::vector<dune::frame14::frame14> frame = make_frames(frames);
+    std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frame);
+    std::unique_ptr<artdaq::Fragment> reordered =
+        dune::Frame14Reorder(*frag_ptr);
+    std::unique_ptr<artdaq::Fragment> compressed =
+        dune::Frame14Compress(*frag_ptr);
+    // Raw and reordered data compress the same.
+    std::unique_ptr<artdaq::Fragment> recompressed =
+        dune::Frame14Compress(*reordered);
+    BOOST_REQUIRE_EQUAL(compressed->dataSizeBytes(),
+                        recompressed->dataSizeBytes());
+    BOOST_REQUIRE_EQUAL(memcmp(compressed->dataBeginBytes(),
+                               recompressed->dataBeginBytes(),
+                               compressed->dataSizeBytes()),
+                        0);
+    if (frames > 1) {
+      BOOST_REQUIRE_LT(compressed->dataSizeBytes(),
+                       frag_ptr->dataSizeBytes() / 2);
+    }
+
+    // Decompression restores the reordered data exactly.
+    const dune::Frame14Decompressor decompressor(
+        reinterpret_cast<const char*>(compressed->dataBeginBytes()),
+        compressed->dataSizeBytes());
+    // The fragment rounds its size up to words, so compare with the exact
+    // size of the reordered data.
+    std::vector<uint8_t> exact(
+        dune::frame14::ReorderedLayout(frames).max_size());
+    BOOST_REQUIRE_EQUAL(
+        decompressor.reordered_size(),
+        dune::frame14::reorder(exact.data(), frame.data(), frames));
+    dune::ReorderThreadPool pool(2);
+    dune::ReorderThreadPool* const pools[] = {nullptr, &pool};
+    for (dune::ReorderThreadPool* p : pools) {
+      std::vector<uint8_t> restored(decompressor.reordered_size());
+      decompressor.decompress(restored.data(), p);
+      BOOST_REQUIRE_EQUAL(memcmp(restored.data(), reordered->dataBeginBytes(),
+                                 restored.size()),
+                          0);
+    }
+
+    std::unique_ptr<const dune::Frame14Fragment> unordered14(
+        dune::ParseFrame14Fragment(*frag_ptr));
+    std::unique_ptr<const dune::Frame14Fragment> compressed14(
+        dune::ParseFrame14Fragment(*compressed));
+    BOOST_REQUIRE(dynamic_cast<const dune::Frame14FragmentCompressed*>(
+        compressed14.get()));
+    require_equal(*unordered14, *compressed14);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CorruptCompressTest) {
+  const unsigned frames = 1013;
+  const std::vector<dune::frame14::frame14> frame = make_frames(frames);
+  const std::vector<char> good = dune::Frame14Compress(frame.data(), frames);
+  dune::Frame14CompMeta meta;
+  memcpy(&meta, good.data(), sizeof(meta));
+  BOOST_REQUIRE_NO_THROW(dune::Frame14Decompressor(good.data(), good.size()));
+
+  // Truncated before the end of the metadata, the frequency table and the
+  // channel offsets.
+  const dune::frame14::ReorderedLayout layout(frames);
+  const size_t offsets = sizeof(meta) + layout.size(meta.num_faulty) -
+                         layout.crc_start() + meta.unique_values * 6;
+  for (size_t size : {size_t(0), sizeof(meta) - 1, offsets - 1,
+                      offsets + 1023}) {
+    BOOST_REQUIRE_THROW(dune::Frame14Decompressor(good.data(), size),
+                        cet::exception);
+  }
+
+  // Another version, inconsistent counts and a channel past the end.
+  std::vector<char> bad = good;
+  dune::Frame14CompMeta bad_meta = meta;
+  bad_meta.version = 2;
+  memcpy(bad.data(), &bad_meta, sizeof(bad_meta));
+  BOOST_REQUIRE_THROW(dune::Frame14Decompressor{bad}, cet::exception);
+  bad_meta = meta;
+  bad_meta.num_faulty += 1;
+  memcpy(bad.data(), &bad_meta, sizeof(bad_meta));
+  BOOST_REQUIRE_THROW(dune::Frame14Decompressor{bad}, cet::exception);
+  bad_meta = meta;
+  bad_meta.num_frames *= 100;
+  memcpy(bad.data(), &bad_meta, sizeof(bad_meta));
+  BOOST_REQUIRE_THROW(dune::Frame14Decompressor{bad}, cet::exception);
+  bad = good;
+  const uint32_t past_end = good.size();
+  memcpy(bad.data() + offsets + 100 * sizeof(uint32_t), &past_end,
+         sizeof(past_end));
+  BOOST_REQUIRE_THROW(dune::Frame14Decompressor{bad}, cet::exception);
+}
+
+BOOST_AUTO_TEST_CASE(CrcTest) {
+  std::mt19937 gen(20);
+  std::vector<uint8_t> data(1000);
+  for (auto& d : data) d = gen();
+  // Two arbitrary definitions; the checker takes any.
+  const dune::frame14::Crc20Params crc_params(0x8359F, 0xFFFFF, 0);
+  const dune::frame14::Crc20Params other(0x3559, 0, 0xABCDE);
+  for (const dune::frame14::Crc20Params& params : {crc_params, other}) {
+    const dune::frame14::Crc20 crc(params);
+    // Both methods, whichever compute() picks on this CPU.
+    auto check = [&](const uint8_t* bytes, const size_t len) {
+      const uint32_t expected = reference_crc(bytes, len, params);
+      BOOST_REQUIRE_EQUAL(crc.compute(bytes, len), expected);
+      BOOST_REQUIRE_EQUAL(
+          (crc.compute_baseline(bytes, len, params.init) ^ params.xorout) &
+              0xFFFFF,
+          expected);
+      if (dune::frame14::Crc20::clmul_available()) {
+        BOOST_REQUIRE_EQUAL(
+            (crc.compute_clmul(bytes, len, params.init) ^ params.xorout) &
+                0xFFFFF,
+            expected);
+      }
+    };
+    for (size_t len = 0; len < 300; len += 7) check(data.data() + 3, len);
+    check(data.data(), 464);
+  }
+
+  // Frames with correct CRCs but for a flipped sample bit, a flipped header
+  // bit and a changed CRC.
+  const unsigned frames = 1013;
+  std::vector<dune::frame14::frame14> frame = make_frames(frames);
+  const dune::frame14::Crc20 crc(crc_params);
+  for (auto& f : frame) {
+    f.crc20 = crc.frame_crc(f);
+    BOOST_REQUIRE(crc.check(f));
+  }
+  frame[5].femb_b_seg[20] ^= 0x100;
+  frame[64].wib_data ^= 1;
+  frame[1000].crc20 ^= 0x80000;
+  std::unique_ptr<artdaq::Fragment> frag_ptr = make_fragment(frame);
+  std::unique_ptr<artdaq::Fragment> reordered = dune::Frame14Reorder(*frag_ptr);
+  std::unique_ptr<artdaq::Fragment> compressed =
+      dune::Frame14Compress(*frag_ptr);
+  for (const artdaq::Fragment* frag :
+       {frag_ptr.get(), reordered.get(), compressed.get()}) {
+    std::unique_ptr<const dune::Frame14Fragment> frag14(
+        dune::ParseFrame14Fragment(*frag));
+    std::vector<uint64_t> bad;
+    BOOST_REQUIRE_EQUAL(frag14->crc_errors(bad, crc), 3);
+    BOOST_REQUIRE_EQUAL(bad.size(), 16);
+    for (unsigned f = 0; f < frames; ++f) {
+      BOOST_REQUIRE_EQUAL((bad[f / 64] >> (f % 64)) & 1,
+                          f == 5 || f == 64 || f == 1000);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma GCC diagnostic pop
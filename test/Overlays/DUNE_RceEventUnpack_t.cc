@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "dunepdlegacy/Overlays/RceEventUnpack.hh"
+#include "dunepdlegacy/Overlays/RceFragment.hh"
+#include "dunepdlegacy/rce/dam/TpcStreamUnpack.hh"
+
+#define BOOST_TEST_MODULE(RceEventUnpack_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+namespace {
+
+const unsigned frame_words = 30;
+
+// Event window of one stream over the frames [begin, end) of its packet.
+// A stream without ranges has no window and cannot be unpacked.
+struct Window {
+  unsigned begin;
+  unsigned end;
+  bool ranges;
+};
+
+// One TpcNormal data fragment with, per window, a stream holding one packet
+// of WIB frames of random ADCs. The stream records are those the unpacker
+// scans for: the ranges, the table of contents and the packet. As from the
+// RCEs, fragments have two streams; TpcFragment counts no fewer.
+std::vector<uint64_t> make_fragment(const std::vector<Window>& windows,
+                                    const unsigned frames,
+                                    std::mt19937_64& gen) {
+  const unsigned ranges_words = 7, toc_words = 2;
+  const unsigned packet_words = 1 + frames * frame_words;
+  const unsigned stream_words = 1 + ranges_words + toc_words + packet_words;
+  const unsigned num_words = 4 + windows.size() * stream_words + 1;
+  const uint64_t first_timestamp = 0x123456789;
+
+  std::vector<uint64_t> buf(num_words, 0);
+  buf[0] = 2 << 4 | uint64_t(num_words) << 8 | uint64_t(2) << 32 |
+           uint64_t(2) << 36 | uint64_t(0x8b309e) << 40;
+  buf[3] = 1 << 8;
+
+  uint64_t* p64 = &buf[4];
+  for (size_t i = 0; i < windows.size(); ++i) {
+    const Window& w = windows[i];
+    const uint32_t left = windows.size() - 1 - i;
+    p64[0] = 1 | 2 << 4 | uint64_t(stream_words) << 8 |
+             uint64_t(left << 16 | i << 4) << 32;
+
+    uint8_t* ranges = reinterpret_cast<uint8_t*>(p64 + 1);
+    const uint32_t header = 2 | (w.ranges ? 2 : 0) << 4 | ranges_words << 8;
+    const uint32_t indices[3] = {w.begin, w.end, w.begin};
+    const uint64_t timestamps[5] = {
+        first_timestamp, first_timestamp + 25 * (frames - 1),
+        first_timestamp + 25 * w.begin, first_timestamp + 25 * w.end,
+        first_timestamp + 25 * w.begin};
+    memcpy(ranges, &header, 4);
+    memcpy(ranges + 4, indices, sizeof(indices));
+    memcpy(ranges + 16, timestamps, sizeof(timestamps));
+
+    uint32_t* toc = reinterpret_cast<uint32_t*>(p64 + 1 + ranges_words);
+    toc[0] = 2 | 1 << 4 | toc_words << 8 | 1 << 24;
+    toc[1] = 1 << 4;
+    toc[2] = 1 << 4 | frames * frame_words << 8;
+
+    uint64_t* packet = p64 + 1 + ranges_words + toc_words;
+    packet[0] = 1 | 3 << 4 | uint64_t(packet_words) << 8;
+    for (unsigned f = 0; f < frames; ++f) {
+      uint64_t* frame = packet + 1 + f * frame_words;
+      for (unsigned k = 0; k < frame_words; ++k) frame[k] = gen();
+      frame[1] = first_timestamp + 25 * f;
+    }
+    p64 += stream_words;
+  }
+  return buf;
+}
+
+// Checks the matrix against each stream unpacked on its own.
+void check(const dune::RceEventUnpack& unpack,
+           const std::vector<dune::RceFragment const*>& rces) {
+  std::vector<TpcStreamUnpack const*> streams;
+  size_t max_ticks = 0;
+  for (auto const* rce : rces) {
+    for (int i = 0; i < rce->size(); ++i) {
+      streams.push_back(rce->get_stream(i));
+      max_ticks = std::max(max_ticks, streams.back()->getNTicks());
+    }
+  }
+  const size_t stride = (max_ticks + 31) / 32 * 32;
+  BOOST_REQUIRE_EQUAL(unpack.n_streams(), streams.size());
+  BOOST_REQUIRE_EQUAL(unpack.n_ticks(), max_ticks);
+  BOOST_REQUIRE_EQUAL(unpack.stride(), stride);
+
+  const size_t n_channels = dune::RceEventUnpack::n_channels;
+  std::vector<int16_t> reference(n_channels * stride);
+  std::vector<int16_t*> rows(n_channels);
+  for (size_t ichan = 0; ichan < n_channels; ++ichan) {
+    rows[ichan] = reference.data() + ichan * stride;
+  }
+  for (size_t istream = 0; istream < streams.size(); ++istream) {
+    const size_t ticks = streams[istream]->getNTicks();
+    BOOST_REQUIRE(unpack.stream(istream) == streams[istream]);
+    BOOST_REQUIRE_EQUAL(unpack.n_ticks(istream), ticks);
+    BOOST_REQUIRE_EQUAL(unpack.ok(istream), ticks > 0);
+    if (ticks) {
+      BOOST_REQUIRE(streams[istream]->getMultiChannelData(rows.data()));
+    }
+    for (size_t ichan = 0; ichan < n_channels; ++ichan) {
+      int16_t const* adcs = unpack.adcs(istream, ichan);
+      BOOST_REQUIRE(memcmp(adcs, rows[ichan], ticks * sizeof(int16_t)) == 0);
+      for (size_t itick = ticks; itick < stride; ++itick) {
+        BOOST_REQUIRE_EQUAL(adcs[itick], 0);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(RceEventUnpack_test)
+
+BOOST_AUTO_TEST_CASE(UnpackTest) {
+  std::mt19937_64 gen(11);
+  std::vector<std::vector<uint64_t>> bufs;
+  bufs.push_back(make_fragment({{0, 136, true}, {16, 88, true}}, 160, gen));
+  bufs.push_back(make_fragment({{8, 104, true}, {0, 0, false}}, 120, gen));
+  bufs.push_back(make_fragment({{24, 64, true}, {0, 56, true}}, 72, gen));
+
+  dune::RceFragments rces;
+  for (auto const& buf : bufs) rces.emplace_back(buf.data());
+  BOOST_REQUIRE_EQUAL(rces[0].size(), 2);
+  BOOST_REQUIRE_EQUAL(rces[1].size(), 2);
+  BOOST_REQUIRE_EQUAL(rces[2].size(), 2);
+
+  for (const unsigned num_threads : {1, 4}) {
+    dune::RceEventUnpack unpack(num_threads);
+    BOOST_REQUIRE_EQUAL(unpack.unpack(rces), 5u);
+    check(unpack, {&rces[0], &rces[1], &rces[2]});
+
+    // Reused matrix: the failing stream and shorter streams now land on
+    // rows that held longer streams.
+    const std::vector<dune::RceFragment const*> reordered = {
+        &rces[1], &rces[0], &rces[2]};
+    BOOST_REQUIRE_EQUAL(unpack.unpack(reordered), 5u);
+    check(unpack, reordered);
+
+    // Only the short fragment: the stride shrinks within the same memory.
+    BOOST_REQUIRE_EQUAL(unpack.unpack({&rces[2]}), 2u);
+    check(unpack, {&rces[2]});
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
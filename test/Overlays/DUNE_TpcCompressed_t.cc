@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "dunepdlegacy/rce/dam/access/TpcCompressed.hh"
+#include "dunepdlegacy/rce/dam/util/ThreadPool.hh"
+#include "dunepdlegacy/rce/src/BFU.h"
+
+#define BOOST_TEST_MODULE(TpcCompressed_t)
+#include "cetlib/quiet_unit_test.hpp"
+
+using pdd::access::TpcCompressed;
+
+namespace {
+
+const int num_channels = 128;
+const int num_samples = 1024;
+const int num_adcs = 1100;
+
+// Whether the symbol table at bit pos decodes to a histogram the decoder can
+// build its tables from, mirroring the table decoding of TpcCompressed.cc.
+bool table_ok(const std::vector<uint64_t>& buf, int pos) {
+  BFU bfu;
+  _bfu_put(bfu, buf[pos >> 6], pos);
+  _bfu_extractR(bfu, buf.data(), pos, 4);
+  const int nbins = _bfu_extractR(bfu, buf.data(), pos, 8) + 1;
+  const int mbits = _bfu_extractR(bfu, buf.data(), pos, 4);
+  _bfu_extractR(bfu, buf.data(), pos, 12);
+  _bfu_extractR(bfu, buf.data(), pos, 4);
+  int left = num_samples - 1, nbits = mbits, total = 0, first = 0;
+  for (int bin = 0; bin < nbins; ++bin) {
+    const int count = left ? _bfu_extractR(bfu, buf.data(), pos, nbits) : 0;
+    if (bin == 0) first = count;
+    total += count;
+    left -= count;
+    nbits = std::min(32 - __builtin_clz(left), mbits);
+  }
+  return nbins >= 4 && nbins <= 64 && total > 64 && total < 65536 && first > 0;
+}
+
+// A compressed record of random channel bit streams behind tables that
+// decode. The samples are not meaningful, only the same for any thread count.
+std::vector<uint64_t> make_record() {
+  const int spacing = 600;
+  const int toc_words = num_channels / 2 + 1;
+  const int num_words = 16 + num_channels * spacing + toc_words;
+  std::vector<uint64_t> buf(num_words);
+  std::mt19937_64 gen(7);
+  for (auto& word : buf) word = gen();
+  buf[0] = 0;
+
+  uint32_t* offsets = reinterpret_cast<uint32_t*>(&buf[num_words - toc_words]);
+  for (int i = 0; i < num_channels; ++i) {
+    const uint32_t pos = 64 * (16 + i * spacing) + (i * 7) % 64;
+    offsets[i] = pos;
+    while (!table_ok(buf, pos)) {
+      buf[pos >> 6] = gen();
+      buf[(pos >> 6) + 1] = gen();
+    }
+  }
+  buf.back() = (uint64_t(toc_words) << 8) | (uint64_t(num_samples - 1) << 28) |
+               (uint64_t(num_channels - 1) << 40);
+  return buf;
+}
+
+// One of the four decompress overloads into adcs, which starts out as -1.
+uint32_t decompress(TpcCompressed& record, const int overload,
+                    std::vector<int16_t>& adcs) {
+  adcs.assign(num_channels * num_adcs, -1);
+  std::vector<int16_t*> rows(num_channels);
+  for (int i = 0; i < num_channels; ++i) rows[i] = adcs.data() + i * num_adcs;
+  switch (overload) {
+    case 0:
+      return record.decompress(adcs.data(), num_adcs, 1000);
+    case 1:
+      return record.decompress(adcs.data(), num_adcs, 100, 900);
+    case 2:
+      return record.decompress(rows.data(), 3, 1000);
+    default:
+      return record.decompress(rows.data(), 3, 100, 900);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(TpcCompressed_test)
+
+BOOST_AUTO_TEST_CASE(ThreadsTest) {
+  std::vector<uint64_t> buf = make_record();
+  TpcCompressed record(buf.data(), buf.size());
+
+  for (int overload = 0; overload < 4; ++overload) {
+    std::vector<int16_t> serial, parallel;
+    TpcCompressed::setNThreads(1);
+    const uint32_t count = decompress(record, overload, serial);
+    BOOST_REQUIRE(count > 0);
+
+    TpcCompressed::setNThreads(4);
+    BOOST_REQUIRE_EQUAL(decompress(record, overload, parallel), count);
+    BOOST_REQUIRE(parallel == serial);
+
+    // A second caller while the pool is busy decodes on its own thread.
+    std::vector<int16_t> other;
+    uint32_t other_count = 0;
+    std::thread thread([&] {
+      for (int i = 0; i < 20; ++i) other_count = decompress(record, overload, other);
+    });
+    for (int i = 0; i < 20; ++i) {
+      BOOST_REQUIRE_EQUAL(decompress(record, overload, parallel), count);
+    }
+    thread.join();
+    BOOST_REQUIRE(parallel == serial);
+    BOOST_REQUIRE_EQUAL(other_count, count);
+    BOOST_REQUIRE(other == serial);
+
+    // Jobs of the pool find it busy and decode their records serially.
+    std::vector<std::vector<int16_t>> nested(8);
+    std::vector<uint32_t> nested_counts(nested.size());
+    TpcCompressed::getThreadPool().run(nested.size(), [&](unsigned i) {
+      nested_counts[i] = decompress(record, overload, nested[i]);
+    });
+    for (size_t i = 0; i < nested.size(); ++i) {
+      BOOST_REQUIRE_EQUAL(nested_counts[i], count);
+      BOOST_REQUIRE(nested[i] == serial);
+    }
+  }
+  TpcCompressed::setNThreads(1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()